@@ -37,6 +37,11 @@ let package = Package(
             path: "Sources/FastClusterWrapper",
             publicHeadersPath: "include"
         ),
+        .executableTarget(
+            name: "FastClusterBenchmark",
+            dependencies: ["FastClusterWrapper"],
+            path: "Sources/FastClusterBenchmark"
+        ),
         .executableTarget(
             name: "FluidAudioCLI",
             dependencies: ["FluidAudio"],
@@ -48,7 +53,10 @@ let package = Package(
         ),
         .testTarget(
             name: "FluidAudioTests",
-            dependencies: ["FluidAudio"]
+            dependencies: [
+                "FluidAudio",
+                "FastClusterWrapper",
+            ]
         ),
     ],
     cxxLanguageStandard: .cxx17
@@ -0,0 +1,2214 @@
+// Native benchmarks for the FastClusterWrapper target.
+//
+// Usage: swift run -c release FastClusterBenchmark <command> [arguments]
+//
+// Commands:
+//   kernels     Squared-Euclidean kernels vs. the historical scalar loop.
+//   precision   Float32 centroid linkage vs. the double path.
+//   scaling     Threaded nearest-neighbour initialization and merge loop,
+//               1-16 threads.
+//               Optional argument: largest N to run (default 30000).
+//   methods     Every linkage method of fastcluster_compute_linkage.
+//   workspace   Back-to-back clusterings with and without a reused workspace.
+//               Optional argument: number of clusterings (default 1000).
+//   batch       Many recordings clustered in one batch call vs. one by one.
+//               Optional argument: number of recordings (default 48).
+//   distances   Blocked vs. pairwise condensed distance matrix construction.
+//   approximate Micro-cluster approximate clustering vs. exact, by error budget.
+//               Optional argument: number of points (default 10000).
+//   incremental Incremental centroid linkage as chunks arrive vs. full reruns.
+//               Optional argument: number of points (default 4000).
+//   control     Cost of progress checks, and how fast cancel and time budgets stop.
+//               Optional argument: number of points (default 4000).
+//   structures  Active-set and heap variants of centroid linkage, by N and D.
+//   index       32-bit vs. 64-bit index builds of single, centroid and median.
+//   half        Float16 and bfloat16 input rows vs. float64: time and label drift.
+//   constraints Centroid linkage under must-link and cannot-link pairs vs. none.
+//               Optional argument: number of points (default 4000).
+//   weights     Pre-merged chunks as weighted points vs. every chunk.
+//               Optional argument: number of chunks (default 8000).
+//   vbx         Native VBx on PLDA-space frames vs. a step-by-step reference:
+//               time and gamma, pi and ELBO agreement.
+//               Optional argument: largest frame count (default 50000).
+//   vbxprecision Float32 VBx vs. float64: time, ELBO drift and frame DER.
+//               Optional argument: largest frame count (default 50000).
+//   vbxscaling  Threaded VBx E-step at 1, 4, 8 and 16 threads.
+//               Optional argument: number of frames (default 200000).
+//   vbxprune    VBx from an over-clustered warm start with and without speaker
+//               pruning and the gamma convergence test: time, speakers, DER.
+//               Optional argument: number of frames (default 50000).
+//   plda        Blocked native PLDA transform vs. one embedding at a time into
+//               nested arrays: time and agreement.
+//               Optional argument: largest embedding count (default 50000).
+//   suite       Centroid linkage across N, D, cluster and thread counts, plus
+//               recordings laid out like OfflineEmbeddingExtractor output.
+//               Reports ns/merge, allocations, peak heap and peak RSS.
+//               Arguments: [--quick] [--repeats N] [--json PATH]
+//
+// Without SwiftPM, for example on Linux CI, build from the package root with
+//   c++ -std=c++17 -O2 -pthread -ISources/FastClusterWrapper/include
+//       Sources/FastClusterWrapper/*.cpp Sources/FastClusterBenchmark/main.cpp -o FastClusterBenchmark
+
+#include "FastClusterWrapper.h"
+#include "../FastClusterWrapper/FastClusterKernels.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <new>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+// Every operator new in the process, counted so that the workspace benchmark
+// can show that a warm workspace clusters without allocating. Each block
+// carries its size in a header so the suite can report a call's peak heap.
+static std::atomic<size_t> heapAllocations(0);
+static std::atomic<size_t> heapLiveBytes(0);
+static std::atomic<size_t> heapPeakBytes(0);
+static constexpr size_t kHeapHeader = alignof(std::max_align_t);
+
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC flags free() in a replacement operator delete, and the read of the size
+// header in front of the block, once it inlines them into callers of new.
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#pragma GCC diagnostic ignored "-Warray-bounds"
+#endif
+
+void *operator new(size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    char *block = size <= SIZE_MAX - kHeapHeader ? static_cast<char *>(std::malloc(size + kHeapHeader)) : nullptr;
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    std::memcpy(block, &size, sizeof(size));
+    const size_t live = heapLiveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak = heapPeakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !heapPeakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+    return block + kHeapHeader;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    try {
+        return operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *pointer) noexcept {
+    if (pointer == nullptr) {
+        return;
+    }
+    char *block = static_cast<char *>(pointer) - kHeapHeader;
+    size_t size;
+    std::memcpy(&size, block, sizeof(size));
+    heapLiveBytes.fetch_sub(size, std::memory_order_relaxed);
+    std::free(block);
+}
+
+void operator delete[](void *pointer) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+    operator delete(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+    operator delete(pointer);
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::vector<double> gaussianMatrix(size_t rows, size_t dimension, unsigned seed) {
+    std::mt19937_64 generator(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<double> values(rows * dimension);
+    for (double &value : values) {
+        value = normal(generator);
+    }
+    return values;
+}
+
+// Unit-norm vectors scattered around `speakers` random centres, mimicking the
+// L2-normalized speaker embeddings AHCClustering feeds to the wrapper.
+std::vector<double> speakerMixture(size_t rows, size_t dimension, size_t speakers, double spread, unsigned seed) {
+    std::mt19937_64 generator(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_int_distribution<size_t> pick(0, speakers - 1);
+    const std::vector<double> centres = gaussianMatrix(speakers, dimension, seed ^ 0x9e3779b9u);
+    std::vector<double> values(rows * dimension);
+    for (size_t i = 0; i < rows; ++i) {
+        const double *centre = centres.data() + pick(generator) * dimension;
+        double *row = values.data() + i * dimension;
+        double norm = 0;
+        for (size_t k = 0; k < dimension; ++k) {
+            row[k] = centre[k] + spread * normal(generator);
+            norm += row[k] * row[k];
+        }
+        const double scale = 1.0 / std::sqrt(norm);
+        for (size_t k = 0; k < dimension; ++k) {
+            row[k] *= scale;
+        }
+    }
+    return values;
+}
+
+// Chunk embeddings of a long recording: consecutive chunks belong to one
+// speaker turn and scatter tightly around it; turns scatter around their
+// speaker. Unit norm, like speakerMixture.
+std::vector<double> speakerTurns(size_t rows, size_t dimension, size_t speakers, size_t turns, unsigned seed) {
+    std::mt19937_64 generator(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_int_distribution<size_t> pick(0, speakers - 1);
+    const std::vector<double> centres = gaussianMatrix(speakers, dimension, seed ^ 0x9e3779b9u);
+    std::vector<double> turnCentres(turns * dimension);
+    for (size_t t = 0; t < turns; ++t) {
+        const double *centre = centres.data() + pick(generator) * dimension;
+        for (size_t k = 0; k < dimension; ++k) {
+            turnCentres[t * dimension + k] = centre[k] + 0.6 * normal(generator);
+        }
+    }
+    std::vector<double> values(rows * dimension);
+    for (size_t i = 0; i < rows; ++i) {
+        const double *turn = turnCentres.data() + (i * turns / rows) * dimension;
+        double *row = values.data() + i * dimension;
+        double norm = 0;
+        for (size_t k = 0; k < dimension; ++k) {
+            row[k] = turn[k] + 0.2 * normal(generator);
+            norm += row[k] * row[k];
+        }
+        const double scale = 1.0 / std::sqrt(norm);
+        for (size_t k = 0; k < dimension; ++k) {
+            row[k] *= scale;
+        }
+    }
+    return values;
+}
+
+// Embeddings laid out like OfflineEmbeddingExtractor output for a recording of
+// `seconds`: 10 s windows every 2 s (the community segmentation defaults),
+// one 256-dim embedding per local speaker active for at least 1 s of the
+// window, at most 3 per window, window by window. Turns last about 5 s, a few
+// speakers hold most of the talk time, and short interjections overlap turns.
+// An embedding mixes a recording-wide channel component, its speaker, the
+// turns it covers and a little of the other speakers in the window, so
+// overlapping windows of one turn come out strongly correlated: cosine
+// similarity averages about 0.9 within a turn, 0.75 within a speaker and 0.15
+// across speakers. Rows keep a varying raw norm, which the cosine metric
+// divides out, and float precision.
+struct ExtractorFixture {
+    std::vector<double> values;
+    std::vector<size_t> labels;
+    size_t rows = 0;
+};
+
+ExtractorFixture extractorFixture(double seconds, size_t speakers, unsigned seed) {
+    const size_t dimension = 256;
+    const double windowSeconds = 10.0;
+    const double stepSeconds = 2.0;
+    const double minimumActivity = 1.0;
+    const size_t maximumLocalSpeakers = 3;
+
+    struct Segment {
+        size_t speaker;
+        double start;
+        double end;
+    };
+    std::mt19937_64 generator(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::exponential_distribution<double> turnLength(1.0 / 5.0);
+    std::vector<double> talkShare(speakers);
+    for (size_t s = 0; s < speakers; ++s) {
+        talkShare[s] = 1.0 / static_cast<double>(s + 1);
+    }
+    std::discrete_distribution<size_t> pickSpeaker(talkShare.begin(), talkShare.end());
+
+    std::vector<Segment> segments;
+    size_t previous = speakers;
+    for (double time = 0; time < seconds;) {
+        size_t speaker = pickSpeaker(generator);
+        if (speaker == previous && speakers > 1) {
+            speaker = (speaker + 1) % speakers;
+        }
+        const double end = std::min(seconds, time + std::min(30.0, 0.5 + turnLength(generator)));
+        segments.push_back({speaker, time, end});
+        if (speakers > 1 && uniform(generator) < 0.15) {
+            const double start = time + uniform(generator) * (end - time);
+            segments.push_back({(speaker + 1 + generator() % (speakers - 1)) % speakers, start,
+                                std::min(seconds, start + 0.5 + 2.0 * uniform(generator))});
+        }
+        previous = speaker;
+        time = end + (uniform(generator) < 0.2 ? 2.0 * uniform(generator) : 0.0);
+    }
+
+    const std::vector<double> centres = gaussianMatrix(speakers, dimension, seed ^ 0x9e3779b9u);
+    std::vector<double> channel(dimension);
+    for (double &value : channel) {
+        value = 0.4 * normal(generator);
+    }
+    std::vector<double> turns(segments.size() * dimension);
+    for (size_t t = 0; t < segments.size(); ++t) {
+        const double *centre = centres.data() + segments[t].speaker * dimension;
+        for (size_t k = 0; k < dimension; ++k) {
+            turns[t * dimension + k] = centre[k] + 0.5 * normal(generator);
+        }
+    }
+
+    ExtractorFixture fixture;
+    std::vector<double> activity(speakers);
+    std::vector<size_t> local;
+    std::vector<double> row(dimension);
+    for (double start = 0; start + windowSeconds <= seconds; start += stepSeconds) {
+        const double end = start + windowSeconds;
+        std::fill(activity.begin(), activity.end(), 0.0);
+        for (const Segment &segment : segments) {
+            activity[segment.speaker] += std::max(0.0, std::min(end, segment.end) - std::max(start, segment.start));
+        }
+        local.clear();
+        for (size_t s = 0; s < speakers; ++s) {
+            if (activity[s] >= minimumActivity) {
+                local.push_back(s);
+            }
+        }
+        std::sort(local.begin(), local.end(), [&](size_t a, size_t b) { return activity[a] > activity[b]; });
+        local.resize(std::min(local.size(), maximumLocalSpeakers));
+        for (const size_t speaker : local) {
+            for (size_t k = 0; k < dimension; ++k) {
+                row[k] = channel[k] + 0.4 * normal(generator);
+            }
+            for (size_t t = 0; t < segments.size(); ++t) {
+                const double overlap =
+                    std::max(0.0, std::min(end, segments[t].end) - std::max(start, segments[t].start));
+                if (segments[t].speaker == speaker && overlap > 0) {
+                    const double weight = overlap / activity[speaker];
+                    for (size_t k = 0; k < dimension; ++k) {
+                        row[k] += weight * turns[t * dimension + k];
+                    }
+                }
+            }
+            for (const size_t other : local) {
+                const double leak = other == speaker ? 0.0 : 0.25 * activity[other] / windowSeconds;
+                for (size_t k = 0; leak > 0 && k < dimension; ++k) {
+                    row[k] += leak * centres[other * dimension + k];
+                }
+            }
+            const double scale = std::exp(0.2 * normal(generator));
+            for (size_t k = 0; k < dimension; ++k) {
+                fixture.values.push_back(static_cast<float>(scale * row[k]));
+            }
+            fixture.labels.push_back(speaker);
+            ++fixture.rows;
+        }
+    }
+    return fixture;
+}
+
+// Flat labels from a SciPy-format dendrogram: merges at or below `threshold`.
+std::vector<size_t> cutDendrogram(const std::vector<double> &dendrogram, size_t rows, double threshold) {
+    std::vector<size_t> parent(2 * rows - 1);
+    std::iota(parent.begin(), parent.end(), size_t{0});
+    auto find = [&parent](size_t node) {
+        while (parent[node] != node) {
+            node = parent[node] = parent[parent[node]];
+        }
+        return node;
+    };
+    for (size_t merge = 0; merge + 1 < rows; ++merge) {
+        if (dendrogram[merge * 4 + 2] <= threshold) {
+            const size_t node = rows + merge;
+            parent[find(static_cast<size_t>(dendrogram[merge * 4]))] = node;
+            parent[find(static_cast<size_t>(dendrogram[merge * 4 + 1]))] = node;
+        }
+    }
+    std::vector<size_t> labels(rows);
+    std::map<size_t, size_t> dense;
+    for (size_t i = 0; i < rows; ++i) {
+        labels[i] = dense.emplace(find(i), dense.size()).first->second;
+    }
+    return labels;
+}
+
+// Adjusted Rand index between two labelings of the same points.
+double adjustedRandIndex(const std::vector<size_t> &a, const std::vector<size_t> &b) {
+    std::map<std::pair<size_t, size_t>, double> joint;
+    std::map<size_t, double> rowsA;
+    std::map<size_t, double> rowsB;
+    for (size_t i = 0; i < a.size(); ++i) {
+        joint[{a[i], b[i]}] += 1;
+        rowsA[a[i]] += 1;
+        rowsB[b[i]] += 1;
+    }
+    auto pairs = [](double n) { return n * (n - 1) / 2; };
+    double sumJoint = 0;
+    double sumA = 0;
+    double sumB = 0;
+    for (const auto &entry : joint) sumJoint += pairs(entry.second);
+    for (const auto &entry : rowsA) sumA += pairs(entry.second);
+    for (const auto &entry : rowsB) sumB += pairs(entry.second);
+    const double expected = sumA * sumB / pairs(static_cast<double>(a.size()));
+    const double maximum = 0.5 * (sumA + sumB);
+    if (maximum == expected) {
+        return 1.0;
+    }
+    return (sumJoint - expected) / (maximum - expected);
+}
+
+// Cosine-similarity threshold expressed as a Euclidean distance between unit vectors.
+double cosineThresholdToDistance(double similarity) {
+    return std::sqrt(std::max(0.0, 2.0 - 2.0 * similarity));
+}
+
+// The loop CentroidDissimilarity used before the kernels were split out.
+double legacySqeuclidean(const double *pi, const double *pj, size_t dimension) {
+    double sum = 0;
+    for (size_t k = 0; k < dimension; ++k) {
+        const double diff = pi[k] - pj[k];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+template <typename Kernel>
+double timePairs(Kernel kernel, const std::vector<double> &rows, size_t rowCount, size_t dimension,
+                 std::vector<double> &results, size_t &pairCount) {
+    // Triangular sweep like the nearest-neighbour initialization; repeated until
+    // the measurement is long enough to be stable.
+    double elapsed = 0;
+    size_t repetitions = 0;
+    pairCount = 0;
+    const auto start = Clock::now();
+    do {
+        size_t cursor = 0;
+        for (size_t i = 1; i < rowCount; ++i) {
+            const double *pi = rows.data() + i * dimension;
+            for (size_t j = 0; j < i; ++j) {
+                results[cursor++] = kernel(pi, rows.data() + j * dimension, dimension);
+            }
+        }
+        pairCount += cursor;
+        ++repetitions;
+        elapsed = secondsSince(start);
+    } while (elapsed < 0.25 || repetitions < 3);
+    return elapsed;
+}
+
+int runKernels(int, char **) {
+    using namespace fastcluster_kernels;
+    const size_t rowCount = 512;
+    const size_t dimensions[] = {128, 192, 256, 512};
+    const simd_level levels[] = {simd_level::scalar, simd_level::neon, simd_level::avx2, simd_level::avx512};
+
+    std::printf("detected SIMD level: %s\n", simd_level_name(detected_simd_level()));
+    std::printf("%-6s %-8s %12s %10s %14s\n", "dim", "kernel", "ns/pair", "speedup", "max rel diff");
+
+    for (const size_t dimension : dimensions) {
+        const std::vector<double> rows = gaussianMatrix(rowCount, dimension, 42u + static_cast<unsigned>(dimension));
+        const size_t pairsPerSweep = rowCount * (rowCount - 1) / 2;
+        std::vector<double> reference(pairsPerSweep);
+        std::vector<double> candidate(pairsPerSweep);
+
+        size_t pairs = 0;
+        const double legacySeconds = timePairs(legacySqeuclidean, rows, rowCount, dimension, reference, pairs);
+        const double legacyNs = legacySeconds * 1e9 / static_cast<double>(pairs);
+        std::printf("%-6zu %-8s %12.2f %10.2f %14s\n", dimension, "legacy", legacyNs, 1.0, "-");
+
+        for (const simd_level level : levels) {
+            const sqeuclidean_f64_fn kernel = sqeuclidean_f64_for_level(level);
+            if (kernel == nullptr) {
+                continue;
+            }
+            const double seconds = timePairs(kernel, rows, rowCount, dimension, candidate, pairs);
+            const double ns = seconds * 1e9 / static_cast<double>(pairs);
+            double maxRelative = 0;
+            for (size_t p = 0; p < pairsPerSweep; ++p) {
+                const double relative = std::fabs(candidate[p] - reference[p]) / std::max(reference[p], 1e-300);
+                maxRelative = std::max(maxRelative, relative);
+            }
+            std::printf("%-6zu %-8s %12.2f %10.2f %14.3e\n", dimension, simd_level_name(level), ns, legacyNs / ns,
+                        maxRelative);
+        }
+    }
+    return 0;
+}
+
+int runPrecision(int, char **) {
+    const size_t dimension = 256;
+    const size_t sizes[] = {1000, 2000, 5000};
+    const double threshold = cosineThresholdToDistance(0.6);
+
+    std::printf("%-6s %10s %10s %8s %12s %12s %10s %8s\n", "N", "f64 ms", "f32 ms", "speedup", "max |dd|",
+                "max rel dd", "same pair", "ARI");
+    for (const size_t rows : sizes) {
+        const std::vector<double> data64 = speakerMixture(rows, dimension, 12, 0.9, static_cast<unsigned>(rows));
+        const std::vector<float> data32(data64.begin(), data64.end());
+        std::vector<double> dendrogram64((rows - 1) * 4);
+        std::vector<double> dendrogram32((rows - 1) * 4);
+
+        auto start = Clock::now();
+        fastcluster_compute_centroid_linkage(data64.data(), rows, dimension, dendrogram64.data(), dendrogram64.size());
+        const double seconds64 = secondsSince(start);
+        start = Clock::now();
+        fastcluster_compute_centroid_linkage_f32(
+            data32.data(), rows, dimension, dendrogram32.data(), dendrogram32.size());
+        const double seconds32 = secondsSince(start);
+
+        double maxAbsolute = 0;
+        double maxRelative = 0;
+        size_t samePair = 0;
+        for (size_t merge = 0; merge + 1 < rows; ++merge) {
+            const double *row64 = dendrogram64.data() + merge * 4;
+            const double *row32 = dendrogram32.data() + merge * 4;
+            if (row64[0] == row32[0] && row64[1] == row32[1]) {
+                ++samePair;
+                const double delta = std::fabs(row64[2] - row32[2]);
+                maxAbsolute = std::max(maxAbsolute, delta);
+                maxRelative = std::max(maxRelative, delta / std::max(row64[2], 1e-12));
+            }
+        }
+        const double ari = adjustedRandIndex(
+            cutDendrogram(dendrogram64, rows, threshold), cutDendrogram(dendrogram32, rows, threshold));
+        std::printf("%-6zu %10.1f %10.1f %8.2f %12.3e %12.3e %9.1f%% %8.4f\n", rows, seconds64 * 1e3,
+                    seconds32 * 1e3, seconds64 / seconds32, maxAbsolute, maxRelative,
+                    100.0 * static_cast<double>(samePair) / static_cast<double>(rows - 1), ari);
+    }
+    return 0;
+}
+
+// Time of the last progress check before the first merge, which splits a run
+// into its nearest-neighbour initialization and its merge loop.
+struct MergeLoopClock {
+    Clock::time_point lastInitializationCheck;
+
+    static int record(void *context, size_t completedMerges, size_t) {
+        if (completedMerges == 0) {
+            static_cast<MergeLoopClock *>(context)->lastInitializationCheck = Clock::now();
+        }
+        return 0;
+    }
+};
+
+int runScaling(int argc, char **argv) {
+    const size_t dimension = 256;
+    const size_t maximumRows = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 30000;
+    const size_t sizes[] = {2000, 10000, 30000};
+    const size_t threadCounts[] = {1, 2, 4, 8, 16};
+
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    std::printf("%-6s %-8s %12s %10s %12s %10s %10s\n", "N", "threads", "ms", "speedup", "merge ms", "speedup",
+                "identical");
+    for (const size_t rows : sizes) {
+        if (rows > maximumRows) {
+            continue;
+        }
+        const std::vector<double> data = speakerMixture(rows, dimension, 24, 0.9, static_cast<unsigned>(rows));
+        std::vector<double> reference((rows - 1) * 4);
+        std::vector<double> dendrogram((rows - 1) * 4);
+        double serialSeconds = 0;
+        double serialMergeSeconds = 0;
+        for (const size_t threads : threadCounts) {
+            MergeLoopClock mergeClock;
+            fastcluster_run_control control = {MergeLoopClock::record, &mergeClock, 0};
+            fastcluster_linkage_options options;
+            fastcluster_linkage_options_init(&options);
+            options.threadCount = threads;
+            options.control = &control;
+            std::vector<double> &output = threads == 1 ? reference : dendrogram;
+            const auto start = Clock::now();
+            mergeClock.lastInitializationCheck = start;
+            fastcluster_compute_centroid_linkage_with_options(
+                data.data(), rows, dimension, &options, output.data(), output.size());
+            const double seconds = secondsSince(start);
+            const double mergeSeconds = secondsSince(mergeClock.lastInitializationCheck);
+            if (threads == 1) {
+                serialSeconds = seconds;
+                serialMergeSeconds = mergeSeconds;
+            }
+            const bool identical = std::memcmp(reference.data(), output.data(), output.size() * sizeof(double)) == 0;
+            std::printf("%-6zu %-8zu %12.1f %10.2f %12.1f %10.2f %10s\n", rows, threads, seconds * 1e3,
+                        serialSeconds / seconds, mergeSeconds * 1e3, serialMergeSeconds / mergeSeconds,
+                        identical ? "yes" : "NO");
+        }
+    }
+    return 0;
+}
+
+int runMethods(int, char **) {
+    struct Method {
+        fastcluster_method method;
+        const char *name;
+    };
+    const Method methods[] = {
+        {FASTCLUSTER_METHOD_SINGLE, "single"},     {FASTCLUSTER_METHOD_COMPLETE, "complete"},
+        {FASTCLUSTER_METHOD_AVERAGE, "average"},   {FASTCLUSTER_METHOD_WEIGHTED, "weighted"},
+        {FASTCLUSTER_METHOD_WARD, "ward"},         {FASTCLUSTER_METHOD_CENTROID, "centroid"},
+        {FASTCLUSTER_METHOD_MEDIAN, "median"},
+    };
+    const size_t dimension = 256;
+    const size_t sizes[] = {1000, 2000, 5000};
+
+    std::printf("%-6s %-10s %12s %14s\n", "N", "method", "ms", "ns/merge");
+    for (const size_t rows : sizes) {
+        const std::vector<double> data = speakerMixture(rows, dimension, 12, 0.9, static_cast<unsigned>(rows));
+        std::vector<double> dendrogram((rows - 1) * 4);
+        for (const Method &method : methods) {
+            const auto start = Clock::now();
+            const fastcluster_wrapper_status status = fastcluster_compute_linkage(
+                method.method, FASTCLUSTER_METRIC_EUCLIDEAN, data.data(), rows, dimension, nullptr,
+                dendrogram.data(), dendrogram.size());
+            const double seconds = secondsSince(start);
+            if (status != FASTCLUSTER_WRAPPER_SUCCESS) {
+                std::printf("%-6zu %-10s failed with status %d\n", rows, method.name, static_cast<int>(status));
+                continue;
+            }
+            std::printf("%-6zu %-10s %12.1f %14.0f\n", rows, method.name, seconds * 1e3,
+                        seconds * 1e9 / static_cast<double>(rows - 1));
+        }
+    }
+    return 0;
+}
+
+int runWorkspace(int argc, char **argv) {
+    const size_t rounds = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 1000;
+    const size_t rows = 500;
+    const size_t dimension = 256;
+    // A few recordings' worth of embeddings, reclustered in turn, as the
+    // streaming diarizer does.
+    std::vector<std::vector<double>> inputs;
+    for (unsigned seed = 1; seed <= 8; ++seed) {
+        inputs.push_back(speakerMixture(rows, dimension, 6, 0.9, seed));
+    }
+
+    fastcluster_workspace *workspace = fastcluster_workspace_create(rows, dimension);
+    if (workspace == nullptr) {
+        std::printf("workspace creation failed\n");
+        return 1;
+    }
+
+    struct Mode {
+        const char *name;
+        fastcluster_workspace *workspace;
+    };
+    const Mode modes[] = {{"per-call", nullptr}, {"workspace", workspace}};
+    std::vector<std::vector<double>> dendrograms(2, std::vector<double>((rows - 1) * 4));
+
+    std::printf("%zu centroid/cosine clusterings of %zu x %zu\n\n", rounds, rows, dimension);
+    std::printf("%-10s %12s %12s %16s\n", "mode", "total ms", "us/call", "allocs/call");
+    double perCallSeconds = 0;
+    for (size_t m = 0; m < 2; ++m) {
+        fastcluster_linkage_options options;
+        fastcluster_linkage_options_init(&options);
+        options.workspace = modes[m].workspace;
+        std::vector<double> &dendrogram = dendrograms[m];
+
+        size_t failures = 0;
+        const size_t allocationsBefore = heapAllocations.load();
+        const auto start = Clock::now();
+        for (size_t round = 0; round < rounds; ++round) {
+            const std::vector<double> &input = inputs[round % inputs.size()];
+            fastcluster_matrix matrix = {input.data(), FASTCLUSTER_SCALAR_FLOAT64, rows, dimension, 0};
+            failures += fastcluster_compute_linkage_matrix(FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_COSINE,
+                                                           &matrix, &options, dendrogram.data(),
+                                                           dendrogram.size()) != FASTCLUSTER_WRAPPER_SUCCESS;
+        }
+        const double seconds = secondsSince(start);
+        const size_t allocations = heapAllocations.load() - allocationsBefore;
+        if (m == 0) {
+            perCallSeconds = seconds;
+        }
+        std::printf("%-10s %12.1f %12.1f %16.2f%s\n", modes[m].name, seconds * 1e3,
+                    seconds * 1e6 / static_cast<double>(rounds),
+                    static_cast<double>(allocations) / static_cast<double>(rounds), failures ? "  FAILED" : "");
+        if (m == 1) {
+            std::printf("\nspeedup %.2fx, identical dendrograms: %s\n", perCallSeconds / seconds,
+                        dendrograms[0] == dendrograms[1] ? "yes" : "NO");
+        }
+    }
+
+    fastcluster_workspace_stats stats;
+    fastcluster_workspace_get_stats(workspace, &stats);
+    std::printf("workspace: %zu calls, %zu buffer allocations, %.1f KiB reserved\n", stats.callCount,
+                stats.allocationCount, static_cast<double>(stats.reservedBytes) / 1024.0);
+    fastcluster_workspace_destroy(workspace);
+    return 0;
+}
+
+int runBatch(int argc, char **argv) {
+    const size_t recordings = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 48;
+    const size_t dimension = 256;
+
+    // Recording lengths vary widely; a few long ones dominate the batch.
+    std::mt19937_64 generator(11);
+    std::uniform_int_distribution<size_t> shortSession(100, 600);
+    std::vector<std::vector<double>> inputs;
+    for (size_t r = 0; r < recordings; ++r) {
+        const size_t rows = (r % 8 == 0) ? 2000 : shortSession(generator);
+        inputs.push_back(speakerMixture(rows, dimension, 8, 0.9, static_cast<unsigned>(r + 1)));
+    }
+
+    auto makeJobs = [&](std::vector<std::vector<double>> &outputs) {
+        std::vector<fastcluster_linkage_job> jobs(recordings);
+        outputs.assign(recordings, std::vector<double>());
+        for (size_t r = 0; r < recordings; ++r) {
+            const size_t rows = inputs[r].size() / dimension;
+            outputs[r].assign((rows - 1) * 4, 0.0);
+            jobs[r].method = FASTCLUSTER_METHOD_CENTROID;
+            jobs[r].metric = FASTCLUSTER_METRIC_COSINE;
+            jobs[r].matrix = {inputs[r].data(), FASTCLUSTER_SCALAR_FLOAT64, rows, dimension, 0};
+            jobs[r].dendrogramOut = outputs[r].data();
+            jobs[r].dendrogramLength = outputs[r].size();
+            jobs[r].status = FASTCLUSTER_WRAPPER_SUCCESS;
+        }
+        return jobs;
+    };
+
+    std::vector<std::vector<double>> sequentialOutputs;
+    std::vector<fastcluster_linkage_job> jobs = makeJobs(sequentialOutputs);
+    auto start = Clock::now();
+    for (fastcluster_linkage_job &job : jobs) {
+        job.status = fastcluster_compute_linkage_matrix(job.method, job.metric, &job.matrix, nullptr,
+                                                        job.dendrogramOut, job.dendrogramLength);
+    }
+    const double sequentialSeconds = secondsSince(start);
+
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    std::printf("%zu recordings (N = 100-2000, D = %zu), %u hardware threads\n\n", recordings, dimension, cores);
+    std::printf("%-22s %10s %9s %10s\n", "mode", "ms", "speedup", "identical");
+    std::printf("%-22s %10.1f %9s %10s\n", "sequential calls", sequentialSeconds * 1e3, "1.00x", "-");
+
+    const size_t threadCounts[] = {1, 2, 4, 8, 0};
+    for (const size_t threads : threadCounts) {
+        if (threads > cores) {
+            continue;
+        }
+        std::vector<std::vector<double>> batchOutputs;
+        std::vector<fastcluster_linkage_job> batchJobs = makeJobs(batchOutputs);
+        fastcluster_linkage_options options;
+        fastcluster_linkage_options_init(&options);
+        options.threadCount = threads;
+        start = Clock::now();
+        const fastcluster_wrapper_status status =
+            fastcluster_compute_linkage_batch(batchJobs.data(), batchJobs.size(), &options);
+        const double seconds = secondsSince(start);
+        char label[32];
+        std::snprintf(label, sizeof(label), threads == 0 ? "batch, threads=all" : "batch, threads=%zu", threads);
+        std::printf("%-22s %10.1f %8.2fx %10s%s\n", label, seconds * 1e3, sequentialSeconds / seconds,
+                    batchOutputs == sequentialOutputs ? "yes" : "NO",
+                    status == FASTCLUSTER_WRAPPER_SUCCESS ? "" : "  FAILED");
+    }
+    return 0;
+}
+
+int runDistances(int, char **) {
+    struct Shape {
+        size_t rows;
+        size_t dimension;
+    };
+    const Shape shapes[] = {{1000, 256}, {2000, 256}, {5000, 256}, {5000, 64}, {2000, 1024}};
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+
+    std::printf("%-6s %-5s %-8s %12s %12s %9s %12s %12s\n", "N", "D", "threads", "pairwise ms", "blocked ms",
+                "speedup", "max rel err", "average tree");
+    for (const Shape &shape : shapes) {
+        const std::vector<double> data = speakerMixture(shape.rows, shape.dimension, 12, 0.9, 3);
+        const fastcluster_matrix matrix = {data.data(), FASTCLUSTER_SCALAR_FLOAT64, shape.rows, shape.dimension, 0};
+        const size_t entries = shape.rows * (shape.rows - 1) / 2;
+        std::vector<double> pairwise(entries);
+        std::vector<double> blocked(entries);
+
+        std::vector<size_t> threadCounts = {1};
+        if (cores > 1) {
+            threadCounts.push_back(cores);
+        }
+        for (const size_t threads : threadCounts) {
+            fastcluster_linkage_options options;
+            fastcluster_linkage_options_init(&options);
+            options.threadCount = threads;
+
+            auto start = Clock::now();
+            fastcluster_compute_distance_matrix(FASTCLUSTER_METRIC_EUCLIDEAN, &matrix, &options, pairwise.data(),
+                                                entries);
+            const double pairwiseSeconds = secondsSince(start);
+
+            options.distanceAlgorithm = FASTCLUSTER_DISTANCES_BLOCKED;
+            start = Clock::now();
+            fastcluster_compute_distance_matrix(FASTCLUSTER_METRIC_EUCLIDEAN, &matrix, &options, blocked.data(),
+                                                entries);
+            const double blockedSeconds = secondsSince(start);
+
+            double maxDistance = 0;
+            double maxError = 0;
+            for (size_t k = 0; k < entries; ++k) {
+                maxDistance = std::max(maxDistance, pairwise[k]);
+                maxError = std::max(maxError, std::fabs(pairwise[k] - blocked[k]));
+            }
+
+            // Does the stored-matrix linkage built on top come out the same?
+            std::vector<double> referenceTree((shape.rows - 1) * 4);
+            std::vector<double> blockedTree((shape.rows - 1) * 4);
+            fastcluster_linkage_options treeOptions;
+            fastcluster_linkage_options_init(&treeOptions);
+            treeOptions.threadCount = threads;
+            fastcluster_compute_linkage(FASTCLUSTER_METHOD_AVERAGE, FASTCLUSTER_METRIC_EUCLIDEAN, data.data(),
+                                        shape.rows, shape.dimension, &treeOptions, referenceTree.data(),
+                                        referenceTree.size());
+            treeOptions.distanceAlgorithm = FASTCLUSTER_DISTANCES_BLOCKED;
+            fastcluster_compute_linkage(FASTCLUSTER_METHOD_AVERAGE, FASTCLUSTER_METRIC_EUCLIDEAN, data.data(),
+                                        shape.rows, shape.dimension, &treeOptions, blockedTree.data(),
+                                        blockedTree.size());
+            bool sameMerges = true;
+            for (size_t row = 0; row + 1 < shape.rows; ++row) {
+                sameMerges = sameMerges && referenceTree[row * 4] == blockedTree[row * 4] &&
+                             referenceTree[row * 4 + 1] == blockedTree[row * 4 + 1];
+            }
+
+            std::printf("%-6zu %-5zu %-8zu %12.1f %12.1f %8.2fx %12.1e %12s\n", shape.rows, shape.dimension, threads,
+                        pairwiseSeconds * 1e3, blockedSeconds * 1e3, pairwiseSeconds / blockedSeconds,
+                        maxError / maxDistance, sameMerges ? "same" : "differs");
+        }
+    }
+    return 0;
+}
+
+int runApproximate(int argc, char **argv) {
+    const size_t rows = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 10000;
+    const size_t dimension = 256;
+    const double threshold = cosineThresholdToDistance(0.6);
+    const double budgets[] = {0.15, 0.2, 0.25, 0.3, 0.4, 0.5, 0.7};
+    if (rows < 2) {
+        std::printf("need at least 2 points\n");
+        return 1;
+    }
+
+    const std::vector<double> data = speakerTurns(rows, dimension, 12, std::max<size_t>(1, rows / 40), 11);
+    const fastcluster_matrix matrix = {data.data(), FASTCLUSTER_SCALAR_FLOAT64, rows, dimension, 0};
+    std::vector<double> dendrogram((rows - 1) * 4);
+    auto start = Clock::now();
+    fastcluster_compute_linkage_matrix(FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_COSINE, &matrix, nullptr,
+                                       dendrogram.data(), dendrogram.size());
+    const std::vector<size_t> exact = cutDendrogram(dendrogram, rows, threshold);
+    const double exactSeconds = secondsSince(start);
+    std::printf("N = %zu, D = %zu, exact centroid linkage + cut: %.1f ms, %zu clusters\n\n", rows, dimension,
+                exactSeconds * 1e3, *std::max_element(exact.begin(), exact.end()) + 1);
+
+    std::printf("%-7s %14s %10s %10s %9s %9s %8s\n", "budget", "micro-clusters", "rms/thr", "ms", "speedup",
+                "clusters", "ARI");
+    std::vector<int32_t> labels(rows);
+    for (const double budget : budgets) {
+        fastcluster_approximate_options approximate;
+        fastcluster_approximate_options_init(&approximate);
+        approximate.errorBudget = budget;
+        fastcluster_approximate_report report;
+        start = Clock::now();
+        fastcluster_cluster_centroid_approximate(FASTCLUSTER_METRIC_COSINE, &matrix, threshold, nullptr, &approximate,
+                                                 labels.data(), labels.size(), &report);
+        const double seconds = secondsSince(start);
+        const std::vector<size_t> approximateLabels(labels.begin(), labels.end());
+        std::printf("%-7.2f %14zu %10.3f %10.1f %8.1fx %9zu %8.4f\n", budget, report.microClusterCount,
+                    report.quantizationError, seconds * 1e3, exactSeconds / seconds,
+                    *std::max_element(approximateLabels.begin(), approximateLabels.end()) + 1,
+                    adjustedRandIndex(exact, approximateLabels));
+    }
+    return 0;
+}
+
+int runIncremental(int argc, char **argv) {
+    const size_t rows = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 4000;
+    const size_t dimension = 256;
+    const size_t steps[] = {1, 10, 50};
+    const size_t updates = 10;
+    if (rows < 4 * 50 * updates / 2) {
+        std::printf("need at least %zu points\n", 4 * 50 * updates / 2);
+        return 1;
+    }
+
+    const std::vector<double> data = speakerTurns(rows, dimension, 12, std::max<size_t>(1, rows / 40), 11);
+    std::printf("N = %zu, D = %zu, cosine; %zu updates of each size, each checked against a full run\n\n", rows,
+                dimension, updates);
+    std::printf("%-6s %12s %10s %9s %11s %12s %10s\n", "points", "incremental", "full", "speedup", "replayed",
+                "recomputed", "identical");
+    std::vector<double> incremental((rows - 1) * 4);
+    std::vector<double> full((rows - 1) * 4);
+    for (const size_t step : steps) {
+        fastcluster_incremental_engine *engine = fastcluster_incremental_create(FASTCLUSTER_METRIC_COSINE, dimension);
+        const size_t base = rows - step * updates;
+        const fastcluster_matrix initial = {data.data(), FASTCLUSTER_SCALAR_FLOAT64, base, dimension, 0};
+        fastcluster_incremental_append(engine, &initial);
+        fastcluster_incremental_linkage(engine, incremental.data(), incremental.size(), nullptr);
+
+        double incrementalSeconds = 0;
+        double fullSeconds = 0;
+        size_t replayed = 0;
+        size_t recomputed = 0;
+        bool identical = true;
+        for (size_t update = 0; update < updates; ++update) {
+            const size_t count = base + (update + 1) * step;
+            const fastcluster_matrix chunk = {data.data() + (count - step) * dimension, FASTCLUSTER_SCALAR_FLOAT64,
+                                              step, dimension, 0};
+            fastcluster_incremental_append(engine, &chunk);
+            fastcluster_incremental_report report;
+            auto start = Clock::now();
+            fastcluster_incremental_linkage(engine, incremental.data(), incremental.size(), &report);
+            incrementalSeconds += secondsSince(start);
+            replayed += report.replayedMerges;
+            recomputed += report.recomputedMerges;
+
+            const fastcluster_matrix matrix = {data.data(), FASTCLUSTER_SCALAR_FLOAT64, count, dimension, 0};
+            start = Clock::now();
+            fastcluster_compute_linkage_matrix(FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_COSINE, &matrix,
+                                               nullptr, full.data(), full.size());
+            fullSeconds += secondsSince(start);
+            identical =
+                identical && std::memcmp(incremental.data(), full.data(), (count - 1) * 4 * sizeof(double)) == 0;
+        }
+        fastcluster_incremental_destroy(engine);
+        std::printf("%-6zu %10.1fms %8.1fms %8.1fx %11zu %12zu %10s\n", step, incrementalSeconds * 1e3 / updates,
+                    fullSeconds * 1e3 / updates, fullSeconds / incrementalSeconds, replayed / updates,
+                    recomputed / updates, identical ? "yes" : "no");
+    }
+    return 0;
+}
+
+// Progress callback state for runControl: counts calls and cancels once
+// `cancelled` is set.
+struct ProgressProbe {
+    size_t calls = 0;
+    std::atomic<bool> cancelled{false};
+};
+
+int probeProgress(void *context, size_t, size_t) {
+    ProgressProbe &probe = *static_cast<ProgressProbe *>(context);
+    ++probe.calls;
+    return probe.cancelled.load() ? 1 : 0;
+}
+
+int runControl(int argc, char **argv) {
+    const size_t rows = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 4000;
+    const size_t dimension = 256;
+    const size_t repeats = 9;
+    if (rows < 1000) {
+        std::printf("need at least 1000 points\n");
+        return 1;
+    }
+    const std::vector<double> data = speakerTurns(rows, dimension, 12, std::max<size_t>(1, rows / 40), 5);
+    const fastcluster_matrix matrix = {data.data(), FASTCLUSTER_SCALAR_FLOAT64, rows, dimension, 0};
+    std::vector<double> dendrogram((rows - 1) * 4);
+    std::vector<double> reference((rows - 1) * 4);
+
+    auto run = [&](const fastcluster_run_control *control, std::vector<double> &out) {
+        fastcluster_linkage_options options;
+        fastcluster_linkage_options_init(&options);
+        options.control = control;
+        return fastcluster_compute_linkage_matrix(FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_COSINE, &matrix,
+                                                  &options, out.data(), out.size());
+    };
+
+    ProgressProbe probe;
+    const fastcluster_run_control callbackOnly = {probeProgress, &probe, 0};
+    const fastcluster_run_control callbackAndBudget = {probeProgress, &probe, 3600};
+    struct Mode {
+        const char *name;
+        const fastcluster_run_control *control;
+        double best;
+        size_t calls;
+        bool identical;
+    };
+    Mode modes[] = {{"none", nullptr, 1e300, 0, true},
+                    {"callback", &callbackOnly, 1e300, 0, true},
+                    {"callback + budget", &callbackAndBudget, 1e300, 0, true}};
+    // Modes alternate within every repeat, so drift in machine load hits all.
+    for (size_t repeat = 0; repeat < repeats; ++repeat) {
+        for (Mode &mode : modes) {
+            probe.calls = 0;
+            const auto start = Clock::now();
+            run(mode.control, mode.control == nullptr ? reference : dendrogram);
+            mode.best = std::min(mode.best, secondsSince(start));
+            mode.calls = probe.calls;
+            mode.identical = mode.identical && (mode.control == nullptr || dendrogram == reference);
+        }
+    }
+    const double baseline = modes[0].best;
+    std::printf("N = %zu, D = %zu, centroid/cosine, best of %zu runs\n\n", rows, dimension, repeats);
+    std::printf("%-22s %10s %10s %10s\n", "control", "ms", "overhead", "callbacks");
+    for (const Mode &mode : modes) {
+        std::printf("%-22s %10.1f %9.2f%% %10zu%s\n", mode.name, mode.best * 1e3, (mode.best / baseline - 1) * 100,
+                    mode.calls, mode.identical ? "" : "  DIFFERENT");
+    }
+
+    // Latency is the time from the request to stop (cancel flag or deadline)
+    // until the call returns.
+    std::printf("\n%-22s %10s %12s\n", "stop after", "status", "latency ms");
+    for (const double fraction : {0.1, 0.5, 0.9}) {
+        ProgressProbe cancel;
+        const fastcluster_run_control control = {probeProgress, &cancel, 0};
+        const auto delay = std::chrono::duration<double>(fraction * baseline);
+        Clock::time_point requested;
+        std::thread canceller([&] {
+            std::this_thread::sleep_for(delay);
+            requested = Clock::now();
+            cancel.cancelled.store(true);
+        });
+        const fastcluster_wrapper_status status = run(&control, dendrogram);
+        const auto returned = Clock::now();
+        canceller.join();
+        std::printf("cancel at %3.0f%% %16d %12.1f\n", fraction * 100, static_cast<int>(status),
+                    std::chrono::duration<double>(returned - requested).count() * 1e3);
+    }
+    for (const double fraction : {0.1, 0.5, 0.9}) {
+        const fastcluster_run_control control = {nullptr, nullptr, fraction * baseline};
+        const auto start = Clock::now();
+        const fastcluster_wrapper_status status = run(&control, dendrogram);
+        std::printf("budget %3.0f%% %19d %12.1f\n", fraction * 100, static_cast<int>(status),
+                    (secondsSince(start) - fraction * baseline) * 1e3);
+    }
+    return 0;
+}
+
+int runStructures(int, char **) {
+    struct Structure {
+        const char *name;
+        fastcluster_active_set activeSet;
+        size_t heapArity;
+        double best;
+        bool identical;
+    };
+    struct Shape {
+        size_t rows;
+        size_t dimension;
+    };
+    const Shape shapes[] = {{2000, 16}, {5000, 16}, {10000, 16}, {2000, 256}, {5000, 256}};
+    const size_t repeats = 5;
+
+    std::printf("centroid/euclidean, best of %zu runs; %% is relative to list + binary heap\n\n", repeats);
+    std::printf("%-6s %-4s %-22s %10s %9s\n", "N", "D", "active set + heap", "ms", "change");
+    for (const Shape &shape : shapes) {
+        const std::vector<double> data =
+            speakerMixture(shape.rows, shape.dimension, 12, 0.9, static_cast<unsigned>(shape.rows));
+        std::vector<double> reference((shape.rows - 1) * 4);
+        std::vector<double> dendrogram((shape.rows - 1) * 4);
+        Structure structures[] = {
+            {"list + binary heap", FASTCLUSTER_ACTIVE_SET_LINKED_LIST, 2, 1e300, true},
+            {"list + 4-ary heap", FASTCLUSTER_ACTIVE_SET_LINKED_LIST, 4, 1e300, true},
+            {"list + 8-ary heap", FASTCLUSTER_ACTIVE_SET_LINKED_LIST, 8, 1e300, true},
+            {"bitmap + binary heap", FASTCLUSTER_ACTIVE_SET_BITMAP, 2, 1e300, true},
+            {"bitmap + 4-ary heap", FASTCLUSTER_ACTIVE_SET_BITMAP, 4, 1e300, true},
+            {"bitmap + 8-ary heap", FASTCLUSTER_ACTIVE_SET_BITMAP, 8, 1e300, true},
+        };
+        // Structures alternate within every repeat, so drift in machine load
+        // hits all of them.
+        for (size_t repeat = 0; repeat < repeats; ++repeat) {
+            for (Structure &structure : structures) {
+                fastcluster_linkage_options options;
+                fastcluster_linkage_options_init(&options);
+                options.activeSet = structure.activeSet;
+                options.heapArity = structure.heapArity;
+                const bool first = &structure == &structures[0];
+                std::vector<double> &out = first ? reference : dendrogram;
+                const auto start = Clock::now();
+                fastcluster_compute_linkage(FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_EUCLIDEAN, data.data(),
+                                            shape.rows, shape.dimension, &options, out.data(), out.size());
+                structure.best = std::min(structure.best, secondsSince(start));
+                structure.identical = structure.identical && (first || dendrogram == reference);
+            }
+        }
+        for (const Structure &structure : structures) {
+            std::printf("%-6zu %-4zu %-22s %10.1f %8.1f%%%s\n", shape.rows, shape.dimension, structure.name,
+                        structure.best * 1e3, (structure.best / structures[0].best - 1) * 100,
+                        structure.identical ? "" : "  DIFFERENT");
+        }
+    }
+    return 0;
+}
+
+int runIndexWidth(int, char **) {
+    struct Method {
+        fastcluster_method method;
+        const char *name;
+    };
+    const Method methods[] = {{FASTCLUSTER_METHOD_SINGLE, "single"},
+                              {FASTCLUSTER_METHOD_CENTROID, "centroid"},
+                              {FASTCLUSTER_METHOD_MEDIAN, "median"}};
+    const size_t dimensions[] = {16, 256};
+    const size_t rows = 4000;
+    const size_t repeats = 5;
+
+    std::printf("N = %zu, euclidean, best of %zu runs\n\n", rows, repeats);
+    std::printf("%-4s %-10s %12s %12s %9s\n", "D", "method", "32-bit ms", "64-bit ms", "change");
+    for (const size_t dimension : dimensions) {
+        const std::vector<double> data = speakerMixture(rows, dimension, 12, 0.9, static_cast<unsigned>(dimension));
+        for (const Method &method : methods) {
+            std::vector<double> narrow((rows - 1) * 4);
+            std::vector<double> wide((rows - 1) * 4);
+            double best[2] = {1e300, 1e300};
+            // Widths alternate within every repeat, so drift in machine load
+            // hits both.
+            for (size_t repeat = 0; repeat < repeats; ++repeat) {
+                for (size_t w = 0; w < 2; ++w) {
+                    fastcluster_linkage_options options;
+                    fastcluster_linkage_options_init(&options);
+                    options.indexWidth = w == 0 ? FASTCLUSTER_INDEX_AUTO : FASTCLUSTER_INDEX_64;
+                    std::vector<double> &out = w == 0 ? narrow : wide;
+                    const auto start = Clock::now();
+                    fastcluster_compute_linkage(method.method, FASTCLUSTER_METRIC_EUCLIDEAN, data.data(), rows,
+                                                dimension, &options, out.data(), out.size());
+                    best[w] = std::min(best[w], secondsSince(start));
+                }
+            }
+            std::printf("%-4zu %-10s %12.1f %12.1f %8.1f%%%s\n", dimension, method.name, best[0] * 1e3,
+                        best[1] * 1e3, (best[1] / best[0] - 1) * 100, narrow == wide ? "" : "  DIFFERENT");
+        }
+    }
+    return 0;
+}
+
+// Centroid linkage of the same rows stored as float64, float32, float16 and
+// bfloat16. Drift is measured against float64: merges with the same pair, the
+// largest height difference among them, and the ARI of the labels at the
+// default cosine threshold (1 means no label drift).
+int runHalf(int, char **) {
+    struct Input {
+        const char *name;
+        std::vector<double> values;
+        std::vector<size_t> truth;
+        size_t rows;
+    };
+    const ExtractorFixture short20 = extractorFixture(1200, 3, 1);
+    const ExtractorFixture long60 = extractorFixture(3600, 6, 2);
+    const Input inputs[] = {{"extractor-20min", short20.values, short20.labels, short20.rows},
+                            {"extractor-1h", long60.values, long60.labels, long60.rows},
+                            {"mixture-4000", speakerMixture(4000, 256, 12, 0.9, 4000), {}, 4000}};
+    const size_t dimension = 256;
+    const double threshold = cosineThresholdToDistance(0.6);
+
+    std::printf("cosine centroid linkage, D = %zu, threshold %.3f\n\n", dimension, threshold);
+    std::printf("%-16s %-9s %9s %10s %12s %9s %10s\n", "input", "storage", "ms", "same pair", "max |dd|", "ARI f64",
+                "ARI truth");
+    for (const Input &input : inputs) {
+        const size_t rows = input.rows;
+        const size_t count = rows * dimension;
+        const std::vector<float> values32(input.values.begin(), input.values.end());
+        std::vector<uint16_t> values16(count);
+        std::vector<uint16_t> valuesBf16(count);
+        fastcluster_convert_to_half(FASTCLUSTER_SCALAR_FLOAT16, values32.data(), count, values16.data());
+        fastcluster_convert_to_half(FASTCLUSTER_SCALAR_BFLOAT16, values32.data(), count, valuesBf16.data());
+
+        struct Storage {
+            const char *name;
+            fastcluster_scalar_type type;
+            const void *data;
+        };
+        const Storage storages[] = {{"float64", FASTCLUSTER_SCALAR_FLOAT64, input.values.data()},
+                                    {"float32", FASTCLUSTER_SCALAR_FLOAT32, values32.data()},
+                                    {"float16", FASTCLUSTER_SCALAR_FLOAT16, values16.data()},
+                                    {"bfloat16", FASTCLUSTER_SCALAR_BFLOAT16, valuesBf16.data()}};
+        std::vector<double> reference;
+        std::vector<size_t> referenceLabels;
+        for (const Storage &storage : storages) {
+            const fastcluster_matrix matrix = {storage.data, storage.type, rows, dimension, 0};
+            std::vector<double> dendrogram((rows - 1) * 4);
+            const auto start = Clock::now();
+            const fastcluster_wrapper_status status =
+                fastcluster_compute_linkage_matrix(FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_COSINE, &matrix,
+                                                   nullptr, dendrogram.data(), dendrogram.size());
+            const double seconds = secondsSince(start);
+            if (status != FASTCLUSTER_WRAPPER_SUCCESS) {
+                std::printf("%-16s %-9s failed with status %d\n", input.name, storage.name, static_cast<int>(status));
+                return 1;
+            }
+            const std::vector<size_t> labels = cutDendrogram(dendrogram, rows, threshold);
+            if (reference.empty()) {
+                reference = dendrogram;
+                referenceLabels = labels;
+            }
+
+            size_t samePair = 0;
+            double maxAbsolute = 0;
+            for (size_t merge = 0; merge + 1 < rows; ++merge) {
+                const double *row = dendrogram.data() + merge * 4;
+                const double *expected = reference.data() + merge * 4;
+                if (row[0] == expected[0] && row[1] == expected[1]) {
+                    ++samePair;
+                    maxAbsolute = std::max(maxAbsolute, std::fabs(row[2] - expected[2]));
+                }
+            }
+            char truth[16] = "-";
+            if (!input.truth.empty()) {
+                std::snprintf(truth, sizeof(truth), "%.4f", adjustedRandIndex(labels, input.truth));
+            }
+            std::printf("%-16s %-9s %9.1f %9.1f%% %12.3e %9.4f %10s\n", input.name, storage.name, seconds * 1e3,
+                        100.0 * static_cast<double>(samePair) / static_cast<double>(rows - 1), maxAbsolute,
+                        adjustedRandIndex(labels, referenceLabels), truth);
+        }
+    }
+    return 0;
+}
+
+// Constrained centroid linkage with growing numbers of random must-link and
+// cannot-link pairs, against the unconstrained entry point. Labels at the
+// default cosine threshold are checked against every constraint.
+int runConstraints(int argc, char **argv) {
+    const size_t rows = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 4000;
+    const size_t dimension = 256;
+    const double threshold = cosineThresholdToDistance(0.6);
+    const std::vector<double> data = speakerMixture(rows, dimension, 12, 0.9, static_cast<unsigned>(rows));
+    const fastcluster_matrix matrix = {data.data(), FASTCLUSTER_SCALAR_FLOAT64, rows, dimension, 0};
+    std::vector<double> dendrogram((rows - 1) * 4);
+
+    const auto start = Clock::now();
+    fastcluster_compute_linkage_matrix(FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_COSINE, &matrix, nullptr,
+                                       dendrogram.data(), dendrogram.size());
+    const double baseline = secondsSince(start);
+    std::printf("N = %zu, D = %zu, cosine centroid linkage; unconstrained %.1f ms\n\n", rows, dimension,
+                baseline * 1e3);
+
+    struct Case {
+        size_t mustLink;
+        size_t cannotLink;
+    };
+    const Case cases[] = {{0, 0}, {0, 100}, {0, 1000}, {0, 10000}, {100, 0}, {1000, 0}, {1000, 10000}};
+    std::printf("%-10s %-12s %8s %10s %9s %11s\n", "must-link", "cannot-link", "groups", "ms", "change", "violations");
+    for (const Case &c : cases) {
+        // Must-link pairs join neighbouring points; cannot-link pairs are drawn
+        // at random and skip pairs inside a must-link group.
+        std::mt19937_64 generator(c.mustLink * 7919 + c.cannotLink);
+        std::uniform_int_distribution<size_t> point(0, rows - 1);
+        std::vector<size_t> mustLink;
+        std::vector<size_t> parent(rows);
+        std::iota(parent.begin(), parent.end(), size_t{0});
+        auto find = [&parent](size_t node) {
+            while (parent[node] != node) {
+                node = parent[node] = parent[parent[node]];
+            }
+            return node;
+        };
+        for (size_t p = 0; p < c.mustLink; ++p) {
+            const size_t a = point(generator);
+            const size_t b = std::min(rows - 1, a + 1 + point(generator) % 8);
+            mustLink.push_back(a);
+            mustLink.push_back(b);
+            parent[find(a)] = find(b);
+        }
+        std::vector<size_t> cannotLink;
+        while (cannotLink.size() < 2 * c.cannotLink) {
+            const size_t a = point(generator);
+            const size_t b = point(generator);
+            if (find(a) != find(b)) {
+                cannotLink.push_back(a);
+                cannotLink.push_back(b);
+            }
+        }
+        size_t groups = 0;
+        for (size_t i = 0; i < rows; ++i) {
+            groups += find(i) == i ? 1 : 0;
+        }
+
+        const fastcluster_pair_constraints constraints = {mustLink.data(), c.mustLink, cannotLink.data(),
+                                                          c.cannotLink};
+        const auto constrainedStart = Clock::now();
+        const fastcluster_wrapper_status status =
+            fastcluster_compute_constrained_linkage(FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_COSINE, &matrix,
+                                                    &constraints, nullptr, dendrogram.data(), dendrogram.size());
+        const double seconds = secondsSince(constrainedStart);
+        if (status != FASTCLUSTER_WRAPPER_SUCCESS) {
+            std::printf("failed with status %d\n", static_cast<int>(status));
+            return 1;
+        }
+        const std::vector<size_t> labels = cutDendrogram(dendrogram, rows, threshold);
+        size_t violations = 0;
+        for (size_t p = 0; p < c.mustLink; ++p) {
+            violations += labels[mustLink[2 * p]] != labels[mustLink[2 * p + 1]] ? 1 : 0;
+        }
+        for (size_t p = 0; p < c.cannotLink; ++p) {
+            violations += labels[cannotLink[2 * p]] == labels[cannotLink[2 * p + 1]] ? 1 : 0;
+        }
+        std::printf("%-10zu %-12zu %8zu %10.1f %8.1f%% %11zu\n", c.mustLink, c.cannotLink, groups, seconds * 1e3,
+                    (seconds / baseline - 1) * 100, violations);
+    }
+    return 0;
+}
+
+int runWeights(int argc, char **argv) {
+    const size_t rows = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 8000;
+    const size_t dimension = 256;
+    const size_t turns = std::max<size_t>(1, rows / 80);
+    const double threshold = cosineThresholdToDistance(0.6);
+    // Long monologue turns of about 80 chunks each.
+    const std::vector<double> data = speakerTurns(rows, dimension, 8, turns, static_cast<unsigned>(rows));
+
+    // The rows are unit length, so every run skips the cosine normalization:
+    // a pre-merged row is then the mean of normalized chunks, as in the full
+    // run's centroids.
+    fastcluster_linkage_options options;
+    fastcluster_linkage_options_init(&options);
+    options.inputIsNormalized = 1;
+    const fastcluster_matrix matrix = {data.data(), FASTCLUSTER_SCALAR_FLOAT64, rows, dimension, 0};
+    std::vector<double> dendrogram((rows - 1) * 4);
+    const auto start = Clock::now();
+    fastcluster_compute_linkage_matrix(FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_COSINE, &matrix, &options,
+                                       dendrogram.data(), dendrogram.size());
+    const double baseline = secondsSince(start);
+    const std::vector<size_t> reference = cutDendrogram(dendrogram, rows, threshold);
+    std::printf("N = %zu chunks in %zu turns, D = %zu, cosine centroid linkage; all chunks %.1f ms\n\n", rows, turns,
+                dimension, baseline * 1e3);
+
+    std::printf("%-14s %8s %10s %9s %8s\n", "merged chunks", "points", "ms", "speedup", "ARI");
+    for (const size_t span : {2, 4, 8, 16, 32}) {
+        // Consecutive chunks of one turn, up to `span` at a time, become one
+        // point: their mean, weighted by their number.
+        std::vector<double> merged;
+        std::vector<double> weights;
+        std::vector<size_t> pointOf(rows);
+        for (size_t first = 0; first < rows;) {
+            const size_t turn = first * turns / rows;
+            size_t last = first + 1;
+            while (last < rows && last - first < span && last * turns / rows == turn) {
+                ++last;
+            }
+            const size_t point = weights.size();
+            merged.resize((point + 1) * dimension, 0.0);
+            for (size_t i = first; i < last; ++i) {
+                pointOf[i] = point;
+                for (size_t k = 0; k < dimension; ++k) {
+                    merged[point * dimension + k] += data[i * dimension + k] / static_cast<double>(last - first);
+                }
+            }
+            weights.push_back(static_cast<double>(last - first));
+            first = last;
+        }
+
+        const size_t points = weights.size();
+        const fastcluster_matrix mergedMatrix = {merged.data(), FASTCLUSTER_SCALAR_FLOAT64, points, dimension, 0};
+        fastcluster_linkage_options weighted = options;
+        weighted.pointWeights = weights.data();
+        std::vector<double> mergedDendrogram((points - 1) * 4);
+        const auto weightedStart = Clock::now();
+        const fastcluster_wrapper_status status =
+            fastcluster_compute_linkage_matrix(FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_COSINE, &mergedMatrix,
+                                               &weighted, mergedDendrogram.data(), mergedDendrogram.size());
+        const double seconds = secondsSince(weightedStart);
+        if (status != FASTCLUSTER_WRAPPER_SUCCESS) {
+            std::printf("failed with status %d\n", static_cast<int>(status));
+            return 1;
+        }
+        const std::vector<size_t> pointLabels = cutDendrogram(mergedDendrogram, points, threshold);
+        std::vector<size_t> labels(rows);
+        for (size_t i = 0; i < rows; ++i) {
+            labels[i] = pointLabels[pointOf[i]];
+        }
+        std::printf("%-14zu %8zu %10.1f %8.1fx %8.3f\n", span, points, seconds * 1e3, baseline / seconds,
+                    adjustedRandIndex(reference, labels));
+    }
+    return 0;
+}
+
+// Frames in PLDA space, in speaker turns: speaker means drawn with covariance
+// separation^2 * diag(phi), frames around them with unit covariance. `phi`
+// receives the decaying eigenvalues and `labels` the speaker of every frame.
+std::vector<double> pldaFrames(size_t frames, size_t dimension, size_t speakers, unsigned seed,
+                               std::vector<double> &phi, std::vector<size_t> &labels, double separation = 1.0) {
+    std::mt19937_64 generator(seed);
+    std::normal_distribution<double> normal;
+    phi.resize(dimension);
+    for (size_t d = 0; d < dimension; ++d) {
+        phi[d] = 8.0 * std::exp(-static_cast<double>(d) / 16.0) + 0.05;
+    }
+    std::vector<double> means(speakers * dimension);
+    for (size_t s = 0; s < speakers; ++s) {
+        for (size_t d = 0; d < dimension; ++d) {
+            means[s * dimension + d] = separation * normal(generator) * std::sqrt(phi[d]);
+        }
+    }
+    std::vector<double> data(frames * dimension);
+    labels.resize(frames);
+    const size_t turnLength = 40;
+    for (size_t t = 0; t < frames; ++t) {
+        if (t % turnLength == 0) {
+            labels[t] = generator() % speakers;
+        } else {
+            labels[t] = labels[t - 1];
+        }
+        for (size_t d = 0; d < dimension; ++d) {
+            data[t * dimension + d] = means[labels[t] * dimension + d] + normal(generator);
+        }
+    }
+    return data;
+}
+
+// One-hot warm start as AHC leaves it: every speaker split into 2 clusters by
+// turn parity, and 5% of the frames in a random cluster, among those and
+// `spurious` further clusters that hold nothing else.
+std::vector<double> vbxWarmStart(const std::vector<size_t> &labels, size_t speakers, size_t spurious = 0) {
+    const size_t clusters = 2 * speakers + spurious;
+    std::mt19937_64 generator(7);
+    std::vector<double> gamma(labels.size() * clusters, 0.0);
+    for (size_t t = 0; t < labels.size(); ++t) {
+        size_t cluster = labels[t] + speakers * ((t / 40) % 2);
+        if (generator() % 20 == 0) {
+            cluster = generator() % clusters;
+        }
+        gamma[t * clusters + cluster] = 1.0;
+    }
+    return gamma;
+}
+
+// Frame-level diarization error rate of hard VBx labels against the true
+// speakers: every frame is speech and has one speaker, so only confusion
+// counts. Clusters are mapped one-to-one to speakers, greedily by overlap.
+template <typename t_float>
+double frameErrorRate(const std::vector<t_float> &gamma, size_t clusters, const std::vector<size_t> &labels,
+                      size_t speakers) {
+    std::vector<size_t> overlap(clusters * speakers, 0);
+    for (size_t t = 0; t < labels.size(); ++t) {
+        const t_float *row = gamma.data() + t * clusters;
+        const size_t cluster = static_cast<size_t>(std::max_element(row, row + clusters) - row);
+        ++overlap[cluster * speakers + labels[t]];
+    }
+    std::vector<bool> clusterUsed(clusters, false);
+    std::vector<bool> speakerUsed(speakers, false);
+    size_t correct = 0;
+    for (size_t pairs = 0; pairs < std::min(clusters, speakers); ++pairs) {
+        size_t best = 0;
+        size_t bestCluster = clusters;
+        size_t bestSpeaker = speakers;
+        for (size_t c = 0; c < clusters; ++c) {
+            for (size_t k = 0; k < speakers; ++k) {
+                if (!clusterUsed[c] && !speakerUsed[k] && overlap[c * speakers + k] >= best) {
+                    best = overlap[c * speakers + k];
+                    bestCluster = c;
+                    bestSpeaker = k;
+                }
+            }
+        }
+        clusterUsed[bestCluster] = true;
+        speakerUsed[bestSpeaker] = true;
+        correct += best;
+    }
+    return 1.0 - static_cast<double>(correct) / static_cast<double>(labels.size());
+}
+
+struct VBxTrajectory {
+    std::vector<double> gamma;
+    std::vector<double> pi;
+    std::vector<double> elbos;
+};
+
+// VBxClustering.runVBx step by step: one pass over the frames per vDSP or BLAS
+// call, with the frames x speakers log-likelihood matrix stored.
+VBxTrajectory referenceVBx(const std::vector<double> &features, size_t frames, size_t dimension,
+                           const std::vector<double> &phi, std::vector<double> gamma, size_t speakers,
+                           const fastcluster_vbx_options &options) {
+    const double Fa = options.Fa;
+    const double Fb = options.Fb;
+    std::vector<double> scratch(speakers);
+    auto softmax = [&](double *row, double *target) {
+        const double rowMax = *std::max_element(row, row + speakers);
+        double sum = 0;
+        for (size_t s = 0; s < speakers; ++s) {
+            row[s] = std::exp(row[s] - rowMax);
+            sum += row[s];
+        }
+        if (sum <= 0 || !std::isfinite(sum)) {
+            std::fill(target, target + speakers, 1.0 / static_cast<double>(speakers));
+            return rowMax;
+        }
+        for (size_t s = 0; s < speakers; ++s) {
+            target[s] = row[s] * (1.0 / sum);
+        }
+        return rowMax + std::log(sum);
+    };
+    if (options.initSmoothing >= 0) {
+        for (size_t t = 0; t < frames; ++t) {
+            for (size_t s = 0; s < speakers; ++s) {
+                scratch[s] = gamma[t * speakers + s] * options.initSmoothing;
+            }
+            softmax(scratch.data(), &gamma[t * speakers]);
+        }
+    }
+    for (size_t t = 0; t < frames; ++t) {
+        double sum = 0;
+        for (size_t s = 0; s < speakers; ++s) {
+            sum += gamma[t * speakers + s];
+        }
+        for (size_t s = 0; s < speakers; ++s) {
+            gamma[t * speakers + s] = sum > 0 && std::isfinite(sum) ? gamma[t * speakers + s] * (1.0 / sum)
+                                                                    : 1.0 / static_cast<double>(speakers);
+        }
+    }
+
+    std::vector<double> pi(speakers, 1.0 / static_cast<double>(speakers));
+    std::vector<double> phiClamped(dimension);
+    for (size_t d = 0; d < dimension; ++d) {
+        phiClamped[d] = std::max(phi[d], 1e-12);
+    }
+    std::vector<double> rho(frames * dimension);
+    std::vector<double> G(frames);
+    for (size_t t = 0; t < frames; ++t) {
+        double sumSquares = 0;
+        for (size_t d = 0; d < dimension; ++d) {
+            rho[t * dimension + d] = features[t * dimension + d] * std::sqrt(phiClamped[d]);
+            sumSquares += features[t * dimension + d] * features[t * dimension + d];
+        }
+        G[t] = -0.5 * (sumSquares + static_cast<double>(dimension) * std::log(2.0 * 3.14159265358979323846));
+    }
+
+    const double ratio = Fa / Fb;
+    std::vector<double> gammaSum(speakers), invL(speakers * dimension), temp(speakers * dimension),
+        alpha(speakers * dimension), phiTerms(speakers), logP(frames * speakers), logPi(speakers);
+    std::vector<double> elbos;
+    double previousElbo = -std::numeric_limits<double>::max();
+    for (size_t iteration = 0; iteration < options.maxIterations; ++iteration) {
+        std::fill(gammaSum.begin(), gammaSum.end(), 0.0);
+        for (size_t t = 0; t < frames; ++t) {
+            for (size_t s = 0; s < speakers; ++s) {
+                gammaSum[s] += gamma[t * speakers + s];
+            }
+        }
+        for (size_t s = 0; s < speakers; ++s) {
+            for (size_t d = 0; d < dimension; ++d) {
+                invL[s * dimension + d] = 1.0 / std::max(1.0 + ratio * gammaSum[s] * phiClamped[d], 1e-12);
+            }
+        }
+        std::fill(temp.begin(), temp.end(), 0.0);
+        for (size_t t = 0; t < frames; ++t) {
+            for (size_t s = 0; s < speakers; ++s) {
+                for (size_t d = 0; d < dimension; ++d) {
+                    temp[s * dimension + d] += gamma[t * speakers + s] * rho[t * dimension + d];
+                }
+            }
+        }
+        for (size_t k = 0; k < alpha.size(); ++k) {
+            alpha[k] = temp[k] * invL[k] * ratio;
+        }
+        for (size_t s = 0; s < speakers; ++s) {
+            double sum = 0;
+            for (size_t d = 0; d < dimension; ++d) {
+                const double a = alpha[s * dimension + d];
+                sum += (a * a + invL[s * dimension + d]) * phiClamped[d];
+            }
+            phiTerms[s] = sum;
+        }
+        for (size_t t = 0; t < frames; ++t) {
+            for (size_t s = 0; s < speakers; ++s) {
+                double dot = 0;
+                for (size_t d = 0; d < dimension; ++d) {
+                    dot += rho[t * dimension + d] * alpha[s * dimension + d];
+                }
+                logP[t * speakers + s] = (dot - 0.5 * phiTerms[s] + G[t]) * Fa;
+            }
+        }
+        for (size_t s = 0; s < speakers; ++s) {
+            logPi[s] = std::log(std::max(pi[s], 1e-8));
+        }
+        double logLikelihood = 0;
+        for (size_t t = 0; t < frames; ++t) {
+            for (size_t s = 0; s < speakers; ++s) {
+                scratch[s] = logP[t * speakers + s] + logPi[s];
+            }
+            logLikelihood += softmax(scratch.data(), &gamma[t * speakers]);
+        }
+        std::fill(pi.begin(), pi.end(), 0.0);
+        for (size_t t = 0; t < frames; ++t) {
+            for (size_t s = 0; s < speakers; ++s) {
+                pi[s] += gamma[t * speakers + s];
+            }
+        }
+        const double piSum = std::accumulate(pi.begin(), pi.end(), 0.0);
+        for (double &value : pi) {
+            value = piSum > 0 && std::isfinite(piSum) ? value * (1.0 / piSum) : 1.0 / static_cast<double>(speakers);
+        }
+        double sumLogInv = 0;
+        double sumInv = 0;
+        double sumAlphaSquares = 0;
+        for (size_t k = 0; k < invL.size(); ++k) {
+            sumLogInv += std::log(invL[k]);
+            sumInv += invL[k];
+            sumAlphaSquares += alpha[k] * alpha[k];
+        }
+        const double elbo =
+            logLikelihood + Fb * 0.5 * (sumLogInv - sumInv - sumAlphaSquares + static_cast<double>(invL.size()));
+        elbos.push_back(elbo);
+        if (iteration > 0 && std::fabs(elbo - previousElbo) < options.convergenceTolerance) {
+            break;
+        }
+        previousElbo = elbo;
+    }
+    return {gamma, pi, elbos};
+}
+
+int runVBx(int argc, char **argv) {
+    const size_t maximumFrames = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 50000;
+    const size_t dimension = 128;
+    const size_t speakers = 8;
+
+    std::printf("PLDA-space frames, D = %zu, %zu speakers; warm start over-segmented into 2 clusters per speaker\n",
+                dimension, speakers);
+    std::printf("with 5%% of the frames mislabelled. Reference: VBxClustering.swift's passes as plain loops.\n\n");
+    std::printf("%-8s %6s %12s %10s %9s %12s %12s %12s\n", "frames", "iters", "reference ms", "fused ms",
+                "speedup", "max dgamma", "max dpi", "ELBO rel d");
+    for (const size_t frames : {2000, 10000, 50000, 200000}) {
+        if (frames > maximumFrames) {
+            continue;
+        }
+        std::vector<double> phi;
+        std::vector<size_t> labels;
+        const std::vector<double> data = pldaFrames(frames, dimension, speakers, static_cast<unsigned>(frames), phi,
+                                                    labels);
+        const size_t clusters = 2 * speakers;
+        const std::vector<double> initialGamma = vbxWarmStart(labels, speakers);
+
+        fastcluster_vbx_options options;
+        fastcluster_vbx_options_init(&options);
+        auto start = Clock::now();
+        const VBxTrajectory reference = referenceVBx(data, frames, dimension, phi, initialGamma, clusters, options);
+        const double referenceSeconds = secondsSince(start);
+
+        std::vector<double> gamma = initialGamma;
+        std::vector<double> pi(clusters);
+        std::vector<double> elbos(options.maxIterations);
+        fastcluster_vbx_report report;
+        const fastcluster_matrix matrix = {data.data(), FASTCLUSTER_SCALAR_FLOAT64, frames, dimension, 0};
+        start = Clock::now();
+        const fastcluster_wrapper_status status =
+            fastcluster_compute_vbx(&matrix, phi.data(), clusters, &options, gamma.data(), gamma.size(), pi.data(),
+                                    elbos.data(), elbos.size(), &report);
+        const double seconds = secondsSince(start);
+        if (status != FASTCLUSTER_WRAPPER_SUCCESS) {
+            std::printf("failed with status %d\n", static_cast<int>(status));
+            return 1;
+        }
+
+        double gammaDelta = 0;
+        for (size_t k = 0; k < gamma.size(); ++k) {
+            gammaDelta = std::max(gammaDelta, std::fabs(gamma[k] - reference.gamma[k]));
+        }
+        double piDelta = 0;
+        for (size_t s = 0; s < clusters; ++s) {
+            piDelta = std::max(piDelta, std::fabs(pi[s] - reference.pi[s]));
+        }
+        double elboDelta = report.iterations == reference.elbos.size() ? 0 : INFINITY;
+        for (size_t i = 0; i < std::min(report.iterations, reference.elbos.size()); ++i) {
+            elboDelta = std::max(elboDelta, std::fabs(elbos[i] - reference.elbos[i]) / std::fabs(reference.elbos[i]));
+        }
+        std::printf("%-8zu %6zu %12.1f %10.1f %8.2fx %12.2e %12.2e %12.2e\n", frames, report.iterations,
+                    referenceSeconds * 1e3, seconds * 1e3, referenceSeconds / seconds, gammaDelta, piDelta,
+                    elboDelta);
+    }
+    return 0;
+}
+
+int runVBxPrecision(int argc, char **argv) {
+    const size_t maximumFrames = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 50000;
+    const size_t dimension = 128;
+    const size_t speakers = 8;
+    const size_t clusters = 2 * speakers;
+
+    std::printf("PLDA-space frames, D = %zu, %zu speakers, warm start as for `vbx`; float32 vs. float64 gamma.\n",
+                dimension, speakers);
+    std::printf("sep: scale of the speaker means. ELBO d: largest relative difference over the iterations both\n"
+                "ran. DER: frame-level confusion against the true speakers.\n\n");
+    std::printf("%-5s %-8s %6s %6s %10s %10s %9s %12s %12s %8s %8s %8s\n", "sep", "frames", "iters", "f32",
+                "f64 ms", "f32 ms", "speedup", "max dgamma", "ELBO d", "changed", "DER f64", "DER f32");
+    for (const double separation : {1.0, 0.7}) {
+        for (const size_t frames : {10000, 50000, 200000}) {
+            if (frames > maximumFrames) {
+                continue;
+            }
+            std::vector<double> phi;
+            std::vector<size_t> labels;
+            const std::vector<double> data = pldaFrames(frames, dimension, speakers, static_cast<unsigned>(frames), phi,
+                                                        labels, separation);
+            const std::vector<double> initialGamma = vbxWarmStart(labels, speakers);
+            std::vector<float> rows(data.begin(), data.end());
+
+            fastcluster_vbx_options options;
+            fastcluster_vbx_options_init(&options);
+            std::vector<double> pi(clusters);
+            fastcluster_vbx_report report;
+            fastcluster_vbx_report floatReport;
+            std::vector<double> elbos(options.maxIterations);
+            std::vector<double> floatElbos(options.maxIterations);
+
+            std::vector<double> gamma = initialGamma;
+            const fastcluster_matrix matrix = {data.data(), FASTCLUSTER_SCALAR_FLOAT64, frames, dimension, 0};
+            auto start = Clock::now();
+            fastcluster_wrapper_status status =
+                fastcluster_compute_vbx(&matrix, phi.data(), clusters, &options, gamma.data(), gamma.size(), pi.data(),
+                                        elbos.data(), elbos.size(), &report);
+            const double seconds = secondsSince(start);
+
+            std::vector<float> floatGamma(initialGamma.begin(), initialGamma.end());
+            const fastcluster_matrix floatMatrix = {rows.data(), FASTCLUSTER_SCALAR_FLOAT32, frames, dimension, 0};
+            start = Clock::now();
+            if (status == FASTCLUSTER_WRAPPER_SUCCESS) {
+                status = fastcluster_compute_vbx_f32(&floatMatrix, phi.data(), clusters, &options, floatGamma.data(),
+                                                     floatGamma.size(), pi.data(), floatElbos.data(), floatElbos.size(),
+                                                     &floatReport);
+            }
+            const double floatSeconds = secondsSince(start);
+            if (status != FASTCLUSTER_WRAPPER_SUCCESS) {
+                std::printf("failed with status %d\n", static_cast<int>(status));
+                return 1;
+            }
+
+            double gammaDelta = 0;
+            size_t changed = 0;
+            for (size_t t = 0; t < frames; ++t) {
+                const double *row = gamma.data() + t * clusters;
+                const float *floatRow = floatGamma.data() + t * clusters;
+                for (size_t c = 0; c < clusters; ++c) {
+                    gammaDelta = std::max(gammaDelta, std::fabs(row[c] - static_cast<double>(floatRow[c])));
+                }
+                changed += std::max_element(row, row + clusters) - row !=
+                           std::max_element(floatRow, floatRow + clusters) - floatRow;
+            }
+            double elboDelta = 0;
+            for (size_t i = 0; i < std::min(report.iterations, floatReport.iterations); ++i) {
+                elboDelta = std::max(elboDelta, std::fabs(floatElbos[i] - elbos[i]) / std::fabs(elbos[i]));
+            }
+            std::printf("%-5.2f %-8zu %6zu %6zu %10.1f %10.1f %8.2fx %12.2e %12.2e %8zu %7.2f%% %7.2f%%\n",
+                        separation, frames, report.iterations, floatReport.iterations, seconds * 1e3,
+                        floatSeconds * 1e3, seconds / floatSeconds, gammaDelta, elboDelta, changed,
+                        100 * frameErrorRate(gamma, clusters, labels, speakers),
+                        100 * frameErrorRate(floatGamma, clusters, labels, speakers));
+        }
+    }
+    return 0;
+}
+
+int runVBxScaling(int argc, char **argv) {
+    const size_t frames = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 200000;
+    const size_t dimension = 128;
+    const size_t speakers = 8;
+    const size_t clusters = 2 * speakers;
+    const size_t threadCounts[] = {1, 4, 8, 16};
+
+    std::vector<double> phi;
+    std::vector<size_t> labels;
+    const std::vector<double> data = pldaFrames(frames, dimension, speakers, 11, phi, labels);
+    std::vector<double> initialGamma(frames * clusters, 0.0);
+    for (size_t t = 0; t < frames; ++t) {
+        initialGamma[t * clusters + labels[t] + speakers * ((t / 40) % 2)] = 1.0;
+    }
+    const fastcluster_matrix matrix = {data.data(), FASTCLUSTER_SCALAR_FLOAT64, frames, dimension, 0};
+
+    std::printf("hardware threads: %u\n", std::thread::hardware_concurrency());
+    std::printf("%zu PLDA-space frames, D = %zu, %zu clusters\n\n", frames, dimension, clusters);
+    std::printf("%-8s %6s %10s %10s %10s\n", "threads", "iters", "ms", "speedup", "identical");
+    std::vector<double> referenceGamma;
+    std::vector<double> referenceElbos;
+    double serialSeconds = 0;
+    for (const size_t threads : threadCounts) {
+        fastcluster_vbx_options options;
+        fastcluster_vbx_options_init(&options);
+        options.threadCount = threads;
+        std::vector<double> gamma = initialGamma;
+        std::vector<double> pi(clusters);
+        std::vector<double> elbos(options.maxIterations);
+        fastcluster_vbx_report report;
+        const auto start = Clock::now();
+        const fastcluster_wrapper_status status =
+            fastcluster_compute_vbx(&matrix, phi.data(), clusters, &options, gamma.data(), gamma.size(), pi.data(),
+                                    elbos.data(), elbos.size(), &report);
+        const double seconds = secondsSince(start);
+        if (status != FASTCLUSTER_WRAPPER_SUCCESS) {
+            std::printf("failed with status %d\n", static_cast<int>(status));
+            return 1;
+        }
+        elbos.resize(report.iterations);
+        if (threads == 1) {
+            serialSeconds = seconds;
+            referenceGamma = gamma;
+            referenceElbos = elbos;
+        }
+        const bool identical = gamma == referenceGamma && elbos == referenceElbos;
+        std::printf("%-8zu %6zu %10.1f %10.2f %10s\n", threads, report.iterations, seconds * 1e3,
+                    serialSeconds / seconds, identical ? "yes" : "NO");
+    }
+    return 0;
+}
+
+int runVBxPrune(int argc, char **argv) {
+    const size_t frames = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 50000;
+    const size_t dimension = 128;
+    const size_t speakers = 8;
+    const size_t spurious = 48;
+    const size_t clusters = 2 * speakers + spurious;
+    struct Setting {
+        const char *name;
+        double pruneThreshold;
+        double gammaTolerance;
+    };
+    const Setting settings[] = {
+        {"off", 0, 0},
+        {"prune 1e-7", 1e-7, 0},
+        {"prune 1e-3", 1e-3, 0},
+        {"prune 1e-3 + gamma 1e-3", 1e-3, 1e-3},
+    };
+
+    std::vector<double> phi;
+    std::vector<size_t> labels;
+    const std::vector<double> data = pldaFrames(frames, dimension, speakers, 13, phi, labels);
+    const std::vector<double> initialGamma = vbxWarmStart(labels, speakers, spurious);
+    const fastcluster_matrix matrix = {data.data(), FASTCLUSTER_SCALAR_FLOAT64, frames, dimension, 0};
+
+    std::printf("%zu PLDA-space frames, D = %zu, %zu speakers; warm start as for `vbx` plus %zu clusters that\n"
+                "hold only some of the 5%% mislabelled frames. Up to 20 iterations, ELBO tolerance 1e-4.\n"
+                "left: speakers with pi > 0 at the end. DER: frame-level confusion against the true speakers.\n\n",
+                frames, dimension, speakers, spurious);
+    std::printf("%-24s %6s %6s %10s %9s %8s  %s\n", "setting", "iters", "left", "ms", "speedup", "DER",
+                "speakers per iteration");
+    double baselineSeconds = 0;
+    for (const Setting &setting : settings) {
+        std::vector<fastcluster_vbx_iteration> history(20);
+        fastcluster_vbx_options options;
+        fastcluster_vbx_options_init(&options);
+        options.pruneThreshold = setting.pruneThreshold;
+        options.gammaTolerance = setting.gammaTolerance;
+        options.history = history.data();
+        options.historyLength = history.size();
+        std::vector<double> gamma = initialGamma;
+        std::vector<double> pi(clusters);
+        fastcluster_vbx_report report;
+        const auto start = Clock::now();
+        const fastcluster_wrapper_status status = fastcluster_compute_vbx(
+            &matrix, phi.data(), clusters, &options, gamma.data(), gamma.size(), pi.data(), nullptr, 0, &report);
+        const double seconds = secondsSince(start);
+        if (status != FASTCLUSTER_WRAPPER_SUCCESS) {
+            std::printf("failed with status %d\n", static_cast<int>(status));
+            return 1;
+        }
+        if (baselineSeconds == 0) {
+            baselineSeconds = seconds;
+        }
+        std::string trace;
+        for (size_t i = 0; i < report.iterations; ++i) {
+            trace += (i > 0 ? " " : "") + std::to_string(history[i].speakerCount);
+        }
+        std::printf("%-24s %6zu %6zu %10.1f %8.2fx %7.2f%%  %s\n", setting.name, report.iterations,
+                    static_cast<size_t>(std::count_if(pi.begin(), pi.end(), [](double p) { return p > 0; })),
+                    seconds * 1e3, baselineSeconds / seconds, 100 * frameErrorRate(gamma, clusters, labels, speakers),
+                    trace.c_str());
+    }
+    return 0;
+}
+
+// The PLDA transform one embedding at a time, each into its own array, as
+// PLDATransform.swift hands rho features to VBx: matrix-vector products with
+// the parameters in their exported layout.
+std::vector<std::vector<double>> referencePLDA(const std::vector<float> &embeddings, size_t E, size_t L,
+                                               const std::vector<double> &inputMean, const std::vector<double> &lda,
+                                               const std::vector<double> &ldaMean, const std::vector<double> &pldaMean,
+                                               const std::vector<double> &transform) {
+    const size_t count = embeddings.size() / E;
+    std::vector<std::vector<double>> rho;
+    rho.reserve(count);
+    for (size_t t = 0; t < count; ++t) {
+        std::vector<double> u(E);
+        double sumSquares = 0;
+        for (size_t e = 0; e < E; ++e) {
+            u[e] = static_cast<double>(embeddings[t * E + e]) - inputMean[e];
+            sumSquares += u[e] * u[e];
+        }
+        const double scale = sumSquares > 0 ? std::sqrt(static_cast<double>(E) / sumSquares) : 0.0;
+        std::vector<double> y(L, 0.0);
+        for (size_t e = 0; e < E; ++e) {
+            for (size_t j = 0; j < L; ++j) {
+                y[j] += scale * u[e] * lda[e * L + j];
+            }
+        }
+        sumSquares = 0;
+        for (size_t j = 0; j < L; ++j) {
+            y[j] -= ldaMean[j];
+            sumSquares += y[j] * y[j];
+        }
+        const double ldaScale = sumSquares > 0 ? std::sqrt(static_cast<double>(L) / sumSquares) : 0.0;
+        for (size_t j = 0; j < L; ++j) {
+            y[j] = ldaScale * y[j] - pldaMean[j];
+        }
+        std::vector<double> row(L, 0.0);
+        for (size_t k = 0; k < L; ++k) {
+            for (size_t j = 0; j < L; ++j) {
+                row[k] += transform[k * L + j] * y[j];
+            }
+        }
+        rho.push_back(std::move(row));
+    }
+    return rho;
+}
+
+int runPLDA(int argc, char **argv) {
+    const size_t maximumCount = argc > 0 ? static_cast<size_t>(std::strtoul(argv[0], nullptr, 10)) : 50000;
+    const size_t E = 256;
+    const size_t L = 128;
+    std::mt19937_64 generator(17);
+    std::normal_distribution<double> normal;
+    auto draw = [&](size_t count, double scale) {
+        std::vector<double> values(count);
+        for (double &value : values) {
+            value = scale * normal(generator);
+        }
+        return values;
+    };
+    const std::vector<double> inputMean = draw(E, 0.1);
+    const std::vector<double> lda = draw(E * L, 1.0 / std::sqrt(static_cast<double>(E)));
+    const std::vector<double> ldaMean = draw(L, 0.1);
+    const std::vector<double> pldaMean = draw(L, 0.1);
+    const std::vector<double> transform = draw(L * L, 1.0 / std::sqrt(static_cast<double>(L)));
+    const fastcluster_plda_parameters parameters = {E,           L,        L,        inputMean.data(), lda.data(),
+                                                    ldaMean.data(), pldaMean.data(), transform.data()};
+    fastcluster_plda_engine *engine = fastcluster_plda_create(&parameters);
+    if (engine == nullptr) {
+        std::printf("fastcluster_plda_create failed\n");
+        return 1;
+    }
+
+    std::printf("float32 embeddings, E = %zu -> LDA %zu -> rho %zu. Reference: one embedding at a time into\n"
+                "nested arrays. Native: blocks of 32 rows into one contiguous matrix.\n\n",
+                E, L, L);
+    std::printf("%-8s %12s %10s %9s %14s %12s\n", "count", "reference ms", "native ms", "speedup", "embeddings/s",
+                "max |d|");
+    int result = 0;
+    for (const size_t count : {1000, 10000, 50000}) {
+        if (count > maximumCount) {
+            continue;
+        }
+        std::vector<float> embeddings(count * E);
+        for (float &value : embeddings) {
+            value = static_cast<float>(normal(generator));
+        }
+
+        auto start = Clock::now();
+        const std::vector<std::vector<double>> reference =
+            referencePLDA(embeddings, E, L, inputMean, lda, ldaMean, pldaMean, transform);
+        const double referenceSeconds = secondsSince(start);
+
+        std::vector<double> rho(count * L);
+        const fastcluster_matrix matrix = {embeddings.data(), FASTCLUSTER_SCALAR_FLOAT32, count, E, 0};
+        start = Clock::now();
+        const fastcluster_wrapper_status status = fastcluster_plda_transform(engine, &matrix, rho.data(), rho.size());
+        const double seconds = secondsSince(start);
+        if (status != FASTCLUSTER_WRAPPER_SUCCESS) {
+            std::printf("failed with status %d\n", static_cast<int>(status));
+            result = 1;
+            break;
+        }
+
+        double delta = 0;
+        for (size_t t = 0; t < count; ++t) {
+            for (size_t k = 0; k < L; ++k) {
+                delta = std::max(delta, std::fabs(rho[t * L + k] - reference[t][k]));
+            }
+        }
+        std::printf("%-8zu %12.1f %10.1f %8.2fx %14.0f %12.2e\n", count, referenceSeconds * 1e3, seconds * 1e3,
+                    referenceSeconds / seconds, static_cast<double>(count) / seconds, delta);
+    }
+    fastcluster_plda_destroy(engine);
+    return result;
+}
+
+// Resets the kernel's resident-set high-water mark so that the next
+// peakRssBytes() covers one case. Linux only; elsewhere the peak spans the
+// whole process.
+bool resetPeakRss() {
+#ifdef __linux__
+    if (FILE *file = std::fopen("/proc/self/clear_refs", "w")) {
+        const bool written = std::fputs("5", file) >= 0;
+        return std::fclose(file) == 0 && written;
+    }
+#endif
+    return false;
+}
+
+size_t peakRssBytes() {
+#ifdef __linux__
+    if (FILE *file = std::fopen("/proc/self/status", "r")) {
+        char line[256];
+        size_t kibibytes = 0;
+        bool found = false;
+        while (!found && std::fgets(line, sizeof(line), file) != nullptr) {
+            found = std::sscanf(line, "VmHWM: %zu kB", &kibibytes) == 1;
+        }
+        std::fclose(file);
+        if (found) {
+            return kibibytes * 1024;
+        }
+    }
+#endif
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+// One row of the suite, printed and written to the JSON report.
+struct SuiteCase {
+    std::string fixture;
+    std::string metric;
+    size_t rows;
+    size_t dimension;
+    size_t clusters;
+    size_t threads;
+    double bestSeconds;
+    size_t allocations;
+    size_t peakHeapBytes;
+    size_t peakRssBytes;
+    double ari;
+    int status;
+};
+
+bool writeSuiteJson(const char *path, const std::vector<SuiteCase> &cases, size_t repeats, bool rssPerCase) {
+    FILE *file = std::fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    std::fprintf(file, "{\n  \"schema\": 1,\n  \"benchmark\": \"FastClusterBenchmark suite\",\n");
+    std::fprintf(file, "  \"host\": {\"simd\": \"%s\", \"hardwareThreads\": %u, \"rssScope\": \"%s\"},\n",
+                 fastcluster_kernels::simd_level_name(fastcluster_kernels::detected_simd_level()),
+                 std::thread::hardware_concurrency(), rssPerCase ? "case" : "process");
+    std::fprintf(file, "  \"repeats\": %zu,\n  \"cases\": [\n", repeats);
+    for (size_t c = 0; c < cases.size(); ++c) {
+        const SuiteCase &entry = cases[c];
+        std::fprintf(file,
+                     "    {\"fixture\": \"%s\", \"method\": \"centroid\", \"metric\": \"%s\", \"n\": %zu, \"d\": %zu, "
+                     "\"clusters\": %zu, \"threads\": %zu, \"status\": %d, \"bestMs\": %.3f, \"nsPerMerge\": %.1f, "
+                     "\"allocations\": %zu, \"peakHeapBytes\": %zu, \"peakRssBytes\": %zu, \"ari\": ",
+                     entry.fixture.c_str(), entry.metric.c_str(), entry.rows, entry.dimension, entry.clusters,
+                     entry.threads, entry.status, entry.bestSeconds * 1e3,
+                     entry.bestSeconds * 1e9 / static_cast<double>(entry.rows - 1), entry.allocations,
+                     entry.peakHeapBytes, entry.peakRssBytes);
+        if (std::isnan(entry.ari)) {
+            std::fprintf(file, "null}");
+        } else {
+            std::fprintf(file, "%.4f}", entry.ari);
+        }
+        std::fprintf(file, "%s\n", c + 1 < cases.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+    return std::fclose(file) == 0;
+}
+
+int runSuite(int argc, char **argv) {
+    bool quick = false;
+    size_t repeats = 3;
+    const char *jsonPath = nullptr;
+    for (int a = 0; a < argc; ++a) {
+        if (std::strcmp(argv[a], "--quick") == 0) {
+            quick = true;
+        } else if (std::strcmp(argv[a], "--repeats") == 0 && a + 1 < argc) {
+            repeats = std::max<size_t>(1, std::strtoul(argv[++a], nullptr, 10));
+        } else if (std::strcmp(argv[a], "--json") == 0 && a + 1 < argc) {
+            jsonPath = argv[++a];
+        } else {
+            std::printf("usage: suite [--quick] [--repeats N] [--json PATH]\n");
+            return 1;
+        }
+    }
+
+    const std::vector<size_t> sizes = quick ? std::vector<size_t>{1000} : std::vector<size_t>{1000, 4000};
+    const size_t dimensions[] = {64, 256};
+    const size_t clusterCounts[] = {4, 32};
+    const size_t threadCounts[] = {1, 4};
+    struct Recording {
+        const char *name;
+        double seconds;
+        size_t speakers;
+    };
+    const Recording allRecordings[] = {{"extractor-20min", 1200, 3}, {"extractor-1h", 3600, 6},
+                                       {"extractor-3h", 10800, 10}};
+    const size_t recordingCount = quick ? 1 : 3;
+    const double threshold = cosineThresholdToDistance(0.6);
+    bool rssPerCase = true;
+
+    std::printf("centroid linkage, best of %zu runs; allocations and peaks from the first run\n", repeats);
+    std::printf("hardware threads: %u, SIMD: %s\n\n", std::thread::hardware_concurrency(),
+                fastcluster_kernels::simd_level_name(fastcluster_kernels::detected_simd_level()));
+    std::printf("%-16s %-6s %-4s %-3s %-3s %10s %10s %8s %10s %10s %7s\n", "fixture", "N", "D", "k", "thr", "ms",
+                "ns/merge", "allocs", "heap MiB", "RSS MiB", "ARI");
+
+    std::vector<SuiteCase> cases;
+    // Runs one case: `compute` clusters into `dendrogram` with the given options.
+    auto measure = [&](SuiteCase entry, const std::function<int(const fastcluster_linkage_options &)> &compute,
+                       const std::vector<double> &dendrogram, const std::vector<size_t> *truth) {
+        fastcluster_linkage_options options;
+        fastcluster_linkage_options_init(&options);
+        options.threadCount = entry.threads;
+        entry.bestSeconds = 1e300;
+        entry.status = FASTCLUSTER_WRAPPER_SUCCESS;
+        rssPerCase = resetPeakRss() && rssPerCase;
+        for (size_t repeat = 0; repeat < repeats; ++repeat) {
+            const size_t allocationsBefore = heapAllocations.load();
+            const size_t liveBefore = heapLiveBytes.load();
+            heapPeakBytes.store(liveBefore);
+            const auto start = Clock::now();
+            const int status = compute(options);
+            entry.bestSeconds = std::min(entry.bestSeconds, secondsSince(start));
+            if (repeat == 0) {
+                entry.allocations = heapAllocations.load() - allocationsBefore;
+                entry.peakHeapBytes = heapPeakBytes.load() - liveBefore;
+                entry.status = status;
+            }
+        }
+        entry.peakRssBytes = peakRssBytes();
+        entry.ari = std::nan("");
+        if (truth != nullptr && entry.status == FASTCLUSTER_WRAPPER_SUCCESS) {
+            entry.ari = adjustedRandIndex(*truth, cutDendrogram(dendrogram, entry.rows, threshold));
+        }
+        char ari[16] = "-";
+        if (!std::isnan(entry.ari)) {
+            std::snprintf(ari, sizeof(ari), "%.4f", entry.ari);
+        }
+        std::printf("%-16s %-6zu %-4zu %-3zu %-3zu %10.1f %10.0f %8zu %10.2f %10.1f %7s%s\n", entry.fixture.c_str(),
+                    entry.rows, entry.dimension, entry.clusters, entry.threads, entry.bestSeconds * 1e3,
+                    entry.bestSeconds * 1e9 / static_cast<double>(entry.rows - 1), entry.allocations,
+                    static_cast<double>(entry.peakHeapBytes) / (1024.0 * 1024.0),
+                    static_cast<double>(entry.peakRssBytes) / (1024.0 * 1024.0), ari,
+                    entry.status == FASTCLUSTER_WRAPPER_SUCCESS ? "" : "  FAILED");
+        cases.push_back(entry);
+    };
+
+    // Unit-norm Gaussian mixtures through the double Euclidean entry point.
+    for (const size_t rows : sizes) {
+        for (const size_t dimension : dimensions) {
+            for (const size_t clusters : clusterCounts) {
+                const std::vector<double> data =
+                    speakerMixture(rows, dimension, clusters, 0.9, static_cast<unsigned>(rows + dimension + clusters));
+                std::vector<double> dendrogram((rows - 1) * 4);
+                for (const size_t threads : threadCounts) {
+                    measure({"mixture", "euclidean", rows, dimension, clusters, threads, 0, 0, 0, 0, 0, 0},
+                            [&](const fastcluster_linkage_options &options) {
+                                return static_cast<int>(fastcluster_compute_centroid_linkage_with_options(
+                                    data.data(), rows, dimension, &options, dendrogram.data(), dendrogram.size()));
+                            },
+                            dendrogram, nullptr);
+                }
+            }
+        }
+    }
+
+    // Raw embeddings through the cosine matrix entry point, as AHCClustering
+    // calls it, scored against the fixture's speakers at its default threshold.
+    for (size_t r = 0; r < recordingCount; ++r) {
+        const Recording &recording = allRecordings[r];
+        const ExtractorFixture fixture =
+            extractorFixture(recording.seconds, recording.speakers, static_cast<unsigned>(r + 1));
+        const size_t rows = fixture.rows;
+        const fastcluster_matrix matrix = {fixture.values.data(), FASTCLUSTER_SCALAR_FLOAT64, rows, 256, 0};
+        std::vector<double> dendrogram((rows - 1) * 4);
+        for (const size_t threads : threadCounts) {
+            measure({recording.name, "cosine", rows, 256, recording.speakers, threads, 0, 0, 0, 0, 0, 0},
+                    [&](const fastcluster_linkage_options &options) {
+                        return static_cast<int>(fastcluster_compute_linkage_matrix(
+                            FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_COSINE, &matrix, &options,
+                            dendrogram.data(), dendrogram.size()));
+                    },
+                    dendrogram, &fixture.labels);
+        }
+    }
+
+    if (!rssPerCase) {
+        std::printf("\npeak RSS could not be reset between cases; it is the process peak so far\n");
+    }
+    if (jsonPath != nullptr) {
+        if (!writeSuiteJson(jsonPath, cases, repeats, rssPerCase)) {
+            std::printf("could not write %s\n", jsonPath);
+            return 1;
+        }
+        std::printf("\nwrote %s\n", jsonPath);
+    }
+    return 0;
+}
+
+struct Command {
+    const char *name;
+    const char *summary;
+    int (*run)(int argc, char **argv);
+};
+
+const Command commands[] = {
+    {"kernels", "Squared-Euclidean kernels vs. the historical scalar loop", runKernels},
+    {"precision", "Float32 centroid linkage vs. the double path", runPrecision},
+    {"scaling", "Threaded initialization and merge loop, 1-16 threads", runScaling},
+    {"methods", "Every linkage method of fastcluster_compute_linkage", runMethods},
+    {"workspace", "Repeated 500-point clusterings with a reused workspace", runWorkspace},
+    {"batch", "Many recordings in one batch call vs. one by one", runBatch},
+    {"distances", "Blocked vs. pairwise condensed distance matrix", runDistances},
+    {"approximate", "Micro-cluster approximate clustering vs. exact", runApproximate},
+    {"incremental", "Incremental centroid linkage vs. full reruns", runIncremental},
+    {"control", "Progress checks, cancellation and time budgets", runControl},
+    {"structures", "Active-set and heap variants of centroid linkage", runStructures},
+    {"index", "32-bit vs. 64-bit index builds of the vector methods", runIndexWidth},
+    {"half", "Float16 and bfloat16 storage vs. float64: time, label drift", runHalf},
+    {"constraints", "Must-link / cannot-link constrained centroid linkage", runConstraints},
+    {"weights", "Pre-merged weighted points vs. every chunk", runWeights},
+    {"vbx", "Native VBx: fused passes vs. the step-by-step reference", runVBx},
+    {"vbxprecision", "Float32 VBx vs. float64: ELBO drift and frame DER", runVBxPrecision},
+    {"vbxscaling", "Threaded VBx E-step, 1-16 threads", runVBxScaling},
+    {"vbxprune", "VBx with and without speaker pruning and the gamma test", runVBxPrune},
+    {"plda", "Blocked native PLDA transform vs. per-embedding arrays", runPLDA},
+    {"suite", "Regression suite: ns/merge, allocations, peak memory; JSON", runSuite},
+};
+
+void printUsage() {
+    std::printf("Usage: FastClusterBenchmark <command> [arguments]\n\nCommands:\n");
+    for (const Command &command : commands) {
+        std::printf("  %-12s %s\n", command.name, command.summary);
+    }
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+    for (const Command &command : commands) {
+        if (std::strcmp(argv[1], command.name) == 0) {
+            return command.run(argc - 2, argv + 2);
+        }
+    }
+    printUsage();
+    return 1;
+}
@@ -0,0 +1,527 @@
+#ifndef FASTCLUSTER_ADAPTER_HPP
+#define FASTCLUSTER_ADAPTER_HPP
+
+// Glue between the wrapper and fastcluster's vector algorithms: the workspace,
+// the dissimilarity adapter over the caller's rows, the SciPy dendrogram
+// writer and the dispatch of the centroid/median data structures.
+//
+// Include after fastcluster_internal.hpp. Everything here compiles against the
+// t_index that header defined, so FastClusterWrapper.cpp (32-bit indices) and
+// FastClusterWide.cpp (FASTCLUSTER_WIDE_INDEX, 64-bit) each get their own copy
+// in their anonymous namespace.
+
+#include "FastClusterWrapper.h"
+#include "FastClusterKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <thread>
+#include <type_traits>
+
+namespace {
+
+// Buffers of CentroidDissimilarity that depend on the storage type.
+template <typename t_storage>
+struct StorageBuffers {
+    reusable_array<t_storage> centroids;
+    reusable_array<t_storage> inverseNorms;
+
+    size_t allocations() const { return centroids.allocations() + inverseNorms.allocations(); }
+    size_t bytes() const { return centroids.bytes() + inverseNorms.bytes(); }
+};
+
+// Every buffer a linkage call needs, kept between calls. Calls without a
+// caller-provided workspace run in a temporary one.
+struct LinkageWorkspace {
+    vector_linkage_workspace linkage;
+    reusable_array<node> merges;
+    reusable_array<t_float> members;
+    reusable_array<t_index> centroidSlots;
+    StorageBuffers<double> f64;
+    StorageBuffers<float> f32;
+    reusable_array<t_float> condensed;
+    reusable_array<t_float> clusterSizes;
+    size_t calls = 0;
+
+    template <typename t_storage>
+    StorageBuffers<t_storage> &storage();
+
+    size_t allocations() const {
+        return linkage.allocations() + merges.allocations() + members.allocations() + centroidSlots.allocations() +
+               f64.allocations() + f32.allocations() + condensed.allocations() + clusterSizes.allocations();
+    }
+
+    size_t bytes() const {
+        return linkage.bytes() + merges.bytes() + members.bytes() + centroidSlots.bytes() + f64.bytes() + f32.bytes() +
+               condensed.bytes() + clusterSizes.bytes();
+    }
+};
+
+template <>
+StorageBuffers<double> &LinkageWorkspace::storage<double>() {
+    return f64;
+}
+
+template <>
+StorageBuffers<float> &LinkageWorkspace::storage<float>() {
+    return f32;
+}
+
+
+// Kernels over `t_storage` rows. `centroid` is the element type of merged
+// centroids: the input type, except that half-precision rows merge into float
+// centroids. For those, `function` compares two centroids, `scaled_function`
+// two input rows and `mixed_function` a centroid with an input row.
+template <typename t_storage>
+struct DistanceKernel;
+
+template <>
+struct DistanceKernel<double> {
+    typedef double centroid;
+    typedef fastcluster_kernels::sqeuclidean_f64_fn function;
+    typedef fastcluster_kernels::sqeuclidean_scaled_f64_fn scaled_function;
+    typedef std::nullptr_t mixed_function;
+    static function resolve() { return fastcluster_kernels::resolve_sqeuclidean_f64(); }
+    static scaled_function resolveScaled() { return fastcluster_kernels::resolve_sqeuclidean_scaled_f64(); }
+    static mixed_function resolveMixed() { return nullptr; }
+};
+
+template <>
+struct DistanceKernel<float> {
+    typedef float centroid;
+    typedef fastcluster_kernels::sqeuclidean_f32_fn function;
+    typedef fastcluster_kernels::sqeuclidean_scaled_f32_fn scaled_function;
+    typedef std::nullptr_t mixed_function;
+    static function resolve() { return fastcluster_kernels::resolve_sqeuclidean_f32(); }
+    static scaled_function resolveScaled() { return fastcluster_kernels::resolve_sqeuclidean_scaled_f32(); }
+    static mixed_function resolveMixed() { return nullptr; }
+};
+
+template <>
+struct DistanceKernel<fastcluster_kernels::float16_bits> {
+    typedef float centroid;
+    typedef fastcluster_kernels::sqeuclidean_f32_fn function;
+    typedef fastcluster_kernels::sqeuclidean_scaled_f16_fn scaled_function;
+    typedef fastcluster_kernels::sqeuclidean_scaled_f32_f16_fn mixed_function;
+    static function resolve() { return fastcluster_kernels::resolve_sqeuclidean_f32(); }
+    static scaled_function resolveScaled() { return fastcluster_kernels::resolve_sqeuclidean_scaled_f16(); }
+    static mixed_function resolveMixed() { return fastcluster_kernels::resolve_sqeuclidean_scaled_f32_f16(); }
+};
+
+template <>
+struct DistanceKernel<fastcluster_kernels::bfloat16_bits> {
+    typedef float centroid;
+    typedef fastcluster_kernels::sqeuclidean_f32_fn function;
+    typedef fastcluster_kernels::sqeuclidean_scaled_bf16_fn scaled_function;
+    typedef fastcluster_kernels::sqeuclidean_scaled_f32_bf16_fn mixed_function;
+    static function resolve() { return fastcluster_kernels::resolve_sqeuclidean_f32(); }
+    static scaled_function resolveScaled() { return fastcluster_kernels::resolve_sqeuclidean_scaled_bf16(); }
+    static mixed_function resolveMixed() { return fastcluster_kernels::resolve_sqeuclidean_scaled_f32_bf16(); }
+};
+
+// Inverse L2 norm of every row, for the cosine metric. Zero rows get 0 and stay
+// at the origin, as in AHCClustering's former Swift normalization.
+template <typename t_storage, typename t_scale>
+void computeInverseNorms(const t_storage *data, t_index count, t_index dimension, size_t rowStride,
+                         t_scale *inverseNorms) {
+    using fastcluster_kernels::widen;
+    for (t_index i = 0; i < count; ++i) {
+        const t_storage *row = data + static_cast<size_t>(i) * rowStride;
+        double norm = 0;
+        for (t_index k = 0; k < dimension; ++k) {
+            norm += static_cast<double>(widen(row[k])) * static_cast<double>(widen(row[k]));
+        }
+        inverseNorms[static_cast<size_t>(i)] = static_cast<t_scale>(norm > 0 ? 1.0 / std::sqrt(norm) : 0.0);
+    }
+}
+
+// Centroid rows a linkage over `count` points needs at once. Every active
+// merged cluster holds at least two points, so at most count / 2 of them are
+// alive, plus the row of the cluster being formed.
+t_index centroidSlotCount(t_index count, bool retainMergedCentroids) {
+    return retainMergedCentroids ? count - 1 : std::min(count - 1, count / 2 + 1);
+}
+
+// Dissimilarity adapter for the vector algorithms. Input rows and merged
+// centroids are kept in `t_storage`; distances are handed back to fastcluster as
+// t_float so the heap and the dendrogram stay in double precision. Half-precision
+// input rows are the exception: their centroids and norms are float.
+//
+// Input rows are read in place: row i starts at data + i * rowStride. With
+// `normalizeRows`, every input row is scaled to unit length on the fly through
+// a precomputed inverse norm, so the cosine metric needs O(N) extra memory
+// instead of a normalized copy of the matrix. Merged centroids are stored
+// already scaled. Centroids, sizes and norms live in the call's workspace.
+//
+// The vector algorithms never read a cluster again once it is merged, so the
+// centroid rows of merged-away clusters are recycled: `slots` maps merged node
+// ids to rows of `centroidStorage`, and freed rows are reused last-in first-out
+// (they are still in cache). This bounds centroid memory by
+// centroidSlotCount() rows instead of N - 1. With `retainMergedCentroids`,
+// merged node count + t keeps row t for the whole run, which the incremental
+// engine reads back as its tree.
+template <typename t_storage>
+struct CentroidDissimilarity {
+    typedef typename DistanceKernel<t_storage>::centroid t_centroid;
+    static constexpr bool halfPrecision = !std::is_same<t_storage, t_centroid>::value;
+
+    const t_storage *data;
+    const t_index dimension;
+    const t_index count;
+    const size_t rowStride;
+    const bool recycleCentroids;
+    t_centroid *centroidStorage;
+    // Weight of every cluster: its point count, or the sum of its point
+    // weights after seedWeights().
+    t_float *members;
+    t_index *slots;
+    t_index *freeSlots;
+    t_index freeSlotCount = 0;
+    t_index usedSlotCount = 0;
+    t_centroid *inverseNorms;
+    const typename DistanceKernel<t_storage>::function kernel;
+    const typename DistanceKernel<t_storage>::scaled_function scaledKernel;
+    const typename DistanceKernel<t_storage>::mixed_function mixedKernel;
+
+    CentroidDissimilarity(const t_storage *input, t_index sampleCount, t_index dim, size_t stride,
+                          bool normalizeRows, LinkageWorkspace &workspace, bool retainMergedCentroids = false)
+        : data(input),
+          dimension(dim),
+          count(sampleCount),
+          rowStride(stride != 0 ? stride : static_cast<size_t>(dim)),
+          recycleCentroids(!retainMergedCentroids),
+          centroidStorage(workspace.storage<t_centroid>().centroids.reserve(
+              static_cast<size_t>(centroidSlotCount(sampleCount, retainMergedCentroids)) *
+              static_cast<size_t>(dim))),
+          members(workspace.members.reserve(2 * sampleCount - 1)),
+          slots(workspace.centroidSlots.reserve(2 * (sampleCount - 1))),
+          freeSlots(slots + (sampleCount - 1)),
+          inverseNorms(normalizeRows ? workspace.storage<t_centroid>().inverseNorms.reserve(sampleCount) : nullptr),
+          kernel(DistanceKernel<t_storage>::resolve()),
+          scaledKernel(DistanceKernel<t_storage>::resolveScaled()),
+          mixedKernel(DistanceKernel<t_storage>::resolveMixed()) {
+        for (t_index i = 0; i < count; ++i) {
+            members[i] = 1;
+        }
+        if (normalizeRows) {
+            computeInverseNorms(data, count, dimension, rowStride, inverseNorms);
+        }
+    }
+
+    // Replaces the weight 1 of every point by `weights[i]`
+    // (`fastcluster_linkage_options.pointWeights`); nullptr keeps 1.
+    void seedWeights(const double *weights) {
+        if (weights != nullptr) {
+            for (t_index i = 0; i < count; ++i) {
+                members[i] = static_cast<t_float>(weights[i]);
+            }
+        }
+    }
+
+    // Both distance functions pass the higher index first, so the distance of a
+    // pair is the same bits whichever side of a search asks for it. The
+    // incremental engine depends on this to reproduce full recomputes exactly.
+    template <bool checkNaN>
+    t_float sqeuclidean(const t_index i, const t_index j) const {
+        const t_index high = std::max(i, j);
+        const t_index low = std::min(i, j);
+        t_float sum;
+        if constexpr (halfPrecision) {
+            sum = scaledKernel(basePointer(high), rowScale(high), basePointer(low), rowScale(low),
+                               static_cast<size_t>(dimension));
+        } else {
+            sum = inverseNorms == nullptr ? kernel(basePointer(high), basePointer(low), static_cast<size_t>(dimension))
+                                          : scaledKernel(basePointer(high), rowScale(high), basePointer(low),
+                                                         rowScale(low), static_cast<size_t>(dimension));
+        }
+        if constexpr (checkNaN) {
+#if HAVE_DIAGNOSTIC
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+#endif
+            if (fc_isnan(sum)) {
+#if HAVE_DIAGNOSTIC
+#pragma GCC diagnostic pop
+#endif
+                throw nan_error();
+            }
+        }
+        return sum;
+    }
+
+    t_float sqeuclidean_extended(const t_index i, const t_index j) const {
+        const t_index high = std::max(i, j);
+        const t_index low = std::min(i, j);
+        t_float sum;
+        if constexpr (halfPrecision) {
+            // Merged nodes have the higher ids, so `high` is the centroid of a
+            // mixed pair.
+            const size_t dim = static_cast<size_t>(dimension);
+            if (high < count) {
+                sum = scaledKernel(basePointer(high), rowScale(high), basePointer(low), rowScale(low), dim);
+            } else if (low < count) {
+                sum = mixedKernel(centroidPointer(high), 1.0f, basePointer(low), rowScale(low), dim);
+            } else {
+                sum = kernel(centroidPointer(high), centroidPointer(low), dim);
+            }
+        } else {
+            sum = inverseNorms == nullptr
+                      ? kernel(extendedPointer(high), extendedPointer(low), static_cast<size_t>(dimension))
+                      : scaledKernel(extendedPointer(high), rowScale(high), extendedPointer(low), rowScale(low),
+                                     static_cast<size_t>(dimension));
+        }
+#if HAVE_DIAGNOSTIC
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+#endif
+        if (fc_isnan(sum)) {
+            throw nan_error();
+        }
+#if HAVE_DIAGNOSTIC
+#pragma GCC diagnostic pop
+#endif
+        return sum;
+    }
+
+    void merge(const t_index i, const t_index j, const t_index newNode) {
+        t_centroid *pn = allocateCentroid(newNode);
+        const t_float mi = members[static_cast<size_t>(i)];
+        const t_float mj = members[static_cast<size_t>(j)];
+        const t_float denom = mi + mj;
+        const t_float wi = rowScale(i) * mi;
+        const t_float wj = rowScale(j) * mj;
+        withRows(i, j, [&](const auto *pi, const auto *pj) {
+            fastcluster_kernels::merge_centroids(pi, wi, pj, wj, denom, static_cast<size_t>(dimension), pn);
+        });
+        members[static_cast<size_t>(newNode)] = members[static_cast<size_t>(i)] + members[static_cast<size_t>(j)];
+        releaseCentroid(i);
+        releaseCentroid(j);
+    }
+
+    void merge_weighted(const t_index i, const t_index j, const t_index newNode) {
+        using fastcluster_kernels::widen;
+        t_centroid *pn = allocateCentroid(newNode);
+        const t_centroid si = rowScale(i);
+        const t_centroid sj = rowScale(j);
+        withRows(i, j, [&](const auto *pi, const auto *pj) {
+            for (t_index k = 0; k < dimension; ++k) {
+                pn[k] = static_cast<t_centroid>(0.5) * (widen(pi[k]) * si + widen(pj[k]) * sj);
+            }
+        });
+        members[static_cast<size_t>(newNode)] = members[static_cast<size_t>(i)] + members[static_cast<size_t>(j)];
+        releaseCentroid(i);
+        releaseCentroid(j);
+    }
+
+    // Dissimilarity used by MST_linkage_core_vector.
+    t_float operator()(const t_index i, const t_index j) const {
+        return sqeuclidean<true>(i, j);
+    }
+
+    t_float ward(const t_index i, const t_index j) const {
+        return sqeuclidean<true>(i, j);
+    }
+
+    t_float ward_initial(const t_index i, const t_index j) const {
+        return sqeuclidean<true>(i, j);
+    }
+
+    static t_float ward_initial_conversion(const t_float value) {
+        return value * static_cast<t_float>(0.5);
+    }
+
+    t_float ward_extended(const t_index i, const t_index j) const {
+        return sqeuclidean_extended(i, j);
+    }
+
+    void postprocess(cluster_result &result) const {
+        result.sqrt();
+    }
+
+private:
+    const t_storage *basePointer(const t_index index) const {
+        return data + static_cast<size_t>(index) * rowStride;
+    }
+
+    // Scale that maps the stored row of `index` to the row the metric sees:
+    // 1 except for input rows under the cosine metric.
+    t_centroid rowScale(const t_index index) const {
+        if (index < count && inverseNorms != nullptr) {
+            return inverseNorms[static_cast<size_t>(index)];
+        }
+        return static_cast<t_centroid>(1);
+    }
+
+    const t_centroid *centroidPointer(const t_index index) const {
+        return centroidStorage + static_cast<size_t>(slots[index - count]) * static_cast<size_t>(dimension);
+    }
+
+    // Input row or centroid of `index`; only when both have the same type.
+    const t_storage *extendedPointer(const t_index index) const {
+        if (index < count) {
+            return basePointer(index);
+        }
+        return centroidPointer(index);
+    }
+
+    // Calls body(pi, pj) with the rows of `i` and `j`, each typed as an input
+    // row or a centroid.
+    template <typename t_body>
+    void withRows(const t_index i, const t_index j, t_body &&body) const {
+        if constexpr (halfPrecision) {
+            if (i < count) {
+                withRow(j, [&](const auto *pj) { body(basePointer(i), pj); });
+            } else {
+                withRow(j, [&](const auto *pj) { body(centroidPointer(i), pj); });
+            }
+        } else {
+            body(extendedPointer(i), extendedPointer(j));
+        }
+    }
+
+    template <typename t_body>
+    void withRow(const t_index index, t_body &&body) const {
+        if (index < count) {
+            body(basePointer(index));
+        } else {
+            body(centroidPointer(index));
+        }
+    }
+
+    // Row for merged node `index`: the most recently freed one, else the next
+    // never used one. Called before the merged children are released, so the
+    // new row never aliases a child.
+    t_centroid *allocateCentroid(const t_index index) {
+        t_index slot;
+        if (!recycleCentroids) {
+            slot = index - count;
+        } else if (freeSlotCount > 0) {
+            slot = freeSlots[--freeSlotCount];
+        } else {
+            slot = usedSlotCount++;
+        }
+        slots[index - count] = slot;
+        return centroidStorage + static_cast<size_t>(slot) * static_cast<size_t>(dimension);
+    }
+
+    void releaseCentroid(const t_index index) {
+        if (recycleCentroids && index >= count) {
+            freeSlots[freeSlotCount++] = slots[index - count];
+        }
+    }
+};
+
+class LinkageOutput {
+public:
+    explicit LinkageOutput(t_float *buffer) : cursor(buffer) {}
+
+    void append(t_index node1, t_index node2, t_float distance, t_float size) {
+        if (node1 < node2) {
+            *(cursor++) = static_cast<t_float>(node1);
+            *(cursor++) = static_cast<t_float>(node2);
+        } else {
+            *(cursor++) = static_cast<t_float>(node2);
+            *(cursor++) = static_cast<t_float>(node1);
+        }
+        *(cursor++) = distance;
+        *(cursor++) = size;
+    }
+
+private:
+    t_float *cursor;
+};
+
+template <bool sorted>
+void generateSciPyDendrogram(t_float *Z, cluster_result &Z2, const t_index N) {
+    union_find nodes(sorted ? 0 : N);
+    if (!sorted) {
+        std::stable_sort(Z2[0], Z2[N - 1]);
+    }
+
+    LinkageOutput output(Z);
+    t_index node1;
+    t_index node2;
+
+    for (node const *entry = Z2[0]; entry != Z2[N - 1]; ++entry) {
+        if (sorted) {
+            node1 = entry->node1;
+            node2 = entry->node2;
+        } else {
+            node1 = nodes.Find(entry->node1);
+            node2 = nodes.Find(entry->node2);
+            nodes.Union(node1, node2);
+        }
+        output.append(node1, node2, entry->dist,
+                      ((node1 < N) ? 1 : Z_(node1 - N, 3)) + ((node2 < N) ? 1 : Z_(node2 - N, 3)));
+    }
+}
+
+// Below this many distance-kernel element operations per thread, starting a
+// thread costs more than it saves.
+constexpr double kMinimumWorkPerThread = 1 << 22;
+
+t_index effectiveThreadCount(size_t requested, size_t pointCount, size_t dimension) {
+    size_t threads = requested;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const double work = 0.5 * static_cast<double>(pointCount) * static_cast<double>(pointCount) *
+                        static_cast<double>(dimension);
+    const double affordable = std::max(1.0, work / kMinimumWorkPerThread);
+    threads = std::min(threads, static_cast<size_t>(std::min(affordable, 1024.0)));
+    return static_cast<t_index>(std::max<size_t>(threads, 1));
+}
+
+// A nearest-neighbor scan of the merge loop is split over the threads only
+// when every thread gets this many distance-kernel element operations; below
+// that, waking the threads costs more than it saves.
+constexpr double kMinimumScanWorkPerThread = 1 << 15;
+
+// vector_linkage_options::scan_min_nodes for `threads` threads over points of
+// `dimension` coordinates.
+t_index mergeScanMinimumNodes(t_index threads, t_index dimension) {
+    const double nodes = std::ceil(static_cast<double>(threads) * kMinimumScanWorkPerThread /
+                                   static_cast<double>(std::max<t_index>(dimension, 1)));
+    return static_cast<t_index>(std::max(nodes, 2.0 * static_cast<double>(threads)));
+}
+
+template <method_codes_vector method, typename t_active_set, typename t_dissimilarity>
+void runVectorLinkageWithActiveSet(const t_index N, t_dissimilarity &dist, cluster_result &result,
+                                   const vector_linkage_options &linkageOptions, size_t heapArity) {
+    switch (heapArity) {
+    case 4:
+        generic_linkage_vector_alternative<method, t_dissimilarity, t_active_set, d_ary_min_heap<4>>(
+            N, dist, result, linkageOptions);
+        break;
+    case 8:
+        generic_linkage_vector_alternative<method, t_dissimilarity, t_active_set, d_ary_min_heap<8>>(
+            N, dist, result, linkageOptions);
+        break;
+    default:
+        generic_linkage_vector_alternative<method, t_dissimilarity, t_active_set>(N, dist, result, linkageOptions);
+        break;
+    }
+}
+
+// generic_linkage_vector_alternative with the active set and heap selected
+// by `options`. With several threads, long nearest-neighbor scans of the merge
+// loop are split over them as well.
+template <method_codes_vector method, typename t_dissimilarity>
+void runVectorLinkage(const t_index N, t_dissimilarity &dist, cluster_result &result,
+                      const vector_linkage_options &linkageOptions, const fastcluster_linkage_options &options) {
+    vector_linkage_options mergeOptions = linkageOptions;
+    if (mergeOptions.threads > 1) {
+        mergeOptions.scan_min_nodes = mergeScanMinimumNodes(mergeOptions.threads, dist.dimension);
+    }
+    if (options.activeSet == FASTCLUSTER_ACTIVE_SET_BITMAP) {
+        runVectorLinkageWithActiveSet<method, bitmap_active_set>(N, dist, result, mergeOptions, options.heapArity);
+    } else {
+        runVectorLinkageWithActiveSet<method, linked_list_active_set>(N, dist, result, mergeOptions,
+                                                                      options.heapArity);
+    }
+}
+
+} // namespace
+
+#endif // FASTCLUSTER_ADAPTER_HPP
@@ -0,0 +1,141 @@
+#include "FastClusterConstraints.hpp"
+
+#include <algorithm>
+#include <initializer_list>
+#include <numeric>
+
+namespace fastcluster_constraints {
+
+namespace {
+
+size_t findRoot(std::vector<size_t> &parent, size_t point) {
+    while (parent[point] != point) {
+        point = parent[point] = parent[parent[point]];
+    }
+    return point;
+}
+
+} // namespace
+
+bool build_groups(size_t pointCount, const size_t *mustLink, size_t mustLinkCount, const size_t *cannotLink,
+                  size_t cannotLinkCount, constraint_groups &groups) {
+    std::vector<size_t> parent(pointCount);
+    std::iota(parent.begin(), parent.end(), size_t{0});
+    for (size_t p = 0; p < mustLinkCount; ++p) {
+        const size_t a = mustLink[2 * p];
+        const size_t b = mustLink[2 * p + 1];
+        if (a >= pointCount || b >= pointCount) {
+            return false;
+        }
+        const size_t rootA = findRoot(parent, a);
+        const size_t rootB = findRoot(parent, b);
+        // The smaller root wins, so every root is the smallest point of its
+        // group.
+        parent[std::max(rootA, rootB)] = std::min(rootA, rootB);
+    }
+
+    // Points are visited in ascending order, so a group is numbered when its
+    // smallest point, its root, is reached.
+    std::vector<size_t> groupOf(pointCount);
+    std::vector<size_t> sizes;
+    for (size_t i = 0; i < pointCount; ++i) {
+        const size_t root = findRoot(parent, i);
+        if (root == i) {
+            groupOf[i] = sizes.size();
+            sizes.push_back(0);
+        } else {
+            groupOf[i] = groupOf[root];
+        }
+        ++sizes[groupOf[i]];
+    }
+
+    const size_t count = sizes.size();
+    std::vector<size_t> offsets(count + 1, 0);
+    for (size_t g = 0; g < count; ++g) {
+        offsets[g + 1] = offsets[g] + sizes[g];
+    }
+    std::vector<size_t> members(pointCount);
+    std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < pointCount; ++i) {
+        members[cursor[groupOf[i]]++] = i;
+    }
+
+    std::vector<std::pair<size_t, size_t>> pairs;
+    pairs.reserve(cannotLinkCount);
+    for (size_t p = 0; p < cannotLinkCount; ++p) {
+        const size_t a = cannotLink[2 * p];
+        const size_t b = cannotLink[2 * p + 1];
+        if (a >= pointCount || b >= pointCount || groupOf[a] == groupOf[b]) {
+            return false;
+        }
+        pairs.emplace_back(std::min(groupOf[a], groupOf[b]), std::max(groupOf[a], groupOf[b]));
+    }
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    groups.groupOf = std::move(groupOf);
+    groups.members = std::move(members);
+    groups.offsets = std::move(offsets);
+    groups.cannotLink = std::move(pairs);
+    return true;
+}
+
+conflict_tracker::conflict_tracker(const constraint_groups &groups) {
+    const size_t count = groups.count();
+    slotOf.assign(count > 0 ? 2 * count - 1 : 0, kNone);
+
+    // One bit, and one slot, per group that appears in a cannot-link pair.
+    size_t constrained = 0;
+    for (const auto &pair : groups.cannotLink) {
+        for (const size_t group : {pair.first, pair.second}) {
+            if (slotOf[group] == kNone) {
+                slotOf[group] = constrained++;
+            }
+        }
+    }
+    // Slot s starts out holding group bit s only.
+    words = (constrained + 63) / 64;
+    contains.assign(constrained * words, 0);
+    forbidden.assign(constrained * words, 0);
+    heads.resize(constrained);
+    tails.resize(constrained);
+    sizes.assign(constrained, 1);
+    nextBit.assign(constrained, kNone);
+    for (size_t slot = 0; slot < constrained; ++slot) {
+        contains[slot * words + slot / 64] |= uint64_t{1} << (slot % 64);
+        heads[slot] = slot;
+        tails[slot] = slot;
+    }
+    for (const auto &pair : groups.cannotLink) {
+        const size_t slotA = slotOf[pair.first];
+        const size_t slotB = slotOf[pair.second];
+        forbidden[slotA * words + slotB / 64] |= uint64_t{1} << (slotB % 64);
+        forbidden[slotB * words + slotA / 64] |= uint64_t{1} << (slotA % 64);
+    }
+}
+
+void conflict_tracker::merge(size_t a, size_t b, size_t node) {
+    size_t slotA = slotOf[a];
+    size_t slotB = slotOf[b];
+    if (slotA == kNone) {
+        std::swap(slotA, slotB);
+    }
+    // The merged cluster takes over a child's slot; a second slot is left
+    // unused, since the number of clusters with constrained groups only falls.
+    if (slotA != kNone && slotB != kNone) {
+        uint64_t *containsA = contains.data() + slotA * words;
+        uint64_t *forbiddenA = forbidden.data() + slotA * words;
+        const uint64_t *containsB = contains.data() + slotB * words;
+        const uint64_t *forbiddenB = forbidden.data() + slotB * words;
+        for (size_t w = 0; w < words; ++w) {
+            containsA[w] |= containsB[w];
+            forbiddenA[w] |= forbiddenB[w];
+        }
+        nextBit[tails[slotA]] = heads[slotB];
+        tails[slotA] = tails[slotB];
+        sizes[slotA] += sizes[slotB];
+    }
+    slotOf[node] = slotA;
+}
+
+} // namespace fastcluster_constraints
@@ -0,0 +1,115 @@
+#ifndef FASTCLUSTER_CONSTRAINTS_HPP
+#define FASTCLUSTER_CONSTRAINTS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Must-link and cannot-link constraints for the vector linkage methods.
+//
+// Must-link pairs are closed transitively into groups, and every group enters
+// the linkage as one weighted point. Cannot-link pairs are mapped to pairs of
+// groups. During the linkage, a cluster carries two bitsets over the groups
+// that appear in any cannot-link pair: the groups it contains and the groups
+// it may not be merged with. Two clusters conflict when one contains a group
+// the other forbids. The wrapper then reports their distance as infinite, so
+// they merge only after every finite merge, at height +inf.
+//
+// A conflict test is a single load for clusters without constrained groups.
+// Otherwise the constrained groups of the smaller cluster, kept as a linked
+// list, are looked up in the other cluster's forbidden set, or both bitsets are
+// scanned when that is shorter: at most C / 64 words, where C is the number
+// of constrained groups. Early in a run, when most tests happen, clusters hold
+// one or two constrained groups, so a test costs a few bit lookups even for
+// thousands of constraints. The bitsets take 2 * C * ceil(C / 64) words in
+// total, because clusters that hold constrained groups are disjoint.
+namespace fastcluster_constraints {
+
+/// Must-link groups of the points, and the cannot-link pairs between them.
+struct constraint_groups {
+    /// Group of every point. Groups are numbered in order of their smallest
+    /// point.
+    std::vector<size_t> groupOf;
+    /// Points of group g, ascending, are members[offsets[g], offsets[g + 1]).
+    std::vector<size_t> members;
+    std::vector<size_t> offsets;
+    /// Sorted, unique pairs (a, b) of groups with a < b that must stay apart.
+    std::vector<std::pair<size_t, size_t>> cannotLink;
+
+    size_t count() const { return offsets.empty() ? 0 : offsets.size() - 1; }
+    size_t size(size_t group) const { return offsets[group + 1] - offsets[group]; }
+};
+
+/// Group `pointCount` points by `mustLinkCount` pairs of indices and map
+/// `cannotLinkCount` pairs onto the groups. Either list may be nullptr when its
+/// count is 0. Must-link pairs of a point with itself are ignored.
+///
+/// - Returns: false when an index is out of range, or a cannot-link pair joins
+///   a point to itself or falls inside one must-link group. Throws
+///   std::bad_alloc.
+bool build_groups(size_t pointCount, const size_t *mustLink, size_t mustLinkCount, const size_t *cannotLink,
+                  size_t cannotLinkCount, constraint_groups &groups);
+
+/// Cannot-link state of the clusters of a linkage over the groups of a
+/// `constraint_groups`: nodes 0 to count - 1 are the groups and merged node
+/// count + t is created by merge t, as in fastcluster.
+class conflict_tracker {
+public:
+    /// Throws std::bad_alloc.
+    explicit conflict_tracker(const constraint_groups &groups);
+
+    /// Whether active clusters `a` and `b` may not be merged. Safe to call
+    /// from several threads between merges.
+    bool conflict(size_t a, size_t b) const {
+        size_t slotA = slotOf[a];
+        size_t slotB = slotOf[b];
+        if (slotA == kNone || slotB == kNone) {
+            return false;
+        }
+        // Forbidding is symmetric, so either side's groups may be looked up.
+        if (sizes[slotA] > sizes[slotB]) {
+            std::swap(slotA, slotB);
+        }
+        const uint64_t *forbiddenB = forbidden.data() + slotB * words;
+        if (sizes[slotA] <= words) {
+            for (size_t bit = heads[slotA]; bit != kNone; bit = nextBit[bit]) {
+                if ((forbiddenB[bit / 64] >> (bit % 64)) & 1) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        const uint64_t *containsA = contains.data() + slotA * words;
+        for (size_t w = 0; w < words; ++w) {
+            if ((containsA[w] & forbiddenB[w]) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Record that `a` and `b` were merged into `node`.
+    void merge(size_t a, size_t b, size_t node);
+
+    /// Whether any cannot-link pair exists.
+    bool empty() const { return words == 0; }
+
+private:
+    static constexpr size_t kNone = std::numeric_limits<size_t>::max();
+
+    size_t words = 0;
+    std::vector<size_t> slotOf;
+    std::vector<uint64_t> contains;
+    std::vector<uint64_t> forbidden;
+    // Constrained groups of every slot: a list through nextBit, and its length.
+    std::vector<size_t> heads;
+    std::vector<size_t> tails;
+    std::vector<size_t> sizes;
+    std::vector<size_t> nextBit;
+};
+
+} // namespace fastcluster_constraints
+
+#endif // FASTCLUSTER_CONSTRAINTS_HPP
@@ -0,0 +1,306 @@
+#include "FastClusterDistanceMatrix.hpp"
+#include "FastClusterKernels.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FASTCLUSTER_DISTANCES_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define FASTCLUSTER_DISTANCES_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace fastcluster_distances {
+
+namespace {
+
+// Rows per packed strip (columns of the register tile).
+constexpr size_t kStripWidth = 8;
+// Rows per register tile.
+constexpr size_t kTileRows = 4;
+// Rows per unit of work handed to a thread; a multiple of kStripWidth.
+constexpr size_t kRowBlock = 64;
+
+// Rows centred on their mean, scaled, converted to double and stored in
+// strips: element k of row s * 8 + c lives at strips[(s * D + k) * 8 + c].
+// Rows past `count` are zero padding.
+struct PackedRows {
+    std::vector<double> strips;
+    std::vector<double> norms;
+    size_t count;
+    size_t dimension;
+
+    const double *strip(size_t index) const { return strips.data() + index * dimension * kStripWidth; }
+};
+
+template <typename t_storage>
+bool packRows(const t_storage *data, size_t count, size_t dimension, size_t rowStride, const t_storage *scales,
+              PackedRows &packed) {
+    const size_t stripCount = (count + kStripWidth - 1) / kStripWidth;
+    packed.count = count;
+    packed.dimension = dimension;
+    packed.strips.assign(stripCount * kStripWidth * dimension, 0.0);
+    packed.norms.assign(stripCount * kStripWidth, 0.0);
+
+    std::vector<double> mean(dimension, 0.0);
+    for (size_t i = 0; i < count; ++i) {
+        const t_storage *row = data + i * rowStride;
+        const double scale = scales != nullptr ? static_cast<double>(scales[i]) : 1.0;
+        for (size_t k = 0; k < dimension; ++k) {
+            mean[k] += scale * static_cast<double>(row[k]);
+        }
+    }
+    for (size_t k = 0; k < dimension; ++k) {
+        mean[k] /= static_cast<double>(count);
+        if (!std::isfinite(mean[k])) {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        const t_storage *row = data + i * rowStride;
+        const double scale = scales != nullptr ? static_cast<double>(scales[i]) : 1.0;
+        double *target = packed.strips.data() + (i / kStripWidth) * dimension * kStripWidth + i % kStripWidth;
+        double norm = 0;
+        for (size_t k = 0; k < dimension; ++k) {
+            const double value = scale * static_cast<double>(row[k]) - mean[k];
+            target[k * kStripWidth] = value;
+            norm += value * value;
+        }
+        if (!std::isfinite(norm)) {
+            return false;
+        }
+        packed.norms[i] = norm;
+    }
+    return true;
+}
+
+// Dot products of 4 consecutive rows of one strip (starting at lane
+// `firstLane`) with the 8 rows of another strip, written row-major to `tile`.
+// The variants differ only in how the 32 accumulators map onto registers.
+typedef void (*dot_tile_fn)(const double *rows, size_t firstLane, const double *columns, size_t dimension,
+                            double *tile);
+
+void dotTileScalar(const double *rows, size_t firstLane, const double *columns, size_t dimension, double *tile) {
+    double acc[kTileRows][kStripWidth] = {};
+    for (size_t k = 0; k < dimension; ++k) {
+        const double *a = rows + k * kStripWidth + firstLane;
+        const double *b = columns + k * kStripWidth;
+        for (size_t r = 0; r < kTileRows; ++r) {
+            const double ar = a[r];
+            for (size_t c = 0; c < kStripWidth; ++c) {
+                acc[r][c] += ar * b[c];
+            }
+        }
+    }
+    for (size_t r = 0; r < kTileRows; ++r) {
+        for (size_t c = 0; c < kStripWidth; ++c) {
+            tile[r * kStripWidth + c] = acc[r][c];
+        }
+    }
+}
+
+#if FASTCLUSTER_DISTANCES_X86
+
+__attribute__((target("avx2,fma"))) void dotTileAvx2(const double *rows, size_t firstLane, const double *columns,
+                                                    size_t dimension, double *tile) {
+    __m256d acc[kTileRows][2];
+    for (size_t r = 0; r < kTileRows; ++r) {
+        acc[r][0] = _mm256_setzero_pd();
+        acc[r][1] = _mm256_setzero_pd();
+    }
+    for (size_t k = 0; k < dimension; ++k) {
+        const double *a = rows + k * kStripWidth + firstLane;
+        const __m256d b0 = _mm256_loadu_pd(columns + k * kStripWidth);
+        const __m256d b1 = _mm256_loadu_pd(columns + k * kStripWidth + 4);
+        for (size_t r = 0; r < kTileRows; ++r) {
+            const __m256d ar = _mm256_broadcast_sd(a + r);
+            acc[r][0] = _mm256_fmadd_pd(ar, b0, acc[r][0]);
+            acc[r][1] = _mm256_fmadd_pd(ar, b1, acc[r][1]);
+        }
+    }
+    for (size_t r = 0; r < kTileRows; ++r) {
+        _mm256_storeu_pd(tile + r * kStripWidth, acc[r][0]);
+        _mm256_storeu_pd(tile + r * kStripWidth + 4, acc[r][1]);
+    }
+}
+
+__attribute__((target("avx512f"))) void dotTileAvx512(const double *rows, size_t firstLane, const double *columns,
+                                                     size_t dimension, double *tile) {
+    // One zmm covers a whole tile row; two sets over alternating k keep
+    // eight FMA chains in flight.
+    __m512d even[kTileRows];
+    __m512d odd[kTileRows];
+    for (size_t r = 0; r < kTileRows; ++r) {
+        even[r] = _mm512_setzero_pd();
+        odd[r] = _mm512_setzero_pd();
+    }
+    size_t k = 0;
+    for (; k + 2 <= dimension; k += 2) {
+        const double *a = rows + k * kStripWidth + firstLane;
+        const __m512d b0 = _mm512_loadu_pd(columns + k * kStripWidth);
+        const __m512d b1 = _mm512_loadu_pd(columns + (k + 1) * kStripWidth);
+        for (size_t r = 0; r < kTileRows; ++r) {
+            even[r] = _mm512_fmadd_pd(_mm512_set1_pd(a[r]), b0, even[r]);
+            odd[r] = _mm512_fmadd_pd(_mm512_set1_pd(a[kStripWidth + r]), b1, odd[r]);
+        }
+    }
+    if (k < dimension) {
+        const double *a = rows + k * kStripWidth + firstLane;
+        const __m512d b = _mm512_loadu_pd(columns + k * kStripWidth);
+        for (size_t r = 0; r < kTileRows; ++r) {
+            even[r] = _mm512_fmadd_pd(_mm512_set1_pd(a[r]), b, even[r]);
+        }
+    }
+    for (size_t r = 0; r < kTileRows; ++r) {
+        _mm512_storeu_pd(tile + r * kStripWidth, _mm512_add_pd(even[r], odd[r]));
+    }
+}
+
+#endif
+
+#if FASTCLUSTER_DISTANCES_NEON
+
+void dotTileNeon(const double *rows, size_t firstLane, const double *columns, size_t dimension, double *tile) {
+    float64x2_t acc[kTileRows][4];
+    for (size_t r = 0; r < kTileRows; ++r) {
+        for (size_t c = 0; c < 4; ++c) {
+            acc[r][c] = vdupq_n_f64(0.0);
+        }
+    }
+    for (size_t k = 0; k < dimension; ++k) {
+        const double *a = rows + k * kStripWidth + firstLane;
+        const double *b = columns + k * kStripWidth;
+        const float64x2_t b0 = vld1q_f64(b);
+        const float64x2_t b1 = vld1q_f64(b + 2);
+        const float64x2_t b2 = vld1q_f64(b + 4);
+        const float64x2_t b3 = vld1q_f64(b + 6);
+        for (size_t r = 0; r < kTileRows; ++r) {
+            const float64x2_t ar = vdupq_n_f64(a[r]);
+            acc[r][0] = vfmaq_f64(acc[r][0], ar, b0);
+            acc[r][1] = vfmaq_f64(acc[r][1], ar, b1);
+            acc[r][2] = vfmaq_f64(acc[r][2], ar, b2);
+            acc[r][3] = vfmaq_f64(acc[r][3], ar, b3);
+        }
+    }
+    for (size_t r = 0; r < kTileRows; ++r) {
+        for (size_t c = 0; c < 4; ++c) {
+            vst1q_f64(tile + r * kStripWidth + 2 * c, acc[r][c]);
+        }
+    }
+}
+
+#endif
+
+// Follows the level chosen for the pairwise kernels, so forcing
+// `simd_level::scalar` there also disables the vectorized tiles here.
+dot_tile_fn resolveDotTile() {
+    using fastcluster_kernels::simd_level;
+    switch (fastcluster_kernels::active_simd_level()) {
+#if FASTCLUSTER_DISTANCES_X86
+    case simd_level::avx512:
+        return dotTileAvx512;
+    case simd_level::avx2:
+        return dotTileAvx2;
+#endif
+#if FASTCLUSTER_DISTANCES_NEON
+    case simd_level::neon:
+        return dotTileNeon;
+#endif
+    default:
+        return dotTileScalar;
+    }
+}
+
+// All entries (i, j > i) for the rows of one block. Each column strip is
+// reused from L1 by the 16 register tiles of the block.
+void computeRowBlock(const PackedRows &packed, dot_tile_fn dotTile, size_t block, double *out) {
+    const size_t N = packed.count;
+    const size_t D = packed.dimension;
+    const size_t firstRow = block * kRowBlock;
+    const size_t lastRow = std::min(firstRow + kRowBlock, N - 1);
+    const size_t stripCount = (N + kStripWidth - 1) / kStripWidth;
+    double tile[kTileRows * kStripWidth];
+
+    for (size_t columnStrip = firstRow / kStripWidth; columnStrip < stripCount; ++columnStrip) {
+        const double *columns = packed.strip(columnStrip);
+        const size_t firstColumn = columnStrip * kStripWidth;
+        for (size_t tileRow = firstRow; tileRow < lastRow; tileRow += kTileRows) {
+            if (tileRow >= firstColumn + kStripWidth - 1) {
+                break; // no entry j > i left in this strip
+            }
+            dotTile(packed.strip(tileRow / kStripWidth), tileRow % kStripWidth, columns, D, tile);
+            for (size_t r = 0; r < kTileRows; ++r) {
+                const size_t i = tileRow + r;
+                if (i >= lastRow) {
+                    break;
+                }
+                // Condensed index of (i, j) is rowBase + j - 1.
+                const size_t rowBase = (2 * N - 3 - i) * i >> 1;
+                for (size_t c = 0; c < kStripWidth; ++c) {
+                    const size_t j = firstColumn + c;
+                    if (j <= i || j >= N) {
+                        continue;
+                    }
+                    const double value = packed.norms[i] + packed.norms[j] - 2 * tile[r * kStripWidth + c];
+                    out[rowBase + j - 1] = value > 0 ? value : 0;
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+template <typename t_storage>
+bool condensed_sqeuclidean_blocked(const t_storage *data, size_t count, size_t dimension, size_t rowStride,
+                                   const t_storage *scales, size_t threads, double *out) {
+    if (count < 2) {
+        return true;
+    }
+    PackedRows packed;
+    if (!packRows(data, count, dimension, rowStride, scales, packed)) {
+        return false;
+    }
+
+    // Block b costs about (N - 64 b) strips, so claiming blocks in ascending
+    // order hands out the largest ones first.
+    const size_t blockCount = (count - 1 + kRowBlock - 1) / kRowBlock;
+    threads = std::max<size_t>(1, std::min(threads, blockCount));
+    const dot_tile_fn dotTile = resolveDotTile();
+    std::atomic<size_t> nextBlock(0);
+    auto worker = [&]() {
+        for (size_t block = nextBlock++; block < blockCount; block = nextBlock++) {
+            computeRowBlock(packed, dotTile, block, out);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    try {
+        for (size_t t = 1; t < threads; ++t) {
+            pool.emplace_back(worker);
+        }
+    } catch (...) {
+        // The threads that did start and the calling thread drain the blocks.
+    }
+    worker();
+    for (std::thread &thread : pool) {
+        thread.join();
+    }
+    return true;
+}
+
+template bool condensed_sqeuclidean_blocked<double>(const double *, size_t, size_t, size_t, const double *, size_t,
+                                                    double *);
+template bool condensed_sqeuclidean_blocked<float>(const float *, size_t, size_t, size_t, const float *, size_t,
+                                                   double *);
+
+} // namespace fastcluster_distances
@@ -0,0 +1,50 @@
+#ifndef FASTCLUSTER_DISTANCE_MATRIX_HPP
+#define FASTCLUSTER_DISTANCE_MATRIX_HPP
+
+#include <cstddef>
+
+// Blocked construction of the condensed squared-Euclidean distance matrix used
+// by the stored-matrix algorithms (NN_chain_core, generic_linkage).
+//
+// Instead of one pairwise difference loop per entry, every entry is expanded as
+// |x|^2 + |y|^2 - 2 x.y and the dot products are computed as a tiled
+// matrix product: rows are packed once into strips of 8 rows stored k-major,
+// and a 4 x 8 register tile accumulates 32 dot products per pass over the
+// strip. The tile has scalar, AVX2+FMA, AVX-512F and NEON variants, chosen
+// from `fastcluster_kernels::active_simd_level()` like the pairwise kernels.
+// Blocks of 64 rows are distributed over worker threads.
+//
+// Accuracy: the expansion cancels when two rows are much closer to each other
+// than to the origin. Rows are centred on their mean while packing, which makes
+// the result translation invariant; the remaining absolute error is about
+// 2^-52 * (|x - mean|^2 + |y - mean|^2) per entry, and negative results of
+// the cancellation are clamped to 0. The pairwise kernels stay the exact
+// reference.
+namespace fastcluster_distances {
+
+/// Fill `out` with the N * (N - 1) / 2 squared distances between the rows of
+/// `data`, in SciPy condensed order (row i holds the entries j > i).
+///
+/// - Parameters:
+///   - data: `count` rows starting `rowStride` elements apart.
+///   - scales: Optional per-row factors applied before the distance is taken
+///     (inverse norms for the cosine metric), or nullptr.
+///   - threads: Worker threads, including the calling thread.
+///   - out: Destination of `count * (count - 1) / 2` doubles.
+///
+/// - Returns: false, without touching `out`, when the input contains NaN or
+///   infinite values; the caller falls back to the pairwise path, which
+///   reports them. Throws std::bad_alloc when the packed copy cannot be
+///   allocated. The packed copy takes about N * D doubles.
+template <typename t_storage>
+bool condensed_sqeuclidean_blocked(const t_storage *data, size_t count, size_t dimension, size_t rowStride,
+                                   const t_storage *scales, size_t threads, double *out);
+
+extern template bool condensed_sqeuclidean_blocked<double>(const double *, size_t, size_t, size_t, const double *,
+                                                           size_t, double *);
+extern template bool condensed_sqeuclidean_blocked<float>(const float *, size_t, size_t, size_t, const float *,
+                                                          size_t, double *);
+
+} // namespace fastcluster_distances
+
+#endif // FASTCLUSTER_DISTANCE_MATRIX_HPP
@@ -0,0 +1,317 @@
+#include "FastClusterIncremental.hpp"
+#include "FastClusterKernels.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <utility>
+
+namespace fastcluster_incremental {
+
+namespace {
+
+constexpr size_t kNone = std::numeric_limits<size_t>::max();
+
+// Nearest neighbours a scan keeps per touched cluster. When the nearest one
+// is merged away, the next one still active is exact as long as it is no
+// farther than the last kept one, which saves most rescans.
+constexpr size_t kCandidates = 16;
+
+// Node ids with O(1) insertion, removal and membership test.
+class NodeSet {
+public:
+    explicit NodeSet(size_t capacity) : position(capacity, kNone) {}
+
+    bool contains(size_t node) const { return position[node] != kNone; }
+
+    void insert(size_t node) {
+        position[node] = members.size();
+        members.push_back(node);
+    }
+
+    void erase(size_t node) {
+        const size_t slot = position[node];
+        const size_t last = members.back();
+        members[slot] = last;
+        position[last] = slot;
+        members.pop_back();
+        position[node] = kNone;
+    }
+
+    const std::vector<size_t> &nodes() const { return members; }
+
+private:
+    std::vector<size_t> members;
+    std::vector<size_t> position;
+};
+
+typedef std::pair<double, size_t> candidate;
+
+// Neighbour candidates of a touched cluster: the closest clusters of its last
+// scan and every cluster created since, in a min-heap. Active clusters that
+// are not in the heap are at least `cutoff` away.
+struct Candidates {
+    std::vector<candidate> heap;
+    double cutoff = std::numeric_limits<double>::infinity();
+
+    void offer(double value, size_t node) {
+        heap.emplace_back(value, node);
+        std::push_heap(heap.begin(), heap.end(), std::greater<candidate>());
+    }
+
+    void pop() {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<candidate>());
+        heap.pop_back();
+    }
+};
+
+class TreeExtender {
+public:
+    TreeExtender(const double *rows, const double *scales, size_t count, size_t dimension,
+                 const centroid_tree &previous)
+        : rows(rows),
+          scales(scales),
+          count(count),
+          dimension(dimension),
+          previous(previous),
+          kernel(fastcluster_kernels::resolve_sqeuclidean_f64()),
+          scaledKernel(fastcluster_kernels::resolve_sqeuclidean_scaled_f64()),
+          active(2 * count - 1),
+          touched(2 * count - 1),
+          candidates(2 * count - 1),
+          members(2 * count - 1, 1),
+          oldToNew(2 * previous.leafCount - 1, kNone),
+          newToOld(2 * count - 1, kNone) {}
+
+    void run(centroid_tree &next, extension_statistics &statistics) {
+        next.leafCount = count;
+        next.left.reserve(count - 1);
+        next.right.reserve(count - 1);
+        next.distances.reserve(count - 1);
+        next.sizes.reserve(count - 1);
+        next.centroids.resize((count - 1) * dimension);
+        centroids = next.centroids.data();
+
+        const size_t oldCount = previous.leafCount;
+        for (size_t i = 0; i < count; ++i) {
+            active.insert(i);
+        }
+        for (size_t i = 0; i < oldCount; ++i) {
+            oldToNew[i] = i;
+            newToOld[i] = i;
+        }
+        for (size_t i = oldCount; i < count; ++i) {
+            touch(i);
+        }
+
+        const size_t oldMerges = oldCount - 1;
+        size_t nextOld = 0;
+        for (size_t node = count; node < 2 * count - 1; ++node) {
+            // An old merge whose child was absorbed into a touched cluster can
+            // no longer happen; its surviving child becomes an orphan.
+            while (nextOld < oldMerges && !replayable(nextOld)) {
+                orphan(previous.left[nextOld]);
+                orphan(previous.right[nextOld]);
+                ++nextOld;
+            }
+            const size_t closest = closestTouched();
+            if (nextOld < oldMerges &&
+                (closest == kNone || previous.distances[nextOld] <= candidates[closest].heap.front().first)) {
+                replay(nextOld++, node, next);
+                ++statistics.replayedMerges;
+            } else {
+                recompute(closest, node, next);
+                ++statistics.recomputedMerges;
+            }
+        }
+    }
+
+private:
+    const double *const rows;
+    const double *const scales;
+    const size_t count;
+    const size_t dimension;
+    const centroid_tree &previous;
+    const fastcluster_kernels::sqeuclidean_f64_fn kernel;
+    const fastcluster_kernels::sqeuclidean_scaled_f64_fn scaledKernel;
+    double *centroids = nullptr;
+
+    NodeSet active;
+    // Touched clusters and their neighbour candidates.
+    NodeSet touched;
+    std::vector<Candidates> candidates;
+    std::vector<candidate> nearestScanned;
+    std::vector<size_t> members;
+    // Untouched old nodes and their ids in the new tree; kNone for old nodes
+    // that were merged, touched, or will never form.
+    std::vector<size_t> oldToNew;
+    std::vector<size_t> newToOld;
+
+    const double *coordinates(size_t node) const {
+        return node < count ? rows + node * dimension : centroids + (node - count) * dimension;
+    }
+
+    double scale(size_t node) const { return node < count && scales != nullptr ? scales[node] : 1.0; }
+
+    // Same kernel and argument order as CentroidDissimilarity: higher id first.
+    double distance(size_t a, size_t b) const {
+        const size_t high = std::max(a, b);
+        const size_t low = std::min(a, b);
+        if (scales == nullptr) {
+            return kernel(coordinates(high), coordinates(low), dimension);
+        }
+        return scaledKernel(coordinates(high), scale(high), coordinates(low), scale(low), dimension);
+    }
+
+    bool replayable(size_t merge) const {
+        return oldToNew[previous.left[merge]] != kNone && oldToNew[previous.right[merge]] != kNone;
+    }
+
+    // Distance from every active cluster to `node`: the closest ones become the
+    // candidates of `node`, and `node` becomes a candidate of every other
+    // touched cluster.
+    void scan(size_t node) {
+        nearestScanned.clear();
+        for (const size_t other : active.nodes()) {
+            if (other == node) {
+                continue;
+            }
+            const double value = distance(node, other);
+            if (nearestScanned.size() < kCandidates) {
+                nearestScanned.emplace_back(value, other);
+                std::push_heap(nearestScanned.begin(), nearestScanned.end());
+            } else if (value < nearestScanned.front().first) {
+                std::pop_heap(nearestScanned.begin(), nearestScanned.end());
+                nearestScanned.back() = candidate(value, other);
+                std::push_heap(nearestScanned.begin(), nearestScanned.end());
+            }
+            if (touched.contains(other)) {
+                candidates[other].offer(value, node);
+            }
+        }
+        Candidates &own = candidates[node];
+        own.cutoff = nearestScanned.size() < kCandidates ? std::numeric_limits<double>::infinity()
+                                                         : nearestScanned.front().first;
+        own.heap.assign(nearestScanned.begin(), nearestScanned.end());
+        std::make_heap(own.heap.begin(), own.heap.end(), std::greater<candidate>());
+    }
+
+    void touch(size_t node) {
+        touched.insert(node);
+        scan(node);
+    }
+
+    void orphan(size_t oldNode) {
+        const size_t node = oldToNew[oldNode];
+        if (node == kNone) {
+            return;
+        }
+        oldToNew[oldNode] = kNone;
+        newToOld[node] = kNone;
+        touch(node);
+    }
+
+    // Touched cluster with the closest pair; its first candidate is then its
+    // exact nearest neighbour. Candidates merged away are dropped, and a cluster
+    // whose remaining candidates no longer cover the cutoff is rescanned once
+    // it could hold the closest pair. kNone when nothing is touched.
+    size_t closestTouched() {
+        for (;;) {
+            size_t best = kNone;
+            double bestValue = std::numeric_limits<double>::infinity();
+            bool exact = false;
+            for (const size_t node : touched.nodes()) {
+                Candidates &own = candidates[node];
+                while (!own.heap.empty() && !active.contains(own.heap.front().second)) {
+                    own.pop();
+                }
+                const bool covered = !own.heap.empty() && own.heap.front().first <= own.cutoff;
+                const double value = covered ? own.heap.front().first : own.cutoff;
+                if (best == kNone || value < bestValue) {
+                    best = node;
+                    bestValue = value;
+                    exact = covered;
+                }
+            }
+            if (best == kNone || exact) {
+                return best;
+            }
+            scan(best);
+        }
+    }
+
+    void record(centroid_tree &next, size_t a, size_t b, double value, size_t size) {
+        next.left.push_back(std::max(a, b));
+        next.right.push_back(std::min(a, b));
+        next.distances.push_back(value);
+        next.sizes.push_back(size);
+    }
+
+    void replay(size_t merge, size_t node, centroid_tree &next) {
+        const size_t oldLeft = previous.left[merge];
+        const size_t oldRight = previous.right[merge];
+        const size_t a = oldToNew[oldLeft];
+        const size_t b = oldToNew[oldRight];
+        oldToNew[oldLeft] = kNone;
+        oldToNew[oldRight] = kNone;
+
+        const double *source = previous.centroids.data() + merge * dimension;
+        std::copy(source, source + dimension, centroids + (node - count) * dimension);
+        members[node] = previous.sizes[merge];
+        record(next, a, b, previous.distances[merge], previous.sizes[merge]);
+
+        active.erase(a);
+        active.erase(b);
+        active.insert(node);
+        oldToNew[previous.leafCount + merge] = node;
+        newToOld[node] = previous.leafCount + merge;
+
+        for (const size_t other : touched.nodes()) {
+            candidates[other].offer(distance(other, node), node);
+        }
+    }
+
+    void recompute(size_t first, size_t node, centroid_tree &next) {
+        const candidate closest = candidates[first].heap.front();
+        const size_t second = closest.second;
+        const size_t high = std::max(first, second);
+        const size_t low = std::min(first, second);
+        // Same operands, in the same order, as CentroidDissimilarity::merge
+        // called by the full run with (high, low).
+        const double highMembers = static_cast<double>(members[high]);
+        const double lowMembers = static_cast<double>(members[low]);
+        fastcluster_kernels::merge_centroids(coordinates(high), scale(high) * highMembers, coordinates(low),
+                                             scale(low) * lowMembers, highMembers + lowMembers, dimension,
+                                             centroids + (node - count) * dimension);
+        members[node] = members[high] + members[low];
+        record(next, first, second, closest.first, members[node]);
+
+        // An untouched partner is absorbed: its old merge cannot happen.
+        if (newToOld[second] != kNone) {
+            oldToNew[newToOld[second]] = kNone;
+            newToOld[second] = kNone;
+        }
+        for (const size_t merged : {first, second}) {
+            if (touched.contains(merged)) {
+                touched.erase(merged);
+                candidates[merged] = Candidates();
+            }
+            active.erase(merged);
+        }
+        active.insert(node);
+        touch(node);
+    }
+};
+
+} // namespace
+
+void extend_centroid_tree(const double *rows, const double *scales, size_t count, size_t dimension,
+                          centroid_tree &tree, extension_statistics &statistics) {
+    statistics = extension_statistics();
+    centroid_tree next;
+    TreeExtender extender(rows, scales, count, dimension, tree);
+    extender.run(next, statistics);
+    tree = std::move(next);
+}
+
+} // namespace fastcluster_incremental
@@ -0,0 +1,78 @@
+#ifndef FASTCLUSTER_INCREMENTAL_HPP
+#define FASTCLUSTER_INCREMENTAL_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Incremental centroid linkage: extends the merge tree of the first N rows to
+// N + k rows without rebuilding it.
+//
+// Centroid linkage always merges the globally closest pair of active clusters.
+// Points appended after a run cannot change the distance between two clusters
+// of the old tree, so the old merge list stays valid until a pair involving a
+// new point, or a cluster built from one, becomes the closest. The extension
+// replays the old merges in order and keeps exact nearest neighbours only for
+// the "touched" clusters:
+//
+//   - new points, and every cluster formed by a merge that involves a touched
+//     cluster;
+//   - orphans: old clusters whose old merge partner was absorbed into a touched
+//     cluster, so their old merge can no longer happen.
+//
+// At every step the next replayable old merge (both children still untouched)
+// is the closest untouched pair: the untouched clusters are a subset of the
+// clusters that were active when the old run took that merge. It competes with
+// the closest touched pair; the smaller distance wins. A replayed merge costs
+// one distance per touched cluster and copies its centroid from the old tree;
+// a recomputed merge scans the active clusters once. For a few new points the
+// touched set stays small and the extension costs O(k * N * D) plus
+// O(N * D) per recomputed merge, against O(N^2 * D) for a full run.
+//
+// Exactness: distances and merged centroids are computed by the same kernels,
+// with the same argument order, as the full run (see CentroidDissimilarity), so
+// the extended tree is bit-identical to a full recompute whenever no two
+// candidate merges have exactly the same distance. Exact ties may be broken
+// differently, which yields an equally valid tree.
+namespace fastcluster_incremental {
+
+/// Centroid linkage tree in merge order: merge t joins nodes left[t] and
+/// right[t] (left > right) into node leafCount + t, SciPy numbering.
+struct centroid_tree {
+    size_t leafCount = 0;
+    std::vector<size_t> left;
+    std::vector<size_t> right;
+    /// Squared merge distances.
+    std::vector<double> distances;
+    /// Points below every merged node.
+    std::vector<size_t> sizes;
+    /// (leafCount - 1) * dimension coordinates of the merged centroids, scaled
+    /// like the rows the metric sees.
+    std::vector<double> centroids;
+};
+
+struct extension_statistics {
+    /// Merges copied from the old tree.
+    size_t replayedMerges = 0;
+    /// Merges that involved a new point or an orphan.
+    size_t recomputedMerges = 0;
+};
+
+/// Extend `tree`, built over rows [0, tree.leafCount), to rows [0, count).
+///
+/// - Parameters:
+///   - rows: `count` densely packed rows of `dimension` doubles; every value
+///     must be finite.
+///   - scales: Per-row factors applied before the distance is taken (inverse
+///     norms for the cosine metric), or nullptr. Must be the scales the tree
+///     was built with.
+///   - tree: Replaced by the tree over all `count` rows. Requires
+///     tree.leafCount >= 1 and count >= tree.leafCount.
+///
+/// Throws std::bad_alloc when the working arrays cannot be allocated; `tree`
+/// is then unchanged.
+void extend_centroid_tree(const double *rows, const double *scales, size_t count, size_t dimension,
+                          centroid_tree &tree, extension_statistics &statistics);
+
+} // namespace fastcluster_incremental
+
+#endif // FASTCLUSTER_INCREMENTAL_HPP
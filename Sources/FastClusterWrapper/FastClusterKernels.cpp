@@ -0,0 +1,771 @@
+#include "FastClusterKernels.hpp"
+
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define FASTCLUSTER_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define FASTCLUSTER_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Round every product and sum on its own. Left to the compiler, clang fuses
+// `a * b + c` on arm64 but not on x86-64, and GCC fuses it wherever FMA is
+// enabled (the AVX2 tails), so the scalar kernels would differ by target.
+// Explicit FMA intrinsics are not affected.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+namespace fastcluster_kernels {
+
+// The scalar kernels keep four independent partial sums, so that consecutive
+// elements do not wait on the latency of one floating-point add chain, and add
+// them pairwise at the end like the vector kernels add their lanes.
+double sqeuclidean_f64_scalar(const double *a, const double *b, size_t dimension) {
+    double sum0 = 0;
+    double sum1 = 0;
+    double sum2 = 0;
+    double sum3 = 0;
+    size_t k = 0;
+    for (; k + 4 <= dimension; k += 4) {
+        const double d0 = a[k] - b[k];
+        const double d1 = a[k + 1] - b[k + 1];
+        const double d2 = a[k + 2] - b[k + 2];
+        const double d3 = a[k + 3] - b[k + 3];
+        sum0 += d0 * d0;
+        sum1 += d1 * d1;
+        sum2 += d2 * d2;
+        sum3 += d3 * d3;
+    }
+    for (; k < dimension; ++k) {
+        const double diff = a[k] - b[k];
+        sum0 += diff * diff;
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+float sqeuclidean_f32_scalar(const float *a, const float *b, size_t dimension) {
+    float sum0 = 0;
+    float sum1 = 0;
+    float sum2 = 0;
+    float sum3 = 0;
+    size_t k = 0;
+    for (; k + 4 <= dimension; k += 4) {
+        const float d0 = a[k] - b[k];
+        const float d1 = a[k + 1] - b[k + 1];
+        const float d2 = a[k + 2] - b[k + 2];
+        const float d3 = a[k + 3] - b[k + 3];
+        sum0 += d0 * d0;
+        sum1 += d1 * d1;
+        sum2 += d2 * d2;
+        sum3 += d3 * d3;
+    }
+    for (; k < dimension; ++k) {
+        const float diff = a[k] - b[k];
+        sum0 += diff * diff;
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+double sqeuclidean_scaled_f64_scalar(const double *a, double scaleA, const double *b, double scaleB,
+                                     size_t dimension) {
+    double sum0 = 0;
+    double sum1 = 0;
+    double sum2 = 0;
+    double sum3 = 0;
+    size_t k = 0;
+    for (; k + 4 <= dimension; k += 4) {
+        const double d0 = a[k] * scaleA - b[k] * scaleB;
+        const double d1 = a[k + 1] * scaleA - b[k + 1] * scaleB;
+        const double d2 = a[k + 2] * scaleA - b[k + 2] * scaleB;
+        const double d3 = a[k + 3] * scaleA - b[k + 3] * scaleB;
+        sum0 += d0 * d0;
+        sum1 += d1 * d1;
+        sum2 += d2 * d2;
+        sum3 += d3 * d3;
+    }
+    for (; k < dimension; ++k) {
+        const double diff = a[k] * scaleA - b[k] * scaleB;
+        sum0 += diff * diff;
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+float sqeuclidean_scaled_f32_scalar(const float *a, float scaleA, const float *b, float scaleB, size_t dimension) {
+    float sum0 = 0;
+    float sum1 = 0;
+    float sum2 = 0;
+    float sum3 = 0;
+    size_t k = 0;
+    for (; k + 4 <= dimension; k += 4) {
+        const float d0 = a[k] * scaleA - b[k] * scaleB;
+        const float d1 = a[k + 1] * scaleA - b[k + 1] * scaleB;
+        const float d2 = a[k + 2] * scaleA - b[k + 2] * scaleB;
+        const float d3 = a[k + 3] * scaleA - b[k + 3] * scaleB;
+        sum0 += d0 * d0;
+        sum1 += d1 * d1;
+        sum2 += d2 * d2;
+        sum3 += d3 * d3;
+    }
+    for (; k < dimension; ++k) {
+        const float diff = a[k] * scaleA - b[k] * scaleB;
+        sum0 += diff * diff;
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+namespace {
+
+// The half-precision kernels are templates over the element types of the two
+// operands (half-precision input rows, float centroids); each level's loads
+// widen whatever they read to float.
+template <typename t_a, typename t_b>
+float sqeuclidean_scaled_half_scalar(const t_a *a, float scaleA, const t_b *b, float scaleB, size_t dimension) {
+    float sum0 = 0;
+    float sum1 = 0;
+    float sum2 = 0;
+    float sum3 = 0;
+    size_t k = 0;
+    for (; k + 4 <= dimension; k += 4) {
+        const float d0 = widen(a[k]) * scaleA - widen(b[k]) * scaleB;
+        const float d1 = widen(a[k + 1]) * scaleA - widen(b[k + 1]) * scaleB;
+        const float d2 = widen(a[k + 2]) * scaleA - widen(b[k + 2]) * scaleB;
+        const float d3 = widen(a[k + 3]) * scaleA - widen(b[k + 3]) * scaleB;
+        sum0 += d0 * d0;
+        sum1 += d1 * d1;
+        sum2 += d2 * d2;
+        sum3 += d3 * d3;
+    }
+    for (; k < dimension; ++k) {
+        const float diff = widen(a[k]) * scaleA - widen(b[k]) * scaleB;
+        sum0 += diff * diff;
+    }
+    return (sum0 + sum1) + (sum2 + sum3);
+}
+
+#if FASTCLUSTER_KERNELS_X86
+
+__attribute__((target("avx2,fma"))) double sqeuclidean_f64_avx2(const double *a, const double *b, size_t dimension) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t k = 0;
+    for (; k + 8 <= dimension; k += 8) {
+        const __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(a + k), _mm256_loadu_pd(b + k));
+        const __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(a + k + 4), _mm256_loadu_pd(b + k + 4));
+        acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+        acc1 = _mm256_fmadd_pd(d1, d1, acc1);
+    }
+    if (k + 4 <= dimension) {
+        const __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(a + k), _mm256_loadu_pd(b + k));
+        acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+        k += 4;
+    }
+    const __m256d acc = _mm256_add_pd(acc0, acc1);
+    const __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+    for (; k < dimension; ++k) {
+        const double diff = a[k] - b[k];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f"))) double sqeuclidean_f64_avx512(const double *a, const double *b, size_t dimension) {
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    size_t k = 0;
+    for (; k + 16 <= dimension; k += 16) {
+        const __m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(a + k), _mm512_loadu_pd(b + k));
+        const __m512d d1 = _mm512_sub_pd(_mm512_loadu_pd(a + k + 8), _mm512_loadu_pd(b + k + 8));
+        acc0 = _mm512_fmadd_pd(d0, d0, acc0);
+        acc1 = _mm512_fmadd_pd(d1, d1, acc1);
+    }
+    if (k < dimension) {
+        // Masked loads cover the tail; inactive lanes read as zero.
+        const size_t remaining = dimension - k;
+        const __mmask8 mask0 = static_cast<__mmask8>(remaining >= 8 ? 0xFF : (1u << remaining) - 1u);
+        const __m512d d0 =
+            _mm512_sub_pd(_mm512_maskz_loadu_pd(mask0, a + k), _mm512_maskz_loadu_pd(mask0, b + k));
+        acc0 = _mm512_fmadd_pd(d0, d0, acc0);
+        if (remaining > 8) {
+            const __mmask8 mask1 = static_cast<__mmask8>((1u << (remaining - 8)) - 1u);
+            const __m512d d1 = _mm512_sub_pd(
+                _mm512_maskz_loadu_pd(mask1, a + k + 8), _mm512_maskz_loadu_pd(mask1, b + k + 8));
+            acc1 = _mm512_fmadd_pd(d1, d1, acc1);
+        }
+    }
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, _mm512_add_pd(acc0, acc1));
+    return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+
+__attribute__((target("avx2,fma"))) float sqeuclidean_f32_avx2(const float *a, const float *b, size_t dimension) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t k = 0;
+    for (; k + 16 <= dimension; k += 16) {
+        const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + k), _mm256_loadu_ps(b + k));
+        const __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + k + 8), _mm256_loadu_ps(b + k + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    if (k + 8 <= dimension) {
+        const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + k), _mm256_loadu_ps(b + k));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        k += 8;
+    }
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 quad = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    quad = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+    float sum = _mm_cvtss_f32(_mm_add_ss(quad, _mm_movehdup_ps(quad)));
+    for (; k < dimension; ++k) {
+        const float diff = a[k] - b[k];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f"))) float sqeuclidean_f32_avx512(const float *a, const float *b, size_t dimension) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t k = 0;
+    for (; k + 32 <= dimension; k += 32) {
+        const __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + k), _mm512_loadu_ps(b + k));
+        const __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + k + 16), _mm512_loadu_ps(b + k + 16));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+    }
+    while (k < dimension) {
+        const size_t remaining = dimension - k;
+        const __mmask16 mask = static_cast<__mmask16>(remaining >= 16 ? 0xFFFFu : (1u << remaining) - 1u);
+        const __m512 d0 = _mm512_sub_ps(_mm512_maskz_loadu_ps(mask, a + k), _mm512_maskz_loadu_ps(mask, b + k));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        k += 16;
+    }
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(acc0, acc1));
+    float sum = 0;
+    for (int lane = 0; lane < 8; ++lane) {
+        sum += lanes[lane] + lanes[lane + 8];
+    }
+    return sum;
+}
+
+// The scaled kernels round both products before subtracting, like the scalar
+// ones: a fused multiply-subtract rounds once, and near-duplicate cosine rows
+// cancel in the subtraction, which would magnify that one rounding.
+__attribute__((target("avx2,fma"))) double sqeuclidean_scaled_f64_avx2(
+    const double *a, double scaleA, const double *b, double scaleB, size_t dimension) {
+    const __m256d sa = _mm256_set1_pd(scaleA);
+    const __m256d sb = _mm256_set1_pd(scaleB);
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t k = 0;
+    for (; k + 8 <= dimension; k += 8) {
+        const __m256d d0 =
+            _mm256_sub_pd(_mm256_mul_pd(_mm256_loadu_pd(a + k), sa), _mm256_mul_pd(_mm256_loadu_pd(b + k), sb));
+        const __m256d d1 =
+            _mm256_sub_pd(_mm256_mul_pd(_mm256_loadu_pd(a + k + 4), sa), _mm256_mul_pd(_mm256_loadu_pd(b + k + 4), sb));
+        acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+        acc1 = _mm256_fmadd_pd(d1, d1, acc1);
+    }
+    const __m256d acc = _mm256_add_pd(acc0, acc1);
+    const __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+    for (; k < dimension; ++k) {
+        const double diff = a[k] * scaleA - b[k] * scaleB;
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma"))) float sqeuclidean_scaled_f32_avx2(
+    const float *a, float scaleA, const float *b, float scaleB, size_t dimension) {
+    const __m256 sa = _mm256_set1_ps(scaleA);
+    const __m256 sb = _mm256_set1_ps(scaleB);
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t k = 0;
+    for (; k + 16 <= dimension; k += 16) {
+        const __m256 d0 =
+            _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(a + k), sa), _mm256_mul_ps(_mm256_loadu_ps(b + k), sb));
+        const __m256 d1 =
+            _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(a + k + 8), sa), _mm256_mul_ps(_mm256_loadu_ps(b + k + 8), sb));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 quad = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    quad = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+    float sum = _mm_cvtss_f32(_mm_add_ss(quad, _mm_movehdup_ps(quad)));
+    for (; k < dimension; ++k) {
+        const float diff = a[k] * scaleA - b[k] * scaleB;
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f"))) double sqeuclidean_scaled_f64_avx512(
+    const double *a, double scaleA, const double *b, double scaleB, size_t dimension) {
+    const __m512d sa = _mm512_set1_pd(scaleA);
+    const __m512d sb = _mm512_set1_pd(scaleB);
+    __m512d acc = _mm512_setzero_pd();
+    for (size_t k = 0; k < dimension; k += 8) {
+        const size_t remaining = dimension - k;
+        const __mmask8 mask = static_cast<__mmask8>(remaining >= 8 ? 0xFF : (1u << remaining) - 1u);
+        const __m512d d = _mm512_sub_pd(_mm512_mul_pd(_mm512_maskz_loadu_pd(mask, a + k), sa),
+                                        _mm512_mul_pd(_mm512_maskz_loadu_pd(mask, b + k), sb));
+        acc = _mm512_fmadd_pd(d, d, acc);
+    }
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, acc);
+    return ((lanes[0] + lanes[4]) + (lanes[1] + lanes[5])) + ((lanes[2] + lanes[6]) + (lanes[3] + lanes[7]));
+}
+
+__attribute__((target("avx512f"))) float sqeuclidean_scaled_f32_avx512(
+    const float *a, float scaleA, const float *b, float scaleB, size_t dimension) {
+    const __m512 sa = _mm512_set1_ps(scaleA);
+    const __m512 sb = _mm512_set1_ps(scaleB);
+    __m512 acc = _mm512_setzero_ps();
+    for (size_t k = 0; k < dimension; k += 16) {
+        const size_t remaining = dimension - k;
+        const __mmask16 mask = static_cast<__mmask16>(remaining >= 16 ? 0xFFFFu : (1u << remaining) - 1u);
+        const __m512 d = _mm512_sub_ps(_mm512_mul_ps(_mm512_maskz_loadu_ps(mask, a + k), sa),
+                                       _mm512_mul_ps(_mm512_maskz_loadu_ps(mask, b + k), sb));
+        acc = _mm512_fmadd_ps(d, d, acc);
+    }
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, acc);
+    float sum = 0;
+    for (int lane = 0; lane < 8; ++lane) {
+        sum += lanes[lane] + lanes[lane + 8];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma,f16c"))) inline __m256 load8(const float *p) {
+    return _mm256_loadu_ps(p);
+}
+
+__attribute__((target("avx2,fma,f16c"))) inline __m256 load8(const float16_bits *p) {
+    return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+}
+
+__attribute__((target("avx2,fma,f16c"))) inline __m256 load8(const bfloat16_bits *p) {
+    const __m256i widened = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(widened, 16));
+}
+
+template <typename t_a, typename t_b>
+__attribute__((target("avx2,fma,f16c"))) float sqeuclidean_scaled_half_avx2(
+    const t_a *a, float scaleA, const t_b *b, float scaleB, size_t dimension) {
+    const __m256 sa = _mm256_set1_ps(scaleA);
+    const __m256 sb = _mm256_set1_ps(scaleB);
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t k = 0;
+    for (; k + 16 <= dimension; k += 16) {
+        const __m256 d0 = _mm256_sub_ps(_mm256_mul_ps(load8(a + k), sa), _mm256_mul_ps(load8(b + k), sb));
+        const __m256 d1 = _mm256_sub_ps(_mm256_mul_ps(load8(a + k + 8), sa), _mm256_mul_ps(load8(b + k + 8), sb));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    if (k + 8 <= dimension) {
+        const __m256 d0 = _mm256_sub_ps(_mm256_mul_ps(load8(a + k), sa), _mm256_mul_ps(load8(b + k), sb));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        k += 8;
+    }
+    const __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 quad = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    quad = _mm_add_ps(quad, _mm_movehl_ps(quad, quad));
+    float sum = _mm_cvtss_f32(_mm_add_ss(quad, _mm_movehdup_ps(quad)));
+    for (; k < dimension; ++k) {
+        const float diff = widen(a[k]) * scaleA - widen(b[k]) * scaleB;
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f"))) inline __m512 load16(const float *p) {
+    return _mm512_loadu_ps(p);
+}
+
+// The all-lanes maskz forms compile to the same instructions; the unmasked
+// ones trip GCC's -Wmaybe-uninitialized inside their own headers.
+__attribute__((target("avx512f"))) inline __m512 load16(const float16_bits *p) {
+    return _mm512_maskz_cvtph_ps(0xFFFF, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)));
+}
+
+__attribute__((target("avx512f"))) inline __m512 load16(const bfloat16_bits *p) {
+    const __mmask16 all = 0xFFFF;
+    const __m512i widened =
+        _mm512_maskz_cvtepu16_epi32(all, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)));
+    return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(all, widened, 16));
+}
+
+// Masked 16-bit loads need AVX-512BW, so the tail runs as scalar code.
+template <typename t_a, typename t_b>
+__attribute__((target("avx512f"))) float sqeuclidean_scaled_half_avx512(
+    const t_a *a, float scaleA, const t_b *b, float scaleB, size_t dimension) {
+    const __m512 sa = _mm512_set1_ps(scaleA);
+    const __m512 sb = _mm512_set1_ps(scaleB);
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t k = 0;
+    for (; k + 32 <= dimension; k += 32) {
+        const __m512 d0 = _mm512_sub_ps(_mm512_mul_ps(load16(a + k), sa), _mm512_mul_ps(load16(b + k), sb));
+        const __m512 d1 = _mm512_sub_ps(_mm512_mul_ps(load16(a + k + 16), sa), _mm512_mul_ps(load16(b + k + 16), sb));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+    }
+    if (k + 16 <= dimension) {
+        const __m512 d0 = _mm512_sub_ps(_mm512_mul_ps(load16(a + k), sa), _mm512_mul_ps(load16(b + k), sb));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        k += 16;
+    }
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(acc0, acc1));
+    float sum = 0;
+    for (int lane = 0; lane < 8; ++lane) {
+        sum += lanes[lane] + lanes[lane + 8];
+    }
+    for (; k < dimension; ++k) {
+        const float diff = widen(a[k]) * scaleA - widen(b[k]) * scaleB;
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+#endif // FASTCLUSTER_KERNELS_X86
+
+#if FASTCLUSTER_KERNELS_NEON
+
+double sqeuclidean_f64_neon(const double *a, const double *b, size_t dimension) {
+    float64x2_t acc0 = vdupq_n_f64(0);
+    float64x2_t acc1 = vdupq_n_f64(0);
+    float64x2_t acc2 = vdupq_n_f64(0);
+    float64x2_t acc3 = vdupq_n_f64(0);
+    size_t k = 0;
+    for (; k + 8 <= dimension; k += 8) {
+        const float64x2_t d0 = vsubq_f64(vld1q_f64(a + k), vld1q_f64(b + k));
+        const float64x2_t d1 = vsubq_f64(vld1q_f64(a + k + 2), vld1q_f64(b + k + 2));
+        const float64x2_t d2 = vsubq_f64(vld1q_f64(a + k + 4), vld1q_f64(b + k + 4));
+        const float64x2_t d3 = vsubq_f64(vld1q_f64(a + k + 6), vld1q_f64(b + k + 6));
+        acc0 = vfmaq_f64(acc0, d0, d0);
+        acc1 = vfmaq_f64(acc1, d1, d1);
+        acc2 = vfmaq_f64(acc2, d2, d2);
+        acc3 = vfmaq_f64(acc3, d3, d3);
+    }
+    for (; k + 2 <= dimension; k += 2) {
+        const float64x2_t d0 = vsubq_f64(vld1q_f64(a + k), vld1q_f64(b + k));
+        acc0 = vfmaq_f64(acc0, d0, d0);
+    }
+    double sum = vaddvq_f64(vaddq_f64(vaddq_f64(acc0, acc1), vaddq_f64(acc2, acc3)));
+    if (k < dimension) {
+        const double diff = a[k] - b[k];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+float sqeuclidean_f32_neon(const float *a, const float *b, size_t dimension) {
+    float32x4_t acc0 = vdupq_n_f32(0);
+    float32x4_t acc1 = vdupq_n_f32(0);
+    float32x4_t acc2 = vdupq_n_f32(0);
+    float32x4_t acc3 = vdupq_n_f32(0);
+    size_t k = 0;
+    for (; k + 16 <= dimension; k += 16) {
+        const float32x4_t d0 = vsubq_f32(vld1q_f32(a + k), vld1q_f32(b + k));
+        const float32x4_t d1 = vsubq_f32(vld1q_f32(a + k + 4), vld1q_f32(b + k + 4));
+        const float32x4_t d2 = vsubq_f32(vld1q_f32(a + k + 8), vld1q_f32(b + k + 8));
+        const float32x4_t d3 = vsubq_f32(vld1q_f32(a + k + 12), vld1q_f32(b + k + 12));
+        acc0 = vfmaq_f32(acc0, d0, d0);
+        acc1 = vfmaq_f32(acc1, d1, d1);
+        acc2 = vfmaq_f32(acc2, d2, d2);
+        acc3 = vfmaq_f32(acc3, d3, d3);
+    }
+    for (; k + 4 <= dimension; k += 4) {
+        const float32x4_t d0 = vsubq_f32(vld1q_f32(a + k), vld1q_f32(b + k));
+        acc0 = vfmaq_f32(acc0, d0, d0);
+    }
+    float sum = vaddvq_f32(vaddq_f32(vaddq_f32(acc0, acc1), vaddq_f32(acc2, acc3)));
+    for (; k < dimension; ++k) {
+        const float diff = a[k] - b[k];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+double sqeuclidean_scaled_f64_neon(const double *a, double scaleA, const double *b, double scaleB, size_t dimension) {
+    const float64x2_t sa = vdupq_n_f64(scaleA);
+    const float64x2_t sb = vdupq_n_f64(scaleB);
+    float64x2_t acc0 = vdupq_n_f64(0);
+    float64x2_t acc1 = vdupq_n_f64(0);
+    size_t k = 0;
+    for (; k + 4 <= dimension; k += 4) {
+        const float64x2_t d0 = vsubq_f64(vmulq_f64(vld1q_f64(a + k), sa), vmulq_f64(vld1q_f64(b + k), sb));
+        const float64x2_t d1 = vsubq_f64(vmulq_f64(vld1q_f64(a + k + 2), sa), vmulq_f64(vld1q_f64(b + k + 2), sb));
+        acc0 = vfmaq_f64(acc0, d0, d0);
+        acc1 = vfmaq_f64(acc1, d1, d1);
+    }
+    double sum = vaddvq_f64(vaddq_f64(acc0, acc1));
+    for (; k < dimension; ++k) {
+        const double diff = a[k] * scaleA - b[k] * scaleB;
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+float sqeuclidean_scaled_f32_neon(const float *a, float scaleA, const float *b, float scaleB, size_t dimension) {
+    const float32x4_t sa = vdupq_n_f32(scaleA);
+    const float32x4_t sb = vdupq_n_f32(scaleB);
+    float32x4_t acc0 = vdupq_n_f32(0);
+    float32x4_t acc1 = vdupq_n_f32(0);
+    size_t k = 0;
+    for (; k + 8 <= dimension; k += 8) {
+        const float32x4_t d0 = vsubq_f32(vmulq_f32(vld1q_f32(a + k), sa), vmulq_f32(vld1q_f32(b + k), sb));
+        const float32x4_t d1 = vsubq_f32(vmulq_f32(vld1q_f32(a + k + 4), sa), vmulq_f32(vld1q_f32(b + k + 4), sb));
+        acc0 = vfmaq_f32(acc0, d0, d0);
+        acc1 = vfmaq_f32(acc1, d1, d1);
+    }
+    float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+    for (; k < dimension; ++k) {
+        const float diff = a[k] * scaleA - b[k] * scaleB;
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+inline float32x4_t load4(const float *p) {
+    return vld1q_f32(p);
+}
+
+inline float32x4_t load4(const float16_bits *p) {
+    return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(reinterpret_cast<const uint16_t *>(p))));
+}
+
+inline float32x4_t load4(const bfloat16_bits *p) {
+    return vreinterpretq_f32_u32(vshll_n_u16(vld1_u16(reinterpret_cast<const uint16_t *>(p)), 16));
+}
+
+template <typename t_a, typename t_b>
+float sqeuclidean_scaled_half_neon(const t_a *a, float scaleA, const t_b *b, float scaleB, size_t dimension) {
+    const float32x4_t sa = vdupq_n_f32(scaleA);
+    const float32x4_t sb = vdupq_n_f32(scaleB);
+    float32x4_t acc0 = vdupq_n_f32(0);
+    float32x4_t acc1 = vdupq_n_f32(0);
+    size_t k = 0;
+    for (; k + 8 <= dimension; k += 8) {
+        const float32x4_t d0 = vsubq_f32(vmulq_f32(load4(a + k), sa), vmulq_f32(load4(b + k), sb));
+        const float32x4_t d1 = vsubq_f32(vmulq_f32(load4(a + k + 4), sa), vmulq_f32(load4(b + k + 4), sb));
+        acc0 = vfmaq_f32(acc0, d0, d0);
+        acc1 = vfmaq_f32(acc1, d1, d1);
+    }
+    float sum = vaddvq_f32(vaddq_f32(acc0, acc1));
+    for (; k < dimension; ++k) {
+        const float diff = widen(a[k]) * scaleA - widen(b[k]) * scaleB;
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+#endif // FASTCLUSTER_KERNELS_NEON
+
+simd_level detectLevel() {
+#if FASTCLUSTER_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return simd_level::avx512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return simd_level::avx2;
+    }
+    return simd_level::scalar;
+#elif FASTCLUSTER_KERNELS_NEON
+    return simd_level::neon;
+#else
+    return simd_level::scalar;
+#endif
+}
+
+std::atomic<int> &activeLevelStorage() {
+    static std::atomic<int> level(static_cast<int>(detected_simd_level()));
+    return level;
+}
+
+} // namespace
+
+simd_level detected_simd_level() {
+    static const simd_level level = detectLevel();
+    return level;
+}
+
+simd_level active_simd_level() {
+    return static_cast<simd_level>(activeLevelStorage().load(std::memory_order_relaxed));
+}
+
+bool set_active_simd_level(simd_level level) {
+    if (sqeuclidean_f64_for_level(level) == nullptr) {
+        return false;
+    }
+    activeLevelStorage().store(static_cast<int>(level), std::memory_order_relaxed);
+    return true;
+}
+
+namespace {
+
+// Table lookup shared by the *_for_level functions: `kernels` lists the
+// implementation for each simd_level in enum order, nullptr where the build
+// has none.
+template <typename t_kernel>
+t_kernel kernelForLevel(simd_level level, const t_kernel (&kernels)[4]) {
+    if (static_cast<int>(level) > static_cast<int>(detected_simd_level())) {
+        return nullptr;
+    }
+    return kernels[static_cast<int>(level)];
+}
+
+#if FASTCLUSTER_KERNELS_NEON
+#define FASTCLUSTER_NEON_KERNEL(name) name##_neon
+#else
+#define FASTCLUSTER_NEON_KERNEL(name) nullptr
+#endif
+
+#if FASTCLUSTER_KERNELS_X86
+#define FASTCLUSTER_AVX2_KERNEL(name) name##_avx2
+#define FASTCLUSTER_AVX512_KERNEL(name) name##_avx512
+#else
+#define FASTCLUSTER_AVX2_KERNEL(name) nullptr
+#define FASTCLUSTER_AVX512_KERNEL(name) nullptr
+#endif
+
+#define FASTCLUSTER_KERNEL_TABLE(name)                                                                        \
+    {                                                                                                         \
+        name##_scalar, FASTCLUSTER_NEON_KERNEL(name), FASTCLUSTER_AVX2_KERNEL(name),                          \
+            FASTCLUSTER_AVX512_KERNEL(name)                                                                   \
+    }
+
+// The same table for sqeuclidean_scaled_half_* over operands `t_a` and `t_b`.
+#if FASTCLUSTER_KERNELS_NEON
+#define FASTCLUSTER_NEON_HALF_KERNEL(t_a, t_b) sqeuclidean_scaled_half_neon<t_a, t_b>
+#else
+#define FASTCLUSTER_NEON_HALF_KERNEL(t_a, t_b) nullptr
+#endif
+
+#if FASTCLUSTER_KERNELS_X86
+#define FASTCLUSTER_AVX2_HALF_KERNEL(t_a, t_b) sqeuclidean_scaled_half_avx2<t_a, t_b>
+#define FASTCLUSTER_AVX512_HALF_KERNEL(t_a, t_b) sqeuclidean_scaled_half_avx512<t_a, t_b>
+#else
+#define FASTCLUSTER_AVX2_HALF_KERNEL(t_a, t_b) nullptr
+#define FASTCLUSTER_AVX512_HALF_KERNEL(t_a, t_b) nullptr
+#endif
+
+#define FASTCLUSTER_HALF_KERNEL_TABLE(t_a, t_b)                                                               \
+    {                                                                                                         \
+        sqeuclidean_scaled_half_scalar<t_a, t_b>, FASTCLUSTER_NEON_HALF_KERNEL(t_a, t_b),                     \
+            FASTCLUSTER_AVX2_HALF_KERNEL(t_a, t_b), FASTCLUSTER_AVX512_HALF_KERNEL(t_a, t_b)                  \
+    }
+
+} // namespace
+
+sqeuclidean_f64_fn sqeuclidean_f64_for_level(simd_level level) {
+    static const sqeuclidean_f64_fn kernels[4] = FASTCLUSTER_KERNEL_TABLE(sqeuclidean_f64);
+    return kernelForLevel(level, kernels);
+}
+
+sqeuclidean_f32_fn sqeuclidean_f32_for_level(simd_level level) {
+    static const sqeuclidean_f32_fn kernels[4] = FASTCLUSTER_KERNEL_TABLE(sqeuclidean_f32);
+    return kernelForLevel(level, kernels);
+}
+
+sqeuclidean_scaled_f64_fn sqeuclidean_scaled_f64_for_level(simd_level level) {
+    static const sqeuclidean_scaled_f64_fn kernels[4] = FASTCLUSTER_KERNEL_TABLE(sqeuclidean_scaled_f64);
+    return kernelForLevel(level, kernels);
+}
+
+sqeuclidean_scaled_f32_fn sqeuclidean_scaled_f32_for_level(simd_level level) {
+    static const sqeuclidean_scaled_f32_fn kernels[4] = FASTCLUSTER_KERNEL_TABLE(sqeuclidean_scaled_f32);
+    return kernelForLevel(level, kernels);
+}
+
+sqeuclidean_scaled_f16_fn sqeuclidean_scaled_f16_for_level(simd_level level) {
+    static const sqeuclidean_scaled_f16_fn kernels[4] = FASTCLUSTER_HALF_KERNEL_TABLE(float16_bits, float16_bits);
+    return kernelForLevel(level, kernels);
+}
+
+sqeuclidean_scaled_f32_f16_fn sqeuclidean_scaled_f32_f16_for_level(simd_level level) {
+    static const sqeuclidean_scaled_f32_f16_fn kernels[4] = FASTCLUSTER_HALF_KERNEL_TABLE(float, float16_bits);
+    return kernelForLevel(level, kernels);
+}
+
+sqeuclidean_scaled_bf16_fn sqeuclidean_scaled_bf16_for_level(simd_level level) {
+    static const sqeuclidean_scaled_bf16_fn kernels[4] = FASTCLUSTER_HALF_KERNEL_TABLE(bfloat16_bits, bfloat16_bits);
+    return kernelForLevel(level, kernels);
+}
+
+sqeuclidean_scaled_f32_bf16_fn sqeuclidean_scaled_f32_bf16_for_level(simd_level level) {
+    static const sqeuclidean_scaled_f32_bf16_fn kernels[4] = FASTCLUSTER_HALF_KERNEL_TABLE(float, bfloat16_bits);
+    return kernelForLevel(level, kernels);
+}
+
+sqeuclidean_f64_fn resolve_sqeuclidean_f64() {
+    sqeuclidean_f64_fn kernel = sqeuclidean_f64_for_level(active_simd_level());
+    return kernel != nullptr ? kernel : sqeuclidean_f64_scalar;
+}
+
+sqeuclidean_f32_fn resolve_sqeuclidean_f32() {
+    sqeuclidean_f32_fn kernel = sqeuclidean_f32_for_level(active_simd_level());
+    return kernel != nullptr ? kernel : sqeuclidean_f32_scalar;
+}
+
+sqeuclidean_scaled_f64_fn resolve_sqeuclidean_scaled_f64() {
+    sqeuclidean_scaled_f64_fn kernel = sqeuclidean_scaled_f64_for_level(active_simd_level());
+    return kernel != nullptr ? kernel : sqeuclidean_scaled_f64_scalar;
+}
+
+sqeuclidean_scaled_f32_fn resolve_sqeuclidean_scaled_f32() {
+    sqeuclidean_scaled_f32_fn kernel = sqeuclidean_scaled_f32_for_level(active_simd_level());
+    return kernel != nullptr ? kernel : sqeuclidean_scaled_f32_scalar;
+}
+
+sqeuclidean_scaled_f16_fn resolve_sqeuclidean_scaled_f16() {
+    sqeuclidean_scaled_f16_fn kernel = sqeuclidean_scaled_f16_for_level(active_simd_level());
+    return kernel != nullptr ? kernel : sqeuclidean_scaled_half_scalar<float16_bits, float16_bits>;
+}
+
+sqeuclidean_scaled_f32_f16_fn resolve_sqeuclidean_scaled_f32_f16() {
+    sqeuclidean_scaled_f32_f16_fn kernel = sqeuclidean_scaled_f32_f16_for_level(active_simd_level());
+    return kernel != nullptr ? kernel : sqeuclidean_scaled_half_scalar<float, float16_bits>;
+}
+
+sqeuclidean_scaled_bf16_fn resolve_sqeuclidean_scaled_bf16() {
+    sqeuclidean_scaled_bf16_fn kernel = sqeuclidean_scaled_bf16_for_level(active_simd_level());
+    return kernel != nullptr ? kernel : sqeuclidean_scaled_half_scalar<bfloat16_bits, bfloat16_bits>;
+}
+
+sqeuclidean_scaled_f32_bf16_fn resolve_sqeuclidean_scaled_f32_bf16() {
+    sqeuclidean_scaled_f32_bf16_fn kernel = sqeuclidean_scaled_f32_bf16_for_level(active_simd_level());
+    return kernel != nullptr ? kernel : sqeuclidean_scaled_half_scalar<float, bfloat16_bits>;
+}
+
+const char *simd_level_name(simd_level level) {
+    switch (level) {
+    case simd_level::scalar:
+        return "scalar";
+    case simd_level::neon:
+        return "neon";
+    case simd_level::avx2:
+        return "avx2";
+    case simd_level::avx512:
+        return "avx512";
+    }
+    return "unknown";
+}
+
+} // namespace fastcluster_kernels
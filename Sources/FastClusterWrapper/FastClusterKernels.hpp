@@ -0,0 +1,201 @@
+#ifndef FASTCLUSTER_KERNELS_HPP
+#define FASTCLUSTER_KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Distance kernels used by the dissimilarity adapters in FastClusterWrapper.cpp.
+//
+// Every kernel has a portable scalar implementation (four interleaved partial
+// sums) and, where the target supports it, explicitly vectorized
+// variants: AVX2+FMA and AVX-512F on x86-64, NEON on arm64. The variant is
+// picked once at runtime from the CPU features and cached; callers resolve the
+// function pointer up front and call through it in their inner loops.
+//
+// Tolerance: the kernels reassociate the sum differently (and the vectorized
+// ones use fused multiply-add), so they are not bit-identical to each other or
+// to the single-accumulator loop fastcluster used before. Every kernel squares
+// the same rounded differences (the scaled ones round `a * scaleA` and
+// `b * scaleB` separately, never as one fused multiply-subtract), and all
+// summands are non-negative, which bounds the difference between any two
+// kernels by 2 * dimension * 2^-53 relative to the exact sum of those squares
+// (about 5.7e-14 at dimension 256; 2^-24 takes the place of 2^-53 for the
+// float kernels). This holds for near-duplicate cosine rows too.
+// FastClusterKernels.cpp is compiled without floating-point contraction, so
+// `simd_level::scalar` returns the same sums on every target.
+//
+// Half-precision rows (IEEE binary16 and bfloat16) are widened to float as they
+// are loaded and accumulate in float: F16C at the AVX2 level (every AVX2
+// processor has it), AVX-512F's own conversion, and the native conversion on
+// arm64. bfloat16 is the upper half of a float, so widening it is a shift.
+namespace fastcluster_kernels {
+
+/// Row elements stored as IEEE 754 binary16 and as bfloat16, by bit pattern.
+struct float16_bits {
+    uint16_t bits;
+};
+
+struct bfloat16_bits {
+    uint16_t bits;
+};
+
+enum class simd_level {
+    scalar = 0,
+    neon = 1,
+    avx2 = 2,
+    avx512 = 3,
+};
+
+typedef double (*sqeuclidean_f64_fn)(const double *a, const double *b, size_t dimension);
+typedef float (*sqeuclidean_f32_fn)(const float *a, const float *b, size_t dimension);
+typedef double (*sqeuclidean_scaled_f64_fn)(const double *a, double scaleA, const double *b, double scaleB,
+                                            size_t dimension);
+typedef float (*sqeuclidean_scaled_f32_fn)(const float *a, float scaleA, const float *b, float scaleB,
+                                           size_t dimension);
+// Half-precision forms of the scaled kernel. The `f32_f16` and `f32_bf16` forms
+// compare a float row (a merged centroid) with a half-precision input row.
+typedef float (*sqeuclidean_scaled_f16_fn)(const float16_bits *a, float scaleA, const float16_bits *b, float scaleB,
+                                           size_t dimension);
+typedef float (*sqeuclidean_scaled_f32_f16_fn)(const float *a, float scaleA, const float16_bits *b, float scaleB,
+                                               size_t dimension);
+typedef float (*sqeuclidean_scaled_bf16_fn)(const bfloat16_bits *a, float scaleA, const bfloat16_bits *b,
+                                            float scaleB, size_t dimension);
+typedef float (*sqeuclidean_scaled_f32_bf16_fn)(const float *a, float scaleA, const bfloat16_bits *b, float scaleB,
+                                                size_t dimension);
+
+inline double widen(double value) {
+    return value;
+}
+
+inline float widen(float value) {
+    return value;
+}
+
+/// Exact float value of a binary16 element, subnormals and NaN included.
+inline float widen(float16_bits value) {
+    const uint32_t sign = static_cast<uint32_t>(value.bits & 0x8000u) << 16;
+    const uint32_t exponent = (value.bits >> 10) & 0x1Fu;
+    const uint32_t mantissa = value.bits & 0x3FFu;
+    if (exponent == 0) {
+        // Zero or subnormal: mantissa * 2^-24.
+        const float magnitude = static_cast<float>(mantissa) * 5.9604644775390625e-8f;
+        return sign != 0 ? -magnitude : magnitude;
+    }
+    const uint32_t bits = sign | (exponent == 0x1Fu ? 0x7F800000u : (exponent + 112) << 23) | (mantissa << 13);
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+inline float widen(bfloat16_bits value) {
+    const uint32_t bits = static_cast<uint32_t>(value.bits) << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+/// Nearest binary16 value, ties to even; out-of-range values become infinite.
+inline float16_bits narrow_to_float16(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+    const uint32_t magnitude = bits & 0x7FFFFFFFu;
+    if (magnitude > 0x7F800000u) {
+        return {static_cast<uint16_t>(sign | 0x7E00u)};
+    }
+    if (magnitude >= 0x477FF000u) {
+        // 65520 and above round past the largest finite value, 65504.
+        return {static_cast<uint16_t>(sign | 0x7C00u)};
+    }
+    if (magnitude >= 0x38800000u) {
+        // Normal: rebias the exponent from 127 to 15, then round off 13 bits.
+        uint32_t rebiased = magnitude - 0x38000000u;
+        rebiased += 0x0FFFu + ((rebiased >> 13) & 1u);
+        return {static_cast<uint16_t>(sign | (rebiased >> 13))};
+    }
+    if (magnitude < 0x33000000u) {
+        return {sign};
+    }
+    // Subnormal: the significand with its implicit bit, scaled to units of 2^-24.
+    const uint32_t significand = (magnitude & 0x7FFFFFu) | 0x800000u;
+    const uint32_t shift = 126 - (magnitude >> 23);
+    uint32_t result = significand >> shift;
+    const uint32_t remainder = significand & ((1u << shift) - 1u);
+    const uint32_t half = 1u << (shift - 1);
+    if (remainder > half || (remainder == half && (result & 1u) != 0)) {
+        ++result;
+    }
+    return {static_cast<uint16_t>(sign | result)};
+}
+
+/// Nearest bfloat16 value, ties to even.
+inline bfloat16_bits narrow_to_bfloat16(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7FFFFFFFu) > 0x7F800000u) {
+        return {static_cast<uint16_t>((bits >> 16) | 0x40u)};
+    }
+    bits += 0x7FFFu + ((bits >> 16) & 1u);
+    return {static_cast<uint16_t>(bits >> 16)};
+}
+
+/// Scalar kernel: sum_k (a[k] - b[k])^2 in four partial sums over k mod 4.
+double sqeuclidean_f64_scalar(const double *a, const double *b, size_t dimension);
+
+/// Single-precision counterpart; accumulates in float.
+float sqeuclidean_f32_scalar(const float *a, const float *b, size_t dimension);
+
+/// sum_k (scaleA * a[k] - scaleB * b[k])^2: the distance between rows that are
+/// normalized on the fly (cosine metric) without materializing a scaled copy.
+double sqeuclidean_scaled_f64_scalar(const double *a, double scaleA, const double *b, double scaleB,
+                                     size_t dimension);
+float sqeuclidean_scaled_f32_scalar(const float *a, float scaleA, const float *b, float scaleB, size_t dimension);
+
+/// Centroid of the union of two clusters: (a * weightA + b * weightB) / total,
+/// where the weights are member counts times row scales. Shared by every path
+/// that merges centroids, so that equal inputs give equal bits. Half-precision
+/// operands are widened; `out` is float for them.
+template <typename t_a, typename t_b, typename t_out>
+inline void merge_centroids(const t_a *a, double weightA, const t_b *b, double weightB, double total,
+                            size_t dimension, t_out *out) {
+    for (size_t k = 0; k < dimension; ++k) {
+        out[k] = static_cast<t_out>((widen(a[k]) * weightA + widen(b[k]) * weightB) / total);
+    }
+}
+
+/// Best kernel for the active SIMD level.
+sqeuclidean_f64_fn resolve_sqeuclidean_f64();
+sqeuclidean_f32_fn resolve_sqeuclidean_f32();
+sqeuclidean_scaled_f64_fn resolve_sqeuclidean_scaled_f64();
+sqeuclidean_scaled_f32_fn resolve_sqeuclidean_scaled_f32();
+sqeuclidean_scaled_f16_fn resolve_sqeuclidean_scaled_f16();
+sqeuclidean_scaled_f32_f16_fn resolve_sqeuclidean_scaled_f32_f16();
+sqeuclidean_scaled_bf16_fn resolve_sqeuclidean_scaled_bf16();
+sqeuclidean_scaled_f32_bf16_fn resolve_sqeuclidean_scaled_f32_bf16();
+
+/// Kernel for a specific level, or nullptr when the CPU cannot run it.
+sqeuclidean_f64_fn sqeuclidean_f64_for_level(simd_level level);
+sqeuclidean_f32_fn sqeuclidean_f32_for_level(simd_level level);
+sqeuclidean_scaled_f64_fn sqeuclidean_scaled_f64_for_level(simd_level level);
+sqeuclidean_scaled_f32_fn sqeuclidean_scaled_f32_for_level(simd_level level);
+sqeuclidean_scaled_f16_fn sqeuclidean_scaled_f16_for_level(simd_level level);
+sqeuclidean_scaled_f32_f16_fn sqeuclidean_scaled_f32_f16_for_level(simd_level level);
+sqeuclidean_scaled_bf16_fn sqeuclidean_scaled_bf16_for_level(simd_level level);
+sqeuclidean_scaled_f32_bf16_fn sqeuclidean_scaled_f32_bf16_for_level(simd_level level);
+
+/// Highest level supported by the CPU and compiler.
+simd_level detected_simd_level();
+
+/// Level currently handed out by the `resolve_*` functions.
+simd_level active_simd_level();
+
+/// Override the active level (benchmarks, reproducibility checks). Returns false
+/// and leaves the active level unchanged when the CPU cannot run `level`.
+bool set_active_simd_level(simd_level level);
+
+const char *simd_level_name(simd_level level);
+
+} // namespace fastcluster_kernels
+
+#endif // FASTCLUSTER_KERNELS_HPP
@@ -0,0 +1,186 @@
+#include "FastClusterPLDA.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace fastcluster_plda {
+
+namespace {
+
+using fastcluster_kernels::widen;
+
+// Rows per block of the transform. The centred block (kBlockRows x E) and its
+// projection (kBlockRows x L) stay in L2 while both products run over them.
+constexpr size_t kBlockRows = 32;
+
+// Register tiles of the products: kRows rows by kLanes columns, 32
+// accumulators, which fit the vector registers of SSE2, AVX and NEON. The
+// fixed-size lane loops vectorize without reassociating any sum, so every
+// output is a sum in coordinate order and does not depend on the instruction
+// set.
+constexpr size_t kRows = 4;
+constexpr size_t kLanes = 8;
+
+// Packs `matrix` (rows x columns, element (i, j) at i * rowStep + j * columnStep)
+// into panels of kLanes columns, each `rows` x kLanes and zero-padded.
+std::vector<double> packPanels(const double *matrix, size_t rows, size_t columns, size_t rowStep,
+                               size_t columnStep) {
+    const size_t panelCount = (columns + kLanes - 1) / kLanes;
+    std::vector<double> panels(panelCount * rows * kLanes, 0.0);
+    for (size_t p = 0; p < panelCount; ++p) {
+        double *panel = panels.data() + p * rows * kLanes;
+        for (size_t i = 0; i < rows; ++i) {
+            for (size_t l = 0; l < kLanes && p * kLanes + l < columns; ++l) {
+                panel[i * kLanes + l] = matrix[i * rowStep + (p * kLanes + l) * columnStep];
+            }
+        }
+    }
+    return panels;
+}
+
+// out[l] = row . column l of `panel`, for the first `columns` lanes.
+void multiplyRow(const double *row, size_t inner, const double *panel, double *out, size_t columns) {
+    double tile[kLanes] = {};
+    for (size_t k = 0; k < inner; ++k, panel += kLanes) {
+        for (size_t l = 0; l < kLanes; ++l) {
+            tile[l] += row[k] * panel[l];
+        }
+    }
+    std::copy(tile, tile + columns, out);
+}
+
+// multiplyRow for kRows = 4 rows at once, so every panel row is loaded once
+// for four rows. The accumulators are named rather than indexed by row so that
+// they stay in registers.
+void multiplyRows(const double *rows, size_t rowStride, size_t inner, const double *panel, double *out,
+                  size_t outStride, size_t columns) {
+    double t0[kLanes] = {};
+    double t1[kLanes] = {};
+    double t2[kLanes] = {};
+    double t3[kLanes] = {};
+    const double *r0 = rows;
+    const double *r1 = rows + rowStride;
+    const double *r2 = rows + 2 * rowStride;
+    const double *r3 = rows + 3 * rowStride;
+    for (size_t k = 0; k < inner; ++k, panel += kLanes) {
+        const double v0 = r0[k];
+        const double v1 = r1[k];
+        const double v2 = r2[k];
+        const double v3 = r3[k];
+        for (size_t l = 0; l < kLanes; ++l) {
+            t0[l] += v0 * panel[l];
+            t1[l] += v1 * panel[l];
+            t2[l] += v2 * panel[l];
+            t3[l] += v3 * panel[l];
+        }
+    }
+    std::copy(t0, t0 + columns, out);
+    std::copy(t1, t1 + columns, out + outStride);
+    std::copy(t2, t2 + columns, out + 2 * outStride);
+    std::copy(t3, t3 + columns, out + 3 * outStride);
+}
+
+// out (rowCount x width) = rows (rowCount x inner) * the panelled matrix
+// (inner x width). Each panel is read once per block and reused by every tile
+// of rows.
+void multiply(const double *rows, size_t rowCount, size_t rowStride, size_t inner, const std::vector<double> &panels,
+              size_t width, double *out, size_t outStride) {
+    for (size_t first = 0; first < width; first += kLanes) {
+        const double *panel = panels.data() + first * inner;
+        const size_t columns = std::min(kLanes, width - first);
+        size_t r = 0;
+        for (; r + kRows <= rowCount; r += kRows) {
+            multiplyRows(rows + r * rowStride, rowStride, inner, panel, out + r * outStride + first, outStride,
+                         columns);
+        }
+        for (; r < rowCount; ++r) {
+            multiplyRow(rows + r * rowStride, inner, panel, out + r * outStride + first, columns);
+        }
+    }
+}
+
+// sqrt(dimension) / |row|, or 0 for a zero row.
+double lengthScale(double sumSquares, size_t dimension) {
+    return sumSquares > 0 ? std::sqrt(static_cast<double>(dimension) / sumSquares) : 0.0;
+}
+
+std::vector<double> copyOrZero(const double *values, size_t count) {
+    return values != nullptr ? std::vector<double>(values, values + count) : std::vector<double>(count, 0.0);
+}
+
+bool allFinite(const std::vector<double> &values) {
+    return std::all_of(values.begin(), values.end(), [](double value) { return std::isfinite(value); });
+}
+
+} // namespace
+
+bool prepare_plda_model(size_t inputDimension, size_t ldaDimension, size_t outputDimension,
+                        const double *inputMean, const double *lda, const double *ldaMean, const double *pldaMean,
+                        const double *pldaTransform, plda_model &model) {
+    model.inputDimension = inputDimension;
+    model.ldaDimension = ldaDimension;
+    model.outputDimension = outputDimension;
+    model.inputMean = copyOrZero(inputMean, inputDimension);
+    model.ldaMean = copyOrZero(ldaMean, ldaDimension);
+    model.pldaMean = copyOrZero(pldaMean, ldaDimension);
+    model.ldaPanels = packPanels(lda, inputDimension, ldaDimension, ldaDimension, 1);
+    model.pldaPanels = packPanels(pldaTransform, ldaDimension, outputDimension, 1, ldaDimension);
+    return allFinite(model.inputMean) && allFinite(model.ldaMean) && allFinite(model.pldaMean) &&
+           allFinite(model.ldaPanels) && allFinite(model.pldaPanels);
+}
+
+template <typename t_storage>
+bool transform_plda(const plda_model &model, const t_storage *data, size_t rowCount, size_t rowStride,
+                    double *out) {
+    const size_t E = model.inputDimension;
+    const size_t L = model.ldaDimension;
+    const size_t R = model.outputDimension;
+    std::vector<double> centred(kBlockRows * E);
+    std::vector<double> projected(kBlockRows * L);
+    double scales[kBlockRows];
+    bool finite = true;
+    for (size_t first = 0; first < rowCount; first += kBlockRows) {
+        const size_t count = std::min(kBlockRows, rowCount - first);
+        for (size_t r = 0; r < count; ++r) {
+            const t_storage *source = data + (first + r) * rowStride;
+            double *row = centred.data() + r * E;
+            double sumSquares = 0;
+            for (size_t e = 0; e < E; ++e) {
+                const double value = static_cast<double>(widen(source[e]));
+                finite = finite && std::isfinite(value);
+                row[e] = value - model.inputMean[e];
+                sumSquares += row[e] * row[e];
+            }
+            scales[r] = lengthScale(sumSquares, E);
+        }
+        if (!finite) {
+            return false;
+        }
+
+        // The first length normalization is a per-row factor, so it is applied
+        // to the projection instead of the E inputs.
+        multiply(centred.data(), count, E, E, model.ldaPanels, L, projected.data(), L);
+        for (size_t r = 0; r < count; ++r) {
+            double *row = projected.data() + r * L;
+            double sumSquares = 0;
+            for (size_t j = 0; j < L; ++j) {
+                row[j] = scales[r] * row[j] - model.ldaMean[j];
+                sumSquares += row[j] * row[j];
+            }
+            const double scale = lengthScale(sumSquares, L);
+            for (size_t j = 0; j < L; ++j) {
+                row[j] = scale * row[j] - model.pldaMean[j];
+            }
+        }
+        multiply(projected.data(), count, L, L, model.pldaPanels, R, out + first * R, R);
+    }
+    return true;
+}
+
+template bool transform_plda(const plda_model &, const double *, size_t, size_t, double *);
+template bool transform_plda(const plda_model &, const float *, size_t, size_t, double *);
+template bool transform_plda(const plda_model &, const fastcluster_kernels::float16_bits *, size_t, size_t, double *);
+template bool transform_plda(const plda_model &, const fastcluster_kernels::bfloat16_bits *, size_t, size_t,
+                             double *);
+
+} // namespace fastcluster_plda
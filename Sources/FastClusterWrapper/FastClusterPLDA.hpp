@@ -0,0 +1,61 @@
+#ifndef FASTCLUSTER_PLDA_HPP
+#define FASTCLUSTER_PLDA_HPP
+
+#include "FastClusterKernels.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// PLDA feature transform of speaker embeddings (x-vectors), as the pyannote
+// pipeline computes it before VBx:
+//
+//   u   = sqrt(E) * l2norm(x - inputMean)              E = input dimension
+//   y   = sqrt(L) * l2norm(u * lda - ldaMean)          L = LDA dimension
+//   rho = (y - pldaMean) * pldaTransform^T             first R PLDA rows
+//
+// Both products run over blocks of rows with the matrices packed into panels
+// of kLanes columns, so a panel stays in L1 while every row of the block is
+// multiplied with it. The centring, both length normalizations and the PLDA
+// offset are applied to the block between and around the two products, and
+// the block's rows are written to one contiguous output matrix.
+namespace fastcluster_plda {
+
+/// Transform parameters packed for the blocked products.
+struct plda_model {
+    size_t inputDimension = 0;
+    size_t ldaDimension = 0;
+    size_t outputDimension = 0;
+    std::vector<double> inputMean;
+    /// lda (inputDimension x ldaDimension) in panels of kLanes columns: panel
+    /// p holds inputDimension rows of columns [p * kLanes, (p + 1) * kLanes),
+    /// zero past ldaDimension.
+    std::vector<double> ldaPanels;
+    std::vector<double> ldaMean;
+    std::vector<double> pldaMean;
+    /// pldaTransform^T (ldaDimension x outputDimension) in the same panels.
+    std::vector<double> pldaPanels;
+};
+
+/// Pack the parameters into `model`. `lda` is inputDimension x ldaDimension
+/// and `pldaTransform` outputDimension x ldaDimension, both row-major; the
+/// means may be nullptr for zero.
+///
+/// - Returns: false when a parameter is NaN or infinite. Throws std::bad_alloc.
+bool prepare_plda_model(size_t inputDimension, size_t ldaDimension, size_t outputDimension,
+                        const double *inputMean, const double *lda, const double *ldaMean, const double *pldaMean,
+                        const double *pldaTransform, plda_model &model);
+
+/// Transform `rowCount` embeddings of model.inputDimension values starting
+/// `rowStride` elements apart into `out`, rowCount x model.outputDimension
+/// doubles, row-major. A vector that is zero when it is length-normalized
+/// stays zero.
+///
+/// - Returns: false when an embedding value is NaN or infinite. Throws
+///   std::bad_alloc.
+template <typename t_storage>
+bool transform_plda(const plda_model &model, const t_storage *data, size_t rowCount, size_t rowStride,
+                    double *out);
+
+} // namespace fastcluster_plda
+
+#endif // FASTCLUSTER_PLDA_HPP
@@ -0,0 +1,274 @@
+#include "FastClusterReduction.hpp"
+#include "FastClusterKernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <thread>
+
+namespace fastcluster_reduction {
+
+namespace {
+
+// Below this many kernel element operations per thread, a pass over the rows
+// runs on the calling thread.
+constexpr double kMinimumWorkPerThread = 1 << 18;
+
+// Uniform double in [0, 1) from the top 53 bits, identical on every platform
+// (std::uniform_real_distribution is implementation-defined).
+double unitInterval(std::mt19937_64 &generator) {
+    return static_cast<double>(generator() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Runs body(begin, end) over a static partition of [0, count). Ranges whose
+// thread cannot be started run on the calling thread.
+template <typename t_body>
+void forEachRange(size_t count, size_t threads, double workPerRow, const t_body &body) {
+    const double affordable = std::max(1.0, static_cast<double>(count) * workPerRow / kMinimumWorkPerThread);
+    threads = std::max<size_t>(1, std::min({threads, count, static_cast<size_t>(std::min(affordable, 1024.0))}));
+    if (threads == 1) {
+        body(size_t{0}, count);
+        return;
+    }
+
+    const size_t chunk = (count + threads - 1) / threads;
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    size_t next = chunk;
+    try {
+        for (; next < count; next += chunk) {
+            pool.emplace_back(body, next, std::min(count, next + chunk));
+        }
+    } catch (...) {
+        for (; next < count; next += chunk) {
+            body(next, std::min(count, next + chunk));
+        }
+    }
+    body(size_t{0}, std::min(count, chunk));
+    for (std::thread &thread : pool) {
+        thread.join();
+    }
+}
+
+class Reducer {
+public:
+    Reducer(const std::vector<double> &rows, size_t count, size_t dimension, size_t threads, progress_sink *progress)
+        : rows(rows),
+          count(count),
+          dimension(dimension),
+          threads(threads),
+          progress(progress),
+          kernel(fastcluster_kernels::resolve_sqeuclidean_f64()),
+          nearest(count),
+          assignment(count) {}
+
+    // k-means++ seeding, stopped as soon as the quantization error is within
+    // `target` or `maxCentres` centres exist. Returns whether `target` was met.
+    bool seed(double target, size_t maxCentres, std::mt19937_64 &generator) {
+        addCentre(std::min(count - 1, static_cast<size_t>(unitInterval(generator) * static_cast<double>(count))));
+        checkProgress();
+        double error = quantizationError();
+        while (error > target && centreCount() < maxCentres) {
+            // Rows are drawn with probability proportional to their squared
+            // distance to the nearest centre; rows on a centre are never drawn.
+            const double draw = unitInterval(generator) * error;
+            double cumulative = 0;
+            size_t pick = count;
+            for (size_t i = 0; i < count; ++i) {
+                if (nearest[i] > 0) {
+                    pick = i;
+                    cumulative += nearest[i];
+                    if (cumulative > draw) {
+                        break;
+                    }
+                }
+            }
+            if (pick == count) {
+                break;
+            }
+            addCentre(pick);
+            checkProgress();
+            error = quantizationError();
+        }
+        return error <= target;
+    }
+
+    // Lloyd iterations: move every centre to the mean of its rows, then
+    // reassign every row to its nearest centre.
+    void refine(size_t iterations) {
+        for (size_t iteration = 0; iteration < iterations; ++iteration) {
+            updateMeans();
+            const size_t k = centreCount();
+            forEachRange(count, threads, static_cast<double>(k * dimension), [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    const double *row = rowPointer(i);
+                    double best = kernel(row, centres.data(), dimension);
+                    uint32_t bestCentre = 0;
+                    for (size_t c = 1; c < k; ++c) {
+                        const double distance = kernel(row, centres.data() + c * dimension, dimension);
+                        if (distance < best) {
+                            best = distance;
+                            bestCentre = static_cast<uint32_t>(c);
+                        }
+                    }
+                    nearest[i] = best;
+                    assignment[i] = bestCentre;
+                }
+            });
+            checkProgress();
+        }
+    }
+
+    // Final centres are the means of their rows; centres without rows are
+    // dropped and the assignment renumbered.
+    void finish(micro_clusters &result) {
+        updateMeans();
+        std::vector<uint32_t> renumbered(centreCount());
+        size_t kept = 0;
+        for (size_t c = 0; c < centreCount(); ++c) {
+            if (weights[c] == 0) {
+                continue;
+            }
+            std::copy(centres.begin() + static_cast<std::ptrdiff_t>(c * dimension),
+                      centres.begin() + static_cast<std::ptrdiff_t>((c + 1) * dimension),
+                      centres.begin() + static_cast<std::ptrdiff_t>(kept * dimension));
+            weights[kept] = weights[c];
+            renumbered[c] = static_cast<uint32_t>(kept++);
+        }
+        centres.resize(kept * dimension);
+        weights.resize(kept);
+        for (size_t i = 0; i < count; ++i) {
+            assignment[i] = renumbered[assignment[i]];
+        }
+        forEachRange(count, threads, static_cast<double>(dimension), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                nearest[i] = kernel(rowPointer(i), centres.data() + assignment[i] * dimension, dimension);
+            }
+        });
+
+        result.count = kept;
+        result.error = quantizationError();
+        result.centres.swap(centres);
+        result.weights.swap(weights);
+        result.assignment.swap(assignment);
+    }
+
+private:
+    const std::vector<double> &rows;
+    const size_t count;
+    const size_t dimension;
+    const size_t threads;
+    progress_sink *const progress;
+    const fastcluster_kernels::sqeuclidean_f64_fn kernel;
+    std::vector<double> centres;
+    std::vector<size_t> weights;
+    // Squared distance of every row to its assigned centre.
+    std::vector<double> nearest;
+    std::vector<uint32_t> assignment;
+
+    size_t centreCount() const { return centres.size() / dimension; }
+
+    // Between passes only, so that a throwing check never leaves a worker running.
+    void checkProgress() {
+        if (progress != nullptr) {
+            progress->check();
+        }
+    }
+
+    const double *rowPointer(size_t index) const { return rows.data() + index * dimension; }
+
+    void addCentre(size_t row) {
+        const uint32_t index = static_cast<uint32_t>(centreCount());
+        centres.insert(centres.end(), rowPointer(row), rowPointer(row) + dimension);
+        const double *centre = centres.data() + static_cast<size_t>(index) * dimension;
+        forEachRange(count, threads, static_cast<double>(dimension), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                const double distance = kernel(rowPointer(i), centre, dimension);
+                if (index == 0 || distance < nearest[i]) {
+                    nearest[i] = distance;
+                    assignment[i] = index;
+                }
+            }
+        });
+    }
+
+    // Summed in row order, so the value does not depend on the thread count.
+    double quantizationError() const {
+        double sum = 0;
+        for (const double distance : nearest) {
+            sum += distance;
+        }
+        return sum;
+    }
+
+    // Centres without rows keep their coordinates and get weight 0.
+    void updateMeans() {
+        const size_t k = centreCount();
+        std::vector<double> sums(k * dimension, 0.0);
+        weights.assign(k, 0);
+        for (size_t i = 0; i < count; ++i) {
+            double *sum = sums.data() + assignment[i] * dimension;
+            const double *row = rowPointer(i);
+            for (size_t d = 0; d < dimension; ++d) {
+                sum[d] += row[d];
+            }
+            ++weights[assignment[i]];
+        }
+        for (size_t c = 0; c < k; ++c) {
+            if (weights[c] == 0) {
+                continue;
+            }
+            const double inverse = 1.0 / static_cast<double>(weights[c]);
+            for (size_t d = 0; d < dimension; ++d) {
+                centres[c * dimension + d] = sums[c * dimension + d] * inverse;
+            }
+        }
+    }
+};
+
+} // namespace
+
+template <typename t_storage>
+bool reduce_to_micro_clusters(const t_storage *data, size_t count, size_t dimension, size_t rowStride,
+                              const t_storage *scales, const reduction_parameters &parameters,
+                              micro_clusters &result) {
+    result = micro_clusters();
+    if (count == 0) {
+        return true;
+    }
+
+    // Scaled double copy: the kernels then read contiguous rows of one type,
+    // and the centres are means of exactly the rows the metric sees.
+    std::vector<double> rows(count * dimension);
+    bool finite = true;
+    for (size_t i = 0; i < count; ++i) {
+        const t_storage *source = data + i * rowStride;
+        const double scale = scales != nullptr ? static_cast<double>(scales[i]) : 1.0;
+        double *row = rows.data() + i * dimension;
+        for (size_t d = 0; d < dimension; ++d) {
+            row[d] = scale * static_cast<double>(source[d]);
+            finite = finite && std::isfinite(row[d]);
+        }
+    }
+    if (!finite) {
+        return false;
+    }
+
+    std::mt19937_64 generator(parameters.seed);
+    Reducer reducer(rows, count, dimension, std::max<size_t>(1, parameters.threads), parameters.progress);
+    const bool withinTarget = reducer.seed(
+        std::max(0.0, parameters.targetError), std::max<size_t>(1, std::min(parameters.maxCentres, count)), generator);
+    if (withinTarget || parameters.refineWhenOverBudget) {
+        reducer.refine(parameters.refinementIterations);
+    }
+    reducer.finish(result);
+    result.withinTarget = withinTarget;
+    return true;
+}
+
+template bool reduce_to_micro_clusters<double>(const double *, size_t, size_t, size_t, const double *,
+                                               const reduction_parameters &, micro_clusters &);
+template bool reduce_to_micro_clusters<float>(const float *, size_t, size_t, size_t, const float *,
+                                              const reduction_parameters &, micro_clusters &);
+
+} // namespace fastcluster_reduction
@@ -0,0 +1,79 @@
+#ifndef FASTCLUSTER_REDUCTION_HPP
+#define FASTCLUSTER_REDUCTION_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Data reduction for approximate centroid linkage on large inputs.
+//
+// The rows are summarized by k-means micro-clusters: k-means++ seeding adds
+// centres until the quantization error (sum of squared distances from every
+// row to its nearest centre) falls to `targetError`, then a few Lloyd passes
+// refine the centres. Exact centroid linkage on the k weighted centres costs
+// O(k^2 * D) instead of O(N^2 * D); seeding and refinement cost O(N * k * D).
+//
+// Seeding draws from a fixed 64-bit generator and every reduction is summed in
+// row order, so the result depends only on the input, the parameters and the
+// seed, not on the thread count.
+namespace fastcluster_reduction {
+
+struct micro_clusters {
+    /// count * dimension centre coordinates (means of the scaled rows).
+    std::vector<double> centres;
+    /// Rows assigned to each centre; every weight is >= 1.
+    std::vector<size_t> weights;
+    /// Centre of every input row.
+    std::vector<uint32_t> assignment;
+    size_t count = 0;
+    /// Achieved quantization error: sum of squared distances from every row to
+    /// its centre.
+    double error = 0;
+    /// Seeding reached `targetError` before `maxCentres`.
+    bool withinTarget = false;
+};
+
+/// Receives a check after every seeding step and every refinement pass, on the
+/// calling thread; throw from `check` to stop the reduction.
+class progress_sink {
+public:
+    virtual void check() = 0;
+
+protected:
+    ~progress_sink() {}
+};
+
+struct reduction_parameters {
+    /// Seeding stops once the quantization error is at most this.
+    double targetError;
+    /// Upper bound on the number of centres; at least 1.
+    size_t maxCentres;
+    size_t refinementIterations;
+    bool refineWhenOverBudget;
+    uint64_t seed;
+    size_t threads;
+    /// May be NULL.
+    progress_sink *progress;
+};
+
+/// Reduce `count` rows starting `rowStride` elements apart. With `scales`,
+/// row i is multiplied by scales[i] first (inverse norms for the cosine
+/// metric). When seeding stops at `maxCentres` without reaching the target and
+/// `refineWhenOverBudget` is false, the refinement passes are skipped.
+///
+/// - Returns: false when the input contains NaN or infinite values. Throws
+///   std::bad_alloc when the scaled copy of the rows (count * dimension
+///   doubles) cannot be allocated.
+template <typename t_storage>
+bool reduce_to_micro_clusters(const t_storage *data, size_t count, size_t dimension, size_t rowStride,
+                              const t_storage *scales, const reduction_parameters &parameters,
+                              micro_clusters &result);
+
+extern template bool reduce_to_micro_clusters<double>(const double *, size_t, size_t, size_t, const double *,
+                                                      const reduction_parameters &, micro_clusters &);
+extern template bool reduce_to_micro_clusters<float>(const float *, size_t, size_t, size_t, const float *,
+                                                     const reduction_parameters &, micro_clusters &);
+
+} // namespace fastcluster_reduction
+
+#endif // FASTCLUSTER_REDUCTION_HPP
@@ -0,0 +1,568 @@
+#include "FastClusterVBx.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <thread>
+
+namespace fastcluster_vbx {
+
+namespace {
+
+using fastcluster_kernels::widen;
+
+// Frames per block of the fused pass. The scores of a block are computed four
+// frames at a time, so every speaker row is loaded once per block.
+constexpr size_t kBlock = 4;
+
+// Width of the fixed-size inner loops, which compilers vectorize without
+// reassociating any sum: scores are computed for tiles of kBlock frames by
+// kLanes speakers, and the statistics are updated kLanes coordinates at a time.
+// Every sum still runs in frame or coordinate order, so results do not depend
+// on the instruction set.
+constexpr size_t kLanes = 4;
+
+constexpr double kTwoPi = 6.283185307179586476925;
+
+// Frames per shard of the E-step, at least. A shard keeps its own partial
+// statistics, and the partials are added in shard order. The shard size depends
+// only on the frame count, so the sums are the same for every thread count.
+constexpr size_t kShardFrames = 2048;
+
+// Shards per run, at most, which bounds the partial statistics kept.
+constexpr size_t kMaxShards = 256;
+
+// Runs body(shard) for every shard in [0, count) over a static partition into
+// `threads` contiguous ranges. Ranges whose thread cannot be started run on the
+// calling thread.
+template <typename t_body>
+void forEachShard(size_t count, size_t threads, const t_body &body) {
+    threads = std::max<size_t>(1, std::min(threads, count));
+    auto range = [&body](size_t begin, size_t end) {
+        for (size_t shard = begin; shard < end; ++shard) {
+            body(shard);
+        }
+    };
+    if (threads == 1) {
+        range(0, count);
+        return;
+    }
+
+    const size_t chunk = (count + threads - 1) / threads;
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    size_t next = chunk;
+    try {
+        for (; next < count; next += chunk) {
+            pool.emplace_back(range, next, std::min(count, next + chunk));
+        }
+    } catch (...) {
+        for (; next < count; next += chunk) {
+            range(next, std::min(count, next + chunk));
+        }
+    }
+    range(0, std::min(count, chunk));
+    for (std::thread &thread : pool) {
+        thread.join();
+    }
+}
+
+// Turns `scores` into responsibilities in `row`: softmax with the maximum
+// subtracted first, and the subtraction, exp and sum in one pass. Every exp is
+// at most 1, so float cannot overflow. Returns log(sum(exp(scores))) in double,
+// or the maximum when the sum is not a positive finite number, in which case
+// the row is uniform.
+template <typename t_float>
+double softmaxRow(t_float *scores, size_t count, t_float *row) {
+    t_float maximum = -std::numeric_limits<t_float>::max();
+    for (size_t s = 0; s < count; ++s) {
+        maximum = std::max(maximum, scores[s]);
+    }
+    t_float sum = 0;
+    for (size_t s = 0; s < count; ++s) {
+        scores[s] = std::exp(scores[s] - maximum);
+        sum += scores[s];
+    }
+    if (!(sum > 0) || !std::isfinite(sum)) {
+        std::fill(row, row + count, static_cast<t_float>(1.0 / static_cast<double>(count)));
+        return static_cast<double>(maximum);
+    }
+    const t_float inverse = 1 / sum;
+    for (size_t s = 0; s < count; ++s) {
+        row[s] = scores[s] * inverse;
+    }
+    return static_cast<double>(maximum) + std::log(static_cast<double>(sum));
+}
+
+// Scales every row of `gamma` to sum to 1; rows without a positive finite sum
+// become uniform.
+template <typename t_float>
+void normalizeRows(t_float *gamma, size_t frameCount, size_t speakerCount) {
+    for (size_t t = 0; t < frameCount; ++t) {
+        t_float *row = gamma + t * speakerCount;
+        double sum = 0;
+        for (size_t s = 0; s < speakerCount; ++s) {
+            sum += row[s];
+        }
+        const double scale = sum > 0 && std::isfinite(sum) ? 1.0 / sum : 0.0;
+        for (size_t s = 0; s < speakerCount; ++s) {
+            row[s] = static_cast<t_float>(scale != 0 ? row[s] * scale : 1.0 / static_cast<double>(speakerCount));
+        }
+    }
+}
+
+// VBx over one input, with frames, scores, responsibilities and the partial
+// statistics of a shard stored as t_float. The M-step, the reduction of the
+// shards, the log-likelihood and the ELBO run in double.
+//
+// Pruned speakers leave the model: gamma, pi and the speaker rows are compacted
+// to the remaining speakers, so later passes cost in proportion to them, and
+// run() expands gamma and pi back to the initial speakers on return.
+template <typename t_float>
+class Engine {
+public:
+    Engine(size_t frameCount, size_t dimension, size_t speakerCount, const vbx_parameters &parameters)
+        : frameCount(frameCount),
+          dimension(dimension),
+          initialSpeakers(speakerCount),
+          speakerCount(speakerCount),
+          speakers(speakerCount),
+          parameters(parameters),
+          rho(frameCount * dimension),
+          frameOffsets(frameCount),
+          phi(dimension),
+          statistics(speakerCount * dimension),
+          gammaSums(speakerCount),
+          alpha(speakerCount * dimension),
+          paddedSpeakers((speakerCount + kLanes - 1) / kLanes * kLanes),
+          alphaTransposed(paddedSpeakers * dimension, 0.0),
+          inverseL(speakerCount * dimension),
+          speakerOffsets(speakerCount),
+          shardFrames(std::max(kShardFrames, (frameCount + kMaxShards - 1) / kMaxShards + kBlock - 1) / kBlock *
+                      kBlock),
+          shards(std::max<size_t>(1, (frameCount + shardFrames - 1) / shardFrames)) {
+        for (Shard &shard : shards) {
+            shard.statistics.resize(speakerCount * dimension);
+            shard.gammaSums.resize(speakerCount);
+            shard.scores.resize(kBlock * speakerCount);
+            shard.previous.resize(speakerCount);
+        }
+        std::iota(speakers.begin(), speakers.end(), size_t(0));
+    }
+
+    // rho = x * sqrt(phi) and the per-frame constant -0.5 * (|x|^2 + D log 2pi).
+    // Returns false on NaN or infinite input.
+    template <typename t_storage>
+    bool load(const t_storage *data, size_t rowStride, const double *eigenvalues) {
+        bool finite = true;
+        std::vector<double> sqrtPhi(dimension);
+        for (size_t d = 0; d < dimension; ++d) {
+            finite = finite && std::isfinite(eigenvalues[d]);
+            phi[d] = std::max(eigenvalues[d], 1e-12);
+            sqrtPhi[d] = std::sqrt(phi[d]);
+        }
+        const double logConstant = static_cast<double>(dimension) * std::log(kTwoPi);
+        for (size_t t = 0; t < frameCount; ++t) {
+            const t_storage *source = data + t * rowStride;
+            t_float *row = rho.data() + t * dimension;
+            double sumSquares = 0;
+            for (size_t d = 0; d < dimension; ++d) {
+                const double value = static_cast<double>(widen(source[d]));
+                finite = finite && std::isfinite(value);
+                sumSquares += value * value;
+                row[d] = static_cast<t_float>(value * sqrtPhi[d]);
+            }
+            frameOffsets[t] = -0.5 * (sumSquares + logConstant);
+        }
+        return finite;
+    }
+
+    void run(t_float *gamma, double *pi, vbx_result &result) {
+        std::vector<t_float> scores(speakerCount);
+        if (parameters.initSmoothing >= 0) {
+            for (size_t t = 0; t < frameCount; ++t) {
+                t_float *row = gamma + t * speakerCount;
+                for (size_t s = 0; s < speakerCount; ++s) {
+                    scores[s] = static_cast<t_float>(parameters.initSmoothing * row[s]);
+                }
+                softmaxRow(scores.data(), speakerCount, row);
+            }
+        }
+        normalizeRows(gamma, frameCount, speakerCount);
+        std::fill(pi, pi + speakerCount, 1.0 / static_cast<double>(speakerCount));
+
+        result.history.clear();
+        result.stop = vbx_stop::max_iterations;
+        result.speakerCount = speakerCount;
+        if (parameters.maxIterations == 0) {
+            return;
+        }
+        result.history.reserve(parameters.maxIterations);
+        accumulate(gamma);
+
+        const double ratio = parameters.Fa / parameters.Fb;
+        double previousElbo = -std::numeric_limits<double>::max();
+        for (size_t iteration = 0; iteration < parameters.maxIterations; ++iteration) {
+            // M-step: speaker posteriors from the statistics of the current gamma.
+            double sumLogInverse = 0;
+            double sumInverse = 0;
+            double sumAlphaSquares = 0;
+            for (size_t s = 0; s < speakerCount; ++s) {
+                const double weight = ratio * gammaSums[s];
+                const double *sums = statistics.data() + s * dimension;
+                double *alphaRow = alpha.data() + s * dimension;
+                double *inverseRow = inverseL.data() + s * dimension;
+                double phiTerm = 0;
+                for (size_t d = 0; d < dimension; ++d) {
+                    inverseRow[d] = 1.0 / std::max(1.0 + weight * phi[d], 1e-12);
+                    alphaRow[d] = sums[d] * inverseRow[d] * ratio;
+                    phiTerm += (alphaRow[d] * alphaRow[d] + inverseRow[d]) * phi[d];
+                    sumLogInverse += std::log(inverseRow[d]);
+                    sumInverse += inverseRow[d];
+                    sumAlphaSquares += alphaRow[d] * alphaRow[d];
+                }
+                for (size_t d = 0; d < dimension; ++d) {
+                    alphaTransposed[d * paddedSpeakers + s] = static_cast<t_float>(alphaRow[d]);
+                }
+                speakerOffsets[s] =
+                    static_cast<t_float>(std::log(std::max(pi[s], 1e-8)) - 0.5 * parameters.Fa * phiTerm);
+            }
+
+            // E-step fused with the statistics of the next M-step, one shard
+            // of frames per task.
+            forEachShard(shards.size(), parameters.threads, [&](size_t index) { expectation(index, gamma); });
+            const double logLikelihood = reduceShards();
+
+            double piSum = 0;
+            for (size_t s = 0; s < speakerCount; ++s) {
+                piSum += gammaSums[s];
+            }
+            for (size_t s = 0; s < speakerCount; ++s) {
+                pi[s] = piSum > 0 && std::isfinite(piSum) ? gammaSums[s] / piSum
+                                                          : 1.0 / static_cast<double>(speakerCount);
+            }
+
+            const double elbo = logLikelihood + parameters.Fb * 0.5 *
+                                                    (sumLogInverse - sumInverse - sumAlphaSquares +
+                                                     static_cast<double>(speakerCount * dimension));
+            vbx_iteration record = {elbo, gammaChange, speakerCount, 0};
+            // Rounding of the t_float scores and statistics moves the ELBO by up
+            // to about epsilon times the summed score magnitude from one
+            // iteration to the next; smaller changes cannot be resolved. In
+            // double this is negligible.
+            const double resolution = std::numeric_limits<t_float>::epsilon() * scoreMagnitude;
+            if (iteration > 0 && std::fabs(elbo - previousElbo) < parameters.tolerance + resolution) {
+                result.stop = vbx_stop::elbo;
+            } else if (gammaChange < parameters.gammaTolerance) {
+                result.stop = vbx_stop::gamma;
+            } else if (parameters.pruneThreshold > 0) {
+                record.prunedSpeakers = prune(gamma, pi);
+            }
+            result.history.push_back(record);
+            if (result.stop != vbx_stop::max_iterations) {
+                break;
+            }
+            // The ELBO of a smaller model is not comparable with the last one.
+            previousElbo = record.prunedSpeakers > 0 ? -std::numeric_limits<double>::max() : elbo;
+        }
+        result.speakerCount = speakerCount;
+        expand(gamma, pi);
+    }
+
+private:
+    // Partial sums over one shard of frames.
+    struct Shard {
+        std::vector<t_float> statistics;
+        std::vector<double> gammaSums;
+        double logLikelihood = 0;
+        // Sum of |log-sum-exp| of the t_float scores.
+        double scoreMagnitude = 0;
+        // Largest change of a responsibility.
+        double gammaChange = 0;
+        // Scores of one block of frames.
+        std::vector<t_float> scores;
+        // Responsibilities of one frame before the update.
+        std::vector<t_float> previous;
+    };
+
+    // gamma^T * rho and the column sums of gamma into `statistics` and
+    // `gammaSums`, for the first M-step and after pruning.
+    void accumulate(const t_float *gamma) {
+        forEachShard(shards.size(), parameters.threads, [&](size_t index) {
+            Shard &shard = shards[index];
+            std::fill(shard.statistics.begin(), shard.statistics.end(), t_float(0));
+            std::fill(shard.gammaSums.begin(), shard.gammaSums.end(), 0.0);
+            const size_t end = std::min(frameCount, (index + 1) * shardFrames);
+            for (size_t first = index * shardFrames; first < end; first += kBlock) {
+                accumulateRows(rho.data() + first * dimension, gamma + first * speakerCount,
+                               std::min(kBlock, end - first), shard);
+            }
+        });
+        reduceShards();
+    }
+
+    // Removes the speakers whose weight is below parameters.pruneThreshold,
+    // always keeping the heaviest one. Every row of gamma is compacted in place
+    // to the remaining columns and renormalized (rows left without mass become
+    // uniform), as is pi, and the statistics are recomputed from the compacted
+    // gamma. Returns the number of speakers removed.
+    size_t prune(t_float *gamma, double *pi) {
+        const size_t heaviest = static_cast<size_t>(std::max_element(pi, pi + speakerCount) - pi);
+        std::vector<size_t> kept;
+        for (size_t s = 0; s < speakerCount; ++s) {
+            if (pi[s] >= parameters.pruneThreshold || s == heaviest) {
+                kept.push_back(s);
+            }
+        }
+        const size_t remaining = kept.size();
+        if (remaining == speakerCount) {
+            return 0;
+        }
+        // Row t moves from t * speakerCount to t * remaining, and every kept
+        // column moves left, so no value is overwritten before it is read.
+        for (size_t t = 0; t < frameCount; ++t) {
+            const t_float *source = gamma + t * speakerCount;
+            t_float *row = gamma + t * remaining;
+            for (size_t k = 0; k < remaining; ++k) {
+                row[k] = source[kept[k]];
+            }
+        }
+        normalizeRows(gamma, frameCount, remaining);
+        double piSum = 0;
+        for (size_t k = 0; k < remaining; ++k) {
+            pi[k] = pi[kept[k]];
+            speakers[k] = speakers[kept[k]];
+            piSum += pi[k];
+        }
+        for (size_t k = 0; k < remaining; ++k) {
+            pi[k] = piSum > 0 ? pi[k] / piSum : 1.0 / static_cast<double>(remaining);
+        }
+
+        const size_t pruned = speakerCount - remaining;
+        speakerCount = remaining;
+        paddedSpeakers = (speakerCount + kLanes - 1) / kLanes * kLanes;
+        std::fill(alphaTransposed.begin(), alphaTransposed.end(), t_float(0));
+        accumulate(gamma);
+        return pruned;
+    }
+
+    // Expands the compacted gamma and pi back to the initial speakers, with
+    // zeros for the pruned ones. Rows are moved from the last one on, each
+    // through a copy, since an expanded row may overlap its compacted self.
+    void expand(t_float *gamma, double *pi) const {
+        if (speakerCount == initialSpeakers) {
+            return;
+        }
+        std::vector<t_float> row(speakerCount);
+        for (size_t t = frameCount; t-- > 0;) {
+            std::copy(gamma + t * speakerCount, gamma + (t + 1) * speakerCount, row.begin());
+            t_float *target = gamma + t * initialSpeakers;
+            std::fill(target, target + initialSpeakers, t_float(0));
+            for (size_t k = 0; k < speakerCount; ++k) {
+                target[speakers[k]] = row[k];
+            }
+        }
+        const std::vector<double> weights(pi, pi + speakerCount);
+        std::fill(pi, pi + initialSpeakers, 0.0);
+        for (size_t k = 0; k < speakerCount; ++k) {
+            pi[speakers[k]] = weights[k];
+        }
+    }
+
+    // One pass over the frames of a shard: new responsibilities from alpha and
+    // the offsets, written to `gamma`, plus the shard's share of gamma^T * rho,
+    // of the column sums of gamma and of the log-likelihood, and the largest
+    // change of a responsibility. The frame
+    // constant Fa * G_t is the same for every speaker, so it stays out of the
+    // softmax and is added to the log-likelihood in double.
+    void expectation(size_t index, t_float *gamma) {
+        Shard &shard = shards[index];
+        std::fill(shard.statistics.begin(), shard.statistics.end(), t_float(0));
+        std::fill(shard.gammaSums.begin(), shard.gammaSums.end(), 0.0);
+        t_float *scores = shard.scores.data();
+        const t_float Fa = static_cast<t_float>(parameters.Fa);
+        t_float *previous = shard.previous.data();
+        double logLikelihood = 0;
+        double scoreMagnitude = 0;
+        double gammaChange = 0;
+        const size_t end = std::min(frameCount, (index + 1) * shardFrames);
+        for (size_t first = index * shardFrames; first < end; first += kBlock) {
+            const size_t count = std::min(kBlock, end - first);
+            const t_float *rows = rho.data() + first * dimension;
+            if (count == kBlock) {
+                blockScores<kBlock>(rows, scores);
+            } else {
+                for (size_t f = 0; f < count; ++f) {
+                    blockScores<1>(rows + f * dimension, scores + f * speakerCount);
+                }
+            }
+            for (size_t f = 0; f < count; ++f) {
+                t_float *frameScores = scores + f * speakerCount;
+                for (size_t s = 0; s < speakerCount; ++s) {
+                    frameScores[s] = Fa * frameScores[s] + speakerOffsets[s];
+                }
+                t_float *row = gamma + (first + f) * speakerCount;
+                std::copy(row, row + speakerCount, previous);
+                const double logSum = softmaxRow(frameScores, speakerCount, row);
+                logLikelihood += parameters.Fa * frameOffsets[first + f] + logSum;
+                scoreMagnitude += std::fabs(logSum);
+                for (size_t s = 0; s < speakerCount; ++s) {
+                    gammaChange = std::max(gammaChange, static_cast<double>(std::fabs(row[s] - previous[s])));
+                }
+            }
+            accumulateRows(rows, gamma + first * speakerCount, count, shard);
+        }
+        shard.logLikelihood = logLikelihood;
+        shard.scoreMagnitude = scoreMagnitude;
+        shard.gammaChange = gammaChange;
+    }
+
+    // Adds up the shards' statistics and column sums of the current speakers in
+    // shard order into `statistics` and `gammaSums`, and their score
+    // magnitudes into `scoreMagnitude`; takes the largest gamma change into
+    // `gammaChange`. Returns the summed log-likelihood.
+    double reduceShards() {
+        const Shard &front = shards.front();
+        const size_t used = speakerCount * dimension;
+        std::copy(front.statistics.begin(), front.statistics.begin() + used, statistics.begin());
+        std::copy(front.gammaSums.begin(), front.gammaSums.begin() + speakerCount, gammaSums.begin());
+        double logLikelihood = front.logLikelihood;
+        scoreMagnitude = front.scoreMagnitude;
+        gammaChange = front.gammaChange;
+        for (size_t index = 1; index < shards.size(); ++index) {
+            const Shard &shard = shards[index];
+            for (size_t k = 0; k < used; ++k) {
+                statistics[k] += static_cast<double>(shard.statistics[k]);
+            }
+            for (size_t s = 0; s < speakerCount; ++s) {
+                gammaSums[s] += shard.gammaSums[s];
+            }
+            logLikelihood += shard.logLikelihood;
+            scoreMagnitude += shard.scoreMagnitude;
+            gammaChange = std::max(gammaChange, shard.gammaChange);
+        }
+        return logLikelihood;
+    }
+
+    // out[f * speakerCount + s] = rho_f . alpha_s for the `count` frames at
+    // `rows`: outer products of the frame coordinates with the rows of the
+    // padded alpha^T, kLanes speakers at a time.
+    template <size_t count>
+    void blockScores(const t_float *rows, t_float *out) const {
+        for (size_t first = 0; first < paddedSpeakers; first += kLanes) {
+            t_float tile[count][kLanes] = {};
+            const t_float *column = alphaTransposed.data() + first;
+            for (size_t d = 0; d < dimension; ++d, column += paddedSpeakers) {
+                for (size_t f = 0; f < count; ++f) {
+                    const t_float value = rows[f * dimension + d];
+                    for (size_t l = 0; l < kLanes; ++l) {
+                        tile[f][l] += value * column[l];
+                    }
+                }
+            }
+            const size_t width = std::min(kLanes, speakerCount - first);
+            for (size_t f = 0; f < count; ++f) {
+                for (size_t l = 0; l < width; ++l) {
+                    out[f * speakerCount + first + l] = tile[f][l];
+                }
+            }
+        }
+    }
+
+    // Adds gamma^T * rho and the column sums of gamma over `count` frames, in
+    // frame order. Full blocks read and write every statistics row once.
+    void accumulateRows(const t_float *rows, const t_float *gammaRows, size_t count, Shard &shard) const {
+        double *columnSums = shard.gammaSums.data();
+        for (size_t s = 0; s < speakerCount; ++s) {
+            t_float *target = shard.statistics.data() + s * dimension;
+            if (count == kBlock) {
+                const t_float w0 = gammaRows[s];
+                const t_float w1 = gammaRows[speakerCount + s];
+                const t_float w2 = gammaRows[2 * speakerCount + s];
+                const t_float w3 = gammaRows[3 * speakerCount + s];
+                columnSums[s] = (((columnSums[s] + w0) + w1) + w2) + w3;
+                const t_float *r0 = rows;
+                const t_float *r1 = rows + dimension;
+                const t_float *r2 = rows + 2 * dimension;
+                const t_float *r3 = rows + 3 * dimension;
+                size_t d = 0;
+                for (; d + kLanes <= dimension; d += kLanes) {
+                    for (size_t l = 0; l < kLanes; ++l) {
+                        target[d + l] = (((target[d + l] + w0 * r0[d + l]) + w1 * r1[d + l]) + w2 * r2[d + l]) +
+                                        w3 * r3[d + l];
+                    }
+                }
+                for (; d < dimension; ++d) {
+                    target[d] = (((target[d] + w0 * r0[d]) + w1 * r1[d]) + w2 * r2[d]) + w3 * r3[d];
+                }
+                continue;
+            }
+            for (size_t f = 0; f < count; ++f) {
+                const t_float weight = gammaRows[f * speakerCount + s];
+                columnSums[s] += weight;
+                const t_float *row = rows + f * dimension;
+                for (size_t d = 0; d < dimension; ++d) {
+                    target[d] += weight * row[d];
+                }
+            }
+        }
+    }
+
+    const size_t frameCount;
+    const size_t dimension;
+    const size_t initialSpeakers;
+    // Speakers still in the model, and their indices among the initial ones.
+    size_t speakerCount;
+    std::vector<size_t> speakers;
+    const vbx_parameters parameters;
+    std::vector<t_float> rho;
+    std::vector<double> frameOffsets;
+    std::vector<double> phi;
+    // gamma^T * rho (speakers x D) and the column sums of gamma.
+    std::vector<double> statistics;
+    std::vector<double> gammaSums;
+    std::vector<double> alpha;
+    // alpha^T, dimension x paddedSpeakers, with zero columns past speakerCount.
+    size_t paddedSpeakers;
+    std::vector<t_float> alphaTransposed;
+    std::vector<double> inverseL;
+    // log(pi_s) - Fa / 2 * sum_d phi_d (alpha_sd^2 + invL_sd).
+    std::vector<t_float> speakerOffsets;
+    const size_t shardFrames;
+    std::vector<Shard> shards;
+    double scoreMagnitude = 0;
+    double gammaChange = 0;
+};
+
+} // namespace
+
+template <typename t_storage, typename t_float>
+bool run_vbx(const t_storage *data, size_t frameCount, size_t dimension, size_t rowStride, const double *phi,
+             size_t speakerCount, const vbx_parameters &parameters, t_float *gamma, double *pi, vbx_result &result) {
+    Engine<t_float> engine(frameCount, dimension, speakerCount, parameters);
+    if (!engine.load(data, rowStride, phi)) {
+        return false;
+    }
+    engine.run(gamma, pi, result);
+    return true;
+}
+
+template bool run_vbx(const double *, size_t, size_t, size_t, const double *, size_t, const vbx_parameters &, double *,
+                      double *, vbx_result &);
+template bool run_vbx(const float *, size_t, size_t, size_t, const double *, size_t, const vbx_parameters &, double *,
+                      double *, vbx_result &);
+template bool run_vbx(const fastcluster_kernels::float16_bits *, size_t, size_t, size_t, const double *, size_t,
+                      const vbx_parameters &, double *, double *, vbx_result &);
+template bool run_vbx(const fastcluster_kernels::bfloat16_bits *, size_t, size_t, size_t, const double *, size_t,
+                      const vbx_parameters &, double *, double *, vbx_result &);
+template bool run_vbx(const double *, size_t, size_t, size_t, const double *, size_t, const vbx_parameters &, float *,
+                      double *, vbx_result &);
+template bool run_vbx(const float *, size_t, size_t, size_t, const double *, size_t, const vbx_parameters &, float *,
+                      double *, vbx_result &);
+template bool run_vbx(const fastcluster_kernels::float16_bits *, size_t, size_t, size_t, const double *, size_t,
+                      const vbx_parameters &, float *, double *, vbx_result &);
+template bool run_vbx(const fastcluster_kernels::bfloat16_bits *, size_t, size_t, size_t, const double *, size_t,
+                      const vbx_parameters &, float *, double *, vbx_result &);
+
+} // namespace fastcluster_vbx
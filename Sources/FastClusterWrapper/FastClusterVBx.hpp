@@ -0,0 +1,103 @@
+#ifndef FASTCLUSTER_VBX_HPP
+#define FASTCLUSTER_VBX_HPP
+
+#include "FastClusterKernels.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// Variational Bayes speaker clustering (VBx, BUT Speech@FIT) of embeddings in
+// PLDA space, as run by VBxClustering.swift.
+//
+// Every EM iteration needs two products over the frames: the speaker scores
+// rho * alpha^T for the E-step, and the statistics gamma^T * rho for the next
+// M-step. Both read every frame once, so the engine computes them in a single
+// pass over blocks of four frames: scores, log-sum-exp, the new
+// responsibilities and their contribution to the next statistics, while the
+// block is still in L1. The frames x speakers log-likelihood matrix is never
+// stored, and the speaker rows (alpha and the statistics, speakers x D) stay in
+// cache for the whole pass.
+//
+// The pass runs over shards of frames, possibly on several threads, and every
+// shard keeps its own partial statistics. Sums run in frame order within a
+// shard and in shard order across shards. Shard boundaries depend only on the
+// frame count, so results depend only on the input, not on the thread count.
+// They match the BLAS formulation of VBxClustering.swift to rounding: the
+// benchmark compares gamma, pi and the ELBO trajectory with an unfused
+// reference.
+//
+// Speakers whose mixture weight collapses can be pruned between iterations.
+// The engine then compacts gamma to the remaining speakers in place, so every
+// later pass scores and accumulates only those.
+namespace fastcluster_vbx {
+
+struct vbx_parameters {
+    size_t maxIterations;
+    /// Stop once the ELBO changes by less than this between iterations, plus
+    /// the rounding resolution of the scores (see run_vbx).
+    double tolerance;
+    /// Acoustic scaling factor and speaker regularization.
+    double Fa;
+    double Fb;
+    /// Softmax sharpness applied to the initial responsibilities; negative
+    /// values keep them as given.
+    double initSmoothing;
+    /// Threads for the E-step; at most one per shard of frames.
+    size_t threads;
+    /// Remove speakers whose pi is below this after an iteration; 0 keeps
+    /// every speaker.
+    double pruneThreshold;
+    /// Also stop once no responsibility changes by this much or more in an
+    /// iteration; 0 disables the test.
+    double gammaTolerance;
+};
+
+/// One EM iteration.
+struct vbx_iteration {
+    double elbo;
+    /// Largest change of a responsibility in the E-step.
+    double gammaChange;
+    /// Speakers in the model during the iteration.
+    size_t speakerCount;
+    /// Speakers pruned after the iteration.
+    size_t prunedSpeakers;
+};
+
+enum class vbx_stop { max_iterations, elbo, gamma };
+
+struct vbx_result {
+    /// Every iteration that ran.
+    std::vector<vbx_iteration> history;
+    vbx_stop stop = vbx_stop::max_iterations;
+    /// Speakers left after pruning.
+    size_t speakerCount = 0;
+};
+
+/// Run VBx over `frameCount` rows of `dimension` features starting
+/// `rowStride` elements apart, with PLDA eigenvalues `phi` (`dimension`
+/// entries, clamped to at least 1e-12).
+///
+/// `gamma` holds frameCount * speakerCount responsibilities, row-major: the
+/// initial ones on entry (e.g. one-hot warm-start labels) and the final ones on
+/// return. Rows that do not sum to a positive finite value start uniform.
+/// `pi` receives the speakerCount mixture weights. Pruned speakers end with
+/// zero pi and zero responsibilities; the remaining ones are renormalized when
+/// speakers are pruned.
+///
+/// t_float (double or float) is the type of the frames, the scores, gamma and
+/// the partial statistics of a shard. The M-step with its log-determinant
+/// terms, the sums across shards, the log-likelihood and the ELBO are always
+/// double. Rounding limits how finely the ELBO can be resolved, to about
+/// epsilon(t_float) times the summed |log-sum-exp| of the frames' scores, so
+/// the convergence test adds that to `tolerance`. For float this is about 1e-8
+/// of the ELBO; for double it is negligible.
+///
+/// - Returns: false when a feature or `phi` is NaN or infinite. Throws
+///   std::bad_alloc.
+template <typename t_storage, typename t_float>
+bool run_vbx(const t_storage *data, size_t frameCount, size_t dimension, size_t rowStride, const double *phi,
+             size_t speakerCount, const vbx_parameters &parameters, t_float *gamma, double *pi, vbx_result &result);
+
+} // namespace fastcluster_vbx
+
+#endif // FASTCLUSTER_VBX_HPP
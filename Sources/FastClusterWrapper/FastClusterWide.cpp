@@ -0,0 +1,106 @@
+#include "FastClusterWide.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#ifndef fc_isnan
+#define fc_isnan(X) ((X) != (X))
+#endif
+
+#define FASTCLUSTER_WIDE_INDEX
+#include "fastcluster_internal.hpp"
+
+// The adapter names fastcluster's types unqualified; here they are the 64-bit
+// ones.
+using namespace fastcluster_wide;
+
+#include "FastClusterAdapter.hpp"
+
+namespace {
+
+// Forwards fastcluster's monitor checks to the wrapper's progress sink.
+class MonitorAdapter final : public linkage_monitor {
+public:
+    explicit MonitorAdapter(progress_sink *sink) : sink(sink) {}
+
+    void check(const t_index mergesDone) override { sink->check(static_cast<size_t>(mergesDone)); }
+
+    linkage_monitor *get() { return sink != nullptr ? this : nullptr; }
+
+private:
+    progress_sink *const sink;
+};
+
+template <typename t_storage>
+void runVectorLinkageWide(fastcluster_method method, bool squared, const t_storage *data, size_t count,
+                          size_t dimension, size_t rowStride, bool normalizeRows,
+                          const fastcluster_linkage_options &options, progress_sink *progress,
+                          double *dendrogramOut) {
+    const t_index N = static_cast<t_index>(count);
+    LinkageWorkspace workspace;
+    MonitorAdapter adapter(progress);
+    linkage_monitor *const monitor = adapter.get();
+
+    CentroidDissimilarity<t_storage> dist(data, N, static_cast<t_index>(dimension), rowStride, normalizeRows,
+                                          workspace);
+    dist.seedWeights(options.pointWeights);
+    cluster_result result(N - 1, workspace.merges.reserve(N - 1));
+    if (method == FASTCLUSTER_METHOD_SINGLE) {
+        MST_linkage_core_vector(N, dist, result, monitor);
+        if (!squared) {
+            result.sqrt();
+        }
+        generateSciPyDendrogram<false>(dendrogramOut, result, N);
+        return;
+    }
+
+    vector_linkage_options linkageOptions;
+    linkageOptions.threads = effectiveThreadCount(options.threadCount, count, dimension);
+    linkageOptions.workspace = &workspace.linkage;
+    linkageOptions.monitor = monitor;
+    if (method == FASTCLUSTER_METHOD_CENTROID) {
+        runVectorLinkage<METHOD_VECTOR_CENTROID>(N, dist, result, linkageOptions, options);
+    } else {
+        runVectorLinkage<METHOD_VECTOR_MEDIAN>(N, dist, result, linkageOptions, options);
+    }
+    dist.postprocess(result);
+    generateSciPyDendrogram<true>(dendrogramOut, result, N);
+}
+
+} // namespace
+
+namespace fastcluster_wide {
+
+template <typename t_storage>
+void vector_linkage(fastcluster_method method, bool squared, const t_storage *data, size_t count, size_t dimension,
+                    size_t rowStride, bool normalizeRows, const fastcluster_linkage_options &options,
+                    progress_sink *progress, double *dendrogramOut) {
+    // fastcluster's exception types of this build are unknown to the wrapper.
+    try {
+        runVectorLinkageWide(method, squared, data, count, dimension, rowStride, normalizeRows, options, progress,
+                             dendrogramOut);
+    } catch (const nan_error &) {
+        throw std::domain_error("NaN dissimilarity value");
+    }
+}
+
+template void vector_linkage<double>(fastcluster_method, bool, const double *, size_t, size_t, size_t, bool,
+                                     const fastcluster_linkage_options &, progress_sink *, double *);
+template void vector_linkage<float>(fastcluster_method, bool, const float *, size_t, size_t, size_t, bool,
+                                    const fastcluster_linkage_options &, progress_sink *, double *);
+template void vector_linkage<fastcluster_kernels::float16_bits>(fastcluster_method, bool,
+                                                                  const fastcluster_kernels::float16_bits *, size_t,
+                                                                  size_t, size_t, bool,
+                                                                  const fastcluster_linkage_options &,
+                                                                  progress_sink *, double *);
+template void vector_linkage<fastcluster_kernels::bfloat16_bits>(fastcluster_method, bool,
+                                                                   const fastcluster_kernels::bfloat16_bits *, size_t,
+                                                                   size_t, size_t, bool,
+                                                                   const fastcluster_linkage_options &,
+                                                                   progress_sink *, double *);
+
+} // namespace fastcluster_wide
@@ -0,0 +1,56 @@
+#ifndef FASTCLUSTER_WIDE_HPP
+#define FASTCLUSTER_WIDE_HPP
+
+#include "FastClusterWrapper.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit-index build of the vector linkage methods (single, centroid, median).
+//
+// The default build indexes points and merged nodes with 32-bit integers, and
+// merged node ids reach 2N - 2, so a run is capped at 2^30 - 1 points.
+// FastClusterWide.cpp compiles fastcluster and FastClusterAdapter.hpp with
+// FASTCLUSTER_WIDE_INDEX instead; the wrapper calls it for larger runs, or when
+// `fastcluster_linkage_options.indexWidth` asks for it. Only the merge loops
+// see the wider indices: the distance kernels count coordinates with size_t in
+// both builds, and the common, smaller runs keep the 32-bit build, so their
+// speed is unchanged. Both builds produce identical dendrograms.
+namespace fastcluster_wide {
+
+/// Largest point count and dimension of the 64-bit build.
+constexpr size_t max_point_count = static_cast<size_t>(INT64_MAX / 2);
+constexpr size_t max_dimension = static_cast<size_t>(INT64_MAX);
+
+/// Receives the progress checks of a run (every 256 merges, see
+/// `fastcluster_run_control`); throw from `check` to stop the run.
+class progress_sink {
+public:
+    virtual void check(size_t completedMerges) = 0;
+
+protected:
+    ~progress_sink() {}
+};
+
+/// Single, centroid or median linkage of `count` rows, written to
+/// `dendrogramOut` in SciPy format.
+///
+/// - Parameters:
+///   - squared: Keep single-linkage heights squared (the squared Euclidean
+///     metric). Centroid and median heights are always Euclidean.
+///   - rowStride: Elements between consecutive rows; 0 means `dimension`.
+///   - normalizeRows: Scale every row to unit length (the cosine metric).
+///   - options: `threadCount`, `activeSet`, `heapArity` and `pointWeights` apply. The 32-bit
+///     `workspace` cannot serve a 64-bit run and is ignored.
+///   - progress: May be nullptr.
+///
+/// Requires 2 <= count <= max_point_count. Throws std::bad_alloc,
+/// std::domain_error for a NaN distance, and whatever `progress` throws.
+template <typename t_storage>
+void vector_linkage(fastcluster_method method, bool squared, const t_storage *data, size_t count, size_t dimension,
+                    size_t rowStride, bool normalizeRows, const fastcluster_linkage_options &options,
+                    progress_sink *progress, double *dendrogramOut);
+
+} // namespace fastcluster_wide
+
+#endif // FASTCLUSTER_WIDE_HPP
@@ -1,9 +1,24 @@
 #include "FastClusterWrapper.h"
+#include "FastClusterConstraints.hpp"
+#include "FastClusterDistanceMatrix.hpp"
+#include "FastClusterIncremental.hpp"
+#include "FastClusterKernels.hpp"
+#include "FastClusterPLDA.hpp"
+#include "FastClusterReduction.hpp"
+#include "FastClusterVBx.hpp"
+#include "FastClusterWide.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
+#include <limits>
+#include <mutex>
 #include <new>
+#include <thread>
 #include <vector>
 
 #ifndef fc_isnan
@@ -21,224 +36,1910 @@
 #pragma clang diagnostic pop
 #endif
 
+#include "FastClusterAdapter.hpp"
+
+// The opaque handle of the C API.
+struct fastcluster_workspace : LinkageWorkspace {};
+
+// Handle of the incremental API: every appended row as double, and the tree
+// over the first `tree.leafCount` rows from the last linkage call.
+struct fastcluster_incremental_engine {
+    fastcluster_metric metric;
+    size_t dimension;
+    std::vector<double> rows;
+    std::vector<double> inverseNorms;
+    fastcluster_incremental::centroid_tree tree;
+    LinkageWorkspace workspace;
+};
+
+struct fastcluster_plda_engine {
+    fastcluster_plda::plda_model model;
+};
+
 namespace {
 
-struct CentroidDissimilarity {
-    const t_float *data;
-    const t_index dimension;
-    const t_index count;
-    std::vector<t_float> centroidStorage;
-    std::vector<t_index> members;
+fastcluster_linkage_options resolveOptions(const fastcluster_linkage_options *options) {
+    fastcluster_linkage_options resolved;
+    fastcluster_linkage_options_init(&resolved);
+    if (options != nullptr) {
+        resolved = *options;
+    }
+    return resolved;
+}
+
+// Whether a vector run over `pointCount` rows needs the 64-bit build of
+// FastClusterWide.hpp: merged node ids reach 2 * pointCount - 2, and
+// generic_linkage_vector_alternative indexes one past them.
+bool needsWideIndex(size_t pointCount, size_t dimension) {
+    return pointCount > static_cast<size_t>(MAX_INDEX) / 2 || dimension > static_cast<size_t>(MAX_INDEX);
+}
+
+// Argument checks shared by every linkage entry point. `trivial` is set when the
+// input is valid but there is nothing to merge (zero or one point).
+fastcluster_wrapper_status validateLinkageArguments(
+    const void *data,
+    size_t pointCount,
+    size_t dimension,
+    bool wideIndex,
+    const double *dendrogramOut,
+    size_t dendrogramLength,
+    bool &trivial
+) {
+    trivial = true;
+    if (data == nullptr || dendrogramOut == nullptr) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if (pointCount == 0) {
+        return FASTCLUSTER_WRAPPER_SUCCESS;
+    }
+    if (dimension == 0) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if (wideIndex ? pointCount > fastcluster_wide::max_point_count || dimension > fastcluster_wide::max_dimension
+                  : needsWideIndex(pointCount, dimension)) {
+        return FASTCLUSTER_WRAPPER_INDEX_OVERFLOW;
+    }
+
+    const size_t requiredLength = (pointCount > 1) ? (pointCount - 1) * 4 : 0;
+    if (dendrogramLength < requiredLength) {
+        return FASTCLUSTER_WRAPPER_OUTPUT_TOO_SMALL;
+    }
+
+    trivial = pointCount == 1;
+    return FASTCLUSTER_WRAPPER_SUCCESS;
+}
+
+// Thrown through fastcluster to stop a run; see RunControl.
+struct run_stopped {
+    fastcluster_wrapper_status status;
+};
 
-    CentroidDissimilarity(const t_float *input, t_index sampleCount, t_index dim)
-        : data(input),
-          dimension(dim),
-          count(sampleCount),
-          centroidStorage(sampleCount > 1 ? static_cast<size_t>((sampleCount - 1) * dim) : 0u),
-          members(sampleCount > 0 ? static_cast<size_t>(2 * sampleCount - 1) : 0u, 0) {
-        for (t_index i = 0; i < count; ++i) {
-            members[static_cast<size_t>(i)] = 1;
+// State of one call's fastcluster_run_control: the deadline and whether a check
+// has stopped it. A batch shares one RunControl across its jobs, so the budget
+// covers the batch and a stop ends every job. Checks are serialized, so the
+// callback never runs twice at a time.
+class RunControl {
+public:
+    explicit RunControl(const fastcluster_run_control *control)
+        : callback(control != nullptr ? control->callback : nullptr),
+          context(control != nullptr ? control->context : nullptr),
+          timed(control != nullptr && control->timeBudgetSeconds > 0) {
+        if (timed) {
+            // Budgets beyond a year are clamped so the deadline cannot overflow.
+            const double seconds = std::min(control->timeBudgetSeconds, 365.0 * 24 * 3600);
+            deadline = std::chrono::steady_clock::now() +
+                       std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                           std::chrono::duration<double>(seconds));
         }
     }
 
-    template <bool checkNaN>
-    t_float sqeuclidean(const t_index i, const t_index j) const {
-        const t_float *pi = basePointer(i);
-        const t_float *pj = basePointer(j);
-        t_float sum = 0;
-        for (t_index k = 0; k < dimension; ++k) {
-            const t_float diff = pi[k] - pj[k];
-            sum += diff * diff;
-        }
-        if constexpr (checkNaN) {
-#if HAVE_DIAGNOSTIC
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wfloat-equal"
-#endif
-            if (fc_isnan(sum)) {
-#if HAVE_DIAGNOSTIC
-#pragma GCC diagnostic pop
-#endif
-                throw nan_error();
-            }
+    bool active() const { return callback != nullptr || timed; }
+
+    // Throws when an earlier check stopped the call or the budget is spent.
+    void begin() {
+        if (!active()) {
+            return;
         }
-        return sum;
+        std::lock_guard<std::mutex> lock(mutex);
+        stopIfDue();
     }
 
-    t_float sqeuclidean_extended(const t_index i, const t_index j) const {
-        const t_float *pi = extendedPointer(i);
-        const t_float *pj = extendedPointer(j);
-        t_float sum = 0;
-        for (t_index k = 0; k < dimension; ++k) {
-            const t_float diff = pi[k] - pj[k];
-            sum += diff * diff;
-        }
-#if HAVE_DIAGNOSTIC
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wfloat-equal"
-#endif
-        if (fc_isnan(sum)) {
-            throw nan_error();
+    void check(size_t completedMerges, size_t totalMerges) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopIfDue();
+        if (callback != nullptr && callback(context, completedMerges, totalMerges) != 0) {
+            stopped = FASTCLUSTER_WRAPPER_CANCELLED;
+            throw run_stopped{stopped};
         }
-#if HAVE_DIAGNOSTIC
-#pragma GCC diagnostic pop
-#endif
-        return sum;
     }
 
-    void merge(const t_index i, const t_index j, const t_index newNode) {
-        const t_float *pi = extendedPointer(i);
-        const t_float *pj = extendedPointer(j);
-        t_float *pn = centroidPointer(newNode);
-        const t_float mi = static_cast<t_float>(members[static_cast<size_t>(i)]);
-        const t_float mj = static_cast<t_float>(members[static_cast<size_t>(j)]);
-        const t_float denom = mi + mj;
-        for (t_index k = 0; k < dimension; ++k) {
-            pn[k] = (pi[k] * mi + pj[k] * mj) / denom;
+    void finish(size_t totalMerges) {
+        if (callback != nullptr) {
+            std::lock_guard<std::mutex> lock(mutex);
+            callback(context, totalMerges, totalMerges);
         }
-        members[static_cast<size_t>(newNode)] = members[static_cast<size_t>(i)] + members[static_cast<size_t>(j)];
     }
 
-    void merge_weighted(const t_index i, const t_index j, const t_index newNode) {
-        const t_float *pi = extendedPointer(i);
-        const t_float *pj = extendedPointer(j);
-        t_float *pn = centroidPointer(newNode);
-        for (t_index k = 0; k < dimension; ++k) {
-            pn[k] = static_cast<t_float>(0.5) * (pi[k] + pj[k]);
+private:
+    const fastcluster_progress_callback callback;
+    void *const context;
+    const bool timed;
+    std::chrono::steady_clock::time_point deadline;
+    std::mutex mutex;
+    fastcluster_wrapper_status stopped = FASTCLUSTER_WRAPPER_SUCCESS;
+
+    void stopIfDue() {
+        if (stopped == FASTCLUSTER_WRAPPER_SUCCESS && timed && std::chrono::steady_clock::now() >= deadline) {
+            stopped = FASTCLUSTER_WRAPPER_TIME_BUDGET_EXCEEDED;
+        }
+        if (stopped != FASTCLUSTER_WRAPPER_SUCCESS) {
+            throw run_stopped{stopped};
         }
-        members[static_cast<size_t>(newNode)] = members[static_cast<size_t>(i)] + members[static_cast<size_t>(j)];
     }
+};
 
-    t_float ward(const t_index i, const t_index j) const {
-        return sqeuclidean<true>(i, j);
+// The linkage_monitor of one run over `pointCount` points. `get()` is NULL
+// without an active control, which keeps the loops free of checks.
+class RunMonitor final : public linkage_monitor {
+public:
+    RunMonitor(RunControl &control, t_index pointCount)
+        : control(control), totalMerges(static_cast<size_t>(pointCount - 1)) {
+        control.begin();
     }
 
-    t_float ward_initial(const t_index i, const t_index j) const {
-        return sqeuclidean<true>(i, j);
+    void check(const t_index mergesDone) override { control.check(static_cast<size_t>(mergesDone), totalMerges); }
+
+    void finish() { control.finish(totalMerges); }
+
+    linkage_monitor *get() { return control.active() ? this : nullptr; }
+
+private:
+    RunControl &control;
+    const size_t totalMerges;
+};
+
+// RunMonitor of a 64-bit-index run.
+class WideRunMonitor final : public fastcluster_wide::progress_sink {
+public:
+    WideRunMonitor(RunControl &control, size_t pointCount) : control(control), totalMerges(pointCount - 1) {
+        control.begin();
     }
 
-    static t_float ward_initial_conversion(const t_float value) {
-        return value * static_cast<t_float>(0.5);
+    void check(const size_t completedMerges) override { control.check(completedMerges, totalMerges); }
+
+    void finish() { control.finish(totalMerges); }
+
+    fastcluster_wide::progress_sink *get() { return control.active() ? this : nullptr; }
+
+private:
+    RunControl &control;
+    const size_t totalMerges;
+};
+
+// Checks of the micro-cluster reduction of an approximate run, which come
+// before any merge and so report 0 of the `pointCount - 1` merges.
+class ReductionMonitor final : public fastcluster_reduction::progress_sink {
+public:
+    ReductionMonitor(RunControl &control, size_t pointCount) : control(control), totalMerges(pointCount - 1) {
+        control.begin();
+    }
+
+    void check() override { control.check(0, totalMerges); }
+
+    fastcluster_reduction::progress_sink *get() { return control.active() ? this : nullptr; }
+
+private:
+    RunControl &control;
+    const size_t totalMerges;
+};
+
+// Runs `body` and maps the exceptions fastcluster can raise to status codes.
+template <typename t_body>
+fastcluster_wrapper_status runGuarded(t_body &&body) {
+    try {
+        body();
+        return FASTCLUSTER_WRAPPER_SUCCESS;
+    } catch (const run_stopped &stop) {
+        return stop.status;
+    } catch (const std::bad_alloc &) {
+        return FASTCLUSTER_WRAPPER_ALLOCATION_FAILURE;
+    } catch (const nan_error &) {
+        return FASTCLUSTER_WRAPPER_RUNTIME_ERROR;
+#ifdef FE_INVALID
+    } catch (const fenv_error &) {
+        return FASTCLUSTER_WRAPPER_RUNTIME_ERROR;
+#endif
+    } catch (const std::exception &) {
+        return FASTCLUSTER_WRAPPER_RUNTIME_ERROR;
+    } catch (...) {
+        return FASTCLUSTER_WRAPPER_UNKNOWN_ERROR;
     }
+}
+
+// Workspace a call runs in: the caller's, or `local` when none was given.
+LinkageWorkspace &callWorkspace(const fastcluster_linkage_options &options, LinkageWorkspace &local) {
+    LinkageWorkspace &workspace = options.workspace != nullptr ? *options.workspace : local;
+    ++workspace.calls;
+    return workspace;
+}
+
+bool validDataStructures(const fastcluster_linkage_options &options) {
+    const bool knownActiveSet =
+        options.activeSet == FASTCLUSTER_ACTIVE_SET_LINKED_LIST || options.activeSet == FASTCLUSTER_ACTIVE_SET_BITMAP;
+    return knownActiveSet && (options.heapArity == 2 || options.heapArity == 4 || options.heapArity == 8);
+}
+
+bool validIndexWidth(const fastcluster_linkage_options &options) {
+    return options.indexWidth == FASTCLUSTER_INDEX_AUTO || options.indexWidth == FASTCLUSTER_INDEX_64;
+}
 
-    t_float ward_extended(const t_index i, const t_index j) const {
-        return sqeuclidean_extended(i, j);
+// `options.pointWeights` is NULL or holds `pointCount` finite, positive weights.
+bool validPointWeights(const fastcluster_linkage_options &options, size_t pointCount) {
+    if (options.pointWeights == nullptr) {
+        return true;
+    }
+    for (size_t i = 0; i < pointCount; ++i) {
+        if (!(options.pointWeights[i] > 0) || !std::isfinite(options.pointWeights[i])) {
+            return false;
+        }
     }
+    return true;
+}
+
+// Whether a single, centroid or median run goes to the 64-bit build.
+bool useWideIndex(const fastcluster_linkage_options &options, size_t pointCount, size_t dimension) {
+    return options.indexWidth == FASTCLUSTER_INDEX_64 || needsWideIndex(pointCount, dimension);
+}
 
-    void postprocess(cluster_result &result) const {
-        result.sqrt();
+template <typename t_storage>
+fastcluster_wrapper_status computeCentroidLinkage(
+    const t_storage *data,
+    size_t pointCount,
+    size_t dimension,
+    const fastcluster_linkage_options &options,
+    double *dendrogramOut,
+    size_t dendrogramLength
+) {
+    if (!validDataStructures(options) || !validIndexWidth(options) || !validPointWeights(options, pointCount)) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    const bool wide = useWideIndex(options, pointCount, dimension);
+    bool trivial = false;
+    const fastcluster_wrapper_status status =
+        validateLinkageArguments(data, pointCount, dimension, wide, dendrogramOut, dendrogramLength, trivial);
+    if (status != FASTCLUSTER_WRAPPER_SUCCESS || trivial) {
+        return status;
     }
 
-private:
-    const t_float *basePointer(const t_index index) const {
-        return data + static_cast<size_t>(index) * static_cast<size_t>(dimension);
+    if (wide) {
+        return runGuarded([&] {
+            RunControl control(options.control);
+            WideRunMonitor monitor(control, pointCount);
+            fastcluster_wide::vector_linkage(FASTCLUSTER_METHOD_CENTROID, false, data, pointCount, dimension, 0,
+                                             false, options, monitor.get(), dendrogramOut);
+            monitor.finish();
+        });
     }
 
-    const t_float *extendedPointer(const t_index index) const {
-        if (index < count) {
-            return basePointer(index);
+    return runGuarded([&] {
+        const t_index N = static_cast<t_index>(pointCount);
+        const t_index dim = static_cast<t_index>(dimension);
+
+        LinkageWorkspace localWorkspace;
+        LinkageWorkspace &workspace = callWorkspace(options, localWorkspace);
+
+        RunControl control(options.control);
+        RunMonitor monitor(control, N);
+        vector_linkage_options linkageOptions;
+        linkageOptions.threads = effectiveThreadCount(options.threadCount, pointCount, dimension);
+        linkageOptions.workspace = &workspace.linkage;
+        linkageOptions.monitor = monitor.get();
+
+        CentroidDissimilarity<t_storage> dist(data, N, dim, 0, false, workspace);
+        dist.seedWeights(options.pointWeights);
+        cluster_result result(N - 1, workspace.merges.reserve(N - 1));
+        runVectorLinkage<METHOD_VECTOR_CENTROID>(N, dist, result, linkageOptions, options);
+        dist.postprocess(result);
+        generateSciPyDendrogram<true>(dendrogramOut, result, N);
+        monitor.finish();
+    });
+}
+
+// Condensed upper-triangular distance matrix, row i holding D(i, j) for j > i,
+// in the layout NN_chain_core and generic_linkage index through D_.
+template <typename t_storage>
+void buildCondensedMatrix(
+    const CentroidDissimilarity<t_storage> &dist,
+    const t_index N,
+    const bool squared,
+    const t_index threads,
+    const fastcluster_distance_algorithm algorithm,
+    t_float *D,
+    linkage_monitor *monitor = nullptr
+) {
+    const size_t entries = static_cast<size_t>(N) * static_cast<size_t>(N - 1) / 2;
+    // Non-finite input makes the blocked builder decline; the pairwise loop
+    // below then raises nan_error exactly as before. Half-precision rows
+    // always take the pairwise loop.
+    if constexpr (!CentroidDissimilarity<t_storage>::halfPrecision) {
+        if (algorithm == FASTCLUSTER_DISTANCES_BLOCKED &&
+            fastcluster_distances::condensed_sqeuclidean_blocked(dist.data, static_cast<size_t>(N),
+                                                                 static_cast<size_t>(dist.dimension), dist.rowStride,
+                                                                 dist.inverseNorms, static_cast<size_t>(threads), D)) {
+            if (!squared) {
+                for (size_t k = 0; k < entries; ++k) {
+                    D[k] = std::sqrt(D[k]);
+                }
+            }
+            if (monitor != nullptr) {
+                monitor->check(0);
+            }
+            return;
         }
-        return centroidStorage.data() + static_cast<size_t>(index - count) * static_cast<size_t>(dimension);
     }
 
-    t_float *centroidPointer(const t_index index) {
-        return centroidStorage.data() + static_cast<size_t>(index - count) * static_cast<size_t>(dimension);
+    // Row i has N-1-i entries; visiting rows from the bottom gives the
+    // ascending cost profile parallel_triangular_rows balances.
+    auto fillRow = [&](const t_index reversedRow) {
+        const t_index row = N - 1 - reversedRow;
+        monitor_step(monitor, reversedRow, 0);
+        t_float *out = D + (static_cast<std::ptrdiff_t>(2 * N - 3 - row) * row >> 1) + row;
+        for (t_index column = row + 1; column < N; ++column) {
+            const t_float value = dist.template sqeuclidean<true>(row, column);
+            *(out++) = squared ? value : std::sqrt(value);
+        }
+    };
+    parallel_triangular_rows(1, N, threads, fillRow);
+}
+
+template <method_codes method>
+void runNNChain(const t_index N, t_float *D, const double *pointWeights, cluster_result &result,
+                LinkageWorkspace &workspace, linkage_monitor *monitor) {
+    t_float *members = workspace.clusterSizes.reserve(N);
+    if (pointWeights != nullptr) {
+        std::copy(pointWeights, pointWeights + N, members);
+        if constexpr (method == METHOD_METR_WARD) {
+            // The squared Ward distance of clusters of sizes a and b is
+            // 2ab / (a + b) times the squared centroid distance. The
+            // Lance-Williams update keeps that for merged clusters, but the
+            // matrix starts out with the factor 1 of two single points.
+            t_float *entry = D;
+            for (t_index i = 0; i < N - 1; ++i) {
+                for (t_index j = i + 1; j < N; ++j) {
+                    *(entry++) *= 2 * members[i] * members[j] / (members[i] + members[j]);
+                }
+            }
+        }
+    } else {
+        std::fill(members, members + N, static_cast<t_float>(1));
     }
-};
+    NN_chain_core<method, t_float>(N, D, members, result, monitor);
+}
 
-class LinkageOutput {
-public:
-    explicit LinkageOutput(t_float *buffer) : cursor(buffer) {}
+template <typename t_storage>
+fastcluster_wrapper_status computeLinkage(
+    fastcluster_method method,
+    fastcluster_metric metric,
+    const t_storage *data,
+    size_t pointCount,
+    size_t dimension,
+    size_t rowStride,
+    const fastcluster_linkage_options &options,
+    RunControl &control,
+    double *dendrogramOut,
+    size_t dendrogramLength
+) {
+    // Cosine is the Euclidean distance between L2-normalized rows, so it
+    // supports every method that Euclidean does.
+    const bool cosine = metric == FASTCLUSTER_METRIC_COSINE;
+    const bool euclidean = metric == FASTCLUSTER_METRIC_EUCLIDEAN || cosine;
+    if (!euclidean && metric != FASTCLUSTER_METRIC_SQEUCLIDEAN) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    switch (method) {
+    case FASTCLUSTER_METHOD_SINGLE:
+    case FASTCLUSTER_METHOD_COMPLETE:
+    case FASTCLUSTER_METHOD_AVERAGE:
+    case FASTCLUSTER_METHOD_WEIGHTED:
+        break;
+    case FASTCLUSTER_METHOD_WARD:
+    case FASTCLUSTER_METHOD_CENTROID:
+    case FASTCLUSTER_METHOD_MEDIAN:
+        // The Lance-Williams updates of these methods are only valid for
+        // Euclidean input (SciPy raises for any other metric).
+        if (!euclidean) {
+            return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+        }
+        break;
+    default:
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if ((rowStride != 0 && rowStride < dimension) || !validDataStructures(options) || !validIndexWidth(options) ||
+        !validPointWeights(options, pointCount)) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
 
-    void append(t_index node1, t_index node2, t_float distance, t_float size) {
-        if (node1 < node2) {
-            *(cursor++) = static_cast<t_float>(node1);
-            *(cursor++) = static_cast<t_float>(node2);
-        } else {
-            *(cursor++) = static_cast<t_float>(node2);
-            *(cursor++) = static_cast<t_float>(node1);
+    const bool vectorMethod = method == FASTCLUSTER_METHOD_SINGLE || method == FASTCLUSTER_METHOD_CENTROID ||
+                              method == FASTCLUSTER_METHOD_MEDIAN;
+    const bool wide = vectorMethod && useWideIndex(options, pointCount, dimension);
+    bool trivial = false;
+    const fastcluster_wrapper_status status =
+        validateLinkageArguments(data, pointCount, dimension, wide, dendrogramOut, dendrogramLength, trivial);
+    if (status != FASTCLUSTER_WRAPPER_SUCCESS || trivial) {
+        return status;
+    }
+
+    if (wide) {
+        return runGuarded([&] {
+            WideRunMonitor monitor(control, pointCount);
+            fastcluster_wide::vector_linkage(method, !euclidean, data, pointCount, dimension, rowStride,
+                                             cosine && !options.inputIsNormalized, options, monitor.get(),
+                                             dendrogramOut);
+            monitor.finish();
+        });
+    }
+
+    return runGuarded([&] {
+        const t_index N = static_cast<t_index>(pointCount);
+        const t_index dim = static_cast<t_index>(dimension);
+        const t_index threads = effectiveThreadCount(options.threadCount, pointCount, dimension);
+
+        LinkageWorkspace localWorkspace;
+        LinkageWorkspace &workspace = callWorkspace(options, localWorkspace);
+        RunMonitor monitor(control, N);
+
+        CentroidDissimilarity<t_storage> dist(data, N, dim, rowStride, cosine && !options.inputIsNormalized,
+                                              workspace);
+        dist.seedWeights(options.pointWeights);
+        cluster_result result(N - 1, workspace.merges.reserve(N - 1));
+
+        switch (method) {
+        case FASTCLUSTER_METHOD_SINGLE:
+            // Minimum spanning tree on the vectors: O(N) memory. sqrt is
+            // monotone, so the tree is built on squared distances.
+            MST_linkage_core_vector(N, dist, result, monitor.get());
+            if (euclidean) {
+                result.sqrt();
+            }
+            generateSciPyDendrogram<false>(dendrogramOut, result, N);
+            monitor.finish();
+            return;
+
+        case FASTCLUSTER_METHOD_CENTROID:
+        case FASTCLUSTER_METHOD_MEDIAN: {
+            vector_linkage_options linkageOptions;
+            linkageOptions.threads = threads;
+            linkageOptions.workspace = &workspace.linkage;
+            linkageOptions.monitor = monitor.get();
+            if (method == FASTCLUSTER_METHOD_CENTROID) {
+                runVectorLinkage<METHOD_VECTOR_CENTROID>(N, dist, result, linkageOptions, options);
+            } else {
+                runVectorLinkage<METHOD_VECTOR_MEDIAN>(N, dist, result, linkageOptions, options);
+            }
+            dist.postprocess(result);
+            generateSciPyDendrogram<true>(dendrogramOut, result, N);
+            monitor.finish();
+            return;
+        }
+
+        default:
+            break;
+        }
+
+        // Nearest-neighbour chain on the stored matrix: O(N^2) memory, O(N^2) time.
+        // Ward runs on squared Euclidean distances, as in fastcluster/SciPy.
+        const bool squared = method == FASTCLUSTER_METHOD_WARD || !euclidean;
+        t_float *D = workspace.condensed.reserve(static_cast<size_t>(N) * static_cast<size_t>(N - 1) / 2);
+        buildCondensedMatrix(dist, N, squared, threads, options.distanceAlgorithm, D, monitor.get());
+
+        switch (method) {
+        case FASTCLUSTER_METHOD_COMPLETE:
+            runNNChain<METHOD_METR_COMPLETE>(N, D, options.pointWeights, result, workspace, monitor.get());
+            break;
+        case FASTCLUSTER_METHOD_AVERAGE:
+            runNNChain<METHOD_METR_AVERAGE>(N, D, options.pointWeights, result, workspace, monitor.get());
+            break;
+        case FASTCLUSTER_METHOD_WEIGHTED:
+            runNNChain<METHOD_METR_WEIGHTED>(N, D, options.pointWeights, result, workspace, monitor.get());
+            break;
+        default:
+            runNNChain<METHOD_METR_WARD>(N, D, options.pointWeights, result, workspace, monitor.get());
+            result.sqrt();
+            break;
         }
-        *(cursor++) = distance;
-        *(cursor++) = size;
+        generateSciPyDendrogram<false>(dendrogramOut, result, N);
+        monitor.finish();
+    });
+}
+
+// A dissimilarity of generic_linkage_vector_alternative under cannot-link
+// constraints: clusters that may not be merged are infinitely far apart.
+// Conflicts only grow as clusters merge, and the distances of a new node are
+// computed fresh, so fastcluster's lower-bound bookkeeping stays valid.
+template <typename t_dissimilarity>
+class ConstrainedDissimilarity {
+public:
+    ConstrainedDissimilarity(t_dissimilarity &inner, fastcluster_constraints::conflict_tracker &conflicts)
+        : dimension(inner.dimension), inner(inner), conflicts(conflicts) {}
+
+    const t_index dimension;
+
+    template <bool checkNaN>
+    t_float sqeuclidean(const t_index i, const t_index j) const {
+        return conflict(i, j) ? kInfinity : inner.template sqeuclidean<checkNaN>(i, j);
+    }
+
+    t_float sqeuclidean_extended(const t_index i, const t_index j) const {
+        return conflict(i, j) ? kInfinity : inner.sqeuclidean_extended(i, j);
+    }
+
+    void merge(const t_index i, const t_index j, const t_index newNode) {
+        conflicts.merge(static_cast<size_t>(i), static_cast<size_t>(j), static_cast<size_t>(newNode));
+        inner.merge(i, j, newNode);
+    }
+
+    void merge_weighted(const t_index i, const t_index j, const t_index newNode) {
+        conflicts.merge(static_cast<size_t>(i), static_cast<size_t>(j), static_cast<size_t>(newNode));
+        inner.merge_weighted(i, j, newNode);
+    }
+
+    // Ward is not offered with constraints; these only satisfy the template.
+    t_float ward_initial(const t_index i, const t_index j) const { return inner.ward_initial(i, j); }
+    static t_float ward_initial_conversion(const t_float value) {
+        return t_dissimilarity::ward_initial_conversion(value);
     }
+    t_float ward_extended(const t_index i, const t_index j) const { return inner.ward_extended(i, j); }
 
 private:
-    t_float *cursor;
-};
+    static constexpr t_float kInfinity = std::numeric_limits<t_float>::infinity();
 
-template <bool sorted>
-void generateSciPyDendrogram(t_float *Z, cluster_result &Z2, const t_index N) {
-    union_find nodes(sorted ? 0 : N);
-    if (!sorted) {
-        std::stable_sort(Z2[0], Z2[N - 1]);
+    bool conflict(const t_index i, const t_index j) const {
+        return conflicts.conflict(static_cast<size_t>(i), static_cast<size_t>(j));
     }
 
-    LinkageOutput output(Z);
-    t_index node1;
-    t_index node2;
+    t_dissimilarity &inner;
+    fastcluster_constraints::conflict_tracker &conflicts;
+};
 
-    for (node const *entry = Z2[0]; entry != Z2[N - 1]; ++entry) {
-        if (sorted) {
-            node1 = entry->node1;
-            node2 = entry->node2;
-        } else {
-            node1 = nodes.Find(entry->node1);
-            node2 = nodes.Find(entry->node2);
-            nodes.Union(node1, node2);
+// SciPy dendrogram over the points of `groups`: every must-link group is first
+// chained at height 0 in ascending point order, then `result`, the linkage of
+// the groups, follows with group g standing for the last node of its chain.
+void writeConstrainedDendrogram(const fastcluster_constraints::constraint_groups &groups, cluster_result &result,
+                                double *dendrogramOut) {
+    const size_t pointCount = groups.groupOf.size();
+    const size_t groupCount = groups.count();
+    LinkageOutput output(dendrogramOut);
+    std::vector<size_t> nodeOf(2 * groupCount - 1);
+    std::vector<size_t> sizeOf(2 * groupCount - 1);
+    size_t nextNode = pointCount;
+    for (size_t g = 0; g < groupCount; ++g) {
+        const size_t *members = groups.members.data() + groups.offsets[g];
+        size_t node = members[0];
+        for (size_t k = 1; k < groups.size(g); ++k) {
+            output.append(static_cast<t_index>(node), static_cast<t_index>(members[k]), 0,
+                          static_cast<t_float>(k + 1));
+            node = nextNode++;
         }
-        output.append(node1, node2, entry->dist,
-                      ((node1 < N) ? 1 : Z_(node1 - N, 3)) + ((node2 < N) ? 1 : Z_(node2 - N, 3)));
+        nodeOf[g] = node;
+        sizeOf[g] = groups.size(g);
+    }
+    for (size_t t = 0; t + 1 < groupCount; ++t) {
+        const node *entry = result[static_cast<t_index>(t)];
+        const size_t left = static_cast<size_t>(entry->node1);
+        const size_t right = static_cast<size_t>(entry->node2);
+        nodeOf[groupCount + t] = nextNode++;
+        sizeOf[groupCount + t] = sizeOf[left] + sizeOf[right];
+        output.append(static_cast<t_index>(nodeOf[left]), static_cast<t_index>(nodeOf[right]), entry->dist,
+                      static_cast<t_float>(sizeOf[groupCount + t]));
     }
 }
 
-} // namespace
+template <typename t_dissimilarity>
+void runConstrainedLinkage(fastcluster_method method, t_dissimilarity &dist,
+                           const fastcluster_constraints::constraint_groups &groups,
+                           const fastcluster_linkage_options &options, LinkageWorkspace &workspace,
+                           RunControl &control, double *dendrogramOut) {
+    const t_index G = static_cast<t_index>(groups.count());
+    RunMonitor monitor(control, G);
+    cluster_result result(std::max<t_index>(G - 1, 1), workspace.merges.reserve(std::max<t_index>(G - 1, 1)));
+    if (G > 1) {
+        fastcluster_constraints::conflict_tracker conflicts(groups);
+        ConstrainedDissimilarity<t_dissimilarity> constrained(dist, conflicts);
+        vector_linkage_options linkageOptions;
+        linkageOptions.threads =
+            effectiveThreadCount(options.threadCount, groups.count(), static_cast<size_t>(dist.dimension));
+        linkageOptions.workspace = &workspace.linkage;
+        linkageOptions.monitor = monitor.get();
+        if (method == FASTCLUSTER_METHOD_CENTROID) {
+            runVectorLinkage<METHOD_VECTOR_CENTROID>(G, constrained, result, linkageOptions, options);
+        } else {
+            runVectorLinkage<METHOD_VECTOR_MEDIAN>(G, constrained, result, linkageOptions, options);
+        }
+        dist.postprocess(result);
+    }
+    writeConstrainedDendrogram(groups, result, dendrogramOut);
+    monitor.finish();
+}
 
-fastcluster_wrapper_status fastcluster_compute_centroid_linkage(
-    const double *data,
+// Centroid or median linkage under must-link and cannot-link constraints.
+// Without must-link pairs the rows are read in place; otherwise every group
+// is replaced by the mean of its (scaled) rows, weighted by its size.
+template <typename t_storage>
+fastcluster_wrapper_status computeConstrainedLinkage(
+    fastcluster_method method,
+    fastcluster_metric metric,
+    const t_storage *data,
     size_t pointCount,
     size_t dimension,
+    size_t rowStride,
+    const fastcluster_pair_constraints &constraints,
+    const fastcluster_linkage_options &options,
     double *dendrogramOut,
     size_t dendrogramLength
 ) {
-    if (data == nullptr || dendrogramOut == nullptr) {
+    const bool cosine = metric == FASTCLUSTER_METRIC_COSINE;
+    if ((method != FASTCLUSTER_METHOD_CENTROID && method != FASTCLUSTER_METHOD_MEDIAN) ||
+        (metric != FASTCLUSTER_METRIC_EUCLIDEAN && !cosine) || (rowStride != 0 && rowStride < dimension) ||
+        (constraints.mustLinkCount > 0 && constraints.mustLinkPairs == nullptr) ||
+        (constraints.cannotLinkCount > 0 && constraints.cannotLinkPairs == nullptr) ||
+        !validDataStructures(options) || !validPointWeights(options, pointCount)) {
         return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
     }
-    if (pointCount == 0) {
-        return FASTCLUSTER_WRAPPER_SUCCESS;
+    if (needsWideIndex(pointCount, dimension)) {
+        return FASTCLUSTER_WRAPPER_INDEX_OVERFLOW;
     }
-    if (dimension == 0) {
+    bool trivial = false;
+    const fastcluster_wrapper_status status =
+        validateLinkageArguments(data, pointCount, dimension, false, dendrogramOut, dendrogramLength, trivial);
+    if (status != FASTCLUSTER_WRAPPER_SUCCESS || trivial) {
+        return status;
+    }
+
+    fastcluster_wrapper_status constraintStatus = FASTCLUSTER_WRAPPER_SUCCESS;
+    const fastcluster_wrapper_status guarded = runGuarded([&] {
+        fastcluster_constraints::constraint_groups groups;
+        if (!fastcluster_constraints::build_groups(pointCount, constraints.mustLinkPairs, constraints.mustLinkCount,
+                                                   constraints.cannotLinkPairs, constraints.cannotLinkCount,
+                                                   groups)) {
+            constraintStatus = FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+            return;
+        }
+        const t_index dim = static_cast<t_index>(dimension);
+        const bool normalizeRows = cosine && !options.inputIsNormalized;
+        LinkageWorkspace localWorkspace;
+        LinkageWorkspace &workspace = callWorkspace(options, localWorkspace);
+        RunControl control(options.control);
+
+        if (groups.count() == pointCount) {
+            CentroidDissimilarity<t_storage> dist(data, static_cast<t_index>(pointCount), dim, rowStride,
+                                                  normalizeRows, workspace);
+            dist.seedWeights(options.pointWeights);
+            runConstrainedLinkage(method, dist, groups, options, workspace, control, dendrogramOut);
+            return;
+        }
+
+        using fastcluster_kernels::widen;
+        const size_t stride = rowStride != 0 ? rowStride : dimension;
+        const size_t groupCount = groups.count();
+        std::vector<double> centres(groupCount * dimension, 0.0);
+        std::vector<double> groupWeights(groupCount, 0.0);
+        for (size_t g = 0; g < groupCount; ++g) {
+            double *centre = centres.data() + g * dimension;
+            for (size_t position = groups.offsets[g]; position < groups.offsets[g + 1]; ++position) {
+                const size_t point = groups.members[position];
+                const t_storage *row = data + point * stride;
+                const double weight = options.pointWeights != nullptr ? options.pointWeights[point] : 1.0;
+                groupWeights[g] += weight;
+                double scale = weight;
+                if (normalizeRows) {
+                    double norm = 0;
+                    for (size_t k = 0; k < dimension; ++k) {
+                        norm += static_cast<double>(widen(row[k])) * static_cast<double>(widen(row[k]));
+                    }
+                    scale = norm > 0 ? weight / std::sqrt(norm) : 0.0;
+                }
+                for (size_t k = 0; k < dimension; ++k) {
+                    centre[k] += scale * static_cast<double>(widen(row[k]));
+                }
+            }
+            for (size_t k = 0; k < dimension; ++k) {
+                if (!std::isfinite(centre[k])) {
+                    throw nan_error();
+                }
+                centre[k] /= groupWeights[g];
+            }
+        }
+        CentroidDissimilarity<double> dist(centres.data(), static_cast<t_index>(groupCount), dim, 0, false,
+                                           workspace);
+        for (size_t g = 0; g < groupCount; ++g) {
+            dist.members[g] = groupWeights[g];
+        }
+        runConstrainedLinkage(method, dist, groups, options, workspace, control, dendrogramOut);
+    });
+    return guarded != FASTCLUSTER_WRAPPER_SUCCESS ? guarded : constraintStatus;
+}
+
+// Flat clusters from a SciPy-format dendrogram, following `fcluster` with the
+// max-dist monocriterion: a merge joins its subtrees into one flat cluster when
+// the largest merge distance anywhere in its subtree is <= threshold. That keeps
+// the cut consistent on non-monotone (centroid, median) dendrograms.
+class DendrogramCut {
+public:
+    DendrogramCut(const double *dendrogram, const t_index pointCount)
+        : Z(dendrogram), N(pointCount), parent(static_cast<size_t>(2 * pointCount - 1), -1) {}
+
+    // Checks that every row merges two distinct, not yet merged, existing nodes.
+    bool validate() const {
+        std::vector<bool> used(static_cast<size_t>(2 * N - 1), false);
+        for (t_index i = 0; i < N - 1; ++i) {
+            const double left = Z[4 * i];
+            const double right = Z[4 * i + 1];
+            if (!(left >= 0 && right >= 0 && left < N + i && right < N + i && left != right) ||
+                left != std::floor(left) || right != std::floor(right)) {
+                return false;
+            }
+            for (const double child : {left, right}) {
+                const size_t index = static_cast<size_t>(child);
+                if (used[index]) {
+                    return false;
+                }
+                used[index] = true;
+            }
+        }
+        return true;
+    }
+
+    // Largest merge distance in the subtree of every merge. Rows list children
+    // before parents, so one forward pass suffices.
+    void maxDistances(std::vector<t_float> &maxDist) const {
+        maxDist.resize(static_cast<size_t>(N - 1));
+        for (t_index i = 0; i < N - 1; ++i) {
+            t_float value = Z[4 * i + 2];
+            for (const t_index child : {child1(i), child2(i)}) {
+                if (child >= N && maxDist[static_cast<size_t>(child - N)] > value) {
+                    value = maxDist[static_cast<size_t>(child - N)];
+                }
+            }
+            maxDist[static_cast<size_t>(i)] = value;
+        }
+    }
+
+    // Union-find pass over the merges: every merge whose subtree max-dist is
+    // within the threshold links both children under its node. Labels are
+    // dense and 0-based in order of first appearance among the points.
+    void assign(const std::vector<t_float> &maxDist, const t_float threshold, int32_t *labels) {
+        for (t_index i = 0; i < N - 1; ++i) {
+            if (maxDist[static_cast<size_t>(i)] <= threshold) {
+                parent[static_cast<size_t>(child1(i))] = N + i;
+                parent[static_cast<size_t>(child2(i))] = N + i;
+            }
+        }
+
+        std::vector<int32_t> clusterLabel(static_cast<size_t>(N - 1), -1);
+        int32_t nextLabel = 0;
+        for (t_index point = 0; point < N; ++point) {
+            const t_index root = find(point);
+            if (root < N) {
+                labels[point] = nextLabel++;
+                continue;
+            }
+            int32_t &label = clusterLabel[static_cast<size_t>(root - N)];
+            if (label < 0) {
+                label = nextLabel++;
+            }
+            labels[point] = label;
+        }
+    }
+
+private:
+    const double *Z;
+    const t_index N;
+    std::vector<t_index> parent;
+
+    t_index child1(const t_index row) const { return static_cast<t_index>(Z[4 * row]); }
+    t_index child2(const t_index row) const { return static_cast<t_index>(Z[4 * row + 1]); }
+
+    t_index find(t_index node) {
+        // Path halving keeps repeated lookups of the same cluster O(1).
+        while (parent[static_cast<size_t>(node)] >= 0) {
+            const t_index up = parent[static_cast<size_t>(node)];
+            if (parent[static_cast<size_t>(up)] >= 0) {
+                parent[static_cast<size_t>(node)] = parent[static_cast<size_t>(up)];
+            }
+            node = up;
+        }
+        return node;
+    }
+};
+
+template <typename t_threshold>
+fastcluster_wrapper_status cutTree(
+    const double *dendrogram,
+    size_t dendrogramLength,
+    size_t pointCount,
+    int32_t *labelsOut,
+    size_t labelsLength,
+    t_threshold &&threshold
+) {
+    if (dendrogram == nullptr || labelsOut == nullptr) {
         return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
     }
-    if (pointCount > static_cast<size_t>(MAX_INDEX) || dimension > static_cast<size_t>(MAX_INDEX)) {
+    if (pointCount == 0) {
+        return FASTCLUSTER_WRAPPER_SUCCESS;
+    }
+    // Node ids reach 2 * pointCount - 2; labels are int32_t.
+    if (needsWideIndex(pointCount, 0)) {
         return FASTCLUSTER_WRAPPER_INDEX_OVERFLOW;
     }
-
-    const size_t requiredLength = (pointCount > 1) ? (pointCount - 1) * 4 : 0;
-    if (dendrogramLength < requiredLength) {
+    if (labelsLength < pointCount) {
         return FASTCLUSTER_WRAPPER_OUTPUT_TOO_SMALL;
     }
-
+    if (dendrogramLength < (pointCount - 1) * 4) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
     if (pointCount == 1) {
+        labelsOut[0] = 0;
         return FASTCLUSTER_WRAPPER_SUCCESS;
     }
 
-    try {
-        const t_index N = static_cast<t_index>(pointCount);
-        const t_index dim = static_cast<t_index>(dimension);
+    fastcluster_wrapper_status status = FASTCLUSTER_WRAPPER_SUCCESS;
+    const fastcluster_wrapper_status guarded = runGuarded([&] {
+        DendrogramCut cut(dendrogram, static_cast<t_index>(pointCount));
+        if (!cut.validate()) {
+            status = FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+            return;
+        }
+        std::vector<t_float> maxDist;
+        cut.maxDistances(maxDist);
+        cut.assign(maxDist, threshold(maxDist), labelsOut);
+    });
+    return guarded != FASTCLUSTER_WRAPPER_SUCCESS ? guarded : status;
+}
 
-        CentroidDissimilarity dist(data, N, dim);
-        cluster_result result(N - 1);
-        generic_linkage_vector_alternative<METHOD_VECTOR_CENTROID>(N, dist, result);
-        dist.postprocess(result);
-        generateSciPyDendrogram<true>(dendrogramOut, result, N);
-        return FASTCLUSTER_WRAPPER_SUCCESS;
-    } catch (const std::bad_alloc &) {
-        return FASTCLUSTER_WRAPPER_ALLOCATION_FAILURE;
-    } catch (const nan_error &) {
-        return FASTCLUSTER_WRAPPER_RUNTIME_ERROR;
-    } catch (const std::exception &) {
+template <typename t_storage>
+fastcluster_wrapper_status computeDistanceMatrix(
+    fastcluster_metric metric,
+    const t_storage *data,
+    size_t pointCount,
+    size_t dimension,
+    size_t rowStride,
+    const fastcluster_linkage_options &options,
+    double *out,
+    size_t outLength
+) {
+    if (metric != FASTCLUSTER_METRIC_EUCLIDEAN && metric != FASTCLUSTER_METRIC_SQEUCLIDEAN &&
+        metric != FASTCLUSTER_METRIC_COSINE) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if (data == nullptr || out == nullptr || (rowStride != 0 && rowStride < dimension)) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if (pointCount < 2) {
+        return FASTCLUSTER_WRAPPER_SUCCESS;
+    }
+    if (dimension == 0) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if (pointCount > static_cast<size_t>(MAX_INDEX) || dimension > static_cast<size_t>(MAX_INDEX)) {
+        return FASTCLUSTER_WRAPPER_INDEX_OVERFLOW;
+    }
+    if (outLength < pointCount * (pointCount - 1) / 2) {
+        return FASTCLUSTER_WRAPPER_OUTPUT_TOO_SMALL;
+    }
+
+    return runGuarded([&] {
+        const t_index N = static_cast<t_index>(pointCount);
+        LinkageWorkspace localWorkspace;
+        LinkageWorkspace &workspace = callWorkspace(options, localWorkspace);
+        const bool normalizeRows = metric == FASTCLUSTER_METRIC_COSINE && !options.inputIsNormalized;
+        CentroidDissimilarity<t_storage> dist(data, N, static_cast<t_index>(dimension), rowStride, normalizeRows,
+                                              workspace);
+        buildCondensedMatrix(dist, N, metric == FASTCLUSTER_METRIC_SQEUCLIDEAN,
+                             effectiveThreadCount(options.threadCount, pointCount, dimension),
+                             options.distanceAlgorithm, out);
+    });
+}
+
+// Centroid linkage of the `count` rows behind `dist`, cut at `threshold` into
+// dense first-appearance labels.
+template <typename t_storage>
+void cutCentroidLinkage(CentroidDissimilarity<t_storage> &dist, const t_index count,
+                        const fastcluster_linkage_options &options, LinkageWorkspace &workspace, RunControl &control,
+                        const double threshold, int32_t *labels) {
+    if (count == 1) {
+        labels[0] = 0;
+        return;
+    }
+    RunMonitor monitor(control, count);
+    vector_linkage_options linkageOptions;
+    linkageOptions.threads =
+        effectiveThreadCount(options.threadCount, static_cast<size_t>(count), static_cast<size_t>(dist.dimension));
+    linkageOptions.workspace = &workspace.linkage;
+    linkageOptions.monitor = monitor.get();
+    cluster_result result(count - 1, workspace.merges.reserve(count - 1));
+    runVectorLinkage<METHOD_VECTOR_CENTROID>(count, dist, result, linkageOptions, options);
+    dist.postprocess(result);
+    monitor.finish();
+
+    std::vector<double> dendrogram(static_cast<size_t>(count - 1) * 4);
+    generateSciPyDendrogram<true>(dendrogram.data(), result, count);
+    DendrogramCut cut(dendrogram.data(), count);
+    std::vector<t_float> maxDist;
+    cut.maxDistances(maxDist);
+    cut.assign(maxDist, threshold, labels);
+}
+
+// Approximate centroid clustering: exact centroid linkage on k-means
+// micro-clusters weighted by their point counts, cut at `threshold`, with every
+// point taking the label of its micro-cluster.
+template <typename t_storage>
+fastcluster_wrapper_status computeApproximateClustering(
+    fastcluster_metric metric,
+    const t_storage *data,
+    size_t pointCount,
+    size_t dimension,
+    size_t rowStride,
+    double threshold,
+    const fastcluster_linkage_options &options,
+    const fastcluster_approximate_options &approximate,
+    int32_t *labelsOut,
+    size_t labelsLength,
+    fastcluster_approximate_report *report
+) {
+    if (metric != FASTCLUSTER_METRIC_EUCLIDEAN && metric != FASTCLUSTER_METRIC_COSINE) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if (data == nullptr || labelsOut == nullptr || (rowStride != 0 && rowStride < dimension) ||
+        !(approximate.errorBudget >= 0) || std::isnan(threshold) || !validDataStructures(options) ||
+        options.pointWeights != nullptr) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if (report != nullptr) {
+        report->microClusterCount = 0;
+        report->quantizationError = 0;
+    }
+    if (pointCount == 0) {
+        return FASTCLUSTER_WRAPPER_SUCCESS;
+    }
+    if (dimension == 0) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if (needsWideIndex(pointCount, dimension)) {
+        return FASTCLUSTER_WRAPPER_INDEX_OVERFLOW;
+    }
+    if (labelsLength < pointCount) {
+        return FASTCLUSTER_WRAPPER_OUTPUT_TOO_SMALL;
+    }
+
+    return runGuarded([&] {
+        const t_index dim = static_cast<t_index>(dimension);
+        const size_t stride = rowStride != 0 ? rowStride : dimension;
+        LinkageWorkspace localWorkspace;
+        LinkageWorkspace &workspace = callWorkspace(options, localWorkspace);
+        // The reduction reports 0 merges of `pointCount - 1`; the linkage then
+        // reports merges of micro-clusters, or of points when the exact
+        // clustering runs.
+        RunControl control(options.control);
+        ReductionMonitor reductionMonitor(control, pointCount);
+
+        const bool normalizeRows = metric == FASTCLUSTER_METRIC_COSINE && !options.inputIsNormalized;
+        const t_storage *scales = nullptr;
+        if (normalizeRows) {
+            t_storage *inverseNorms = workspace.storage<t_storage>().inverseNorms.reserve(pointCount);
+            computeInverseNorms(data, static_cast<t_index>(pointCount), dim, stride, inverseNorms);
+            scales = inverseNorms;
+        }
+
+        // The budget is an RMS distance relative to the threshold: micro-clusters
+        // much tighter than the cut rarely straddle a cluster boundary.
+        const double radius = approximate.errorBudget > 0 ? approximate.errorBudget * std::max(0.0, threshold) : 0.0;
+        fastcluster_reduction::reduction_parameters parameters;
+        parameters.targetError = static_cast<double>(pointCount) * radius * radius;
+        // Past N / 4 micro-clusters the reduction costs more than it saves;
+        // without an explicit bound the exact clustering runs instead.
+        const bool automaticBound = approximate.maxMicroClusters == 0;
+        parameters.maxCentres = automaticBound ? std::max<size_t>(1, pointCount / 4) : approximate.maxMicroClusters;
+        parameters.refinementIterations = approximate.refinementIterations;
+        parameters.refineWhenOverBudget = !automaticBound;
+        parameters.seed = approximate.seed;
+        parameters.threads = options.threadCount != 0 ? options.threadCount
+                                                      : std::max(1u, std::thread::hardware_concurrency());
+        parameters.progress = reductionMonitor.get();
+        fastcluster_reduction::micro_clusters reduced;
+        if (!fastcluster_reduction::reduce_to_micro_clusters(data, pointCount, dimension, stride, scales, parameters,
+                                                             reduced)) {
+            throw nan_error();
+        }
+
+        if (automaticBound && !reduced.withinTarget) {
+            CentroidDissimilarity<t_storage> dist(data, static_cast<t_index>(pointCount), dim, rowStride,
+                                                  normalizeRows, workspace);
+            cutCentroidLinkage(dist, static_cast<t_index>(pointCount), options, workspace, control, threshold,
+                               labelsOut);
+            if (report != nullptr) {
+                report->microClusterCount = pointCount;
+            }
+            return;
+        }
+
+        // Weighted centres: merged centroids are the means of all points below.
+        const t_index k = static_cast<t_index>(reduced.count);
+        std::vector<int32_t> microLabels(reduced.count, 0);
+        CentroidDissimilarity<double> dist(reduced.centres.data(), k, dim, 0, false, workspace);
+        for (t_index i = 0; i < k; ++i) {
+            dist.members[i] = static_cast<t_float>(reduced.weights[static_cast<size_t>(i)]);
+        }
+        cutCentroidLinkage(dist, k, options, workspace, control, threshold, microLabels.data());
+
+        // Renumber in order of first appearance among the points.
+        std::vector<int32_t> labelOf(reduced.count, -1);
+        int32_t nextLabel = 0;
+        for (size_t i = 0; i < pointCount; ++i) {
+            int32_t &label = labelOf[static_cast<size_t>(microLabels[reduced.assignment[i]])];
+            if (label < 0) {
+                label = nextLabel++;
+            }
+            labelsOut[i] = label;
+        }
+        if (report != nullptr) {
+            report->microClusterCount = reduced.count;
+            const double rms = std::sqrt(reduced.error / static_cast<double>(pointCount));
+            report->quantizationError = rms > 0 ? rms / std::max(0.0, threshold) : 0;
+        }
+    });
+}
+
+// fastcluster_compute_linkage_matrix under a caller-provided control, so that
+// the jobs of a batch share one.
+fastcluster_wrapper_status computeLinkageMatrix(
+    fastcluster_method method,
+    fastcluster_metric metric,
+    const fastcluster_matrix *matrix,
+    const fastcluster_linkage_options &options,
+    RunControl &control,
+    double *dendrogramOut,
+    size_t dendrogramLength
+) {
+    if (matrix == nullptr) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    switch (matrix->scalarType) {
+    case FASTCLUSTER_SCALAR_FLOAT64:
+        return computeLinkage(method, metric, static_cast<const double *>(matrix->data), matrix->pointCount,
+                              matrix->dimension, matrix->rowStride, options, control, dendrogramOut,
+                              dendrogramLength);
+    case FASTCLUSTER_SCALAR_FLOAT32:
+        return computeLinkage(method, metric, static_cast<const float *>(matrix->data), matrix->pointCount,
+                              matrix->dimension, matrix->rowStride, options, control, dendrogramOut,
+                              dendrogramLength);
+    case FASTCLUSTER_SCALAR_FLOAT16:
+        return computeLinkage(method, metric, static_cast<const fastcluster_kernels::float16_bits *>(matrix->data),
+                              matrix->pointCount, matrix->dimension, matrix->rowStride, options, control,
+                              dendrogramOut, dendrogramLength);
+    case FASTCLUSTER_SCALAR_BFLOAT16:
+        return computeLinkage(method, metric, static_cast<const fastcluster_kernels::bfloat16_bits *>(matrix->data),
+                              matrix->pointCount, matrix->dimension, matrix->rowStride, options, control,
+                              dendrogramOut, dendrogramLength);
+    default:
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+}
+
+// Rough cost of a linkage job, used only to order a batch. Every method
+// evaluates O(N^2 * D) distances.
+double jobCost(const fastcluster_linkage_job &job) {
+    const double points = static_cast<double>(job.matrix.pointCount);
+    return points * points * static_cast<double>(job.matrix.dimension);
+}
+
+// Copy `count` rows into the engine. Nothing is appended when a value is not
+// finite (nan_error) or the storage cannot grow (std::bad_alloc).
+template <typename t_storage>
+void appendIncrementalRows(fastcluster_incremental_engine &engine, const t_storage *data, size_t count,
+                           size_t rowStride) {
+    const size_t dimension = engine.dimension;
+    const size_t stride = rowStride != 0 ? rowStride : dimension;
+    using fastcluster_kernels::widen;
+    const bool cosine = engine.metric == FASTCLUSTER_METRIC_COSINE;
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t k = 0; k < dimension; ++k) {
+            if (!std::isfinite(static_cast<double>(widen(data[i * stride + k])))) {
+                throw nan_error();
+            }
+        }
+    }
+    engine.rows.reserve(engine.rows.size() + count * dimension);
+    if (cosine) {
+        engine.inverseNorms.reserve(engine.inverseNorms.size() + count);
+    }
+
+    const size_t first = engine.rows.size() / dimension;
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t k = 0; k < dimension; ++k) {
+            engine.rows.push_back(static_cast<double>(widen(data[i * stride + k])));
+        }
+    }
+    if (cosine) {
+        engine.inverseNorms.resize(first + count);
+        computeInverseNorms(engine.rows.data() + first * dimension, static_cast<t_index>(count),
+                            static_cast<t_index>(dimension), dimension, engine.inverseNorms.data() + first);
+    }
+}
+
+template <typename t_storage, typename t_float>
+fastcluster_wrapper_status computeVBx(const t_storage *data, size_t frameCount, size_t dimension, size_t rowStride,
+                                      const double *phi, size_t speakerCount,
+                                      const fastcluster_vbx_options &options, t_float *gamma, double *piOut,
+                                      double *elbosOut, fastcluster_vbx_report *report) {
+    const fastcluster_vbx::vbx_parameters parameters = {
+        options.maxIterations,
+        options.convergenceTolerance,
+        options.Fa,
+        options.Fb,
+        options.initSmoothing,
+        options.threadCount != 0 ? options.threadCount : std::max(1u, std::thread::hardware_concurrency()),
+        options.pruneThreshold,
+        options.gammaTolerance,
+    };
+    fastcluster_vbx::vbx_result result;
+    bool finite = true;
+    const fastcluster_wrapper_status status = runGuarded([&] {
+        finite = fastcluster_vbx::run_vbx(data, frameCount, dimension, rowStride == 0 ? dimension : rowStride, phi,
+                                          speakerCount, parameters, gamma, piOut, result);
+    });
+    if (status != FASTCLUSTER_WRAPPER_SUCCESS) {
+        return status;
+    }
+    if (!finite) {
         return FASTCLUSTER_WRAPPER_RUNTIME_ERROR;
-    } catch (...) {
-        return FASTCLUSTER_WRAPPER_UNKNOWN_ERROR;
     }
+    for (size_t i = 0; i < result.history.size(); ++i) {
+        const fastcluster_vbx::vbx_iteration &iteration = result.history[i];
+        if (elbosOut != nullptr) {
+            elbosOut[i] = iteration.elbo;
+        }
+        if (options.history != nullptr) {
+            options.history[i] = {iteration.elbo, iteration.gammaChange, iteration.speakerCount,
+                                  iteration.prunedSpeakers};
+        }
+    }
+    if (report != nullptr) {
+        report->iterations = result.history.size();
+        report->speakerCount = result.speakerCount;
+        switch (result.stop) {
+        case fastcluster_vbx::vbx_stop::max_iterations:
+            report->stopReason = FASTCLUSTER_VBX_STOP_MAX_ITERATIONS;
+            break;
+        case fastcluster_vbx::vbx_stop::elbo:
+            report->stopReason = FASTCLUSTER_VBX_STOP_ELBO;
+            break;
+        case fastcluster_vbx::vbx_stop::gamma:
+            report->stopReason = FASTCLUSTER_VBX_STOP_GAMMA;
+            break;
+        }
+    }
+    return FASTCLUSTER_WRAPPER_SUCCESS;
+}
+
+// Validates the arguments of fastcluster_compute_vbx and its float variant and
+// dispatches on the scalar type of `features`.
+template <typename t_float>
+fastcluster_wrapper_status computeVBxMatrix(const fastcluster_matrix *features, const double *phi,
+                                            size_t speakerCount, const fastcluster_vbx_options *options,
+                                            t_float *gamma, size_t gammaLength, double *piOut, double *elbosOut,
+                                            size_t elbosLength, fastcluster_vbx_report *report) {
+    fastcluster_vbx_options resolved;
+    fastcluster_vbx_options_init(&resolved);
+    if (options != nullptr) {
+        resolved = *options;
+    }
+    if (features == nullptr || phi == nullptr || gamma == nullptr || piOut == nullptr || speakerCount == 0 ||
+        features->dimension == 0 || (features->data == nullptr && features->pointCount > 0) ||
+        (features->rowStride != 0 && features->rowStride < features->dimension) || !(resolved.Fb > 0) ||
+        !(resolved.pruneThreshold >= 0) || !(resolved.gammaTolerance >= 0)) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if (features->pointCount > std::numeric_limits<size_t>::max() / speakerCount ||
+        features->pointCount > std::numeric_limits<size_t>::max() / features->dimension) {
+        return FASTCLUSTER_WRAPPER_INDEX_OVERFLOW;
+    }
+    if (gammaLength < features->pointCount * speakerCount ||
+        (elbosOut != nullptr && elbosLength < resolved.maxIterations) ||
+        (resolved.history != nullptr && resolved.historyLength < resolved.maxIterations)) {
+        return FASTCLUSTER_WRAPPER_OUTPUT_TOO_SMALL;
+    }
+    const size_t frames = features->pointCount;
+    const size_t dimension = features->dimension;
+    const size_t stride = features->rowStride;
+    switch (features->scalarType) {
+    case FASTCLUSTER_SCALAR_FLOAT64:
+        return computeVBx(static_cast<const double *>(features->data), frames, dimension, stride, phi, speakerCount,
+                          resolved, gamma, piOut, elbosOut, report);
+    case FASTCLUSTER_SCALAR_FLOAT32:
+        return computeVBx(static_cast<const float *>(features->data), frames, dimension, stride, phi, speakerCount,
+                          resolved, gamma, piOut, elbosOut, report);
+    case FASTCLUSTER_SCALAR_FLOAT16:
+        return computeVBx(static_cast<const fastcluster_kernels::float16_bits *>(features->data), frames, dimension,
+                          stride, phi, speakerCount, resolved, gamma, piOut, elbosOut, report);
+    case FASTCLUSTER_SCALAR_BFLOAT16:
+        return computeVBx(static_cast<const fastcluster_kernels::bfloat16_bits *>(features->data), frames, dimension,
+                          stride, phi, speakerCount, resolved, gamma, piOut, elbosOut, report);
+    default:
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+}
+
+// Full centroid linkage over every row of the engine, kept as its tree.
+void rebuildIncrementalTree(fastcluster_incremental_engine &engine) {
+    const t_index N = static_cast<t_index>(engine.rows.size() / engine.dimension);
+    const size_t dimension = engine.dimension;
+    LinkageWorkspace &workspace = engine.workspace;
+
+    vector_linkage_options linkageOptions;
+    linkageOptions.workspace = &workspace.linkage;
+    CentroidDissimilarity<double> dist(engine.rows.data(), N, static_cast<t_index>(dimension), 0,
+                                       engine.metric == FASTCLUSTER_METRIC_COSINE, workspace, true);
+    cluster_result result(N - 1, workspace.merges.reserve(N - 1));
+    generic_linkage_vector_alternative<METHOD_VECTOR_CENTROID>(N, dist, result, linkageOptions);
+
+    fastcluster_incremental::centroid_tree tree;
+    const size_t merges = static_cast<size_t>(N - 1);
+    tree.leafCount = static_cast<size_t>(N);
+    tree.left.resize(merges);
+    tree.right.resize(merges);
+    tree.distances.resize(merges);
+    tree.sizes.resize(merges);
+    for (size_t t = 0; t < merges; ++t) {
+        const node *entry = result[static_cast<t_index>(t)];
+        tree.left[t] = static_cast<size_t>(entry->node1);
+        tree.right[t] = static_cast<size_t>(entry->node2);
+        tree.distances[t] = entry->dist;
+        // fastcluster does not record the size of the root; sum the children.
+        const size_t left = tree.left[t];
+        const size_t right = tree.right[t];
+        tree.sizes[t] = (left < tree.leafCount ? 1 : tree.sizes[left - tree.leafCount]) +
+                        (right < tree.leafCount ? 1 : tree.sizes[right - tree.leafCount]);
+    }
+    tree.centroids.assign(dist.centroidStorage, dist.centroidStorage + merges * dimension);
+    engine.tree = std::move(tree);
+}
+
+} // namespace
+
+void fastcluster_linkage_options_init(fastcluster_linkage_options *options) {
+    if (options == nullptr) {
+        return;
+    }
+    options->threadCount = 1;
+    options->inputIsNormalized = 0;
+    options->workspace = nullptr;
+    options->distanceAlgorithm = FASTCLUSTER_DISTANCES_PAIRWISE;
+    options->control = nullptr;
+    options->activeSet = FASTCLUSTER_ACTIVE_SET_LINKED_LIST;
+    options->heapArity = 2;
+    options->indexWidth = FASTCLUSTER_INDEX_AUTO;
+    options->pointWeights = nullptr;
+}
+
+fastcluster_workspace *fastcluster_workspace_create(size_t maxPointCount, size_t maxDimension) {
+    if (maxPointCount > static_cast<size_t>(MAX_INDEX) || maxDimension > static_cast<size_t>(MAX_INDEX)) {
+        return nullptr;
+    }
+    try {
+        fastcluster_workspace *workspace = new fastcluster_workspace();
+        if (maxPointCount > 1) {
+            try {
+                const t_index N = static_cast<t_index>(maxPointCount);
+                workspace->linkage.reserve(N);
+                workspace->merges.reserve(N - 1);
+                workspace->members.reserve(2 * N - 1);
+                workspace->centroidSlots.reserve(2 * (N - 1));
+                workspace->f64.centroids.reserve(static_cast<size_t>(centroidSlotCount(N, false)) * maxDimension);
+            } catch (...) {
+                delete workspace;
+                throw;
+            }
+        }
+        return workspace;
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void fastcluster_workspace_destroy(fastcluster_workspace *workspace) {
+    delete workspace;
+}
+
+void fastcluster_workspace_get_stats(const fastcluster_workspace *workspace, fastcluster_workspace_stats *stats) {
+    if (stats == nullptr) {
+        return;
+    }
+    stats->callCount = workspace != nullptr ? workspace->calls : 0;
+    stats->allocationCount = workspace != nullptr ? workspace->allocations() : 0;
+    stats->reservedBytes = workspace != nullptr ? workspace->bytes() : 0;
+}
+
+fastcluster_simd_level fastcluster_get_simd_level(void) {
+    return static_cast<fastcluster_simd_level>(fastcluster_kernels::active_simd_level());
+}
+
+fastcluster_wrapper_status fastcluster_set_simd_level(fastcluster_simd_level level) {
+    if (level < FASTCLUSTER_SIMD_SCALAR || level > FASTCLUSTER_SIMD_AVX512) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    return fastcluster_kernels::set_active_simd_level(static_cast<fastcluster_kernels::simd_level>(level))
+               ? FASTCLUSTER_WRAPPER_SUCCESS
+               : FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+}
+
+fastcluster_wrapper_status fastcluster_compute_centroid_linkage(
+    const double *data,
+    size_t pointCount,
+    size_t dimension,
+    double *dendrogramOut,
+    size_t dendrogramLength
+) {
+    return computeCentroidLinkage(data, pointCount, dimension, resolveOptions(nullptr), dendrogramOut,
+                                  dendrogramLength);
+}
+
+fastcluster_wrapper_status fastcluster_compute_centroid_linkage_f32(
+    const float *data,
+    size_t pointCount,
+    size_t dimension,
+    double *dendrogramOut,
+    size_t dendrogramLength
+) {
+    return computeCentroidLinkage(data, pointCount, dimension, resolveOptions(nullptr), dendrogramOut,
+                                  dendrogramLength);
+}
+
+fastcluster_wrapper_status fastcluster_compute_centroid_linkage_with_options(
+    const double *data,
+    size_t pointCount,
+    size_t dimension,
+    const fastcluster_linkage_options *options,
+    double *dendrogramOut,
+    size_t dendrogramLength
+) {
+    return computeCentroidLinkage(data, pointCount, dimension, resolveOptions(options), dendrogramOut,
+                                  dendrogramLength);
+}
+
+fastcluster_wrapper_status fastcluster_compute_centroid_linkage_f32_with_options(
+    const float *data,
+    size_t pointCount,
+    size_t dimension,
+    const fastcluster_linkage_options *options,
+    double *dendrogramOut,
+    size_t dendrogramLength
+) {
+    return computeCentroidLinkage(data, pointCount, dimension, resolveOptions(options), dendrogramOut,
+                                  dendrogramLength);
+}
+
+fastcluster_wrapper_status fastcluster_compute_linkage(
+    fastcluster_method method,
+    fastcluster_metric metric,
+    const double *data,
+    size_t pointCount,
+    size_t dimension,
+    const fastcluster_linkage_options *options,
+    double *dendrogramOut,
+    size_t dendrogramLength
+) {
+    fastcluster_matrix matrix;
+    matrix.data = data;
+    matrix.scalarType = FASTCLUSTER_SCALAR_FLOAT64;
+    matrix.pointCount = pointCount;
+    matrix.dimension = dimension;
+    matrix.rowStride = 0;
+    return fastcluster_compute_linkage_matrix(method, metric, &matrix, options, dendrogramOut, dendrogramLength);
+}
+
+fastcluster_wrapper_status fastcluster_compute_linkage_matrix(
+    fastcluster_method method,
+    fastcluster_metric metric,
+    const fastcluster_matrix *matrix,
+    const fastcluster_linkage_options *options,
+    double *dendrogramOut,
+    size_t dendrogramLength
+) {
+    const fastcluster_linkage_options resolved = resolveOptions(options);
+    RunControl control(resolved.control);
+    return computeLinkageMatrix(method, metric, matrix, resolved, control, dendrogramOut, dendrogramLength);
+}
+
+fastcluster_wrapper_status fastcluster_compute_constrained_linkage(
+    fastcluster_method method,
+    fastcluster_metric metric,
+    const fastcluster_matrix *matrix,
+    const fastcluster_pair_constraints *constraints,
+    const fastcluster_linkage_options *options,
+    double *dendrogramOut,
+    size_t dendrogramLength
+) {
+    if (matrix == nullptr) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    const fastcluster_pair_constraints none = {nullptr, 0, nullptr, 0};
+    const fastcluster_pair_constraints &resolved = constraints != nullptr ? *constraints : none;
+    switch (matrix->scalarType) {
+    case FASTCLUSTER_SCALAR_FLOAT64:
+        return computeConstrainedLinkage(method, metric, static_cast<const double *>(matrix->data),
+                                         matrix->pointCount, matrix->dimension, matrix->rowStride, resolved,
+                                         resolveOptions(options), dendrogramOut, dendrogramLength);
+    case FASTCLUSTER_SCALAR_FLOAT32:
+        return computeConstrainedLinkage(method, metric, static_cast<const float *>(matrix->data),
+                                         matrix->pointCount, matrix->dimension, matrix->rowStride, resolved,
+                                         resolveOptions(options), dendrogramOut, dendrogramLength);
+    case FASTCLUSTER_SCALAR_FLOAT16:
+        return computeConstrainedLinkage(method, metric,
+                                         static_cast<const fastcluster_kernels::float16_bits *>(matrix->data),
+                                         matrix->pointCount, matrix->dimension, matrix->rowStride, resolved,
+                                         resolveOptions(options), dendrogramOut, dendrogramLength);
+    case FASTCLUSTER_SCALAR_BFLOAT16:
+        return computeConstrainedLinkage(method, metric,
+                                         static_cast<const fastcluster_kernels::bfloat16_bits *>(matrix->data),
+                                         matrix->pointCount, matrix->dimension, matrix->rowStride, resolved,
+                                         resolveOptions(options), dendrogramOut, dendrogramLength);
+    default:
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+}
+
+fastcluster_wrapper_status fastcluster_convert_to_half(
+    fastcluster_scalar_type type,
+    const float *values,
+    size_t count,
+    uint16_t *out
+) {
+    if ((type != FASTCLUSTER_SCALAR_FLOAT16 && type != FASTCLUSTER_SCALAR_BFLOAT16) ||
+        (count > 0 && (values == nullptr || out == nullptr))) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = type == FASTCLUSTER_SCALAR_FLOAT16 ? fastcluster_kernels::narrow_to_float16(values[i]).bits
+                                                    : fastcluster_kernels::narrow_to_bfloat16(values[i]).bits;
+    }
+    return FASTCLUSTER_WRAPPER_SUCCESS;
+}
+
+fastcluster_wrapper_status fastcluster_cut_tree_distance(
+    const double *dendrogram,
+    size_t dendrogramLength,
+    size_t pointCount,
+    double threshold,
+    int32_t *labelsOut,
+    size_t labelsLength
+) {
+    return cutTree(dendrogram, dendrogramLength, pointCount, labelsOut, labelsLength,
+                   [threshold](const std::vector<t_float> &) { return threshold; });
+}
+
+fastcluster_wrapper_status fastcluster_cut_tree_maxclust(
+    const double *dendrogram,
+    size_t dendrogramLength,
+    size_t pointCount,
+    size_t maxClusters,
+    int32_t *labelsOut,
+    size_t labelsLength
+) {
+    if (maxClusters == 0) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    // Cutting at max-dist r leaves N - #{merges with max-dist <= r} clusters,
+    // so the smallest admissible r is the (N - maxClusters)-th smallest max-dist.
+    return cutTree(dendrogram, dendrogramLength, pointCount, labelsOut, labelsLength,
+                   [pointCount, maxClusters](const std::vector<t_float> &maxDist) {
+                       if (maxClusters >= pointCount) {
+                           return -std::numeric_limits<t_float>::infinity();
+                       }
+                       std::vector<t_float> sorted(maxDist);
+                       const auto nth = sorted.begin() + static_cast<std::ptrdiff_t>(pointCount - maxClusters - 1);
+                       std::nth_element(sorted.begin(), nth, sorted.end());
+                       return *nth;
+                   });
+}
+
+fastcluster_wrapper_status fastcluster_compute_linkage_batch(
+    fastcluster_linkage_job *jobs,
+    size_t jobCount,
+    const fastcluster_linkage_options *options
+) {
+    if (jobs == nullptr && jobCount > 0) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    // A batch that fails before its jobs run reports its status in every job,
+    // so callers never read a status left over from before the call.
+    auto failAll = [jobs, jobCount](fastcluster_wrapper_status status) {
+        for (size_t i = 0; i < jobCount; ++i) {
+            jobs[i].status = status;
+        }
+        return status;
+    };
+    // One weight array cannot describe the points of several jobs.
+    if (options != nullptr && options->pointWeights != nullptr) {
+        return failAll(FASTCLUSTER_WRAPPER_INVALID_ARGUMENT);
+    }
+    if (jobCount == 0) {
+        return FASTCLUSTER_WRAPPER_SUCCESS;
+    }
+
+    try {
+        const fastcluster_linkage_options resolved = resolveOptions(options);
+        size_t threads = resolved.threadCount;
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        threads = std::min(threads, jobCount);
+
+        // Largest first: the last jobs to start are the cheapest, so no single
+        // big job starts late and sets the batch latency.
+        std::vector<size_t> order(jobCount);
+        for (size_t i = 0; i < jobCount; ++i) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [jobs](size_t a, size_t b) { return jobCost(jobs[a]) > jobCost(jobs[b]); });
+
+        // One workspace per worker, reused for every job that worker runs, and
+        // one control for the whole batch.
+        std::vector<fastcluster_workspace> workspaces(threads);
+        RunControl control(resolved.control);
+        std::atomic<size_t> nextJob(0);
+        auto worker = [&](size_t index) {
+            fastcluster_linkage_options jobOptions = resolved;
+            jobOptions.threadCount = 1;
+            jobOptions.workspace = &workspaces[index];
+            for (size_t position = nextJob++; position < jobCount; position = nextJob++) {
+                fastcluster_linkage_job &job = jobs[order[position]];
+                job.status = computeLinkageMatrix(job.method, job.metric, &job.matrix, jobOptions, control,
+                                                  job.dendrogramOut, job.dendrogramLength);
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        try {
+            for (size_t t = 1; t < threads; ++t) {
+                pool.emplace_back(worker, t);
+            }
+        } catch (...) {
+            // Could not start every thread: the ones that did and the calling
+            // thread still drain the queue.
+        }
+        worker(0);
+        for (std::thread &thread : pool) {
+            thread.join();
+        }
+    } catch (const std::bad_alloc &) {
+        // Only the setup allocates outside the workers, so no job has run.
+        return failAll(FASTCLUSTER_WRAPPER_ALLOCATION_FAILURE);
+    }
+
+    for (size_t i = 0; i < jobCount; ++i) {
+        if (jobs[i].status != FASTCLUSTER_WRAPPER_SUCCESS) {
+            return jobs[i].status;
+        }
+    }
+    return FASTCLUSTER_WRAPPER_SUCCESS;
+}
+
+fastcluster_wrapper_status fastcluster_compute_distance_matrix(
+    fastcluster_metric metric,
+    const fastcluster_matrix *matrix,
+    const fastcluster_linkage_options *options,
+    double *out,
+    size_t outLength
+) {
+    if (matrix == nullptr) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    switch (matrix->scalarType) {
+    case FASTCLUSTER_SCALAR_FLOAT64:
+        return computeDistanceMatrix(metric, static_cast<const double *>(matrix->data), matrix->pointCount,
+                                     matrix->dimension, matrix->rowStride, resolveOptions(options), out, outLength);
+    case FASTCLUSTER_SCALAR_FLOAT32:
+        return computeDistanceMatrix(metric, static_cast<const float *>(matrix->data), matrix->pointCount,
+                                     matrix->dimension, matrix->rowStride, resolveOptions(options), out, outLength);
+    case FASTCLUSTER_SCALAR_FLOAT16:
+        return computeDistanceMatrix(metric, static_cast<const fastcluster_kernels::float16_bits *>(matrix->data),
+                                     matrix->pointCount, matrix->dimension, matrix->rowStride,
+                                     resolveOptions(options), out, outLength);
+    case FASTCLUSTER_SCALAR_BFLOAT16:
+        return computeDistanceMatrix(metric, static_cast<const fastcluster_kernels::bfloat16_bits *>(matrix->data),
+                                     matrix->pointCount, matrix->dimension, matrix->rowStride,
+                                     resolveOptions(options), out, outLength);
+    default:
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+}
+
+void fastcluster_approximate_options_init(fastcluster_approximate_options *options) {
+    if (options == nullptr) {
+        return;
+    }
+    options->errorBudget = 0.25;
+    options->maxMicroClusters = 0;
+    options->refinementIterations = 2;
+    options->seed = 0;
+}
+
+fastcluster_wrapper_status fastcluster_cluster_centroid_approximate(
+    fastcluster_metric metric,
+    const fastcluster_matrix *matrix,
+    double threshold,
+    const fastcluster_linkage_options *options,
+    const fastcluster_approximate_options *approximate,
+    int32_t *labelsOut,
+    size_t labelsLength,
+    fastcluster_approximate_report *report
+) {
+    if (matrix == nullptr) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    fastcluster_approximate_options parameters;
+    fastcluster_approximate_options_init(&parameters);
+    if (approximate != nullptr) {
+        parameters = *approximate;
+    }
+    switch (matrix->scalarType) {
+    case FASTCLUSTER_SCALAR_FLOAT64:
+        return computeApproximateClustering(metric, static_cast<const double *>(matrix->data), matrix->pointCount,
+                                            matrix->dimension, matrix->rowStride, threshold, resolveOptions(options),
+                                            parameters, labelsOut, labelsLength, report);
+    case FASTCLUSTER_SCALAR_FLOAT32:
+        return computeApproximateClustering(metric, static_cast<const float *>(matrix->data), matrix->pointCount,
+                                            matrix->dimension, matrix->rowStride, threshold, resolveOptions(options),
+                                            parameters, labelsOut, labelsLength, report);
+    default:
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+}
+
+fastcluster_incremental_engine *fastcluster_incremental_create(fastcluster_metric metric, size_t dimension) {
+    if ((metric != FASTCLUSTER_METRIC_EUCLIDEAN && metric != FASTCLUSTER_METRIC_COSINE) || dimension == 0 ||
+        dimension > static_cast<size_t>(MAX_INDEX)) {
+        return nullptr;
+    }
+    try {
+        fastcluster_incremental_engine *engine = new fastcluster_incremental_engine();
+        engine->metric = metric;
+        engine->dimension = dimension;
+        return engine;
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void fastcluster_incremental_destroy(fastcluster_incremental_engine *engine) {
+    delete engine;
+}
+
+size_t fastcluster_incremental_point_count(const fastcluster_incremental_engine *engine) {
+    return engine != nullptr ? engine->rows.size() / engine->dimension : 0;
+}
+
+fastcluster_wrapper_status fastcluster_incremental_append(
+    fastcluster_incremental_engine *engine,
+    const fastcluster_matrix *matrix
+) {
+    if (engine == nullptr || matrix == nullptr || matrix->dimension != engine->dimension ||
+        (matrix->data == nullptr && matrix->pointCount > 0) ||
+        (matrix->rowStride != 0 && matrix->rowStride < matrix->dimension)) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if (matrix->pointCount > static_cast<size_t>(MAX_INDEX) - fastcluster_incremental_point_count(engine)) {
+        return FASTCLUSTER_WRAPPER_INDEX_OVERFLOW;
+    }
+    switch (matrix->scalarType) {
+    case FASTCLUSTER_SCALAR_FLOAT64:
+        return runGuarded([&] {
+            appendIncrementalRows(*engine, static_cast<const double *>(matrix->data), matrix->pointCount,
+                                  matrix->rowStride);
+        });
+    case FASTCLUSTER_SCALAR_FLOAT32:
+        return runGuarded([&] {
+            appendIncrementalRows(*engine, static_cast<const float *>(matrix->data), matrix->pointCount,
+                                  matrix->rowStride);
+        });
+    case FASTCLUSTER_SCALAR_FLOAT16:
+        return runGuarded([&] {
+            appendIncrementalRows(*engine, static_cast<const fastcluster_kernels::float16_bits *>(matrix->data),
+                                  matrix->pointCount, matrix->rowStride);
+        });
+    case FASTCLUSTER_SCALAR_BFLOAT16:
+        return runGuarded([&] {
+            appendIncrementalRows(*engine, static_cast<const fastcluster_kernels::bfloat16_bits *>(matrix->data),
+                                  matrix->pointCount, matrix->rowStride);
+        });
+    default:
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+}
+
+fastcluster_wrapper_status fastcluster_incremental_linkage(
+    fastcluster_incremental_engine *engine,
+    double *dendrogramOut,
+    size_t dendrogramLength,
+    fastcluster_incremental_report *report
+) {
+    if (engine == nullptr || dendrogramOut == nullptr) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if (report != nullptr) {
+        report->replayedMerges = 0;
+        report->recomputedMerges = 0;
+    }
+    const size_t count = fastcluster_incremental_point_count(engine);
+    if (count < 2) {
+        return FASTCLUSTER_WRAPPER_SUCCESS;
+    }
+    if (dendrogramLength < (count - 1) * 4) {
+        return FASTCLUSTER_WRAPPER_OUTPUT_TOO_SMALL;
+    }
+
+    return runGuarded([&] {
+        fastcluster_incremental::centroid_tree &tree = engine->tree;
+        if (tree.leafCount != count) {
+            // Once the new rows outnumber the old ones, replaying the old tree
+            // saves less than a full run costs.
+            if (count - tree.leafCount > tree.leafCount) {
+                rebuildIncrementalTree(*engine);
+                if (report != nullptr) {
+                    report->recomputedMerges = count - 1;
+                }
+            } else {
+                fastcluster_incremental::extension_statistics statistics;
+                fastcluster_incremental::extend_centroid_tree(
+                    engine->rows.data(),
+                    engine->metric == FASTCLUSTER_METRIC_COSINE ? engine->inverseNorms.data() : nullptr, count,
+                    engine->dimension, tree, statistics);
+                if (report != nullptr) {
+                    report->replayedMerges = statistics.replayedMerges;
+                    report->recomputedMerges = statistics.recomputedMerges;
+                }
+            }
+        }
+
+        LinkageOutput output(dendrogramOut);
+        for (size_t t = 0; t + 1 < count; ++t) {
+            output.append(static_cast<t_index>(tree.left[t]), static_cast<t_index>(tree.right[t]),
+                          std::sqrt(tree.distances[t]), static_cast<t_float>(tree.sizes[t]));
+        }
+    });
+}
+
+void fastcluster_vbx_options_init(fastcluster_vbx_options *options) {
+    if (options == nullptr) {
+        return;
+    }
+    options->maxIterations = 20;
+    options->convergenceTolerance = 1e-4;
+    options->Fa = 0.07;
+    options->Fb = 0.8;
+    options->initSmoothing = 7.0;
+    options->threadCount = 1;
+    options->pruneThreshold = 0;
+    options->gammaTolerance = 0;
+    options->history = nullptr;
+    options->historyLength = 0;
+}
+
+fastcluster_wrapper_status fastcluster_compute_vbx(
+    const fastcluster_matrix *features,
+    const double *phi,
+    size_t speakerCount,
+    const fastcluster_vbx_options *options,
+    double *gamma,
+    size_t gammaLength,
+    double *piOut,
+    double *elbosOut,
+    size_t elbosLength,
+    fastcluster_vbx_report *report
+) {
+    return computeVBxMatrix(features, phi, speakerCount, options, gamma, gammaLength, piOut, elbosOut, elbosLength,
+                            report);
+}
+
+fastcluster_wrapper_status fastcluster_compute_vbx_f32(
+    const fastcluster_matrix *features,
+    const double *phi,
+    size_t speakerCount,
+    const fastcluster_vbx_options *options,
+    float *gamma,
+    size_t gammaLength,
+    double *piOut,
+    double *elbosOut,
+    size_t elbosLength,
+    fastcluster_vbx_report *report
+) {
+    return computeVBxMatrix(features, phi, speakerCount, options, gamma, gammaLength, piOut, elbosOut, elbosLength,
+                            report);
+}
+
+fastcluster_plda_engine *fastcluster_plda_create(const fastcluster_plda_parameters *parameters) {
+    if (parameters == nullptr || parameters->inputDimension == 0 || parameters->ldaDimension == 0 ||
+        parameters->outputDimension == 0 || parameters->outputDimension > parameters->ldaDimension ||
+        parameters->lda == nullptr || parameters->pldaTransform == nullptr ||
+        parameters->inputDimension > std::numeric_limits<size_t>::max() / parameters->ldaDimension) {
+        return nullptr;
+    }
+    try {
+        fastcluster_plda_engine *engine = new fastcluster_plda_engine();
+        if (!fastcluster_plda::prepare_plda_model(parameters->inputDimension, parameters->ldaDimension,
+                                                  parameters->outputDimension, parameters->inputMean,
+                                                  parameters->lda, parameters->ldaMean, parameters->pldaMean,
+                                                  parameters->pldaTransform, engine->model)) {
+            delete engine;
+            return nullptr;
+        }
+        return engine;
+    } catch (const std::bad_alloc &) {
+        return nullptr;
+    }
+}
+
+void fastcluster_plda_destroy(fastcluster_plda_engine *engine) {
+    delete engine;
+}
+
+fastcluster_wrapper_status fastcluster_plda_transform(
+    const fastcluster_plda_engine *engine,
+    const fastcluster_matrix *embeddings,
+    double *rhoOut,
+    size_t rhoLength
+) {
+    if (engine == nullptr || embeddings == nullptr || rhoOut == nullptr ||
+        embeddings->dimension != engine->model.inputDimension ||
+        (embeddings->data == nullptr && embeddings->pointCount > 0) ||
+        (embeddings->rowStride != 0 && embeddings->rowStride < embeddings->dimension)) {
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    const size_t outputDimension = engine->model.outputDimension;
+    if (embeddings->pointCount > std::numeric_limits<size_t>::max() / outputDimension ||
+        embeddings->pointCount > std::numeric_limits<size_t>::max() / embeddings->dimension) {
+        return FASTCLUSTER_WRAPPER_INDEX_OVERFLOW;
+    }
+    if (rhoLength < embeddings->pointCount * outputDimension) {
+        return FASTCLUSTER_WRAPPER_OUTPUT_TOO_SMALL;
+    }
+    const size_t stride = embeddings->rowStride != 0 ? embeddings->rowStride : embeddings->dimension;
+    bool finite = true;
+    fastcluster_wrapper_status status = FASTCLUSTER_WRAPPER_SUCCESS;
+    switch (embeddings->scalarType) {
+    case FASTCLUSTER_SCALAR_FLOAT64:
+        status = runGuarded([&] {
+            finite = fastcluster_plda::transform_plda(engine->model, static_cast<const double *>(embeddings->data),
+                                                      embeddings->pointCount, stride, rhoOut);
+        });
+        break;
+    case FASTCLUSTER_SCALAR_FLOAT32:
+        status = runGuarded([&] {
+            finite = fastcluster_plda::transform_plda(engine->model, static_cast<const float *>(embeddings->data),
+                                                      embeddings->pointCount, stride, rhoOut);
+        });
+        break;
+    case FASTCLUSTER_SCALAR_FLOAT16:
+        status = runGuarded([&] {
+            finite = fastcluster_plda::transform_plda(
+                engine->model, static_cast<const fastcluster_kernels::float16_bits *>(embeddings->data),
+                embeddings->pointCount, stride, rhoOut);
+        });
+        break;
+    case FASTCLUSTER_SCALAR_BFLOAT16:
+        status = runGuarded([&] {
+            finite = fastcluster_plda::transform_plda(
+                engine->model, static_cast<const fastcluster_kernels::bfloat16_bits *>(embeddings->data),
+                embeddings->pointCount, stride, rhoOut);
+        });
+        break;
+    default:
+        return FASTCLUSTER_WRAPPER_INVALID_ARGUMENT;
+    }
+    if (status != FASTCLUSTER_WRAPPER_SUCCESS) {
+        return status;
+    }
+    return finite ? FASTCLUSTER_WRAPPER_SUCCESS : FASTCLUSTER_WRAPPER_RUNTIME_ERROR;
 }
@@ -47,10 +47,17 @@
 #ifdef __SOFTFP__
 #define NO_INCLUDE_FENV
 #endif
+/* A FASTCLUSTER_WIDE_INDEX build (see below) is the second copy of this file
+   in the program: it skips the notices, and under GCC, which ignores it, the
+   FENV_ACCESS pragma, so that it adds no warnings of its own. */
 #ifdef NO_INCLUDE_FENV
+#ifndef FASTCLUSTER_WIDE_INDEX
 #pragma message("Do not use fenv header.")
+#endif
 #else
+#ifndef FASTCLUSTER_WIDE_INDEX
 #pragma message("Use fenv header.")
+#endif
 /* The following #pragma is necessary even if it generates a warning in many
    compilers. Quoting https://en.cppreference.com/w/cpp/numeric/fenv:
    "The floating-point environment access and modification is only meaningful
@@ -59,8 +66,12 @@
    support the #pragma explicitly, but most compilers allow meaningful access
    to the floating-point environment anyway."
 */
+#if !(defined(FASTCLUSTER_WIDE_INDEX) && defined(__GNUC__) && !defined(__clang__))
 #pragma STDC FENV_ACCESS ON
+#endif
+#ifndef FASTCLUSTER_WIDE_INDEX
 #pragma messag("If there is a warning about unknown #pragma STDC FENV_ACCESS, this can be ignored.")
+#endif
 #include <fenv.h>
 #endif
 
@@ -70,6 +81,12 @@
 #include <algorithm> // for std::fill_n
 #include <stdexcept> // for std::runtime_error
 #include <string> // for std::string
+#include <atomic> // for std::atomic
+#include <condition_variable> // for std::condition_variable
+#include <exception> // for std::exception_ptr
+#include <mutex> // for std::mutex
+#include <thread> // for std::thread
+#include <vector> // for std::vector
 
 #include <cfloat> // also for DBL_MAX, DBL_MIN
 #ifndef DBL_MANT_DIG
@@ -137,6 +154,17 @@ typedef __int64 int64_t;
 #pragma GCC visibility push(hidden)
 #endif
 
+/*
+  FASTCLUSTER_WIDE_INDEX builds every type and algorithm below with 64-bit
+  indices, inside namespace fastcluster_wide, so that a translation unit
+  compiled with it can be linked next to the default 32-bit build without the
+  two sharing (differently laid out) symbols.
+*/
+#ifdef FASTCLUSTER_WIDE_INDEX
+namespace fastcluster_wide {
+typedef int64_t t_index;
+#define MAX_INDEX INT64_MAX
+#else
 typedef int_fast32_t t_index;
 #ifndef INT32_MAX
 #define MAX_INDEX 0x7fffffffL
@@ -146,6 +174,7 @@ typedef int_fast32_t t_index;
 #if (LONG_MAX < MAX_INDEX)
 #error The integer format "t_index" must not have a greater range than "long int".
 #endif
+#endif
 #if (INT_MAX > MAX_INDEX)
 #error The integer format "int" must not have a greater range than "t_index".
 #endif
@@ -183,36 +212,46 @@ enum method_codes_vector {
   MAX_METHOD_VECTOR_CODE       = 3
 };
 
+// Tag for auto_array_ptr constructors that borrow storage owned elsewhere.
+struct borrowed_storage {};
+
 // self-destructing array pointer
 template <typename type>
 class auto_array_ptr{
 private:
   type * ptr;
+  bool owned;
   auto_array_ptr(auto_array_ptr const &); // non construction-copyable
   auto_array_ptr& operator=(auto_array_ptr const &); // non copyable
 public:
   auto_array_ptr()
-    : ptr(NULL)
+    : ptr(NULL), owned(true)
   { }
   template <typename index>
   auto_array_ptr(index const size)
-    : ptr(new type[size])
+    : ptr(new type[size]), owned(true)
   { }
   template <typename index, typename value>
   auto_array_ptr(index const size, value const val)
-    : ptr(new type[size])
+    : ptr(new type[size]), owned(true)
   {
     FILL_N(ptr, size, val);
   }
+  // Use caller-owned storage; it is not freed on destruction.
+  auto_array_ptr(type * const storage, borrowed_storage)
+    : ptr(storage), owned(false)
+  { }
   ~auto_array_ptr() {
-    delete [] ptr; }
+    if (owned) delete [] ptr; }
   void free() {
-    delete [] ptr;
+    if (owned) delete [] ptr;
     ptr = NULL;
   }
   template <typename index>
   void init(index const size) {
+    free();
     ptr = new type [size];
+    owned = true;
   }
   template <typename index, typename value>
   void init(index const size, value const val) {
@@ -222,6 +261,43 @@ public:
   inline operator type *() const { return ptr; }
 };
 
+template <typename type>
+class reusable_array {
+  /*
+    Grow-only array that keeps its storage between clustering runs, so that
+    repeated runs of similar size stop allocating. reserve() reallocates only
+    when the requested size exceeds the capacity; the old contents are not
+    preserved. allocations() counts the reallocations.
+  */
+private:
+  type * ptr;
+  std::size_t capacity_;
+  std::size_t allocations_;
+  reusable_array(reusable_array const &); // non construction-copyable
+  reusable_array& operator=(reusable_array const &); // non copyable
+public:
+  reusable_array()
+    : ptr(NULL), capacity_(0), allocations_(0)
+  { }
+  ~reusable_array() {
+    delete [] ptr; }
+  template <typename index>
+  type * reserve(index const size) {
+    const std::size_t required = static_cast<std::size_t>(size);
+    if (required>capacity_) {
+      type * const grown = new type[required];
+      delete [] ptr;
+      ptr = grown;
+      capacity_ = required;
+      ++allocations_;
+    }
+    return ptr;
+  }
+  std::size_t capacity() const { return capacity_; }
+  std::size_t allocations() const { return allocations_; }
+  std::size_t bytes() const { return capacity_*sizeof(type); }
+};
+
 struct node {
   t_index node1, node2;
   t_float dist;
@@ -242,6 +318,12 @@ public:
     , pos(0)
   {}
 
+  // Write the merges into caller-owned storage of at least `size` nodes.
+  cluster_result(const t_index, node * const storage)
+    : Z(storage, borrowed_storage())
+    , pos(0)
+  {}
+
   void append(const t_index node1, const t_index node2, const t_float dist) {
     Z[pos].node1 = node1;
     Z[pos].node2 = node2;
@@ -321,6 +403,23 @@ public:
     , succ(size+1)
     , pred(size+1)
   {
+    init(size);
+  }
+
+  doubly_linked_list(const t_index size, t_index * const succ_storage,
+                     t_index * const pred_storage)
+    // Same, in caller-owned arrays of at least size+1 elements.
+    : start(0)
+    , succ(succ_storage, borrowed_storage())
+    , pred(pred_storage, borrowed_storage())
+  {
+    init(size);
+  }
+
+  ~doubly_linked_list() {}
+
+private:
+  void init(const t_index size) {
     for (t_index i=0; i<size; ++i) {
       pred[i+1] = i;
       succ[i] = i+1;
@@ -329,7 +428,7 @@ public:
     //succ[size] is never accessed!
   }
 
-  ~doubly_linked_list() {}
+public:
 
   void remove(const t_index idx) {
     // Remove an index from the list.
@@ -346,6 +445,11 @@ public:
   bool is_inactive(t_index idx) const {
     return (succ[idx]==0);
   }
+
+  t_index next(const t_index idx) const {
+    // Successor of the active index idx; the list size when there is none.
+    return succ[idx];
+  }
 };
 
 // Indexing functions
@@ -402,6 +506,30 @@ class nan_error{};
 class fenv_error{};
 #endif
 
+class linkage_monitor {
+  /*
+    Hook for stopping long runs. The linkage loops call check() every
+    `interval` merges with the number of merges done so far, and every
+    `interval` rows of their initial O(N²) pass with 0. check() aborts the run
+    by throwing. During a threaded initialization it may be called from
+    several threads at once.
+  */
+public:
+  static const t_index interval = 256;
+  virtual void check(const t_index merges_done) = 0;
+
+protected:
+  ~linkage_monitor() {}
+};
+
+static inline void monitor_step(linkage_monitor * const monitor,
+                                const t_index step, const t_index merges_done) {
+  if (monitor && (step & (linkage_monitor::interval-1))==0)
+    monitor->check(merges_done);
+}
+
+#ifndef FASTCLUSTER_WIDE_INDEX
+// The 64-bit build only clusters vector data and never calls this.
 static void MST_linkage_core(const t_index N, const t_float * const D,
                              cluster_result & Z2) {
 /*
@@ -488,6 +616,7 @@ static void MST_linkage_core(const t_index N, const t_float * const D,
     Z2.append(prev_node, idx2, min);
   }
 }
+#endif // FASTCLUSTER_WIDE_INDEX
 
 /* Functions for the update of the dissimilarity array */
 
@@ -571,11 +700,13 @@ inline static void f_median( t_float * const b, const t_float a, const t_float c
 }
 
 template <method_codes method, typename t_members>
-static void NN_chain_core(const t_index N, t_float * const D, t_members * const members, cluster_result & Z2) {
+static void NN_chain_core(const t_index N, t_float * const D, t_members * const members, cluster_result & Z2,
+                          linkage_monitor * const monitor = NULL) {
 /*
     N: integer
     D: condensed distance matrix N*(N-1)/2
     Z2: output data structure
+    monitor: optional, checked every linkage_monitor::interval merges
 
     This is the NN-chain algorithm, described on page 86 in the following book:
 
@@ -613,6 +744,7 @@ static void NN_chain_core(const t_index N, t_float * const D, t_members * const
   #endif
 
   for (t_index j=0; j<N-1; ++j) {
+    monitor_step(monitor, j, j);
     if (NN_chain_tip <= 3) {
       NN_chain[0] = idx1 = active_nodes.start;
       NN_chain_tip = 1;
@@ -829,6 +961,18 @@ public:
     }
   }
 
+  binary_min_heap(t_float * const A_, const t_index size1, const t_index start,
+                  t_index * const I_storage, t_index * const R_storage)
+    : A(A_), size(size1), I(I_storage, borrowed_storage()),
+      R(R_storage, borrowed_storage())
+  { // As above, with I and R in caller-owned arrays of at least size1 and
+    // start+size1 elements.
+    for (t_index i=0; i<size; ++i) {
+      R[i+start] = i;
+      I[i] = i + start;
+    }
+  }
+
   ~binary_min_heap() {}
 
   void heapify() {
@@ -1350,14 +1494,510 @@ static void generic_linkage(const t_index N, t_float * const D, t_members * cons
   Clustering methods for vector data
 */
 
+struct heap_entry {
+  // Key and index of one d_ary_min_heap node, stored together so that
+  // comparing siblings reads one contiguous block.
+  t_float key;
+  t_index index;
+};
+
+struct vector_linkage_workspace {
+  /* Working arrays of generic_linkage_vector_alternative, kept between runs
+     so that a sequence of clusterings of similar size allocates only once.
+     Only the arrays of the selected active set and heap are reserved. */
+  reusable_array<t_index> n_nghbr;
+  reusable_array<t_float> mindist;
+  reusable_array<t_index> list_succ;
+  reusable_array<t_index> list_pred;
+  reusable_array<t_index> heap_I;
+  reusable_array<t_index> heap_R;
+  reusable_array<uint64_t> active_bits;
+  reusable_array<heap_entry> heap_entries;
+  reusable_array<t_index> scan_nodes;
+
+  void reserve(const t_index N) {
+    n_nghbr.reserve(2*N-2);
+    mindist.reserve(2*N-2);
+    list_succ.reserve(2*N);
+    list_pred.reserve(2*N);
+    heap_I.reserve(N-1);
+    heap_R.reserve(2*N-2);
+  }
+
+  std::size_t allocations() const {
+    return n_nghbr.allocations() + mindist.allocations() + list_succ.allocations()
+      + list_pred.allocations() + heap_I.allocations() + heap_R.allocations()
+      + active_bits.allocations() + heap_entries.allocations()
+      + scan_nodes.allocations();
+  }
+
+  std::size_t bytes() const {
+    return n_nghbr.bytes() + mindist.bytes() + list_succ.bytes()
+      + list_pred.bytes() + heap_I.bytes() + heap_R.bytes()
+      + active_bits.bytes() + heap_entries.bytes() + scan_nodes.bytes();
+  }
+};
+
+/*
+  Active-set and heap types for generic_linkage_vector_alternative. Each one
+  takes its arrays from the workspace. Active sets offer the interface of
+  doubly_linked_list (start, next, remove, is_inactive), heaps that of
+  binary_min_heap (heapify, argmin, remove, replace, update_leq, update_geq)
+  and also take the number of indices they may hold. The defaults are the
+  original doubly_linked_list and binary_min_heap.
+*/
+
+struct linked_list_active_set : doubly_linked_list {
+  linked_list_active_set(const t_index size, vector_linkage_workspace & workspace)
+    : doubly_linked_list(size, workspace.list_succ.reserve(size+1),
+                         workspace.list_pred.reserve(size+1))
+  {}
+};
+
+struct binary_heap_index : binary_min_heap {
+  binary_heap_index(t_float * const A_, const t_index size1, const t_index start,
+                    const t_index index_count, vector_linkage_workspace & workspace)
+    : binary_min_heap(A_, size1, start, workspace.heap_I.reserve(size1),
+                      workspace.heap_R.reserve(index_count))
+  {}
+};
+
+static inline t_index lowest_set_bit(const uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<t_index>(__builtin_ctzll(word));
+#else
+  t_index bit = 0;
+  while (!((word >> bit) & 1)) ++bit;
+  return bit;
+#endif
+}
+
+class bitmap_active_set {
+  /*
+    The integer range [0, size) as a bitmap, one bit per index: 1/64 of the
+    memory of doubly_linked_list, so the whole set stays in L1/L2 for the
+    sizes this library sees. next() finds the following set bit with a
+    count-trailing-zeros instruction, and skips runs of empty words four at a
+    time with one OR, which compilers turn into a single vector test. Iteration
+    order is ascending, exactly as with doubly_linked_list.
+  */
+public:
+  t_index start;
+
+private:
+  const t_index size;
+  const t_index word_count;
+  uint64_t * const words;
+
+  bitmap_active_set(bitmap_active_set const &);
+  bitmap_active_set & operator=(bitmap_active_set const &);
+
+public:
+  bitmap_active_set(const t_index size_, vector_linkage_workspace & workspace)
+    : start(0), size(size_), word_count((size_+63)>>6),
+      words(workspace.active_bits.reserve(((size_+63)>>6)+4))
+  {
+    FILL_N(words, word_count, ~static_cast<uint64_t>(0));
+    // Tail bits past size and four guard words stay clear.
+    if (size & 63)
+      words[word_count-1] = (static_cast<uint64_t>(1) << (size & 63)) - 1;
+    FILL_N(words+word_count, 4, static_cast<uint64_t>(0));
+  }
+
+  t_index next(const t_index idx) const {
+    // Smallest active index > idx, or size when there is none.
+    const t_index from = idx+1;
+    if (from>=size) return size;
+    t_index w = from >> 6;
+    uint64_t bits = words[w] & (~static_cast<uint64_t>(0) << (from & 63));
+    while (!bits) {
+      ++w;
+      while (w<word_count && !(words[w] | words[w+1] | words[w+2] | words[w+3]))
+        w += 4;
+      if (w>=word_count) return size;
+      bits = words[w];
+    }
+    return (w << 6) + lowest_set_bit(bits);
+  }
+
+  void remove(const t_index idx) {
+    words[idx >> 6] &= ~(static_cast<uint64_t>(1) << (idx & 63));
+    if (idx==start) start = next(idx);
+  }
+
+  bool is_inactive(const t_index idx) const {
+    return !((words[idx >> 6] >> (idx & 63)) & 1);
+  }
+};
+
+template <t_index arity>
+class d_ary_min_heap {
+  /*
+    Indexed min-heap over A[start, start+size) with `arity` children per
+    node, the drop-in counterpart of binary_min_heap. Keys are kept next to
+    their indices in the heap array (and mirrored in A, which the caller
+    reads), and the array is aligned so that the children of a node share
+    one or two cache lines. A sift then touches log_arity(size) lines instead
+    of log_2(size) scattered entries of A.
+
+    Among equal keys the minimum may be a different index than in
+    binary_min_heap.
+  */
+private:
+  t_float * const A;
+  t_index size;
+  heap_entry * H;
+  t_index * const R;
+
+  d_ary_min_heap(d_ary_min_heap const &);
+  d_ary_min_heap & operator=(d_ary_min_heap const &);
+
+public:
+  d_ary_min_heap(t_float * const A_, const t_index size1, const t_index start,
+                 const t_index index_count, vector_linkage_workspace & workspace)
+    : A(A_), size(size1), H(NULL), R(workspace.heap_R.reserve(index_count))
+  {
+    // Children of node i are 1 + arity*i, ..., arity*(i+1). Entry 1 starts
+    // on a 64-byte boundary, so every sibling group does too.
+    heap_entry * const storage = workspace.heap_entries.reserve(size1+arity+4);
+    const std::size_t misalignment =
+      reinterpret_cast<std::size_t>(storage+1) % 64 / sizeof(heap_entry);
+    H = storage + (misalignment ? 64/sizeof(heap_entry) - misalignment : 0);
+    for (t_index i=0; i<size; ++i) {
+      H[i].index = i+start;
+      R[i+start] = i;
+    }
+  }
+
+  void heapify() {
+    // The caller fills A after construction, so the keys are read here.
+    for (t_index i=0; i<size; ++i)
+      H[i].key = A[H[i].index];
+    if (size<2) return;
+    for (t_index i=(size-2)/arity+1; i>0; ) {
+      --i;
+      sift_down(i, H[i]);
+    }
+  }
+
+  inline t_index argmin() const {
+    return H[0].index;
+  }
+
+  void heap_pop() {
+    --size;
+    if (size) sift_down(0, H[size]);
+  }
+
+  void remove(const t_index idx) {
+    --size;
+    const t_index position = R[idx];
+    if (position==size) return;
+    const heap_entry last = H[size];
+    if (last.key<=H[position].key)
+      sift_up(position, last);
+    else
+      sift_down(position, last);
+  }
+
+  void replace(const t_index idxold, const t_index idxnew, const t_float val) {
+    const t_index position = R[idxold];
+    const t_float old = H[position].key;
+    A[idxnew] = val;
+    heap_entry entry;
+    entry.key = val;
+    entry.index = idxnew;
+    if (val<=old)
+      sift_up(position, entry);
+    else
+      sift_down(position, entry);
+  }
+
+  void update(const t_index idx, const t_float val) {
+    if (val<=A[idx])
+      update_leq(idx, val);
+    else
+      update_geq(idx, val);
+  }
+
+  void update_leq(const t_index idx, const t_float val) {
+    A[idx] = val;
+    heap_entry entry;
+    entry.key = val;
+    entry.index = idx;
+    sift_up(R[idx], entry);
+  }
+
+  void update_geq(const t_index idx, const t_float val) {
+    A[idx] = val;
+    heap_entry entry;
+    entry.key = val;
+    entry.index = idx;
+    sift_down(R[idx], entry);
+  }
+
+private:
+  // Both sifts move a hole instead of swapping, and place `entry` last.
+  void sift_up(t_index i, const heap_entry entry) {
+    while (i>0) {
+      const t_index parent = (i-1)/arity;
+      if (!(entry.key<H[parent].key)) break;
+      H[i] = H[parent];
+      R[H[i].index] = i;
+      i = parent;
+    }
+    H[i] = entry;
+    R[entry.index] = i;
+  }
+
+  void sift_down(t_index i, const heap_entry entry) {
+    for (;;) {
+      const t_index first = arity*i+1;
+      if (first>=size) break;
+      const t_index last = std::min<t_index>(first+arity, size);
+      t_index child = first;
+      for (t_index c=first+1; c<last; ++c)
+        if (H[c].key<H[child].key) child = c;
+      if (!(H[child].key<entry.key)) break;
+      H[i] = H[child];
+      R[H[i].index] = i;
+      i = child;
+    }
+    H[i] = entry;
+    R[entry.index] = i;
+  }
+};
+
+struct vector_linkage_options {
+  /* Number of threads for the nearest-neighbor initialization of
+     generic_linkage_vector_alternative, and for its per-merge scans (see
+     scan_min_nodes). 1 keeps everything on the calling thread. */
+  t_index threads;
+  /* Reusable working arrays, or NULL to allocate them for this run only. */
+  vector_linkage_workspace * workspace;
+  /* Checked every linkage_monitor::interval rows and merges, or NULL. */
+  linkage_monitor * monitor;
+  /* Candidates from which a nearest-neighbor scan of the merge loop is split
+     over the threads. The default never splits. */
+  t_index scan_min_nodes;
+
+  vector_linkage_options()
+    : threads(1), workspace(NULL), monitor(NULL),
+      scan_min_nodes(std::numeric_limits<t_index>::max())
+  {}
+};
+
+template <typename t_body>
+static void parallel_triangular_rows(const t_index first, const t_index last,
+                                     const t_index threads, t_body & body) {
+  /*
+    Run body(i) for every row i in [first, last), where the cost of row i is
+    proportional to i (a triangular workload). The rows are cut into chunks of
+    equal total cost, several per thread, and the threads claim chunks from a
+    shared counter so that uneven progress is balanced dynamically.
+
+    body(i) must only write state that belongs to row i. Every row is computed
+    by exactly the same code as in a serial loop, so the results do not depend
+    on the number of threads. The first exception thrown by any row is
+    rethrown on the calling thread.
+  */
+  if (threads<=1 || last-first<2) {
+    for (t_index i=first; i<last; ++i)
+      body(i);
+    return;
+  }
+
+  const t_index chunk_count = std::min<t_index>(threads*8, last-first);
+  std::vector<t_index> bounds(static_cast<std::size_t>(chunk_count)+1);
+  const double lo = static_cast<double>(first);
+  const double hi = static_cast<double>(last);
+  bounds[0] = first;
+  for (t_index c=1; c<chunk_count; ++c) {
+    // Row r splits the work at fraction (r² - first²)/(last² - first²).
+    const double fraction = static_cast<double>(c)/static_cast<double>(chunk_count);
+    t_index bound = static_cast<t_index>(std::sqrt(lo*lo + fraction*(hi*hi-lo*lo)));
+    bounds[c] = std::max(bound, bounds[c-1]);
+  }
+  bounds[chunk_count] = last;
+
+  std::atomic<t_index> next_chunk(0);
+  std::atomic<bool> failed(false);
+  std::exception_ptr error;
+  std::atomic_flag error_taken = ATOMIC_FLAG_INIT;
+
+  auto worker = [&]() {
+    try {
+      for (t_index c=next_chunk++; c<chunk_count && !failed.load(std::memory_order_relaxed);
+           c=next_chunk++) {
+        for (t_index i=bounds[c]; i<bounds[c+1]; ++i)
+          body(i);
+      }
+    }
+    catch (...) {
+      if (!error_taken.test_and_set()) {
+        error = std::current_exception();
+      }
+      failed.store(true);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(static_cast<std::size_t>(threads-1));
+  try {
+    for (t_index t=1; t<threads; ++t)
+      pool.emplace_back(worker);
+  }
+  catch (...) {
+    // Could not start all threads: the ones that did start and the calling
+    // thread still drain the chunk counter.
+  }
+  worker();
+  for (std::size_t t=0; t<pool.size(); ++t)
+    pool[t].join();
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+class merge_scan_pool {
+  /*
+    Worker threads that live for one run of generic_linkage_vector_alternative
+    and execute the tasks of run() together with the calling thread. Starting
+    threads for every merge would cost more than most scans; idle workers
+    instead spin briefly for the next scan and then sleep.
+
+    A task is claimed by a compare-and-swap on a single word that holds the
+    generation of the current run() call and the next task number, so a late
+    worker can never claim a task of a later call with the body of an earlier
+    one.
+  */
+public:
+  explicit merge_scan_pool(const t_index threads)
+    : claim(0), pending(0), body(NULL), context(NULL), task_count(0),
+      generation(0), stopping(false)
+  {
+    workers.reserve(static_cast<std::size_t>(threads-1));
+    try {
+      for (t_index t=1; t<threads; ++t)
+        workers.emplace_back(&merge_scan_pool::work, this);
+    }
+    catch (...) {
+      // Fewer workers: the calling thread still takes every unclaimed task.
+    }
+  }
+
+  ~merge_scan_pool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+    for (std::size_t t=0; t<workers.size(); ++t)
+      workers[t].join();
+  }
+
+  t_index size() const { return static_cast<t_index>(workers.size())+1; }
+
+  /* Runs task(i) for i in [0, tasks) and returns when all are done. The first
+     exception of any task is rethrown here. */
+  template <typename t_task>
+  void run(const t_index tasks, t_task & task) {
+    body = &call<t_task>;
+    context = &task;
+    task_count.store(tasks, std::memory_order_relaxed);
+    error = std::exception_ptr();
+    pending.store(tasks, std::memory_order_relaxed);
+    const uint64_t current = static_cast<uint64_t>(++generation) << 32;
+    claim.store(current, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+    }
+    wake.notify_all();
+    execute(current);
+    while (pending.load(std::memory_order_acquire)!=0)
+      std::this_thread::yield();
+    if (error) {
+      std::rethrow_exception(error);
+    }
+  }
+
+private:
+  static constexpr int spin_rounds = 4096;
+  static constexpr uint64_t task_mask = 0xffffffffu;
+  static constexpr uint64_t generation_mask = ~task_mask;
+
+  template <typename t_task>
+  static void call(void * const task, const t_index i) {
+    (*static_cast<t_task *>(task))(i);
+  }
+
+  // Claims and runs tasks of the run() call of generation `current`.
+  void execute(const uint64_t current) {
+    uint64_t seen = claim.load(std::memory_order_acquire);
+    while ((seen & generation_mask)==current
+           && static_cast<t_index>(seen & task_mask)<task_count.load(std::memory_order_relaxed)) {
+      if (!claim.compare_exchange_weak(seen, seen+1, std::memory_order_acquire))
+        continue;
+      try {
+        body(context, static_cast<t_index>(seen & task_mask));
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+      }
+      pending.fetch_sub(1, std::memory_order_release);
+      seen = claim.load(std::memory_order_acquire);
+    }
+  }
+
+  void work() {
+    uint64_t done = 0;
+    for (;;) {
+      uint64_t current = claim.load(std::memory_order_acquire) & generation_mask;
+      for (int round=0; current==done && round<spin_rounds; ++round) {
+        std::this_thread::yield();
+        current = claim.load(std::memory_order_acquire) & generation_mask;
+      }
+      if (current==done) {
+        std::unique_lock<std::mutex> lock(mutex);
+        wake.wait(lock, [&] {
+          return stopping
+            || (claim.load(std::memory_order_acquire) & generation_mask)!=done;
+        });
+        if (stopping)
+          return;
+        continue;
+      }
+      execute(current);
+      done = current;
+    }
+  }
+
+  std::atomic<uint64_t> claim;
+  std::atomic<t_index> pending;
+  void (*body)(void *, t_index);
+  void * context;
+  std::atomic<t_index> task_count;
+  uint64_t generation;
+  bool stopping;
+  std::exception_ptr error;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::vector<std::thread> workers;
+};
+
 template <typename t_dissimilarity>
 static void MST_linkage_core_vector(const t_index N,
                                     t_dissimilarity & dist,
-                                    cluster_result & Z2) {
+                                    cluster_result & Z2,
+                                    linkage_monitor * const monitor = NULL) {
 /*
     N: integer, number of data points
     dist: function pointer to the metric
     Z2: output data structure
+    monitor: optional, checked every linkage_monitor::interval merges
 
     The basis of this algorithm is an algorithm by Rohlf:
 
@@ -1395,6 +2035,7 @@ static void MST_linkage_core_vector(const t_index N,
   Z2.append(0, idx2, min);
 
   for (t_index j=1; j<N-1; ++j) {
+    monitor_step(monitor, j, j);
     prev_node = idx2;
     active_nodes.remove(prev_node);
 
@@ -1622,60 +2263,143 @@ static void generic_linkage_vector(const t_index N,
   }
 }
 
-template <method_codes_vector method, typename t_dissimilarity>
+template <method_codes_vector method, typename t_dissimilarity,
+          typename t_active_set = linked_list_active_set,
+          typename t_heap = binary_heap_index>
 static void generic_linkage_vector_alternative(const t_index N,
                                                t_dissimilarity & dist,
-                                               cluster_result & Z2) {
+                                               cluster_result & Z2,
+                                               const vector_linkage_options &
+                                               options = vector_linkage_options()) {
   /*
     N: integer, number of data points
     dist: function pointer to the metric
     Z2: output data structure
+    options: threading, workspace and monitor (see vector_linkage_options)
+    t_active_set, t_heap: data structures for the active nodes and the
+      nearest-neighbour distances (see heap_entry and below)
 
     This algorithm is valid for the distance update methods
     "Ward", "centroid" and "median" only!
   */
   const t_index N_1 = N-1;
-  t_index i, j=0; // loop variables
+  t_index i; // loop variable
   t_index idx1, idx2; // row and column indices
 
-  auto_array_ptr<t_index> n_nghbr(2*N-2); // array of nearest neighbors
-  auto_array_ptr<t_float> mindist(2*N-2); // distances to the nearest neighbors
+  vector_linkage_workspace local_workspace;
+  vector_linkage_workspace & workspace =
+    options.workspace ? *options.workspace : local_workspace;
 
-  doubly_linked_list active_nodes(N+N_1);
-  binary_min_heap nn_distances(&*mindist, N_1, 2*N-2, 1); // minimum heap
-      // structure for the distance to the nearest neighbor of each point
+  t_index * const n_nghbr = workspace.n_nghbr.reserve(2*N-2); // array of
+      // nearest neighbors
+  t_float * const mindist = workspace.mindist.reserve(2*N-2); // distances to
+      // the nearest neighbors
+
+  t_active_set active_nodes(N+N_1, workspace);
+  t_heap nn_distances(mindist, N_1, 1, 2*N-2, workspace); // minimum heap
+      // structure for the distance to the nearest neighbor of each point; new
+      // nodes up to 2N-3 take over heap slots
 
   t_float min; // minimum for nearest-neighbor searches
 
+  // Nearest-neighbor searches in the main loop scan every active node, O(N·D)
+  // per merge. With many candidates, the candidates are listed in ascending
+  // order, cut into chunks for the threads of scan_pool, and the chunk minima
+  // are combined in ascending order with a strict comparison. That keeps the
+  // first minimum, exactly as the serial scan, for every thread count.
+  struct alignas(64) scan_minimum {
+    t_float min;
+    t_index index;
+  };
+  const bool parallel_scans = options.threads>1 && options.scan_min_nodes<N;
+  merge_scan_pool scan_pool(parallel_scans ? options.threads : 1);
+  t_index * const scan_nodes = parallel_scans ? workspace.scan_nodes.reserve(N) : NULL;
+  std::vector<scan_minimum> chunk_minima(parallel_scans ? 4*static_cast<std::size_t>(scan_pool.size()) : 0);
+  t_index active_count = N; // active nodes below the next new node
+
+  // Returns the active node j<limit with the smallest distance(j), the first
+  // one on ties, and stores that distance in min.
+  auto nearest_below = [&](const t_index limit, const auto & distance) -> t_index {
+    t_index nearest = active_nodes.start;
+    t_index count = 0;
+    if (parallel_scans && active_count>=options.scan_min_nodes) {
+      for (t_index k=active_nodes.start; k<limit; k=active_nodes.next(k))
+        scan_nodes[count++] = k;
+    }
+    if (!parallel_scans || count<options.scan_min_nodes) {
+      min = distance(nearest);
+      for (t_index k=active_nodes.next(nearest); k<limit; k=active_nodes.next(k)) {
+        t_float const tmp = distance(k);
+        if (tmp<min) {
+          min = tmp;
+          nearest = k;
+        }
+      }
+      return nearest;
+    }
+
+    const t_index chunks = std::min(static_cast<t_index>(chunk_minima.size()), count);
+    auto scan_chunk = [&](const t_index c) {
+      const t_index first = count*c/chunks;
+      const t_index last = count*(c+1)/chunks;
+      t_index best = scan_nodes[first];
+      t_float best_min = distance(best);
+      for (t_index k=first+1; k<last; ++k) {
+        t_float const tmp = distance(scan_nodes[k]);
+        if (tmp<best_min) {
+          best_min = tmp;
+          best = scan_nodes[k];
+        }
+      }
+      chunk_minima[static_cast<std::size_t>(c)].min = best_min;
+      chunk_minima[static_cast<std::size_t>(c)].index = best;
+    };
+    scan_pool.run(chunks, scan_chunk);
+    min = chunk_minima[0].min;
+    nearest = chunk_minima[0].index;
+    for (t_index c=1; c<chunks; ++c) {
+      if (chunk_minima[static_cast<std::size_t>(c)].min<min) {
+        min = chunk_minima[static_cast<std::size_t>(c)].min;
+        nearest = chunk_minima[static_cast<std::size_t>(c)].index;
+      }
+    }
+    return nearest;
+  };
+
   // Initialize the minimal distances:
   // Find the nearest neighbor of each point.
-  // n_nghbr[i] = argmin_{j>i} D(i,j) for i in range(N-1)
-  for (i=1; i<N; ++i) {
-    min = std::numeric_limits<t_float>::infinity();
-    t_index idx;
-    for (idx=j=0; j<i; ++j) {
+  // n_nghbr[i] = argmin_{j<i} D(i,j) for i in range(1,N)
+  // Rows are independent, so they may be distributed over several threads.
+  // Each row is scanned in ascending j with a strict comparison, so ties
+  // resolve to the smallest j regardless of the thread count.
+  auto initialize_row = [&](const t_index row) {
+    monitor_step(options.monitor, row, 0);
+    t_float row_min = std::numeric_limits<t_float>::infinity();
+    t_index idx = 0;
+    for (t_index col=0; col<row; ++col) {
       t_float tmp;
       switch (method) {
       case METHOD_VECTOR_WARD:
-        tmp = dist.ward_initial(i,j);
+        tmp = dist.ward_initial(row,col);
         break;
       default:
-        tmp = dist.template sqeuclidean<true>(i,j);
+        tmp = dist.template sqeuclidean<true>(row,col);
       }
-      if (tmp<min) {
-        min = tmp;
-        idx = j;
+      if (tmp<row_min) {
+        row_min = tmp;
+        idx = col;
       }
     }
     switch (method) {
     case METHOD_VECTOR_WARD:
-      mindist[i] = t_dissimilarity::ward_initial_conversion(min);
+      mindist[row] = t_dissimilarity::ward_initial_conversion(row_min);
       break;
     default:
-      mindist[i] = min;
+      mindist[row] = row_min;
     }
-    n_nghbr[i] = idx;
-  }
+    n_nghbr[row] = idx;
+  };
+  parallel_triangular_rows(1, N, options.threads, initialize_row);
 
   // Put the minimal distances into a heap structure to make the repeated
   // global minimum searches fast.
@@ -1683,6 +2407,7 @@ static void generic_linkage_vector_alternative(const t_index N,
 
   // Main loop: We have N-1 merging steps.
   for (i=N; i<N+N_1; ++i) {
+    monitor_step(options.monitor, i-N, i-N);
     /*
       The bookkeeping is different from the "stored matrix approach" algorithm
       generic_linkage.
@@ -1705,27 +2430,16 @@ static void generic_linkage_vector_alternative(const t_index N,
     idx1 = nn_distances.argmin();
     while ( active_nodes.is_inactive(n_nghbr[idx1]) ) {
       // Recompute the minimum mindist[idx1] and n_nghbr[idx1].
-      n_nghbr[idx1] = j = active_nodes.start;
       switch (method) {
       case METHOD_VECTOR_WARD:
-        min = dist.ward_extended(idx1,j);
-        for (j=active_nodes.succ[j]; j<idx1; j=active_nodes.succ[j]) {
-          t_float tmp = dist.ward_extended(idx1,j);
-          if (tmp<min) {
-            min = tmp;
-            n_nghbr[idx1] = j;
-          }
-        }
+        n_nghbr[idx1] = nearest_below(idx1, [&](const t_index k) {
+          return dist.ward_extended(idx1,k);
+        });
         break;
       default:
-        min = dist.sqeuclidean_extended(idx1,j);
-        for (j=active_nodes.succ[j]; j<idx1; j=active_nodes.succ[j]) {
-          t_float const tmp = dist.sqeuclidean_extended(idx1,j);
-          if (tmp<min) {
-            min = tmp;
-            n_nghbr[idx1] = j;
-          }
-        }
+        n_nghbr[idx1] = nearest_below(idx1, [&](const t_index k) {
+          return dist.sqeuclidean_extended(idx1,k);
+        });
       }
       /* Update the heap with the new true minimum and search for the (possibly
          different) minimal entry. */
@@ -1754,7 +2468,7 @@ static void generic_linkage_vector_alternative(const t_index N,
         throw std::runtime_error(std::string("Invalid method."));
       }
 
-      n_nghbr[i] = active_nodes.start;
+      --active_count;
       if (method==METHOD_VECTOR_WARD) {
         /*
           Ward linkage.
@@ -1762,15 +2476,9 @@ static void generic_linkage_vector_alternative(const t_index N,
           Shorter and longer distances can occur, not smaller than min(d1,d2)
           but maybe bigger than max(d1,d2).
         */
-        min = dist.ward_extended(active_nodes.start, i);
-        for (j=active_nodes.succ[active_nodes.start]; j<i;
-             j=active_nodes.succ[j]) {
-          t_float tmp = dist.ward_extended(j, i);
-          if (tmp < min) {
-            min = tmp;
-            n_nghbr[i] = j;
-          }
-        }
+        n_nghbr[i] = nearest_below(i, [&](const t_index k) {
+          return dist.ward_extended(k, i);
+        });
       }
       else {
         /*
@@ -1779,15 +2487,9 @@ static void generic_linkage_vector_alternative(const t_index N,
           Shorter and longer distances can occur, not bigger than max(d1,d2)
           but maybe smaller than min(d1,d2).
         */
-        min = dist.sqeuclidean_extended(active_nodes.start, i);
-        for (j=active_nodes.succ[active_nodes.start]; j<i;
-             j=active_nodes.succ[j]) {
-          t_float tmp = dist.sqeuclidean_extended(j, i);
-          if (tmp < min) {
-            min = tmp;
-            n_nghbr[i] = j;
-          }
-        }
+        n_nghbr[i] = nearest_below(i, [&](const t_index k) {
+          return dist.sqeuclidean_extended(k, i);
+        });
       }
       if (idx2<active_nodes.start)  {
         nn_distances.remove(active_nodes.start);
@@ -1799,6 +2501,10 @@ static void generic_linkage_vector_alternative(const t_index N,
   }
 }
 
+#ifdef FASTCLUSTER_WIDE_INDEX
+} // namespace fastcluster_wide
+#endif
+
 #if HAVE_VISIBILITY
 #pragma GCC visibility pop
 #endif
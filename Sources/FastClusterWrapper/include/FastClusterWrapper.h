@@ -2,6 +2,7 @@
 #define FASTCLUSTER_WRAPPER_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -15,9 +16,224 @@ typedef enum {
     FASTCLUSTER_WRAPPER_OUTPUT_TOO_SMALL = 3,
     FASTCLUSTER_WRAPPER_ALLOCATION_FAILURE = 4,
     FASTCLUSTER_WRAPPER_RUNTIME_ERROR = 5,
+    /// The progress callback of `fastcluster_run_control` asked to stop.
+    FASTCLUSTER_WRAPPER_CANCELLED = 6,
+    /// `fastcluster_run_control.timeBudgetSeconds` ran out.
+    FASTCLUSTER_WRAPPER_TIME_BUDGET_EXCEEDED = 7,
     FASTCLUSTER_WRAPPER_UNKNOWN_ERROR = 255
 } fastcluster_wrapper_status;
 
+// Linkage methods accepted by `fastcluster_compute_linkage` (SciPy names).
+typedef enum {
+    FASTCLUSTER_METHOD_SINGLE = 0,
+    FASTCLUSTER_METHOD_COMPLETE = 1,
+    FASTCLUSTER_METHOD_AVERAGE = 2,
+    FASTCLUSTER_METHOD_WEIGHTED = 3,
+    FASTCLUSTER_METHOD_WARD = 4,
+    FASTCLUSTER_METHOD_CENTROID = 5,
+    FASTCLUSTER_METHOD_MEDIAN = 6
+} fastcluster_method;
+
+// Dissimilarity between input rows.
+typedef enum {
+    FASTCLUSTER_METRIC_EUCLIDEAN = 0,
+    FASTCLUSTER_METRIC_SQEUCLIDEAN = 1,
+    /// Euclidean distance between the L2-normalized rows, sqrt(2 - 2 * cos(a, b)).
+    /// Rows are normalized on the fly; all-zero rows stay at the origin.
+    FASTCLUSTER_METRIC_COSINE = 2
+} fastcluster_metric;
+
+// Element type of a `fastcluster_matrix`.
+typedef enum {
+    FASTCLUSTER_SCALAR_FLOAT64 = 0,
+    FASTCLUSTER_SCALAR_FLOAT32 = 1,
+    /// IEEE 754 binary16 bit patterns (uint16_t). Distances accumulate in
+    /// float and merged centroids are float, so only the input rows are
+    /// rounded: half the memory of float32, a quarter of float64. Supported by
+    /// `fastcluster_compute_linkage_matrix`, the batch API,
+    /// `fastcluster_compute_distance_matrix` and `fastcluster_incremental_append`;
+    /// the approximate clustering rejects it. The blocked distance algorithm
+    /// falls back to pairwise.
+    FASTCLUSTER_SCALAR_FLOAT16 = 2,
+    /// bfloat16 bit patterns (the high half of a float32), handled like
+    /// FASTCLUSTER_SCALAR_FLOAT16: float range, 8 significant bits.
+    FASTCLUSTER_SCALAR_BFLOAT16 = 3
+} fastcluster_scalar_type;
+
+/// Row-major input matrix read in place by `fastcluster_compute_linkage_matrix`.
+typedef struct {
+    /// `pointCount` rows of `scalarType` elements.
+    const void *data;
+    fastcluster_scalar_type scalarType;
+    size_t pointCount;
+    size_t dimension;
+    /// Distance in elements between the starts of consecutive rows. 0 means
+    /// `dimension` (densely packed); otherwise it must be >= `dimension`.
+    size_t rowStride;
+} fastcluster_matrix;
+
+// How the stored-matrix methods (complete, average, weighted, ward) build their
+// condensed distance matrix.
+typedef enum {
+    /// One difference loop per pair: exact, SciPy-identical distances.
+    FASTCLUSTER_DISTANCES_PAIRWISE = 0,
+    /// Cache-blocked |x|^2 + |y|^2 - 2 x.y on mean-centred rows. About twice as
+    /// fast, with an absolute error of about 2^-52 * (|x - mean|^2 +
+    /// |y - mean|^2) per squared distance (negative results are clamped to 0).
+    /// Merge order can differ from the pairwise path only for near-ties.
+    FASTCLUSTER_DISTANCES_BLOCKED = 1
+} fastcluster_distance_algorithm;
+
+// Set of active clusters in the centroid and median merge loop.
+typedef enum {
+    /// Doubly linked list of indices, as in upstream fastcluster.
+    FASTCLUSTER_ACTIVE_SET_LINKED_LIST = 0,
+    /// One bit per index, scanned a word at a time: 1/64 of the memory of the
+    /// list. Produces the same dendrogram.
+    FASTCLUSTER_ACTIVE_SET_BITMAP = 1
+} fastcluster_active_set;
+
+// Index width of single, centroid and median linkage.
+typedef enum {
+    /// 32-bit indices when every merged node id fits (up to 2^30 - 1 points),
+    /// 64-bit indices beyond.
+    FASTCLUSTER_INDEX_AUTO = 0,
+    /// 64-bit indices for every run, e.g. to test or time the large-run build.
+    FASTCLUSTER_INDEX_64 = 1
+} fastcluster_index_width;
+
+/// Buffers reused across linkage calls; see `fastcluster_workspace_create`.
+typedef struct fastcluster_workspace fastcluster_workspace;
+
+/// Progress callback of `fastcluster_run_control`. Return non-zero to cancel.
+typedef int (*fastcluster_progress_callback)(void *context, size_t completedMerges, size_t totalMerges);
+
+/// Progress reporting, cooperative cancellation and a wall-clock budget for a
+/// long linkage call, passed through `fastcluster_linkage_options.control`.
+///
+/// A run checks its control every 256 merges, and every 256 rows of the
+/// distance or nearest-neighbour pass that precedes the first merge (reported
+/// as 0 completed merges). Each check reads the clock once and calls the
+/// callback once, which is negligible next to 256 merges. A run that is
+/// stopped returns `FASTCLUSTER_WRAPPER_CANCELLED` or
+/// `FASTCLUSTER_WRAPPER_TIME_BUDGET_EXCEEDED`, and its output is unspecified.
+typedef struct {
+    /// Called at every check with the merges done so far and `pointCount - 1`,
+    /// and once more with both equal when the dendrogram is complete (the
+    /// return value of that last call is ignored). May be NULL. Calls come from
+    /// the calling thread or a worker thread, but never two at a time.
+    fastcluster_progress_callback callback;
+    /// Passed to `callback` unchanged.
+    void *context;
+    /// Seconds the call may run, measured from its start. 0 or less means no
+    /// limit. For a batch, the budget covers the whole batch.
+    double timeBudgetSeconds;
+} fastcluster_run_control;
+
+/// Tuning knobs for the `*_with_options` entry points. Always initialize with
+/// `fastcluster_linkage_options_init` so that fields added later get defaults.
+typedef struct {
+    /// Threads for the O(N^2 * D) nearest-neighbour initialization and, for
+    /// centroid and median linkage, the long nearest-neighbour scans of the
+    /// merge loop. 0 uses every hardware thread, 1 (the default) stays on the
+    /// calling thread. Results are identical for every thread count; small
+    /// inputs always run serially.
+    size_t threadCount;
+    /// Non-zero promises that every row already has unit L2 norm, so
+    /// `FASTCLUSTER_METRIC_COSINE` skips the per-row normalization. Default 0.
+    int inputIsNormalized;
+    /// Buffers to reuse, or NULL (the default) to allocate them for this call
+    /// only. A workspace must not be used by two calls at the same time.
+    fastcluster_workspace *workspace;
+    /// Distance-matrix construction for the stored-matrix methods and
+    /// `fastcluster_compute_distance_matrix`. Default
+    /// `FASTCLUSTER_DISTANCES_PAIRWISE`.
+    fastcluster_distance_algorithm distanceAlgorithm;
+    /// Progress, cancellation and time budget, or NULL (the default) to run
+    /// to completion. Used by the linkage, batch and approximate entry points.
+    const fastcluster_run_control *control;
+    /// Active-cluster set of centroid and median linkage. Default
+    /// `FASTCLUSTER_ACTIVE_SET_LINKED_LIST`.
+    fastcluster_active_set activeSet;
+    /// Children per node of the nearest-neighbour heap of centroid and median
+    /// linkage: 2 (the default, upstream's binary heap), 4 or 8. The 4- and
+    /// 8-ary heaps keep keys inline in cache-line-aligned sibling groups; they
+    /// can order merges at exactly equal distances differently.
+    size_t heapArity;
+    /// Index width of single, centroid and median linkage, whose O(N * D)
+    /// memory allows runs past 32-bit indices. Default `FASTCLUSTER_INDEX_AUTO`.
+    /// Both widths produce identical dendrograms. A 64-bit run does not use
+    /// `workspace`. The stored-matrix methods always use 32-bit indices and
+    /// return `FASTCLUSTER_WRAPPER_INDEX_OVERFLOW` past 2^30 - 1 points.
+    fastcluster_index_width indexWidth;
+    /// `pointCount` finite, positive weights, or NULL (the default) for 1 each.
+    /// A point of weight w counts as w identical points, so an embedding that
+    /// stands for an already merged region (the mean of its chunks, weighted by
+    /// their number) replaces those chunks at a fraction of the cost. Seeds the
+    /// centroid updates of centroid linkage and the cluster sizes of average
+    /// and Ward linkage; single, complete, weighted and median linkage do not
+    /// depend on sizes. The cosine metric normalizes a row before weighting it,
+    /// so pass means of unit rows with `inputIsNormalized` to get exactly the
+    /// centroids of the full input. The size column of the dendrogram still
+    /// counts points. Used by the linkage and constrained entry points; the
+    /// batch and approximate entry points reject it.
+    const double *pointWeights;
+} fastcluster_linkage_options;
+
+/// Fill `options` with the defaults used by the entry points without options.
+void fastcluster_linkage_options_init(fastcluster_linkage_options *options);
+
+/// Allocation statistics of a workspace.
+typedef struct {
+    /// Linkage calls that ran in the workspace.
+    size_t callCount;
+    /// Buffer (re)allocations since creation, including the initial reservation.
+    /// Constant across calls once every buffer has reached its working size.
+    size_t allocationCount;
+    /// Bytes currently held by the workspace.
+    size_t reservedBytes;
+} fastcluster_workspace_stats;
+
+/// Create a workspace for repeated linkage calls. Pass it through
+/// `fastcluster_linkage_options.workspace`. Buffers for centroid and median
+/// linkage of up to `maxPointCount` float64 rows of `maxDimension` are reserved
+/// up front. Every buffer grows on demand and is never shrunk.
+///
+/// With a warm workspace and `threadCount` 1, centroid and median linkage
+/// perform no heap allocation. The other methods reuse their distance matrix
+/// and result buffers, but fastcluster still allocates a few O(N) arrays.
+///
+/// - Returns: NULL when the reservation fails or the sizes exceed the index range.
+fastcluster_workspace *fastcluster_workspace_create(size_t maxPointCount, size_t maxDimension);
+
+/// Release a workspace. NULL is ignored.
+void fastcluster_workspace_destroy(fastcluster_workspace *workspace);
+
+/// Read the allocation counters of `workspace`.
+void fastcluster_workspace_get_stats(const fastcluster_workspace *workspace, fastcluster_workspace_stats *stats);
+
+/// Instruction sets of the distance kernels.
+typedef enum {
+    FASTCLUSTER_SIMD_SCALAR = 0,
+    FASTCLUSTER_SIMD_NEON = 1,
+    FASTCLUSTER_SIMD_AVX2 = 2,
+    FASTCLUSTER_SIMD_AVX512 = 3
+} fastcluster_simd_level;
+
+/// Level the distance kernels currently run at: the best one the CPU supports
+/// unless `fastcluster_set_simd_level` chose another.
+fastcluster_simd_level fastcluster_get_simd_level(void);
+
+/// Run the distance kernels of every later call at `level`, for tests and
+/// reproducibility checks. Levels differ only in the order of summation, within
+/// `2 * dimension * 2^-53` relative (2^-24 for float and half-precision input),
+/// for every metric; `FASTCLUSTER_SIMD_SCALAR` gives the same kernel sums on
+/// every target. Must not be called while another call is running.
+///
+/// - Returns: `FASTCLUSTER_WRAPPER_INVALID_ARGUMENT`, leaving the level
+///   unchanged, when the CPU or the build cannot run `level`.
+fastcluster_wrapper_status fastcluster_set_simd_level(fastcluster_simd_level level);
+
 /// Compute centroid linkage dendrogram for the provided feature matrix.
 ///
 /// - Parameters:
@@ -39,6 +255,568 @@ fastcluster_wrapper_status fastcluster_compute_centroid_linkage(
     size_t dendrogramLength
 );
 
+/// Single-precision variant of `fastcluster_compute_centroid_linkage`.
+///
+/// Input rows and merged centroids are stored as `float` and distances are
+/// accumulated in `float`, which halves the memory traffic of the distance loops
+/// and the size of the centroid buffer. The nearest-neighbour heap and the
+/// dendrogram stay in double precision. Merge distances typically agree with the
+/// double path to about 1e-6 relative; see README.md for the accuracy report.
+///
+/// - Parameters: Same as `fastcluster_compute_centroid_linkage`, except `data`
+///   points to `pointCount * dimension` floats.
+fastcluster_wrapper_status fastcluster_compute_centroid_linkage_f32(
+    const float *data,
+    size_t pointCount,
+    size_t dimension,
+    double *dendrogramOut,
+    size_t dendrogramLength
+);
+
+/// `fastcluster_compute_centroid_linkage` with explicit options. `options` may be
+/// NULL, which is equivalent to the defaults.
+fastcluster_wrapper_status fastcluster_compute_centroid_linkage_with_options(
+    const double *data,
+    size_t pointCount,
+    size_t dimension,
+    const fastcluster_linkage_options *options,
+    double *dendrogramOut,
+    size_t dendrogramLength
+);
+
+/// `fastcluster_compute_centroid_linkage_f32` with explicit options.
+fastcluster_wrapper_status fastcluster_compute_centroid_linkage_f32_with_options(
+    const float *data,
+    size_t pointCount,
+    size_t dimension,
+    const fastcluster_linkage_options *options,
+    double *dendrogramOut,
+    size_t dendrogramLength
+);
+
+/// Compute a linkage dendrogram with any SciPy method, matching
+/// `scipy.cluster.hierarchy.linkage(data, method, metric)`.
+///
+/// The algorithm is chosen per method:
+///   - single: minimum spanning tree on the vectors (O(N) memory).
+///   - complete, average, weighted, ward: nearest-neighbour chain on the
+///     condensed distance matrix (O(N^2) memory: `N * (N - 1) / 2` doubles).
+///   - centroid, median: generic vector algorithm (O(N * D) memory).
+///
+/// ward, centroid and median require `FASTCLUSTER_METRIC_EUCLIDEAN` or
+/// `FASTCLUSTER_METRIC_COSINE` and return `FASTCLUSTER_WRAPPER_INVALID_ARGUMENT`
+/// for `FASTCLUSTER_METRIC_SQEUCLIDEAN`. `options` may be
+/// NULL; `threadCount` also parallelizes the distance-matrix construction.
+/// Output format and error codes are those of `fastcluster_compute_centroid_linkage`.
+fastcluster_wrapper_status fastcluster_compute_linkage(
+    fastcluster_method method,
+    fastcluster_metric metric,
+    const double *data,
+    size_t pointCount,
+    size_t dimension,
+    const fastcluster_linkage_options *options,
+    double *dendrogramOut,
+    size_t dendrogramLength
+);
+
+/// `fastcluster_compute_linkage` on a strided float64, float32, float16 or
+/// bfloat16 matrix, read without copying. With `FASTCLUSTER_METRIC_COSINE` the
+/// wrapper keeps one inverse norm per row instead of a normalized copy of the
+/// input. float32 input stores merged centroids and accumulates distances in
+/// float, as in `fastcluster_compute_centroid_linkage_f32`; so do the 16-bit
+/// types, which are widened as they are loaded (F16C on x86, native
+/// conversions on arm64). See README.md for their label drift against float64.
+fastcluster_wrapper_status fastcluster_compute_linkage_matrix(
+    fastcluster_method method,
+    fastcluster_metric metric,
+    const fastcluster_matrix *matrix,
+    const fastcluster_linkage_options *options,
+    double *dendrogramOut,
+    size_t dendrogramLength
+);
+
+/// Pairwise constraints of `fastcluster_compute_constrained_linkage`. Each list
+/// holds `count` pairs of point indices, `2 * count` entries in all; a list may
+/// be NULL when its count is 0.
+typedef struct {
+    /// Points that must end up in the same cluster, e.g. embeddings of one
+    /// enrolled speaker. Closed transitively.
+    const size_t *mustLinkPairs;
+    size_t mustLinkCount;
+    /// Points that must end up in different clusters, e.g. two speakers active
+    /// in the same window.
+    const size_t *cannotLinkPairs;
+    size_t cannotLinkCount;
+} fastcluster_pair_constraints;
+
+/// Centroid or median linkage of `matrix` under must-link and cannot-link
+/// constraints, as a SciPy dendrogram over all `pointCount` rows.
+///
+/// Every must-link group is merged first, at height 0, and then enters the
+/// linkage as the mean of its rows (normalized rows for the cosine metric),
+/// weighted by its size, or with `options->pointWeights` by the weighted mean
+/// and the total weight of its rows. Two clusters whose union would hold a cannot-link pair
+/// are infinitely far apart, so those merges come last, at height +infinity.
+/// A distance cut at any finite threshold, such as
+/// `fastcluster_cut_tree_distance`, therefore honours every constraint.
+/// Conflicts are tracked with one bitset per constrained cluster, so thousands
+/// of constraints add little to the run time; see README.md.
+///
+/// `constraints` may be NULL, which gives the unconstrained linkage. Progress
+/// counts the merges after the must-link groups.
+///
+/// - Returns: `FASTCLUSTER_WRAPPER_INVALID_ARGUMENT` for other methods, the
+///   squared-Euclidean metric, out-of-range indices, a cannot-link pair of a
+///   point with itself, or a cannot-link pair inside a must-link group.
+///   `FASTCLUSTER_WRAPPER_INDEX_OVERFLOW` past the 32-bit index range.
+fastcluster_wrapper_status fastcluster_compute_constrained_linkage(
+    fastcluster_method method,
+    fastcluster_metric metric,
+    const fastcluster_matrix *matrix,
+    const fastcluster_pair_constraints *constraints,
+    const fastcluster_linkage_options *options,
+    double *dendrogramOut,
+    size_t dendrogramLength
+);
+
+/// Round `count` floats to `FASTCLUSTER_SCALAR_FLOAT16` or
+/// `FASTCLUSTER_SCALAR_BFLOAT16` bit patterns (round to nearest even; float16
+/// overflows to infinity), for building half-precision input where the
+/// language has no native 16-bit float type.
+///
+/// - Returns: `FASTCLUSTER_WRAPPER_INVALID_ARGUMENT` for any other `type` or a
+///   NULL pointer with `count` > 0.
+fastcluster_wrapper_status fastcluster_convert_to_half(
+    fastcluster_scalar_type type,
+    const float *values,
+    size_t count,
+    uint16_t *out
+);
+
+/// Condensed pairwise distances between the rows of `matrix`, in the order of
+/// `scipy.spatial.distance.pdist`: entry (i, j) with i < j is at index
+/// `N * i - i * (i + 1) / 2 + j - i - 1`.
+///
+/// Uses `options->distanceAlgorithm` and `options->threadCount`; `options` may be
+/// NULL. `outLength` must be at least `N * (N - 1) / 2`, otherwise
+/// `FASTCLUSTER_WRAPPER_OUTPUT_TOO_SMALL` is returned. NaN or infinite input
+/// returns `FASTCLUSTER_WRAPPER_RUNTIME_ERROR`.
+fastcluster_wrapper_status fastcluster_compute_distance_matrix(
+    fastcluster_metric metric,
+    const fastcluster_matrix *matrix,
+    const fastcluster_linkage_options *options,
+    double *out,
+    size_t outLength
+);
+
+/// One linkage computation of a batch.
+typedef struct {
+    fastcluster_method method;
+    fastcluster_metric metric;
+    fastcluster_matrix matrix;
+    double *dendrogramOut;
+    size_t dendrogramLength;
+    /// Written by `fastcluster_compute_linkage_batch`.
+    fastcluster_wrapper_status status;
+} fastcluster_linkage_job;
+
+/// Run independent linkage jobs, e.g. one per recording, on `threadCount`
+/// worker threads (0 = every hardware thread, 1 = the calling thread only).
+///
+/// Jobs are started largest first (by N^2 * D), and each worker takes the next
+/// job as soon as it finishes one. Each job runs single-threaded with its
+/// worker's own workspace, which is reused across that worker's jobs.
+/// `options.workspace` is ignored and `options.pointWeights` must be NULL; the
+/// other options apply to every job. With
+/// `options.control`, progress is reported per job and one job that is stopped
+/// stops the jobs still running or waiting, which then return the same status.
+/// Results match `fastcluster_compute_linkage_matrix` on each job.
+///
+/// - Returns: `FASTCLUSTER_WRAPPER_SUCCESS` when every job succeeded, otherwise
+///   the status of the first failed job in array order. Each job's own status
+///   is stored in `jobs[i].status`; when the batch fails before any job runs
+///   (invalid options, allocation failure), every job receives that status.
+fastcluster_wrapper_status fastcluster_compute_linkage_batch(
+    fastcluster_linkage_job *jobs,
+    size_t jobCount,
+    const fastcluster_linkage_options *options
+);
+
+/// Flat clusters at a distance threshold, as `scipy.cluster.hierarchy.fcluster(
+/// Z, threshold, criterion="distance")`: points share a cluster when they are
+/// joined by a subtree whose largest merge distance is <= `threshold`.
+///
+/// - Parameters:
+///   - dendrogram: `(pointCount - 1) * 4` doubles in SciPy linkage format, as
+///     written by the linkage entry points.
+///   - dendrogramLength: Length of `dendrogram` in elements.
+///   - pointCount: Number of clustered points.
+///   - labelsOut: Receives `pointCount` labels. Labels are dense and 0-based and
+///     numbered in order of first appearance (point 0 is always in cluster 0),
+///     unlike the 1-based labels SciPy returns; the partition is the same.
+///   - labelsLength: Length of `labelsOut` in elements.
+///
+/// - Returns: `FASTCLUSTER_WRAPPER_INVALID_ARGUMENT` when the dendrogram does not
+///   describe a valid merge tree over `pointCount` points.
+fastcluster_wrapper_status fastcluster_cut_tree_distance(
+    const double *dendrogram,
+    size_t dendrogramLength,
+    size_t pointCount,
+    double threshold,
+    int32_t *labelsOut,
+    size_t labelsLength
+);
+
+/// Flat clusters with at most `maxClusters` clusters, as `fcluster(Z, maxClusters,
+/// criterion="maxclust")`: the lowest max-distance threshold that leaves no more
+/// than `maxClusters` clusters. Ties in merge distances can leave fewer.
+/// Parameters and labels are those of `fastcluster_cut_tree_distance`;
+/// `maxClusters` must be >= 1.
+fastcluster_wrapper_status fastcluster_cut_tree_maxclust(
+    const double *dendrogram,
+    size_t dendrogramLength,
+    size_t pointCount,
+    size_t maxClusters,
+    int32_t *labelsOut,
+    size_t labelsLength
+);
+
+/// Parameters of `fastcluster_cluster_centroid_approximate`. Always initialize
+/// with `fastcluster_approximate_options_init`.
+typedef struct {
+    /// Target quantization error of the micro-cluster reduction: the root mean
+    /// square distance from a point to its micro-cluster centre, as a fraction
+    /// of the cut threshold. Smaller budgets keep more micro-clusters; 0 keeps
+    /// one per distinct point. Default 0.25.
+    double errorBudget;
+    /// Upper bound on the number of micro-clusters. When the budget needs more,
+    /// the reduction stops at the bound and the result misses the budget (see
+    /// the report). 0 (the default) bounds it at N / 4, past which the
+    /// reduction costs more than it saves, and runs the exact clustering when
+    /// the budget needs more.
+    size_t maxMicroClusters;
+    /// Lloyd refinement passes after k-means++ seeding. Default 2.
+    size_t refinementIterations;
+    /// Seed of the k-means++ sampling. Results are reproducible for a given
+    /// seed and independent of the thread count. Default 0.
+    uint64_t seed;
+} fastcluster_approximate_options;
+
+/// Fill `options` with the defaults.
+void fastcluster_approximate_options_init(fastcluster_approximate_options *options);
+
+/// What an approximate clustering did.
+typedef struct {
+    /// Micro-clusters the centroid linkage ran on; `pointCount` when the exact
+    /// clustering ran instead.
+    size_t microClusterCount;
+    /// Achieved quantization error, in the units of `errorBudget`.
+    double quantizationError;
+} fastcluster_approximate_report;
+
+/// Approximate flat centroid clustering for large inputs.
+///
+/// The points are first reduced to k-means micro-clusters within
+/// `approximate->errorBudget` (k-means++ seeding, then Lloyd refinement).
+/// Exact centroid linkage then runs on the micro-cluster centres, each weighted
+/// by its point count, so merged centroids are the means of all underlying
+/// points. The tree is cut at `threshold` as in `fastcluster_cut_tree_distance`,
+/// and every point takes the label of its micro-cluster. Linkage drops from
+/// O(N^2 * D) to O(k^2 * D) for k micro-clusters; the reduction costs
+/// O(N * k * D).
+///
+/// Points of one micro-cluster always share a label, so the result can differ
+/// from the exact clustering near cluster boundaries; the benchmark reports the
+/// agreement (adjusted Rand index) for a range of budgets.
+///
+/// - Parameters:
+///   - metric: `FASTCLUSTER_METRIC_EUCLIDEAN` or `FASTCLUSTER_METRIC_COSINE`.
+///   - threshold: Distance threshold in the units of `metric`.
+///   - options: `threadCount`, `inputIsNormalized`, `workspace` and `control`
+///     apply; `pointWeights` must be NULL. May be NULL. The reduction checks
+///     `control` after every seeding step and Lloyd pass and reports 0 of
+///     `pointCount - 1` merges; the linkage then reports its own merges.
+///   - approximate: Reduction parameters; NULL selects the defaults.
+///   - labelsOut: Receives `pointCount` dense 0-based labels in order of first
+///     appearance.
+///   - report: Optional; receives the micro-cluster count and achieved error.
+fastcluster_wrapper_status fastcluster_cluster_centroid_approximate(
+    fastcluster_metric metric,
+    const fastcluster_matrix *matrix,
+    double threshold,
+    const fastcluster_linkage_options *options,
+    const fastcluster_approximate_options *approximate,
+    int32_t *labelsOut,
+    size_t labelsLength,
+    fastcluster_approximate_report *report
+);
+
+/// Centroid linkage over a growing set of points, e.g. the embeddings of an
+/// ongoing meeting. See `fastcluster_incremental_create`.
+typedef struct fastcluster_incremental_engine fastcluster_incremental_engine;
+
+/// How `fastcluster_incremental_linkage` built its tree.
+typedef struct {
+    /// Merges reused from the previous tree.
+    size_t replayedMerges;
+    /// Merges computed from scratch: those involving new points or clusters
+    /// whose old merge partner changed. Every merge after a full run.
+    size_t recomputedMerges;
+} fastcluster_incremental_report;
+
+/// Create an engine for exact centroid linkage that is updated as points
+/// arrive instead of being recomputed.
+///
+/// The engine keeps a copy of every appended row (as double) and the merge
+/// tree with its centroids from the last `fastcluster_incremental_linkage`
+/// call. The next call replays the old merges while no pair involving a new
+/// point is closer, and computes exact nearest neighbours only for the clusters
+/// the new points touch. For k new points the update costs about k * N * D
+/// plus N * D per recomputed merge, instead of N^2 * D; when the new points
+/// outnumber the old ones, a full run is made instead.
+///
+/// The dendrogram equals `fastcluster_compute_linkage_matrix` with
+/// `FASTCLUSTER_METHOD_CENTROID` on all rows (as float64) bit for bit, except
+/// that merges at exactly equal distances may be ordered differently.
+///
+/// - Parameters:
+///   - metric: `FASTCLUSTER_METRIC_EUCLIDEAN` or `FASTCLUSTER_METRIC_COSINE`.
+///   - dimension: Length of every row (> 0).
+///
+/// - Returns: NULL for an unsupported metric or dimension, or when allocation
+///   fails. An engine must not be used by two calls at the same time.
+fastcluster_incremental_engine *fastcluster_incremental_create(fastcluster_metric metric, size_t dimension);
+
+/// Release an engine. NULL is ignored.
+void fastcluster_incremental_destroy(fastcluster_incremental_engine *engine);
+
+/// Points appended so far.
+size_t fastcluster_incremental_point_count(const fastcluster_incremental_engine *engine);
+
+/// Append the rows of `matrix` (any scalar type and stride) as the next
+/// points; they are stored as float64. `matrix->dimension` must equal the engine's dimension. NaN or
+/// infinite values return `FASTCLUSTER_WRAPPER_RUNTIME_ERROR` and append
+/// nothing.
+fastcluster_wrapper_status fastcluster_incremental_append(
+    fastcluster_incremental_engine *engine,
+    const fastcluster_matrix *matrix
+);
+
+/// Centroid linkage dendrogram over every point appended so far, in SciPy
+/// format with `(pointCount - 1) * 4` doubles, updated from the previous call.
+/// `report` is optional.
+fastcluster_wrapper_status fastcluster_incremental_linkage(
+    fastcluster_incremental_engine *engine,
+    double *dendrogramOut,
+    size_t dendrogramLength,
+    fastcluster_incremental_report *report
+);
+
+/// One iteration of `fastcluster_compute_vbx`.
+typedef struct {
+    /// Evidence lower bound after the iteration.
+    double elbo;
+    /// Largest change of a responsibility in the iteration.
+    double gammaChange;
+    /// Speakers in the model during the iteration.
+    size_t speakerCount;
+    /// Speakers pruned after the iteration.
+    size_t prunedSpeakers;
+} fastcluster_vbx_iteration;
+
+/// Options of `fastcluster_compute_vbx`. Always initialize with
+/// `fastcluster_vbx_options_init` so that fields added later get defaults.
+typedef struct {
+    /// EM iterations at most. Default 20.
+    size_t maxIterations;
+    /// Stop once the ELBO changes by less than this between two iterations.
+    /// Default 1e-4.
+    double convergenceTolerance;
+    /// Acoustic scaling factor. Default 0.07.
+    double Fa;
+    /// Speaker regularization. Default 0.8.
+    double Fb;
+    /// Softmax sharpness applied to the initial responsibilities before the
+    /// first iteration; negative keeps them as given. Default 7.
+    double initSmoothing;
+    /// Threads for the E-step. 0 uses every hardware thread, 1 (the default)
+    /// stays on the calling thread. Frames are split into shards of at least
+    /// 2048 frames, so short inputs run serially. Results are identical for
+    /// every thread count.
+    size_t threadCount;
+    /// After every iteration that does not stop the run, speakers whose
+    /// mixture weight is below this leave the model (the heaviest one always
+    /// stays). Their columns are dropped from the responsibilities, which are
+    /// compacted in place and renormalized, so later iterations cost in
+    /// proportion to the remaining speakers. 0 (the default) keeps every
+    /// speaker.
+    double pruneThreshold;
+    /// Also stop once no responsibility changes by this much or more in an
+    /// iteration. 0 (the default) disables the test.
+    double gammaTolerance;
+    /// Optional: receives one record per iteration; at least `maxIterations`
+    /// entries. Default NULL.
+    fastcluster_vbx_iteration *history;
+    size_t historyLength;
+} fastcluster_vbx_options;
+
+/// Fill `options` with the defaults.
+void fastcluster_vbx_options_init(fastcluster_vbx_options *options);
+
+/// Why a VBx run stopped.
+typedef enum {
+    FASTCLUSTER_VBX_STOP_MAX_ITERATIONS = 0,
+    FASTCLUSTER_VBX_STOP_ELBO = 1,
+    FASTCLUSTER_VBX_STOP_GAMMA = 2
+} fastcluster_vbx_stop;
+
+/// What a VBx run did.
+typedef struct {
+    /// EM iterations run, and ELBO values and history records written.
+    size_t iterations;
+    /// Speakers left after pruning.
+    size_t speakerCount;
+    fastcluster_vbx_stop stopReason;
+} fastcluster_vbx_report;
+
+/// Variational Bayes (VBx) refinement of a speaker clustering, as in
+/// `VBxClustering.swift`, without Accelerate.
+///
+/// Each iteration updates the speaker models from the responsibilities, then
+/// the responsibilities and the mixture weights from the speaker models, and
+/// records the evidence lower bound (ELBO). The E-step and the statistics of
+/// the next M-step are fused into one cache-blocked pass over the frames, and
+/// the frames x speakers log-likelihood matrix is never stored. The pass can
+/// run on several threads: each shard of frames keeps partial statistics,
+/// which are added in shard order, so results depend only on the input.
+///
+/// - Parameters:
+///   - features: `pointCount` frames of PLDA-space features (x-vectors after
+///     the PLDA transform), any scalar type and stride. NaN or infinite values
+///     return `FASTCLUSTER_WRAPPER_RUNTIME_ERROR`.
+///   - phi: `dimension` PLDA eigenvalues (clamped to at least 1e-12).
+///   - speakerCount: Speakers of the model (> 0).
+///   - options: May be NULL for the defaults.
+///   - gamma: `pointCount * speakerCount` responsibilities, row-major: the
+///     initial ones on entry (e.g. one-hot warm-start labels), the final ones
+///     on return. Rows that do not sum to a positive finite value start uniform.
+///     Pruned speakers end with zero responsibilities.
+///   - piOut: Receives the `speakerCount` mixture weights, zero for pruned
+///     speakers.
+///   - elbosOut: Receives the ELBO of every iteration; at least
+///     `options->maxIterations` entries, or NULL.
+///   - report: Optional; receives the iteration count, the speakers left and
+///     why the run stopped.
+fastcluster_wrapper_status fastcluster_compute_vbx(
+    const fastcluster_matrix *features,
+    const double *phi,
+    size_t speakerCount,
+    const fastcluster_vbx_options *options,
+    double *gamma,
+    size_t gammaLength,
+    double *piOut,
+    double *elbosOut,
+    size_t elbosLength,
+    fastcluster_vbx_report *report
+);
+
+/// Single-precision variant of `fastcluster_compute_vbx`.
+///
+/// The frames, the speaker scores, `gamma` and the per-shard statistics are
+/// `float`. That halves the memory of the frames x dimension and
+/// frames x speakers buffers and doubles the SIMD width of the fused pass. The
+/// speaker models with their log-determinant terms, the sums across shards, the
+/// log-likelihood and the ELBO stay in double. The softmax subtracts the row
+/// maximum before the exp, and the per-frame constant of the log-likelihood
+/// never enters the float scores. The ELBO typically agrees with the double
+/// path to about 1e-8 relative; see README.md for the drift report. Changes of
+/// the ELBO below its float resolution, about 1e-8 of its value, count as
+/// converged.
+///
+/// - Parameters: Same as `fastcluster_compute_vbx`, except that `gamma` points
+///   to `gammaLength` floats. `features` may have any scalar type.
+fastcluster_wrapper_status fastcluster_compute_vbx_f32(
+    const fastcluster_matrix *features,
+    const double *phi,
+    size_t speakerCount,
+    const fastcluster_vbx_options *options,
+    float *gamma,
+    size_t gammaLength,
+    double *piOut,
+    double *elbosOut,
+    size_t elbosLength,
+    fastcluster_vbx_report *report
+);
+
+/// PLDA feature transform parameters, as in pyannote's x-vector and PLDA
+/// models:
+///
+///     u   = sqrt(E) * l2norm(x - inputMean)
+///     y   = sqrt(L) * l2norm(u * lda - ldaMean)
+///     rho = (y - pldaMean) * pldaTransform^T
+///
+/// The arrays are copied by `fastcluster_plda_create`.
+typedef struct {
+    /// Embedding dimension E (256 for the community-1 x-vectors).
+    size_t inputDimension;
+    /// LDA dimension L.
+    size_t ldaDimension;
+    /// Output (rho) dimension, at most `ldaDimension`.
+    size_t outputDimension;
+    /// `inputDimension` values (mean1), or NULL for zero.
+    const double *inputMean;
+    /// `inputDimension x ldaDimension`, row-major.
+    const double *lda;
+    /// `ldaDimension` values (mean2), or NULL for zero.
+    const double *ldaMean;
+    /// `ldaDimension` values (mu), or NULL for zero.
+    const double *pldaMean;
+    /// `outputDimension x ldaDimension`, row-major: the first rows of the PLDA
+    /// transform as pyannote's `vbx_setup` returns it, i.e. the generalized
+    /// eigenvectors of the across- and within-class covariances in descending
+    /// order of eigenvalue (`wccn.T[::-1]`). Those eigenvalues are the phi of
+    /// `fastcluster_compute_vbx`; the raw `tr` of the PLDA model does not match
+    /// them.
+    const double *pldaTransform;
+} fastcluster_plda_parameters;
+
+/// A PLDA transform with its matrices packed for the blocked products; see
+/// `fastcluster_plda_create`.
+typedef struct fastcluster_plda_engine fastcluster_plda_engine;
+
+/// Pack `parameters` into a transform engine.
+///
+/// - Returns: NULL when a dimension is zero, `outputDimension` exceeds
+///   `ldaDimension`, `lda` or `pldaTransform` is NULL, a parameter is NaN or
+///   infinite, or allocation fails. An engine may be used by several calls at
+///   the same time.
+fastcluster_plda_engine *fastcluster_plda_create(const fastcluster_plda_parameters *parameters);
+
+/// Release an engine. NULL is ignored.
+void fastcluster_plda_destroy(fastcluster_plda_engine *engine);
+
+/// Transform embeddings into PLDA space (the rho features of VBx).
+///
+/// Rows are processed in blocks of 32. Each block is centred and multiplied
+/// with the LDA matrix, normalized, offset and multiplied with the PLDA matrix
+/// while it is in cache, and written to its rows of `rhoOut`. Both products run
+/// over register tiles, with the matrices packed into column panels once by
+/// `fastcluster_plda_create`. A vector that is zero when it would be
+/// length-normalized stays zero.
+///
+/// - Parameters:
+///   - embeddings: `pointCount` rows of `inputDimension` values, any scalar
+///     type and stride. NaN or infinite values return
+///     `FASTCLUSTER_WRAPPER_RUNTIME_ERROR`.
+///   - rhoOut: Receives `pointCount * outputDimension` doubles, row-major,
+///     ready to pass to `fastcluster_compute_vbx` as a dense matrix.
+fastcluster_wrapper_status fastcluster_plda_transform(
+    const fastcluster_plda_engine *engine,
+    const fastcluster_matrix *embeddings,
+    double *rhoOut,
+    size_t rhoLength
+);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -1,6 +1,6 @@
-import Accelerate
 import Foundation
 import OSLog
+import os
 import os.signpost
 
 #if canImport(FastClusterWrapper)
@@ -17,10 +17,15 @@ struct AHCClustering {
     )
 
     // MARK: - Agglomerative Hierarchical Clustering
+    /// - Parameter weights: Optional weight per embedding, e.g. the number of
+    ///   chunks a pre-merged same-speaker embedding stands for. An embedding of
+    ///   weight w counts as w copies in the merged centroids. Embeddings are
+    ///   L2-normalized before they are weighted.
     func cluster(
         embeddingFeatures: [[Double]],
-        threshold: Double
-    ) -> [Int] {
+        threshold: Double,
+        weights: [Double]? = nil
+    ) async -> [Int] {
         let count = embeddingFeatures.count
         guard count > 0 else { return [] }
         guard let dimension = embeddingFeatures.first?.count, dimension > 0 else {
@@ -29,177 +34,393 @@ struct AHCClustering {
         if count == 1 {
             return [0]
         }
+        precondition(weights == nil || weights?.count == count, "One weight per embedding is required")
 
         let ahcState = signposter.beginInterval("Agglomerative Hierarchical Clustering")
 
-        let normalized = normalizeFeatures(embeddingFeatures, dimension: dimension)
+        let flattened = flattenFeatures(embeddingFeatures, dimension: dimension)
+        let pointWeights = weights ?? []
         let dendrogramLength = (count - 1) * 4
         var dendrogram = [Double](repeating: 0, count: dendrogramLength)
 
         // MARK: - Fastcluster FFI Boundary
-        let status = normalized.withUnsafeBufferPointer { normalizedPointer in
-            dendrogram.withUnsafeMutableBufferPointer { dendrogramPointer in
-                fastcluster_compute_centroid_linkage(
-                    normalizedPointer.baseAddress,
-                    count,
-                    dimension,
-                    dendrogramPointer.baseAddress,
-                    dendrogramLength
-                )
+        // The wrapper's cosine metric normalizes rows on the fly, which gives
+        // the centroid linkage of the L2-normalized embeddings without a
+        // normalized copy of the matrix. Cancelling the calling task stops the
+        // linkage within a few hundred merges.
+        let status = await withCancellationControl { controlPointer in
+            flattened.withUnsafeBufferPointer { featurePointer in
+                pointWeights.withUnsafeBufferPointer { weightPointer in
+                    dendrogram.withUnsafeMutableBufferPointer { dendrogramPointer -> fastcluster_wrapper_status in
+                        var matrix = fastcluster_matrix(
+                            data: UnsafeRawPointer(featurePointer.baseAddress),
+                            scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                            pointCount: count,
+                            dimension: dimension,
+                            rowStride: 0
+                        )
+                        var options = fastcluster_linkage_options()
+                        fastcluster_linkage_options_init(&options)
+                        options.control = controlPointer
+                        options.pointWeights = weights == nil ? nil : weightPointer.baseAddress
+                        return fastcluster_compute_linkage_matrix(
+                            FASTCLUSTER_METHOD_CENTROID,
+                            FASTCLUSTER_METRIC_COSINE,
+                            &matrix,
+                            &options,
+                            dendrogramPointer.baseAddress,
+                            dendrogramLength
+                        )
+                    }
+                }
             }
         }
 
+        if status == FASTCLUSTER_WRAPPER_CANCELLED {
+            signposter.endInterval("Agglomerative Hierarchical Clustering", ahcState)
+            logger.debug("AHC cancelled after task cancellation")
+            return Array(0..<count)
+        }
+
         guard status == FASTCLUSTER_WRAPPER_SUCCESS else {
             logger.error("fastcluster failed with status \(status.rawValue)")
             return Array(0..<count)
         }
 
-        let distanceThreshold = convertThresholdToDistance(threshold)
-        let assignments = assignmentsFromDendrogram(
-            dendrogram,
-            count: count,
-            distanceThreshold: distanceThreshold
-        )
-
-        let result = remapClusterIds(assignments)
+        let result = cutTree(dendrogram[...], count: count, threshold: threshold)
         signposter.endInterval("Agglomerative Hierarchical Clustering", ahcState)
         return result
     }
 
-    // MARK: - L2 Feature Normalization
-    private func normalizeFeatures(_ features: [[Double]], dimension: Int) -> [Double] {
-        var normalized = [Double](repeating: 0, count: features.count * dimension)
+    // MARK: - Constrained Clustering
+    /// Clustering under pairwise constraints given as index pairs into
+    /// `embeddingFeatures`: `mustLink` pairs always share a label (e.g. the
+    /// embeddings of an enrolled speaker), `cannotLink` pairs never do (e.g.
+    /// two speakers active in the same chunk). Without constraints the labels
+    /// equal `cluster(embeddingFeatures:threshold:)`. Contradictory
+    /// constraints are logged and give one cluster per embedding.
+    func cluster(
+        embeddingFeatures: [[Double]],
+        threshold: Double,
+        mustLink: [(Int, Int)],
+        cannotLink: [(Int, Int)]
+    ) async -> [Int] {
+        let count = embeddingFeatures.count
+        guard count > 0 else { return [] }
+        guard let dimension = embeddingFeatures.first?.count, dimension > 0 else {
+            return Array(repeating: 0, count: count)
+        }
+        if count == 1 {
+            return [0]
+        }
 
-        for (rowIndex, vector) in features.enumerated() {
-            precondition(vector.count == dimension, "All feature vectors must share the same dimension")
+        let ahcState = signposter.beginInterval("Constrained Agglomerative Hierarchical Clustering")
 
-            var norm: Double = 0
-            vector.withUnsafeBufferPointer { pointer in
-                vDSP_dotprD(
-                    pointer.baseAddress!,
-                    1,
-                    pointer.baseAddress!,
-                    1,
-                    &norm,
-                    vDSP_Length(dimension)
-                )
-            }
+        let flattened = flattenFeatures(embeddingFeatures, dimension: dimension)
+        let mustLinkPairs = mustLink.flatMap { [$0.0, $0.1] }
+        let cannotLinkPairs = cannotLink.flatMap { [$0.0, $0.1] }
+        let dendrogramLength = (count - 1) * 4
+        var dendrogram = [Double](repeating: 0, count: dendrogramLength)
 
-            let scale = norm > 0 ? 1.0 / sqrt(norm) : 0
-            var mutableScale = scale
-            vector.withUnsafeBufferPointer { source in
-                normalized.withUnsafeMutableBufferPointer { destination in
-                    vDSP_vsmulD(
-                        source.baseAddress!,
-                        1,
-                        &mutableScale,
-                        destination.baseAddress!.advanced(by: rowIndex * dimension),
-                        1,
-                        vDSP_Length(dimension)
-                    )
+        // MARK: - Fastcluster FFI Boundary
+        let status = await withCancellationControl { controlPointer in
+            flattened.withUnsafeBufferPointer { featurePointer in
+                mustLinkPairs.withUnsafeBufferPointer { mustLinkPointer in
+                    cannotLinkPairs.withUnsafeBufferPointer { cannotLinkPointer in
+                        dendrogram.withUnsafeMutableBufferPointer { dendrogramPointer -> fastcluster_wrapper_status in
+                            var matrix = fastcluster_matrix(
+                                data: UnsafeRawPointer(featurePointer.baseAddress),
+                                scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                                pointCount: count,
+                                dimension: dimension,
+                                rowStride: 0
+                            )
+                            var constraints = fastcluster_pair_constraints(
+                                mustLinkPairs: mustLinkPointer.baseAddress,
+                                mustLinkCount: mustLink.count,
+                                cannotLinkPairs: cannotLinkPointer.baseAddress,
+                                cannotLinkCount: cannotLink.count
+                            )
+                            var options = fastcluster_linkage_options()
+                            fastcluster_linkage_options_init(&options)
+                            options.control = controlPointer
+                            return fastcluster_compute_constrained_linkage(
+                                FASTCLUSTER_METHOD_CENTROID,
+                                FASTCLUSTER_METRIC_COSINE,
+                                &matrix,
+                                &constraints,
+                                &options,
+                                dendrogramPointer.baseAddress,
+                                dendrogramLength
+                            )
+                        }
+                    }
                 }
             }
         }
 
-        return normalized
-    }
+        if status == FASTCLUSTER_WRAPPER_CANCELLED {
+            signposter.endInterval("Constrained Agglomerative Hierarchical Clustering", ahcState)
+            logger.debug("Constrained AHC cancelled after task cancellation")
+            return Array(0..<count)
+        }
 
-    // MARK: - Similarity-to-Distance Conversion
-    private func convertThresholdToDistance(_ similarity: Double) -> Double {
-        guard !similarity.isNaN else { return Double.infinity }
-        if similarity < -1.0 || similarity > 1.0 {
-            logger.debug("Clustering threshold \(similarity) outside cosine range; clamping to [-1, 1]")
+        guard status == FASTCLUSTER_WRAPPER_SUCCESS else {
+            signposter.endInterval("Constrained Agglomerative Hierarchical Clustering", ahcState)
+            logger.error("fastcluster constrained linkage failed with status \(status.rawValue)")
+            return Array(0..<count)
         }
-        let clamped = max(-1.0, min(1.0, similarity))
-        return sqrt(max(0, 2.0 - 2.0 * clamped))
+
+        let result = cutTree(dendrogram[...], count: count, threshold: threshold)
+        signposter.endInterval("Constrained Agglomerative Hierarchical Clustering", ahcState)
+        return result
     }
 
-    // MARK: - Dendrogram Parsing & Threshold-Based Cluster Assignment
-    private func assignmentsFromDendrogram(
-        _ dendrogram: [Double],
-        count: Int,
-        distanceThreshold: Double
-    ) -> [Int] {
+    // MARK: - Approximate Clustering
+    /// Approximate clustering for very long recordings. The embeddings are
+    /// reduced to k-means micro-clusters whose RMS radius is at most
+    /// `errorBudget` times the cut distance, and centroid linkage runs on the
+    /// weighted micro-clusters. When the budget would need more than a quarter
+    /// of the embeddings as micro-clusters, the exact clustering runs instead.
+    func cluster(
+        embeddingFeatures: [[Double]],
+        threshold: Double,
+        errorBudget: Double
+    ) async -> [Int] {
+        let count = embeddingFeatures.count
         guard count > 0 else { return [] }
-        if count == 1 {
-            return [0]
+        guard let dimension = embeddingFeatures.first?.count, dimension > 0 else {
+            return Array(repeating: 0, count: count)
         }
 
-        let totalNodes = count * 2 - 1
-        var leftChild = [Int](repeating: -1, count: totalNodes)
-        var rightChild = [Int](repeating: -1, count: totalNodes)
-        var nodeDistance = [Double](repeating: 0, count: totalNodes)
+        let ahcState = signposter.beginInterval("Approximate Agglomerative Hierarchical Clustering")
+
+        let flattened = flattenFeatures(embeddingFeatures, dimension: dimension)
+        var labels = [Int32](repeating: 0, count: count)
+        var report = fastcluster_approximate_report()
+        var approximate = fastcluster_approximate_options()
+        fastcluster_approximate_options_init(&approximate)
+        approximate.errorBudget = errorBudget
 
-        for mergeIndex in 0..<(count - 1) {
-            let base = mergeIndex * 4
-            let left = Int(dendrogram[base])
-            let right = Int(dendrogram[base + 1])
-            let dist = dendrogram[base + 2]
-            let newNode = count + mergeIndex
-            leftChild[newNode] = left
-            rightChild[newNode] = right
-            nodeDistance[newNode] = dist
+        // MARK: - Fastcluster FFI Boundary
+        // Cancelling the calling task stops the k-means reduction after its
+        // current pass, or the linkage within a few hundred merges.
+        let status = await withCancellationControl { controlPointer in
+            flattened.withUnsafeBufferPointer { featurePointer in
+                labels.withUnsafeMutableBufferPointer { labelsPointer -> fastcluster_wrapper_status in
+                    var matrix = fastcluster_matrix(
+                        data: UnsafeRawPointer(featurePointer.baseAddress),
+                        scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                        pointCount: count,
+                        dimension: dimension,
+                        rowStride: 0
+                    )
+                    var options = fastcluster_linkage_options()
+                    fastcluster_linkage_options_init(&options)
+                    options.control = controlPointer
+                    return fastcluster_cluster_centroid_approximate(
+                        FASTCLUSTER_METRIC_COSINE,
+                        &matrix,
+                        convertThresholdToDistance(threshold),
+                        &options,
+                        &approximate,
+                        labelsPointer.baseAddress,
+                        count,
+                        &report
+                    )
+                }
+            }
         }
+        signposter.endInterval("Approximate Agglomerative Hierarchical Clustering", ahcState)
 
-        let root = totalNodes - 1
-        var assignments = [Int](repeating: -1, count: count)
-        var stack = [root]
-        var nextLabel = 0
+        if status == FASTCLUSTER_WRAPPER_CANCELLED {
+            logger.debug("Approximate AHC cancelled after task cancellation")
+            return Array(0..<count)
+        }
 
-        while let node = stack.popLast() {
-            if node < 0 {
-                continue
+        guard status == FASTCLUSTER_WRAPPER_SUCCESS else {
+            logger.error("fastcluster approximate clustering failed with status \(status.rawValue)")
+            return Array(0..<count)
+        }
+        logger.debug(
+            "Approximate AHC: \(count) embeddings, \(report.microClusterCount) micro-clusters, RMS error \(report.quantizationError) of the threshold"
+        )
+        return labels.map { Int($0) }
+    }
+
+    // MARK: - Batched Clustering
+    /// Clusters several independent embedding sets (e.g. one per recording) with
+    /// a single native call that spreads them over all cores, largest first.
+    /// Each result equals `cluster(embeddingFeatures:threshold:)` on that set.
+    func cluster(
+        batch: [[[Double]]],
+        threshold: Double,
+        threadCount: Int = 0
+    ) -> [[Int]] {
+        var results = batch.map { features -> [Int] in
+            let count = features.count
+            guard let dimension = features.first?.count, dimension > 0 else {
+                return Array(repeating: 0, count: count)
             }
+            return count == 1 ? [0] : []
+        }
+        let pending = batch.indices.filter { results[$0].isEmpty && batch[$0].count > 1 }
+        guard !pending.isEmpty else { return results }
 
-            if node < count {
-                if assignments[node] == -1 {
-                    assignments[node] = nextLabel
-                    nextLabel += 1
+        let batchState = signposter.beginInterval("Batched Agglomerative Hierarchical Clustering")
+
+        // All sessions share one feature buffer and one dendrogram buffer, so
+        // a single pair of pointers covers the whole batch.
+        var featureOffsets: [Int] = []
+        var dendrogramOffsets: [Int] = []
+        var featureTotal = 0
+        var dendrogramTotal = 0
+        for index in pending {
+            featureOffsets.append(featureTotal)
+            dendrogramOffsets.append(dendrogramTotal)
+            featureTotal += batch[index].count * batch[index][0].count
+            dendrogramTotal += (batch[index].count - 1) * 4
+        }
+        var features = [Double]()
+        features.reserveCapacity(featureTotal)
+        for index in pending {
+            features.append(contentsOf: flattenFeatures(batch[index], dimension: batch[index][0].count))
+        }
+        var dendrograms = [Double](repeating: 0, count: dendrogramTotal)
+
+        // MARK: - Fastcluster FFI Boundary
+        let (batchStatus, jobs) = features.withUnsafeBufferPointer { featurePointer in
+            dendrograms.withUnsafeMutableBufferPointer {
+                dendrogramPointer -> (fastcluster_wrapper_status, [fastcluster_linkage_job]) in
+                var batchJobs = pending.enumerated().map { position, index in
+                    fastcluster_linkage_job(
+                        method: FASTCLUSTER_METHOD_CENTROID,
+                        metric: FASTCLUSTER_METRIC_COSINE,
+                        matrix: fastcluster_matrix(
+                            data: UnsafeRawPointer(featurePointer.baseAddress! + featureOffsets[position]),
+                            scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                            pointCount: batch[index].count,
+                            dimension: batch[index][0].count,
+                            rowStride: 0
+                        ),
+                        dendrogramOut: dendrogramPointer.baseAddress! + dendrogramOffsets[position],
+                        dendrogramLength: (batch[index].count - 1) * 4,
+                        // Not run yet; only the native call reports success.
+                        status: FASTCLUSTER_WRAPPER_UNKNOWN_ERROR
+                    )
                 }
+                var options = fastcluster_linkage_options()
+                fastcluster_linkage_options_init(&options)
+                options.threadCount = threadCount
+                let status = fastcluster_compute_linkage_batch(&batchJobs, batchJobs.count, &options)
+                return (status, batchJobs)
+            }
+        }
+
+        // A failed batch may still hold finished jobs; their own status says
+        // which dendrograms are complete.
+        if batchStatus != FASTCLUSTER_WRAPPER_SUCCESS {
+            logger.error("fastcluster batch failed with status \(batchStatus.rawValue)")
+        }
+        for (position, index) in pending.enumerated() {
+            let count = batch[index].count
+            guard jobs[position].status == FASTCLUSTER_WRAPPER_SUCCESS else {
+                logger.error("fastcluster failed with status \(jobs[position].status.rawValue)")
+                results[index] = Array(0..<count)
                 continue
             }
+            let start = dendrogramOffsets[position]
+            results[index] = cutTree(
+                dendrograms[start..<(start + (count - 1) * 4)],
+                count: count,
+                threshold: threshold
+            )
+        }
 
-            let distance = nodeDistance[node]
-            if distance <= distanceThreshold {
-                let label = nextLabel
-                nextLabel += 1
-                var queue = [node]
-                while let current = queue.popLast() {
-                    if current < count {
-                        assignments[current] = label
-                    } else {
-                        let left = leftChild[current]
-                        let right = rightChild[current]
-                        if left >= 0 { queue.append(left) }
-                        if right >= 0 { queue.append(right) }
-                    }
-                }
-            } else {
-                let left = leftChild[node]
-                let right = rightChild[node]
-                if left >= 0 { stack.append(left) }
-                if right >= 0 { stack.append(right) }
+        signposter.endInterval("Batched Agglomerative Hierarchical Clustering", batchState)
+        return results
+    }
+
+    // MARK: - Cancellation
+    /// Runs `body` with a run control whose callback reports the calling
+    /// task's cancellation. The callback may run on a native worker thread,
+    /// where `Task.isCancelled` is always false, so it reads a flag that the
+    /// task's cancellation handler sets instead.
+    private func withCancellationControl<T>(
+        _ body: (UnsafePointer<fastcluster_run_control>) -> T
+    ) async -> T {
+        let flag = CancellationFlag()
+        return await withTaskCancellationHandler {
+            var control = fastcluster_run_control(
+                callback: { context, _, _ in
+                    guard let context else { return 0 }
+                    return Unmanaged<CancellationFlag>.fromOpaque(context).takeUnretainedValue().isSet ? 1 : 0
+                },
+                context: Unmanaged.passUnretained(flag).toOpaque(),
+                timeBudgetSeconds: 0
+            )
+            return withExtendedLifetime(flag) {
+                withUnsafePointer(to: &control) { body($0) }
             }
+        } onCancel: {
+            flag.set()
         }
+    }
 
-        for index in 0..<assignments.count where assignments[index] == -1 {
-            assignments[index] = nextLabel
-            nextLabel += 1
+    // MARK: - Threshold Cut
+    /// Dense 0-based labels in order of first appearance, computed natively.
+    private func cutTree(_ dendrogram: ArraySlice<Double>, count: Int, threshold: Double) -> [Int] {
+        var labels = [Int32](repeating: 0, count: count)
+        let cutStatus = dendrogram.withUnsafeBufferPointer { dendrogramPointer in
+            labels.withUnsafeMutableBufferPointer { labelsPointer in
+                fastcluster_cut_tree_distance(
+                    dendrogramPointer.baseAddress,
+                    dendrogramPointer.count,
+                    count,
+                    convertThresholdToDistance(threshold),
+                    labelsPointer.baseAddress,
+                    count
+                )
+            }
         }
 
-        return assignments
+        guard cutStatus == FASTCLUSTER_WRAPPER_SUCCESS else {
+            logger.error("fastcluster tree cut failed with status \(cutStatus.rawValue)")
+            return Array(0..<count)
+        }
+        return labels.map { Int($0) }
     }
 
-    // MARK: - Cluster ID Remapping
-    private func remapClusterIds(_ assignments: [Int]) -> [Int] {
-        var mapping: [Int: Int] = [:]
-        var nextId = 0
-        return assignments.map { original in
-            if mapping[original] == nil {
-                mapping[original] = nextId
-                nextId += 1
-            }
-            return mapping[original]!
+    // MARK: - Feature Flattening
+    private func flattenFeatures(_ features: [[Double]], dimension: Int) -> [Double] {
+        var flattened = [Double]()
+        flattened.reserveCapacity(features.count * dimension)
+        for vector in features {
+            precondition(vector.count == dimension, "All feature vectors must share the same dimension")
+            flattened.append(contentsOf: vector)
+        }
+        return flattened
+    }
+
+    // MARK: - Similarity-to-Distance Conversion
+    private func convertThresholdToDistance(_ similarity: Double) -> Double {
+        guard !similarity.isNaN else { return Double.infinity }
+        if similarity < -1.0 || similarity > 1.0 {
+            logger.debug("Clustering threshold \(similarity) outside cosine range; clamping to [-1, 1]")
         }
+        let clamped = max(-1.0, min(1.0, similarity))
+        return sqrt(max(0, 2.0 - 2.0 * clamped))
+    }
+}
+
+/// Cancellation flag shared between a task's cancellation handler and the
+/// native progress callback, which may read it from any thread.
+private final class CancellationFlag: Sendable {
+    private let state = OSAllocatedUnfairLock(initialState: false)
+
+    var isSet: Bool { state.withLock { $0 } }
+
+    func set() {
+        state.withLock { $0 = true }
     }
 }
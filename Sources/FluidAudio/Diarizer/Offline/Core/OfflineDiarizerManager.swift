@@ -157,11 +157,13 @@ public final class OfflineDiarizerManager {
             }
         }
 
-        let embeddingTask = Task(priority: .userInitiated) { () throws -> ([TimedEmbedding], TimeInterval) in
+        let embeddingTask = Task(
+            priority: .userInitiated
+        ) { () throws -> (OfflineEmbeddingExtraction, TimeInterval) in
             let extractor = OfflineEmbeddingExtractor(
                 fbankModel: models.fbankModel,
                 embeddingModel: models.embeddingModel,
-                pldaTransform: PLDATransform(pldaRhoModel: models.pldaRhoModel, psi: models.pldaPsi),
+                pldaTransform: makePLDATransform(models: models),
                 config: config
             )
             let start = Date()
@@ -173,7 +175,7 @@ public final class OfflineDiarizerManager {
         }
 
         let segmentationResult: (SegmentationOutput, TimeInterval)
-        let embeddingResult: ([TimedEmbedding], TimeInterval)
+        let embeddingResult: (OfflineEmbeddingExtraction, TimeInterval)
         do {
             async let awaitedSegmentation = segmentationTask.value
             async let awaitedEmbeddings = embeddingTask.value
@@ -189,17 +191,17 @@ public final class OfflineDiarizerManager {
         let (segmentation, segmentationTime) = segmentationResult
         logger.debug("Segmentation completed in \(segmentationTime)s (async)")
 
-        let (timedEmbeddings, embeddingTime) = embeddingResult
+        let (extraction, embeddingTime) = embeddingResult
+        let timedEmbeddings = extraction.embeddings
         logger.debug("Embedding extraction produced \(timedEmbeddings.count) vectors in \(embeddingTime)s (async)")
 
-        let pldaTransform = PLDATransform(pldaRhoModel: models.pldaRhoModel, psi: models.pldaPsi)
+        let pldaTransform = makePLDATransform(models: models)
 
         guard !timedEmbeddings.isEmpty else {
             throw OfflineDiarizationError.noSpeechDetected
         }
 
         let embeddingFeatures = timedEmbeddings.map { $0.embedding256.map { Double($0) } }
-        let rhoFeatures = timedEmbeddings.map { $0.rho128 }
 
         let clusteringStart = Date()
         let trainingIndices = selectTrainingEmbeddings(
@@ -207,7 +209,21 @@ public final class OfflineDiarizerManager {
         )
 
         let trainingEmbeddings = trainingIndices.map { embeddingFeatures[$0] }
-        let trainingRho = trainingIndices.map { rhoFeatures[$0] }
+        // VBx takes the training rho as one contiguous row-major matrix: the
+        // extractor's matrix itself when every embedding trains, otherwise its
+        // training rows.
+        let rhoDimension = extraction.rhoDimension
+        let trainingRho: [Double]
+        if trainingIndices.count == timedEmbeddings.count {
+            trainingRho = extraction.rho
+        } else {
+            var rows: [Double] = []
+            rows.reserveCapacity(trainingIndices.count * rhoDimension)
+            for index in trainingIndices {
+                rows.append(contentsOf: extraction.rho(of: timedEmbeddings[index]))
+            }
+            trainingRho = rows
+        }
 
         logger.debug(
             "Clustering will use \(trainingEmbeddings.count)/\(timedEmbeddings.count) embeddings (NaN filtered)"
@@ -215,10 +231,23 @@ public final class OfflineDiarizerManager {
 
         let initialClusters: [Int]
         if trainingEmbeddings.count >= 2 {
-            initialClusters = AHCClustering().cluster(
-                embeddingFeatures: trainingEmbeddings,
-                threshold: config.clusteringThreshold
-            )
+            if config.clustering.separateChunkSpeakers {
+                initialClusters = await AHCClustering().cluster(
+                    embeddingFeatures: trainingEmbeddings,
+                    threshold: config.clusteringThreshold,
+                    mustLink: [],
+                    cannotLink: chunkCannotLinkPairs(
+                        trainingIndices: trainingIndices,
+                        timedEmbeddings: timedEmbeddings
+                    )
+                )
+            } else {
+                initialClusters = await AHCClustering().cluster(
+                    embeddingFeatures: trainingEmbeddings,
+                    threshold: config.clusteringThreshold
+                )
+            }
+            try Task.checkCancellation()
         } else {
             initialClusters = Array(repeating: 0, count: trainingEmbeddings.count)
         }
@@ -226,7 +255,8 @@ public final class OfflineDiarizerManager {
         let vbxOutput: VBxOutput
         if !trainingRho.isEmpty, !initialClusters.isEmpty {
             vbxOutput = VBxClustering(config: config, pldaTransform: pldaTransform).refine(
-                rhoFeatures: trainingRho,
+                rhoMatrix: trainingRho,
+                dimension: rhoDimension,
                 initialClusters: initialClusters
             )
         } else {
@@ -284,7 +314,7 @@ public final class OfflineDiarizerManager {
 
         if let exportPath = config.embeddingExportPath {
             try exportEmbeddings(
-                embeddings: timedEmbeddings,
+                extraction: extraction,
                 assignments: assignments,
                 path: exportPath
             )
@@ -361,7 +391,7 @@ public final class OfflineDiarizerManager {
         let extractor = OfflineEmbeddingExtractor(
             fbankModel: models.fbankModel,
             embeddingModel: models.embeddingModel,
-            pldaTransform: PLDATransform(pldaRhoModel: models.pldaRhoModel, psi: models.pldaPsi),
+            pldaTransform: makePLDATransform(models: models),
             config: config
         )
 
@@ -382,6 +412,19 @@ public final class OfflineDiarizerManager {
         )
     }
 
+    /// The native PLDA kernel runs only when the config asks for it and the
+    /// parameter file carries its tensors.
+    private func makePLDATransform(models: OfflineDiarizerModels) -> PLDATransform {
+        if config.embedding.nativePLDA && models.pldaParameters == nil {
+            logger.warning("Native PLDA requested but plda-parameters.json has no transform tensors; using Core ML")
+        }
+        return PLDATransform(
+            pldaRhoModel: models.pldaRhoModel,
+            psi: models.pldaPsi,
+            parameters: config.embedding.nativePLDA ? models.pldaParameters : nil
+        )
+    }
+
     private func selectTrainingEmbeddings(
         timedEmbeddings: [TimedEmbedding]
     ) -> [Int] {
@@ -404,6 +447,30 @@ public final class OfflineDiarizerManager {
         return selected
     }
 
+    /// Pairs of training positions whose embeddings belong to different local
+    /// speakers of the same chunk.
+    private func chunkCannotLinkPairs(
+        trainingIndices: [Int],
+        timedEmbeddings: [TimedEmbedding]
+    ) -> [(Int, Int)] {
+        var positionsByChunk: [Int: [Int]] = [:]
+        for (position, index) in trainingIndices.enumerated() {
+            positionsByChunk[timedEmbeddings[index].chunkIndex, default: []].append(position)
+        }
+
+        var pairs: [(Int, Int)] = []
+        for positions in positionsByChunk.values {
+            for (offset, first) in positions.enumerated() {
+                let firstSpeaker = timedEmbeddings[trainingIndices[first]].speakerIndex
+                for second in positions[(offset + 1)...]
+                where timedEmbeddings[trainingIndices[second]].speakerIndex != firstSpeaker {
+                    pairs.append((first, second))
+                }
+            }
+        }
+        return pairs
+    }
+
     private func computeCentroids(
         trainingEmbeddings: [[Double]],
         vbxOutput: VBxOutput,
@@ -685,7 +752,7 @@ public final class OfflineDiarizerManager {
     }
 
     private func exportEmbeddings(
-        embeddings: [TimedEmbedding],
+        extraction: OfflineEmbeddingExtraction,
         assignments: [Int],
         path: String
     ) throws {
@@ -702,8 +769,8 @@ public final class OfflineDiarizerManager {
         }
 
         var payload: [ExportPayload] = []
-        payload.reserveCapacity(embeddings.count)
-        for (index, embedding) in embeddings.enumerated() {
+        payload.reserveCapacity(extraction.embeddings.count)
+        for (index, embedding) in extraction.embeddings.enumerated() {
             let cluster =
                 assignments.indices.contains(index)
                 ? assignments[index] : -1
@@ -716,7 +783,7 @@ public final class OfflineDiarizerManager {
                     startTime: embedding.startTime,
                     endTime: embedding.endTime,
                     embedding256: embedding.embedding256,
-                    rho128: embedding.rho128,
+                    rho128: Array(extraction.rho(of: embedding)),
                     cluster: cluster
                 )
             )
@@ -9,12 +9,15 @@ public struct OfflineDiarizerModels: Sendable {
     public let embeddingModel: MLModel
     public let pldaRhoModel: MLModel
     public let pldaPsi: [Double]
+    /// Parameters for the native PLDA transform, when the parameter file
+    /// carries them.
+    public let pldaParameters: PLDAParameters?
 
     public let compilationDuration: TimeInterval
 
     private static let logger = AppLogger(category: "OfflineDiarizerModels")
 
-    private static func loadPLDAPsi(from directory: URL) throws -> [Double] {
+    private static func loadPLDATensors(from directory: URL) throws -> [String: Any] {
         let candidatePaths = [
             directory.appendingPathComponent("plda-parameters.json", isDirectory: false),
             directory.appendingPathComponent("speaker-diarization-coreml/plda-parameters.json", isDirectory: false),
@@ -29,18 +32,25 @@ public struct OfflineDiarizerModels: Sendable {
         let jsonObject = try JSONSerialization.jsonObject(with: data, options: [])
         guard
             let root = jsonObject as? [String: Any],
-            let tensors = root["tensors"] as? [String: Any],
-            let psiInfo = tensors["psi"] as? [String: Any],
-            let base64 = psiInfo["data_base64"] as? String,
+            let tensors = root["tensors"] as? [String: Any]
+        else {
+            throw OfflineDiarizationError.processingFailed("Failed to decode PLDA parameters")
+        }
+        return tensors
+    }
+
+    /// Decode a base64 float32 tensor, or nil when it is missing or empty.
+    private static func decodePLDATensor(_ name: String, in tensors: [String: Any]) -> [Double]? {
+        guard
+            let info = tensors[name] as? [String: Any],
+            let base64 = info["data_base64"] as? String,
             let decoded = Data(base64Encoded: base64, options: [.ignoreUnknownCharacters])
         else {
-            throw OfflineDiarizationError.processingFailed("Failed to decode PLDA psi parameters")
+            return nil
         }
 
         let floatCount = decoded.count / MemoryLayout<Float>.size
-        guard floatCount > 0 else {
-            throw OfflineDiarizationError.processingFailed("PLDA psi tensor is empty")
-        }
+        guard floatCount > 0 else { return nil }
 
         var floats = [Float](repeating: 0, count: floatCount)
         _ = floats.withUnsafeMutableBytes { destination in
@@ -50,12 +60,50 @@ public struct OfflineDiarizerModels: Sendable {
         return floats.map { Double($0) }
     }
 
+    private static func loadPLDAPsi(from tensors: [String: Any]) throws -> [Double] {
+        guard let psi = decodePLDATensor("psi", in: tensors) else {
+            throw OfflineDiarizationError.processingFailed("Failed to decode PLDA psi parameters")
+        }
+        return psi
+    }
+
+    /// The x-vector (mean1, mean2, lda) and PLDA (mu, tr) tensors for the
+    /// native transform. `tr` must be the rotated transform that belongs to
+    /// `psi` (see `PLDAParameters`). Parameter files without these tensors, or
+    /// whose `tr` does not span the `psi` dimension, keep the Core ML PldaRho
+    /// model.
+    private static func loadPLDAParameters(from tensors: [String: Any], psi: [Double]) -> PLDAParameters? {
+        guard
+            let inputMean = decodePLDATensor("mean1", in: tensors),
+            let lda = decodePLDATensor("lda", in: tensors),
+            let ldaMean = decodePLDATensor("mean2", in: tensors),
+            let pldaMean = decodePLDATensor("mu", in: tensors),
+            let pldaTransform = decodePLDATensor("tr", in: tensors)
+        else {
+            return nil
+        }
+        guard ldaMean.count == psi.count, pldaTransform.count == psi.count * psi.count else {
+            logger.warning(
+                "PLDA tr (\(pldaTransform.count) values) does not match psi (\(psi.count)); ignoring native parameters"
+            )
+            return nil
+        }
+        return PLDAParameters(
+            inputMean: inputMean,
+            lda: lda,
+            ldaMean: ldaMean,
+            pldaMean: pldaMean,
+            pldaTransform: pldaTransform
+        )
+    }
+
     public init(
         segmentationModel: MLModel,
         fbankModel: MLModel,
         embeddingModel: MLModel,
         pldaRhoModel: MLModel,
         pldaPsi: [Double],
+        pldaParameters: PLDAParameters? = nil,
         compilationDuration: TimeInterval
     ) {
         self.segmentationModel = segmentationModel
@@ -63,6 +111,7 @@ public struct OfflineDiarizerModels: Sendable {
         self.embeddingModel = embeddingModel
         self.pldaRhoModel = pldaRhoModel
         self.pldaPsi = pldaPsi
+        self.pldaParameters = pldaParameters
         self.compilationDuration = compilationDuration
     }
 
@@ -128,7 +177,9 @@ public struct OfflineDiarizerModels: Sendable {
             throw OfflineDiarizationError.modelNotLoaded(ModelNames.OfflineDiarizer.fbank)
         }
 
-        let pldaPsi = try loadPLDAPsi(from: modelsDirectory)
+        let pldaTensors = try loadPLDATensors(from: modelsDirectory)
+        let pldaPsi = try loadPLDAPsi(from: pldaTensors)
+        let pldaParameters = loadPLDAParameters(from: pldaTensors, psi: pldaPsi)
         let compilationDuration = Date().timeIntervalSince(loadStart)
         let compileString = String(format: "%.3f", compilationDuration)
         logger.info(
@@ -141,6 +192,7 @@ public struct OfflineDiarizerModels: Sendable {
             embeddingModel: embedding,
             pldaRhoModel: plda,
             pldaPsi: pldaPsi,
+            pldaParameters: pldaParameters,
             compilationDuration: compilationDuration
         )
     }
@@ -78,6 +78,12 @@ public struct OfflineDiarizerConfig: Sendable {
         public var excludeOverlap: Bool
         public var minSegmentDurationSeconds: Double
 
+        /// Compute rho features with the native PLDA kernel instead of the
+        /// PldaRho Core ML model. Takes effect only when plda-parameters.json
+        /// carries the transform tensors (see `PLDAParameters`), whose `tr` must
+        /// be the rotated transform that belongs to its `psi`. Off by default.
+        public var nativePLDA: Bool
+
         public static let community = Embedding(
             batchSize: 32,
             excludeOverlap: true,
@@ -87,11 +93,13 @@ public struct OfflineDiarizerConfig: Sendable {
         public init(
             batchSize: Int,
             excludeOverlap: Bool,
-            minSegmentDurationSeconds: Double
+            minSegmentDurationSeconds: Double,
+            nativePLDA: Bool = false
         ) {
             self.batchSize = batchSize
             self.excludeOverlap = excludeOverlap
             self.minSegmentDurationSeconds = minSegmentDurationSeconds
+            self.nativePLDA = nativePLDA
         }
     }
 
@@ -103,6 +111,12 @@ public struct OfflineDiarizerConfig: Sendable {
         public var warmStartFa: Double
         public var warmStartFb: Double
 
+        /// Keep the local speakers of one segmentation chunk in separate AHC
+        /// clusters. Two speakers of the same chunk are different people by
+        /// construction, so their embeddings are passed to AHC as cannot-link
+        /// pairs. Off by default, which keeps the community-1 clustering.
+        public var separateChunkSpeakers: Bool
+
         // NOTE: minClusterSize is NOT used in community-1 (VBx-based pipeline).
         // VBx is designed to handle 100+ under-clustered initial assignments from AHC
         // and naturally merge them during Bayesian refinement. Pre-merging small clusters
@@ -119,11 +133,13 @@ public struct OfflineDiarizerConfig: Sendable {
         public init(
             threshold: Double,
             warmStartFa: Double,
-            warmStartFb: Double
+            warmStartFb: Double,
+            separateChunkSpeakers: Bool = false
         ) {
             self.threshold = threshold
             self.warmStartFa = warmStartFa
             self.warmStartFb = warmStartFb
+            self.separateChunkSpeakers = separateChunkSpeakers
         }
     }
 
@@ -131,6 +147,20 @@ public struct OfflineDiarizerConfig: Sendable {
         public var maxIterations: Int
         public var convergenceTolerance: Double
 
+        /// Run VBx on Float features and responsibilities, which halves their
+        /// memory. Speaker models, log-determinants and the ELBO stay in
+        /// Double. Off by default.
+        public var singlePrecision: Bool
+
+        /// Speakers whose mixture weight falls below this after an iteration
+        /// leave the model, so later iterations only score the remaining
+        /// ones. 0 (the default) keeps every warm-start speaker.
+        public var pruneThreshold: Double
+
+        /// Also stop once no responsibility changes by this much in an
+        /// iteration. 0 (the default) stops on the ELBO only.
+        public var gammaTolerance: Double
+
         // Default values from pyannote.community-1
         public static let community = VBx(
             maxIterations: 20,
@@ -139,10 +169,16 @@ public struct OfflineDiarizerConfig: Sendable {
 
         public init(
             maxIterations: Int,
-            convergenceTolerance: Double
+            convergenceTolerance: Double,
+            singlePrecision: Bool = false,
+            pruneThreshold: Double = 0,
+            gammaTolerance: Double = 0
         ) {
             self.maxIterations = maxIterations
             self.convergenceTolerance = convergenceTolerance
+            self.singlePrecision = singlePrecision
+            self.pruneThreshold = pruneThreshold
+            self.gammaTolerance = gammaTolerance
         }
     }
 
@@ -299,6 +335,18 @@ public struct OfflineDiarizerConfig: Sendable {
             )
         }
 
+        guard vbx.pruneThreshold >= 0, vbx.pruneThreshold < 1 else {
+            throw OfflineDiarizationError.invalidConfiguration(
+                "vbx.pruneThreshold must be in [0, 1), got \(vbx.pruneThreshold)"
+            )
+        }
+
+        guard vbx.gammaTolerance >= 0 else {
+            throw OfflineDiarizationError.invalidConfiguration(
+                "vbx.gammaTolerance must be >= 0"
+            )
+        }
+
         guard embedding.minSegmentDurationSeconds >= 0 else {
             throw OfflineDiarizationError.invalidConfiguration(
                 "embedding.minSegmentDuration must be >= 0"
@@ -506,6 +554,25 @@ enum SegmentationChunkContinuation: Sendable {
 
 typealias SegmentationChunkHandler = @Sendable (SegmentationChunk) -> SegmentationChunkContinuation
 
+/// One VBx iteration, for monitoring convergence and pruning.
+@available(macOS 13.0, iOS 16.0, *)
+public struct VBxIteration: Sendable {
+    public let elbo: Double
+    /// Largest change of a responsibility in the iteration.
+    public let gammaChange: Double
+    /// Speakers in the model during the iteration.
+    public let speakerCount: Int
+    /// Speakers pruned after the iteration.
+    public let prunedSpeakers: Int
+
+    public init(elbo: Double, gammaChange: Double, speakerCount: Int, prunedSpeakers: Int) {
+        self.elbo = elbo
+        self.gammaChange = gammaChange
+        self.speakerCount = speakerCount
+        self.prunedSpeakers = prunedSpeakers
+    }
+}
+
 /// Result returned by the VBx refinement step.
 @available(macOS 13.0, iOS 16.0, *)
 public struct VBxOutput: Sendable {
@@ -515,6 +582,9 @@ public struct VBxOutput: Sendable {
     public let centroids: [[Double]]
     public let numClusters: Int
     public let elbos: [Double]
+    /// Every iteration that ran. Pruned speakers keep their column in
+    /// `gamma` with zero responsibilities and zero `pi`.
+    public let iterations: [VBxIteration]
 
     public init(
         gamma: [[Double]],
@@ -522,7 +592,8 @@ public struct VBxOutput: Sendable {
         hardClusters: [[Int]],
         centroids: [[Double]],
         numClusters: Int,
-        elbos: [Double]
+        elbos: [Double],
+        iterations: [VBxIteration] = []
     ) {
         self.gamma = gamma
         self.pi = pi
@@ -530,6 +601,7 @@ public struct VBxOutput: Sendable {
         self.centroids = centroids
         self.numClusters = numClusters
         self.elbos = elbos
+        self.iterations = iterations
     }
 }
 
@@ -544,5 +616,22 @@ struct TimedEmbedding: Sendable {
     let startTime: Double
     let endTime: Double
     let embedding256: [Float]
-    let rho128: [Double]
+    /// Row of this embedding's rho features in `OfflineEmbeddingExtraction.rho`.
+    let rhoRow: Int
+}
+
+/// Embeddings of one extraction pass with their rho features, kept as the
+/// contiguous row-major matrix the PLDA transform writes so VBx can take it
+/// without per-embedding arrays.
+@available(macOS 13.0, iOS 16.0, *)
+struct OfflineEmbeddingExtraction: Sendable {
+    let embeddings: [TimedEmbedding]
+    /// `embeddings.count x rhoDimension` rho features.
+    let rho: [Double]
+    let rhoDimension: Int
+
+    func rho(of embedding: TimedEmbedding) -> ArraySlice<Double> {
+        let start = embedding.rhoRow * rhoDimension
+        return rho[start..<(start + rhoDimension)]
+    }
 }
@@ -171,7 +171,7 @@ struct OfflineEmbeddingExtractor {
     func extractEmbeddings(
         audio: [Float],
         segmentation: SegmentationOutput
-    ) async throws -> [TimedEmbedding] {
+    ) async throws -> OfflineEmbeddingExtraction {
         try await extractEmbeddings(
             audioSource: ArrayAudioSampleSource(samples: audio),
             segmentation: segmentation
@@ -181,7 +181,7 @@ struct OfflineEmbeddingExtractor {
     func extractEmbeddings(
         audioSource: StreamingAudioSampleSource,
         segmentation: SegmentationOutput
-    ) async throws -> [TimedEmbedding] {
+    ) async throws -> OfflineEmbeddingExtraction {
         let stream = AsyncThrowingStream<SegmentationChunk, Error> { continuation in
             for chunkIndex in 0..<segmentation.numChunks {
                 guard segmentation.speakerWeights.indices.contains(chunkIndex) else { continue }
@@ -223,7 +223,7 @@ struct OfflineEmbeddingExtractor {
     func extractEmbeddings<S: AsyncSequence>(
         audioSource: StreamingAudioSampleSource,
         segmentationStream: S
-    ) async throws -> [TimedEmbedding] where S.Element == SegmentationChunk {
+    ) async throws -> OfflineEmbeddingExtraction where S.Element == SegmentationChunk {
         var embeddings: [TimedEmbedding] = []
         embeddings.reserveCapacity(config.embeddingBatchSize * 8)
 
@@ -231,9 +231,13 @@ struct OfflineEmbeddingExtractor {
 
         let maxPLDABatch = max(1, min(config.embeddingBatchSize, modelBatchLimit))
         let fbankBatchLimit = min(modelBatchLimit, 32)
-        var pendingEmbeddings: [[Float]] = []
+        // Embeddings waiting for PLDA, row after row, and their rho features
+        // for every flushed embedding, in the same order as `embeddings`.
+        var pendingEmbeddings: [Float] = []
         var pendingMetadata: [OfflineEmbeddingPending] = []
-        pendingEmbeddings.reserveCapacity(maxPLDABatch)
+        var rhoMatrix: [Double] = []
+        let rhoDimension = pldaTransform.outputDimension
+        pendingEmbeddings.reserveCapacity(maxPLDABatch * pldaTransform.inputDimension)
         pendingMetadata.reserveCapacity(maxPLDABatch)
 
         var processedMasks = 0
@@ -296,19 +300,20 @@ struct OfflineEmbeddingExtractor {
         }
 
         func flushPending() async throws {
-            guard !pendingEmbeddings.isEmpty else { return }
+            guard !pendingMetadata.isEmpty else { return }
             let pldaStart = clock.now
-            let rhoBatch = try await pldaTransform.transform(pendingEmbeddings)
+            let rhoBatch = try await pldaTransform.transformMatrix(pendingEmbeddings, count: pendingMetadata.count)
             pldaDuration += pldaStart.duration(to: clock.now)
-            pldaOutputCount += rhoBatch.count
+            pldaOutputCount += rhoBatch.count / rhoDimension
             pldaBatchCallCount += 1
-            guard rhoBatch.count == pendingMetadata.count else {
+            guard rhoBatch.count == pendingMetadata.count * rhoDimension else {
                 throw OfflineDiarizationError.processingFailed(
-                    "PldaRho batch size mismatch (expected \(pendingMetadata.count), got \(rhoBatch.count))"
+                    "PldaRho batch size mismatch (expected \(pendingMetadata.count * rhoDimension) values, "
+                        + "got \(rhoBatch.count))"
                 )
             }
 
-            for (info, rho) in zip(pendingMetadata, rhoBatch) {
+            for info in pendingMetadata {
                 let timedEmbedding = TimedEmbedding(
                     chunkIndex: info.chunkIndex,
                     speakerIndex: info.speakerIndex,
@@ -318,10 +323,11 @@ struct OfflineEmbeddingExtractor {
                     startTime: info.startTime,
                     endTime: info.endTime,
                     embedding256: info.embedding256,
-                    rho128: rho
+                    rhoRow: embeddings.count
                 )
                 embeddings.append(timedEmbedding)
             }
+            rhoMatrix.append(contentsOf: rhoBatch)
 
             pendingEmbeddings.removeAll(keepingCapacity: true)
             pendingMetadata.removeAll(keepingCapacity: true)
@@ -471,7 +477,7 @@ struct OfflineEmbeddingExtractor {
                 processedMasks += 1
                 accumulatedMaskFrames += Double(maskSum)
 
-                pendingEmbeddings.append(embedding256)
+                pendingEmbeddings.append(contentsOf: embedding256)
                 pendingMetadata.append(
                     OfflineEmbeddingPending(
                         chunkIndex: info.chunkIndex,
@@ -485,7 +491,7 @@ struct OfflineEmbeddingExtractor {
                     )
                 )
 
-                if pendingEmbeddings.count == maxPLDABatch {
+                if pendingMetadata.count == maxPLDABatch {
                     try await flushPending()
                 }
             }
@@ -613,7 +619,7 @@ struct OfflineEmbeddingExtractor {
             Self.emitProfileLog(message)
         }
 
-        return embeddings
+        return OfflineEmbeddingExtraction(embeddings: embeddings, rho: rhoMatrix, rhoDimension: rhoDimension)
     }
 
     private func runFbankModel(
@@ -3,10 +3,103 @@ import CoreML
 import Foundation
 import OSLog
 
+#if canImport(FastClusterWrapper)
+import FastClusterWrapper
+#elseif canImport(FluidAudio_FastClusterWrapper)
+import FluidAudio_FastClusterWrapper
+#endif
+
+/// The x-vector and PLDA parameters behind the PldaRho model, for the native
+/// transform. `lda` is `inputDimension x ldaDimension` and `pldaTransform`
+/// `ldaDimension x ldaDimension`, both row-major.
+///
+/// `pldaTransform` is the transform pyannote's `vbx_setup` derives, not the
+/// raw `tr` of the PLDA model: the generalized eigenvectors of the across- and
+/// within-class covariances as rows, in descending order of their
+/// eigenvalues (`wccn.T[::-1]`). Those eigenvalues are the `psi` VBx uses as
+/// phi, so the two must come from the same export. The raw `tr` gives rho in
+/// a different basis and silently wrong VBx results.
+public struct PLDAParameters: Sendable {
+    public let inputMean: [Double]
+    public let lda: [Double]
+    public let ldaMean: [Double]
+    public let pldaMean: [Double]
+    public let pldaTransform: [Double]
+
+    public var inputDimension: Int { inputMean.count }
+    public var ldaDimension: Int { ldaMean.count }
+
+    /// Returns nil when the array sizes do not describe one transform.
+    public init?(
+        inputMean: [Double],
+        lda: [Double],
+        ldaMean: [Double],
+        pldaMean: [Double],
+        pldaTransform: [Double]
+    ) {
+        let inputDimension = inputMean.count
+        let ldaDimension = ldaMean.count
+        guard
+            inputDimension > 0,
+            ldaDimension > 0,
+            lda.count == inputDimension * ldaDimension,
+            pldaMean.count == ldaDimension,
+            pldaTransform.count == ldaDimension * ldaDimension
+        else {
+            return nil
+        }
+        self.inputMean = inputMean
+        self.lda = lda
+        self.ldaMean = ldaMean
+        self.pldaMean = pldaMean
+        self.pldaTransform = pldaTransform
+    }
+}
+
+/// Owns a native PLDA engine shared by copies of a `PLDATransform`.
+private final class NativePLDAEngine: @unchecked Sendable {
+    let engine: OpaquePointer
+    let inputDimension: Int
+    let outputDimension: Int
+
+    init?(parameters: PLDAParameters) {
+        let created = parameters.inputMean.withUnsafeBufferPointer { inputMean in
+            parameters.lda.withUnsafeBufferPointer { lda in
+                parameters.ldaMean.withUnsafeBufferPointer { ldaMean in
+                    parameters.pldaMean.withUnsafeBufferPointer { pldaMean in
+                        parameters.pldaTransform.withUnsafeBufferPointer { pldaTransform in
+                            var native = fastcluster_plda_parameters(
+                                inputDimension: parameters.inputDimension,
+                                ldaDimension: parameters.ldaDimension,
+                                outputDimension: parameters.ldaDimension,
+                                inputMean: inputMean.baseAddress,
+                                lda: lda.baseAddress,
+                                ldaMean: ldaMean.baseAddress,
+                                pldaMean: pldaMean.baseAddress,
+                                pldaTransform: pldaTransform.baseAddress
+                            )
+                            return fastcluster_plda_create(&native)
+                        }
+                    }
+                }
+            }
+        }
+        guard let created else { return nil }
+        engine = created
+        inputDimension = parameters.inputDimension
+        outputDimension = parameters.ldaDimension
+    }
+
+    deinit {
+        fastcluster_plda_destroy(engine)
+    }
+}
+
 @available(macOS 14.0, iOS 17.0, *)
 public struct PLDATransform {
     private let pldaRhoModel: MLModel
     private let psi: [Double]
+    private let native: NativePLDAEngine?
     private let memoryOptimizer = ANEMemoryOptimizer()
     private let logger = AppLogger(category: "OfflinePLDA")
 
@@ -14,15 +107,29 @@ public struct PLDATransform {
     private let rhoDimension = 128
     private let maxBatchSize = 32
 
-    public init(pldaRhoModel: MLModel, psi: [Double]) {
+    /// - Parameter parameters: When given, embeddings are transformed by the
+    ///   native blocked kernel instead of the Core ML model. Parameters that
+    ///   do not map 256-dim embeddings to 128-dim rho are ignored.
+    public init(pldaRhoModel: MLModel, psi: [Double], parameters: PLDAParameters? = nil) {
         self.pldaRhoModel = pldaRhoModel
         self.psi = psi
+        let engine = parameters.flatMap { NativePLDAEngine(parameters: $0) }
+        self.native = engine?.inputDimension == 256 && engine?.outputDimension == 128 ? engine : nil
     }
 
     public var phiParameters: [Double] { psi }
 
+    /// Dimension of the input embeddings (256).
+    public var inputDimension: Int { embeddingDimension }
+
+    /// Dimension of the rho features (128).
+    public var outputDimension: Int { rhoDimension }
+
+    /// Whether `transform` runs the native kernel rather than Core ML.
+    public var usesNativeTransform: Bool { native != nil }
+
     /// Transform a sequence of 256-dimensional embeddings into 128-dimensional
-    /// PLDA-space rho features using the Core ML model exported from Pyannote.
+    /// PLDA-space rho features; see `transformMatrix(_:count:)`.
     public func transform(_ embeddings: [[Float]]) async throws -> [[Double]] {
         guard !embeddings.isEmpty else { return [] }
 
@@ -34,8 +141,40 @@ public struct PLDATransform {
             }
         }
 
-        var results: [[Double]] = []
-        results.reserveCapacity(embeddings.count)
+        let rho = try await transformMatrix(embeddings.flatMap { $0 }, count: embeddings.count)
+        return stride(from: 0, to: rho.count, by: rhoDimension).map {
+            Array(rho[$0..<($0 + rhoDimension)])
+        }
+    }
+
+    /// Convenience wrapper for single-embedding transform.
+    public func transform(_ embedding: [Float]) async throws -> [Double] {
+        guard embedding.count == embeddingDimension else {
+            throw OfflineDiarizationError.invalidConfiguration(
+                "Expected \(embeddingDimension)-dim embedding, got \(embedding.count)"
+            )
+        }
+        let transformed = try await transform([embedding])
+        return transformed.first ?? []
+    }
+
+    /// Transform `count` 256-dimensional embeddings stored row after row in
+    /// `embeddings` into `count x 128` rho features, row-major. Uses the native
+    /// kernel when the transform has parameters, and the Core ML model
+    /// exported from Pyannote otherwise. The result can be passed to
+    /// `VBxClustering.refine(rhoMatrix:dimension:initialClusters:)` as it is.
+    /// Embeddings with NaN or infinite values get NaN rows, as from Core ML.
+    public func transformMatrix(_ embeddings: [Float], count: Int) async throws -> [Double] {
+        guard count >= 0, embeddings.count == count * embeddingDimension else {
+            throw OfflineDiarizationError.invalidConfiguration(
+                "Expected \(count) x \(embeddingDimension) embedding values, got \(embeddings.count)"
+            )
+        }
+        guard count > 0 else { return [] }
+
+        if let native {
+            return try transformNative(embeddings, count: count, engine: native)
+        }
 
         do {
             try await performWarmup()
@@ -43,28 +182,57 @@ public struct PLDATransform {
             logger.debug("PLDA warmup skipped due to error: \(error.localizedDescription)")
         }
 
+        var rho: [Double] = []
+        rho.reserveCapacity(count * rhoDimension)
         var startIndex = 0
-        while startIndex < embeddings.count {
+        while startIndex < count {
             try Task.checkCancellation()
-            let endIndex = min(startIndex + maxBatchSize, embeddings.count)
-            let batch = embeddings[startIndex..<endIndex]
-            let batchResults = try await transformBatch(batch)
-            results.append(contentsOf: batchResults)
+            let endIndex = min(startIndex + maxBatchSize, count)
+            let batch = embeddings[(startIndex * embeddingDimension)..<(endIndex * embeddingDimension)]
+            rho.append(contentsOf: try await transformBatch(batch, count: endIndex - startIndex))
             startIndex = endIndex
         }
-
-        return results
+        return rho
     }
 
-    /// Convenience wrapper for single-embedding transform.
-    public func transform(_ embedding: [Float]) async throws -> [Double] {
-        guard embedding.count == embeddingDimension else {
-            throw OfflineDiarizationError.invalidConfiguration(
-                "Expected \(embeddingDimension)-dim embedding, got \(embedding.count)"
-            )
+    private func transformNative(_ embeddings: [Float], count: Int, engine: NativePLDAEngine) throws -> [Double] {
+        // The kernel rejects non-finite input, so such rows go in as zeros and
+        // come out as NaN.
+        var input = embeddings
+        var invalidRows: [Int] = []
+        for row in 0..<count {
+            let values = input[(row * embeddingDimension)..<((row + 1) * embeddingDimension)]
+            if values.contains(where: { !$0.isFinite }) {
+                invalidRows.append(row)
+                input.replaceSubrange(
+                    (row * embeddingDimension)..<((row + 1) * embeddingDimension),
+                    with: repeatElement(0, count: embeddingDimension))
+            }
         }
-        let transformed = try await transform([embedding])
-        return transformed.first ?? []
+
+        var rho = [Double](repeating: 0, count: count * rhoDimension)
+        let status = input.withUnsafeBufferPointer { data in
+            rho.withUnsafeMutableBufferPointer { output -> fastcluster_wrapper_status in
+                var matrix = fastcluster_matrix(
+                    data: UnsafeRawPointer(data.baseAddress),
+                    scalarType: FASTCLUSTER_SCALAR_FLOAT32,
+                    pointCount: count,
+                    dimension: embeddingDimension,
+                    rowStride: 0
+                )
+                return fastcluster_plda_transform(engine.engine, &matrix, output.baseAddress, output.count)
+            }
+        }
+        guard status == FASTCLUSTER_WRAPPER_SUCCESS else {
+            throw OfflineDiarizationError.processingFailed(
+                "native PLDA transform failed with status \(status.rawValue)")
+        }
+        for row in invalidRows {
+            rho.replaceSubrange(
+                (row * rhoDimension)..<((row + 1) * rhoDimension),
+                with: repeatElement(.nan, count: rhoDimension))
+        }
+        return rho
     }
 
     /// Cosine similarity score between two rho vectors.
@@ -114,30 +282,27 @@ public struct PLDATransform {
         return dot / magnitude
     }
 
-    private func transformBatch(_ embeddings: ArraySlice<[Float]>) async throws -> [[Double]] {
-        guard !embeddings.isEmpty else { return [] }
-        guard embeddings.count <= maxBatchSize else {
+    private func transformBatch(_ embeddings: ArraySlice<Float>, count: Int) async throws -> [Double] {
+        guard count > 0 else { return [] }
+        guard count <= maxBatchSize else {
             throw OfflineDiarizationError.invalidBatchSize(
-                "PldaRho batch size must be <= \(maxBatchSize), got \(embeddings.count)"
+                "PldaRho batch size must be <= \(maxBatchSize), got \(count)"
             )
         }
 
-        let shape: [NSNumber] = [NSNumber(value: embeddings.count), NSNumber(value: embeddingDimension)]
+        let shape: [NSNumber] = [NSNumber(value: count), NSNumber(value: embeddingDimension)]
         let inputArray = try memoryOptimizer.createAlignedArray(shape: shape, dataType: .float32)
         let pointer = inputArray.dataPointer.assumingMemoryBound(to: Float.self)
 
-        for (batchIndex, embedding) in embeddings.enumerated() {
-            let base = batchIndex * embeddingDimension
-            embedding.withUnsafeBufferPointer { buffer in
-                vDSP_mmov(
-                    buffer.baseAddress!,
-                    pointer.advanced(by: base),
-                    vDSP_Length(embeddingDimension),
-                    1,
-                    vDSP_Length(embeddingDimension),
-                    1
-                )
-            }
+        embeddings.withUnsafeBufferPointer { buffer in
+            vDSP_mmov(
+                buffer.baseAddress!,
+                pointer,
+                vDSP_Length(embeddingDimension),
+                vDSP_Length(count),
+                vDSP_Length(embeddingDimension),
+                vDSP_Length(embeddingDimension)
+            )
         }
 
         let provider = ZeroCopyDiarizerFeatureProvider(
@@ -153,10 +318,7 @@ public struct PLDATransform {
         }
 
         let rhoPointer = rhoArray.dataPointer.assumingMemoryBound(to: Float.self)
-        var results: [[Double]] = []
-        results.reserveCapacity(embeddings.count)
-
-        let totalRhoCount = embeddings.count * rhoDimension
+        let totalRhoCount = count * rhoDimension
         var rhoScratch = [Double](repeating: 0, count: totalRhoCount)
 
         let floatPointer = UnsafePointer<Float>(rhoPointer)
@@ -167,14 +329,7 @@ public struct PLDATransform {
             vDSP.convertElements(of: sourceBuffer, to: &destinationBuffer)
         }
 
-        for batchIndex in 0..<embeddings.count {
-            let start = batchIndex * rhoDimension
-            let end = start + rhoDimension
-            let rhoSlice = Array(rhoScratch[start..<end])
-            results.append(rhoSlice)
-        }
-
-        return results
+        return rhoScratch
     }
 
     private func performWarmup() async throws {
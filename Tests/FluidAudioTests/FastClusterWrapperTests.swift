@@ -0,0 +1,1352 @@
+import XCTest
+
+#if canImport(FastClusterWrapper)
+import FastClusterWrapper
+#elseif canImport(FluidAudio_FastClusterWrapper)
+import FluidAudio_FastClusterWrapper
+#endif
+
+/// Parity tests for the fastcluster C wrapper.
+/// Reference dendrograms come from `scipy.cluster.hierarchy.linkage` (SciPy 1.17).
+final class FastClusterWrapperTests: XCTestCase {
+
+    private let points: [[Double]] = [
+        [0.0, 0.3, -0.27],
+        [-0.89, -0.45, -0.99],
+        [0.06, 1.34, -0.49],
+        [-0.62, 0.49, 0.36],
+        [0.11, -0.93, -0.03],
+        [0.7, -1.34, -0.46],
+        [-1.9, -1.29, -1.84],
+        [-0.24, -1.27, 0.27],
+    ]
+
+    // MARK: - Helpers
+
+    private func linkage(
+        _ method: fastcluster_method,
+        metric: fastcluster_metric = FASTCLUSTER_METRIC_EUCLIDEAN,
+        threadCount: Int = 1,
+        distanceAlgorithm: fastcluster_distance_algorithm = FASTCLUSTER_DISTANCES_PAIRWISE,
+        activeSet: fastcluster_active_set = FASTCLUSTER_ACTIVE_SET_LINKED_LIST,
+        heapArity: Int = 2,
+        indexWidth: fastcluster_index_width = FASTCLUSTER_INDEX_AUTO,
+        control: fastcluster_run_control? = nil,
+        pointWeights: [Double]? = nil,
+        rows: [[Double]]? = nil,
+        workspace: OpaquePointer? = nil
+    ) -> (status: fastcluster_wrapper_status, dendrogram: [[Double]]) {
+        var options = fastcluster_linkage_options()
+        fastcluster_linkage_options_init(&options)
+        options.workspace = workspace
+        options.threadCount = threadCount
+        options.distanceAlgorithm = distanceAlgorithm
+        options.activeSet = activeSet
+        options.heapArity = heapArity
+        options.indexWidth = indexWidth
+        return runLinkage(rows: rows ?? points, options: options, control: control, pointWeights: pointWeights) {
+            data, count, dimension, options, output in
+            fastcluster_compute_linkage(
+                method, metric, data, count, dimension, options, output.baseAddress, output.count)
+        }
+    }
+
+    /// Centroid linkage of `points` under index-pair constraints (flattened pairs).
+    private func constrainedLinkage(
+        mustLink: [Int], cannotLink: [Int]
+    ) -> (status: fastcluster_wrapper_status, dendrogram: [[Double]]) {
+        var options = fastcluster_linkage_options()
+        fastcluster_linkage_options_init(&options)
+        return runLinkage(rows: points, options: options) { data, count, dimension, options, output in
+            mustLink.withUnsafeBufferPointer { mustLinkPairs in
+                cannotLink.withUnsafeBufferPointer { cannotLinkPairs in
+                    var matrix = fastcluster_matrix(
+                        data: UnsafeRawPointer(data),
+                        scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                        pointCount: count,
+                        dimension: dimension,
+                        rowStride: 0
+                    )
+                    var constraints = fastcluster_pair_constraints(
+                        mustLinkPairs: mustLinkPairs.baseAddress,
+                        mustLinkCount: mustLink.count / 2,
+                        cannotLinkPairs: cannotLinkPairs.baseAddress,
+                        cannotLinkCount: cannotLink.count / 2
+                    )
+                    return fastcluster_compute_constrained_linkage(
+                        FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_EUCLIDEAN, &matrix, &constraints, options,
+                        output.baseAddress, output.count)
+                }
+            }
+        }
+    }
+
+    /// Runs `compute` on the flattened `rows` and a dendrogram buffer, with
+    /// `options` completed by `control` and `pointWeights`, and splits the
+    /// dendrogram into its merges.
+    private func runLinkage(
+        rows: [[Double]],
+        options: fastcluster_linkage_options,
+        control: fastcluster_run_control? = nil,
+        pointWeights: [Double]? = nil,
+        _ compute: (
+            _ data: UnsafePointer<Double>?, _ count: Int, _ dimension: Int,
+            _ options: UnsafePointer<fastcluster_linkage_options>, _ output: UnsafeMutableBufferPointer<Double>
+        ) -> fastcluster_wrapper_status
+    ) -> (status: fastcluster_wrapper_status, dendrogram: [[Double]]) {
+        let flat = rows.flatMap { $0 }
+        let weights = pointWeights ?? []
+        var dendrogram = [Double](repeating: 0, count: (rows.count - 1) * 4)
+        var options = options
+        // A zeroed control (no callback, no budget) runs to completion like NULL.
+        var control = control ?? fastcluster_run_control()
+
+        let status = flat.withUnsafeBufferPointer { data in
+            weights.withUnsafeBufferPointer { weightPointer in
+                dendrogram.withUnsafeMutableBufferPointer { output in
+                    withUnsafePointer(to: &control) { controlPointer in
+                        options.control = controlPointer
+                        options.pointWeights = pointWeights == nil ? nil : weightPointer.baseAddress
+                        return withUnsafePointer(to: &options) { optionsPointer in
+                            compute(data.baseAddress, rows.count, rows[0].count, optionsPointer, output)
+                        }
+                    }
+                }
+            }
+        }
+        let merges = stride(from: 0, to: dendrogram.count, by: 4).map { Array(dendrogram[$0..<($0 + 4)]) }
+        return (status, merges)
+    }
+
+    private func assertDendrogram(
+        _ actual: [[Double]],
+        equals expected: [[Double]],
+        file: StaticString = #filePath,
+        line: UInt = #line
+    ) {
+        XCTAssertEqual(actual.count, expected.count, file: file, line: line)
+        for (actualRow, expectedRow) in zip(actual, expected) {
+            XCTAssertEqual(actualRow[0], expectedRow[0], file: file, line: line)
+            XCTAssertEqual(actualRow[1], expectedRow[1], file: file, line: line)
+            XCTAssertEqual(actualRow[2], expectedRow[2], accuracy: 1e-9, file: file, line: line)
+            XCTAssertEqual(actualRow[3], expectedRow[3], file: file, line: line)
+        }
+    }
+
+    private func cut(
+        _ dendrogram: [[Double]],
+        distance threshold: Double? = nil,
+        maxClusters: Int? = nil
+    ) -> (status: fastcluster_wrapper_status, labels: [Int32]) {
+        let flat = dendrogram.flatMap { $0 }
+        let count = dendrogram.count + 1
+        var labels = [Int32](repeating: -1, count: count)
+        let status = flat.withUnsafeBufferPointer { tree in
+            labels.withUnsafeMutableBufferPointer { output -> fastcluster_wrapper_status in
+                if let threshold {
+                    return fastcluster_cut_tree_distance(
+                        tree.baseAddress, tree.count, count, threshold, output.baseAddress, output.count)
+                }
+                return fastcluster_cut_tree_maxclust(
+                    tree.baseAddress, tree.count, count, maxClusters ?? 1, output.baseAddress, output.count)
+            }
+        }
+        return (status, labels)
+    }
+
+    private func approximate(
+        threshold: Double,
+        errorBudget: Double,
+        maxMicroClusters: Int = 0,
+        control: fastcluster_run_control? = nil
+    ) -> (status: fastcluster_wrapper_status, labels: [Int32], report: fastcluster_approximate_report) {
+        let flat = points.flatMap { $0 }
+        // A zeroed control (no callback, no budget) runs to completion like NULL.
+        var control = control ?? fastcluster_run_control()
+        var labels = [Int32](repeating: -1, count: points.count)
+        var report = fastcluster_approximate_report()
+        var parameters = fastcluster_approximate_options()
+        fastcluster_approximate_options_init(&parameters)
+        parameters.errorBudget = errorBudget
+        parameters.maxMicroClusters = maxMicroClusters
+
+        let status = flat.withUnsafeBufferPointer { data in
+            labels.withUnsafeMutableBufferPointer { output -> fastcluster_wrapper_status in
+                withUnsafePointer(to: &control) { controlPointer in
+                    var matrix = fastcluster_matrix(
+                        data: UnsafeRawPointer(data.baseAddress),
+                        scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                        pointCount: points.count,
+                        dimension: points[0].count,
+                        rowStride: 0
+                    )
+                    var options = fastcluster_linkage_options()
+                    fastcluster_linkage_options_init(&options)
+                    options.control = controlPointer
+                    return fastcluster_cluster_centroid_approximate(
+                        FASTCLUSTER_METRIC_EUCLIDEAN, &matrix, threshold, &options, &parameters,
+                        output.baseAddress, output.count, &report)
+                }
+            }
+        }
+        return (status, labels, report)
+    }
+
+    private func append(
+        _ rows: ArraySlice<[Double]>,
+        to engine: OpaquePointer
+    ) -> fastcluster_wrapper_status {
+        let flat = rows.flatMap { $0 }
+        return flat.withUnsafeBufferPointer { data in
+            var matrix = fastcluster_matrix(
+                data: UnsafeRawPointer(data.baseAddress),
+                scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                pointCount: rows.count,
+                dimension: points[0].count,
+                rowStride: 0
+            )
+            return fastcluster_incremental_append(engine, &matrix)
+        }
+    }
+
+    private func incrementalLinkage(
+        _ engine: OpaquePointer
+    ) -> (status: fastcluster_wrapper_status, dendrogram: [[Double]], report: fastcluster_incremental_report) {
+        let count = fastcluster_incremental_point_count(engine)
+        var dendrogram = [Double](repeating: 0, count: (count - 1) * 4)
+        var report = fastcluster_incremental_report()
+        let status = dendrogram.withUnsafeMutableBufferPointer { output in
+            fastcluster_incremental_linkage(engine, output.baseAddress, output.count, &report)
+        }
+        let rows = stride(from: 0, to: dendrogram.count, by: 4).map { Array(dendrogram[$0..<($0 + 4)]) }
+        return (status, rows, report)
+    }
+
+    // MARK: - SciPy Parity
+
+    func testSingleLinkageMatchesSciPy() {
+        let result = linkage(FASTCLUSTER_METHOD_SINGLE)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        assertDendrogram(
+            result.dendrogram,
+            equals: [
+                [4, 7, 0.572800139665, 2],
+                [5, 8, 0.837317144217, 3],
+                [0, 3, 0.904101764184, 2],
+                [2, 10, 1.064706532336, 3],
+                [9, 11, 1.258014308345, 6],
+                [1, 12, 1.368575902170, 7],
+                [6, 13, 1.564672489692, 8],
+            ])
+    }
+
+    func testCompleteLinkageMatchesSciPy() {
+        let result = linkage(FASTCLUSTER_METHOD_COMPLETE)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        assertDendrogram(
+            result.dendrogram,
+            equals: [
+                [4, 7, 0.572800139665, 2],
+                [0, 3, 0.904101764184, 2],
+                [5, 8, 1.192224811015, 3],
+                [2, 9, 1.381086528788, 3],
+                [1, 6, 1.564672489692, 2],
+                [10, 11, 2.755521729183, 6],
+                [12, 13, 3.546970538361, 8],
+            ])
+    }
+
+    func testAverageLinkageMatchesSciPy() {
+        let result = linkage(FASTCLUSTER_METHOD_AVERAGE)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        assertDendrogram(
+            result.dendrogram,
+            equals: [
+                [4, 7, 0.572800139665, 2],
+                [0, 3, 0.904101764184, 2],
+                [5, 8, 1.014770977616, 3],
+                [2, 9, 1.222896530562, 3],
+                [1, 6, 1.564672489692, 2],
+                [10, 11, 2.042561295542, 6],
+                [12, 13, 2.339062786227, 8],
+            ])
+    }
+
+    func testWeightedLinkageMatchesSciPy() {
+        let result = linkage(FASTCLUSTER_METHOD_WEIGHTED)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        assertDendrogram(
+            result.dendrogram,
+            equals: [
+                [4, 7, 0.572800139665, 2],
+                [0, 3, 0.904101764184, 2],
+                [5, 8, 1.014770977616, 3],
+                [2, 9, 1.222896530562, 3],
+                [1, 6, 1.564672489692, 2],
+                [10, 11, 2.243450470648, 6],
+                [12, 13, 2.409036708210, 8],
+            ])
+    }
+
+    func testWardLinkageMatchesSciPy() {
+        let result = linkage(FASTCLUSTER_METHOD_WARD)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        assertDendrogram(
+            result.dendrogram,
+            equals: [
+                [4, 7, 0.572800139665, 2],
+                [0, 3, 0.904101764184, 2],
+                [5, 8, 1.142643134725, 3],
+                [2, 9, 1.324713805570, 3],
+                [1, 6, 1.564672489692, 2],
+                [10, 12, 3.252713738814, 5],
+                [11, 13, 3.577108236178, 8],
+            ])
+    }
+
+    func testCentroidLinkageMatchesSciPy() {
+        let result = linkage(FASTCLUSTER_METHOD_CENTROID)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        assertDendrogram(
+            result.dendrogram,
+            equals: [
+                [4, 7, 0.572800139665, 2],
+                [0, 3, 0.904101764184, 2],
+                [5, 8, 0.989557982131, 3],
+                [2, 9, 1.147235808367, 3],
+                [1, 6, 1.564672489692, 2],
+                [10, 11, 1.928102118089, 6],
+                [12, 13, 2.018507424366, 8],
+            ])
+    }
+
+    func testMedianLinkageMatchesSciPy() {
+        let result = linkage(FASTCLUSTER_METHOD_MEDIAN)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        assertDendrogram(
+            result.dendrogram,
+            equals: [
+                [4, 7, 0.572800139665, 2],
+                [0, 3, 0.904101764184, 2],
+                [5, 8, 0.989557982131, 3],
+                [2, 9, 1.147235808367, 3],
+                [1, 6, 1.564672489692, 2],
+                [10, 11, 2.134530100514, 6],
+                [12, 13, 2.047063063880, 8],
+            ])
+    }
+
+    func testSquaredEuclideanAverageLinkageMatchesSciPy() {
+        let result = linkage(FASTCLUSTER_METHOD_AVERAGE, metric: FASTCLUSTER_METRIC_SQEUCLIDEAN)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        assertDendrogram(
+            result.dendrogram,
+            equals: [
+                [4, 7, 0.328100000000, 2],
+                [0, 3, 0.817400000000, 2],
+                [5, 8, 1.061250000000, 3],
+                [2, 9, 1.520500000000, 3],
+                [1, 6, 2.448200000000, 2],
+                [10, 11, 4.418577777778, 6],
+                [12, 13, 5.966316666667, 8],
+            ])
+    }
+
+    func testCentroidLinkageMatchesLegacyEntryPoint() {
+        let flat = points.flatMap { $0 }
+        var legacy = [Double](repeating: 0, count: (points.count - 1) * 4)
+        let status = flat.withUnsafeBufferPointer { data in
+            legacy.withUnsafeMutableBufferPointer { output in
+                fastcluster_compute_centroid_linkage(
+                    data.baseAddress, points.count, points[0].count, output.baseAddress, output.count)
+            }
+        }
+        XCTAssertEqual(status, FASTCLUSTER_WRAPPER_SUCCESS)
+        XCTAssertEqual(linkage(FASTCLUSTER_METHOD_CENTROID, threadCount: 4).dendrogram.flatMap { $0 }, legacy)
+    }
+
+    func testCosineMetricMatchesNormalizedEuclidean() {
+        let normalized = points.map { row -> [Double] in
+            let norm = sqrt(row.reduce(0) { $0 + $1 * $1 })
+            return row.map { $0 / norm }
+        }
+        let normalizedFlat = normalized.flatMap { $0 }
+        var expected = [Double](repeating: 0, count: (points.count - 1) * 4)
+        let expectedStatus = normalizedFlat.withUnsafeBufferPointer { data in
+            expected.withUnsafeMutableBufferPointer { output in
+                fastcluster_compute_linkage(
+                    FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_EUCLIDEAN, data.baseAddress,
+                    points.count, points[0].count, nil, output.baseAddress, output.count)
+            }
+        }
+        XCTAssertEqual(expectedStatus, FASTCLUSTER_WRAPPER_SUCCESS)
+
+        // Float rows padded to a stride of 5, read in place.
+        let stride = 5
+        var strided = [Float](repeating: .nan, count: points.count * stride)
+        for (row, values) in points.enumerated() {
+            for (column, value) in values.enumerated() {
+                strided[row * stride + column] = Float(value)
+            }
+        }
+        var actual = [Double](repeating: 0, count: expected.count)
+        let status = strided.withUnsafeBufferPointer { data in
+            actual.withUnsafeMutableBufferPointer { output -> fastcluster_wrapper_status in
+                var matrix = fastcluster_matrix(
+                    data: UnsafeRawPointer(data.baseAddress),
+                    scalarType: FASTCLUSTER_SCALAR_FLOAT32,
+                    pointCount: points.count,
+                    dimension: points[0].count,
+                    rowStride: stride
+                )
+                return fastcluster_compute_linkage_matrix(
+                    FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METRIC_COSINE, &matrix, nil,
+                    output.baseAddress, output.count)
+            }
+        }
+        XCTAssertEqual(status, FASTCLUSTER_WRAPPER_SUCCESS)
+        for index in 0..<expected.count {
+            XCTAssertEqual(actual[index], expected[index], accuracy: 1e-6)
+        }
+    }
+
+    // MARK: - Distance Matrix
+
+    func testBlockedDistanceMatrixMatchesPairwise() {
+        let flat = points.flatMap { $0 }
+        let length = points.count * (points.count - 1) / 2
+        var pairwise = [Double](repeating: 0, count: length)
+        var blocked = pairwise
+        var options = fastcluster_linkage_options()
+        fastcluster_linkage_options_init(&options)
+
+        flat.withUnsafeBufferPointer { data in
+            var matrix = fastcluster_matrix(
+                data: UnsafeRawPointer(data.baseAddress),
+                scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                pointCount: points.count,
+                dimension: points[0].count,
+                rowStride: 0
+            )
+            XCTAssertEqual(
+                fastcluster_compute_distance_matrix(
+                    FASTCLUSTER_METRIC_EUCLIDEAN, &matrix, &options, &pairwise, length),
+                FASTCLUSTER_WRAPPER_SUCCESS)
+            options.distanceAlgorithm = FASTCLUSTER_DISTANCES_BLOCKED
+            XCTAssertEqual(
+                fastcluster_compute_distance_matrix(
+                    FASTCLUSTER_METRIC_EUCLIDEAN, &matrix, &options, &blocked, length),
+                FASTCLUSTER_WRAPPER_SUCCESS)
+        }
+
+        // pdist(points)[:3]
+        XCTAssertEqual(pairwise[0], 1.368575902170, accuracy: 1e-9)
+        XCTAssertEqual(pairwise[1], 1.064706532336, accuracy: 1e-9)
+        XCTAssertEqual(pairwise[2], 0.904101764184, accuracy: 1e-9)
+        for (expected, actual) in zip(pairwise, blocked) {
+            XCTAssertEqual(actual, expected, accuracy: 1e-12)
+        }
+    }
+
+    func testBlockedDistancesKeepStoredMatrixMerges() {
+        for method in [FASTCLUSTER_METHOD_SINGLE, FASTCLUSTER_METHOD_AVERAGE, FASTCLUSTER_METHOD_WARD] {
+            let blocked = linkage(method, distanceAlgorithm: FASTCLUSTER_DISTANCES_BLOCKED)
+            XCTAssertEqual(blocked.status, FASTCLUSTER_WRAPPER_SUCCESS)
+            assertDendrogram(blocked.dendrogram, equals: linkage(method).dendrogram)
+        }
+    }
+
+    // MARK: - Distance Kernels
+
+    func testSIMDKernelsMatchScalarWithinTolerance() {
+        let original = fastcluster_get_simd_level()
+        defer { XCTAssertEqual(fastcluster_set_simd_level(original), FASTCLUSTER_WRAPPER_SUCCESS) }
+
+        let rowCount = 6
+        // Dimensions below, between and past the vector widths exercise every tail.
+        for dimension in [3, 17, 64, 257] {
+            // Well-separated rows, then near-duplicates of one row: their cosine
+            // distances cancel almost every digit inside the scaled kernels.
+            let separated = (0..<(rowCount * dimension)).map { sin(Double($0) * 0.37) + Double($0 % 5) * 0.1 }
+            let nearDuplicates = (0..<(rowCount * dimension)).map { index -> Double in
+                let column = index % dimension
+                return sin(Double(column) * 0.37) + Double(column % 5) * 0.1 + 1e-5 * sin(Double(index) * 1.3)
+            }
+            for values in [separated, nearDuplicates] {
+                let floats = values.map { Float($0) }
+                var halves = [UInt16](repeating: 0, count: floats.count)
+                XCTAssertEqual(
+                    fastcluster_convert_to_half(FASTCLUSTER_SCALAR_FLOAT16, floats, floats.count, &halves),
+                    FASTCLUSTER_WRAPPER_SUCCESS)
+
+                func distances(_ scalarType: fastcluster_scalar_type, _ metric: fastcluster_metric) -> [Double] {
+                    let length = rowCount * (rowCount - 1) / 2
+                    var out = [Double](repeating: 0, count: length)
+                    let compute = { (data: UnsafeRawPointer?) -> fastcluster_wrapper_status in
+                        var matrix = fastcluster_matrix(
+                            data: data, scalarType: scalarType, pointCount: rowCount, dimension: dimension,
+                            rowStride: 0)
+                        return fastcluster_compute_distance_matrix(metric, &matrix, nil, &out, length)
+                    }
+                    let status: fastcluster_wrapper_status
+                    switch scalarType {
+                    case FASTCLUSTER_SCALAR_FLOAT32:
+                        status = floats.withUnsafeBufferPointer { compute(UnsafeRawPointer($0.baseAddress)) }
+                    case FASTCLUSTER_SCALAR_FLOAT16:
+                        status = halves.withUnsafeBufferPointer { compute(UnsafeRawPointer($0.baseAddress)) }
+                    default:
+                        status = values.withUnsafeBufferPointer { compute(UnsafeRawPointer($0.baseAddress)) }
+                    }
+                    XCTAssertEqual(status, FASTCLUSTER_WRAPPER_SUCCESS)
+                    return out
+                }
+
+                // The cosine metric runs the scaled kernels. Float and half-precision rows accumulate in float.
+                let cases: [(fastcluster_scalar_type, fastcluster_metric, Double)] = [
+                    (FASTCLUSTER_SCALAR_FLOAT64, FASTCLUSTER_METRIC_SQEUCLIDEAN, 0x1p-53),
+                    (FASTCLUSTER_SCALAR_FLOAT64, FASTCLUSTER_METRIC_COSINE, 0x1p-53),
+                    (FASTCLUSTER_SCALAR_FLOAT32, FASTCLUSTER_METRIC_SQEUCLIDEAN, 0x1p-24),
+                    (FASTCLUSTER_SCALAR_FLOAT32, FASTCLUSTER_METRIC_COSINE, 0x1p-24),
+                    (FASTCLUSTER_SCALAR_FLOAT16, FASTCLUSTER_METRIC_SQEUCLIDEAN, 0x1p-24),
+                ]
+                for (scalarType, metric, epsilon) in cases {
+                    XCTAssertEqual(fastcluster_set_simd_level(FASTCLUSTER_SIMD_SCALAR), FASTCLUSTER_WRAPPER_SUCCESS)
+                    let reference = distances(scalarType, metric)
+                    let tolerance = 2 * Double(dimension) * epsilon
+                    for level in [FASTCLUSTER_SIMD_NEON, FASTCLUSTER_SIMD_AVX2, FASTCLUSTER_SIMD_AVX512]
+                    where fastcluster_set_simd_level(level) == FASTCLUSTER_WRAPPER_SUCCESS {
+                        for (expected, actual) in zip(reference, distances(scalarType, metric)) {
+                            XCTAssertLessThanOrEqual(
+                                abs(actual - expected), tolerance * expected,
+                                "level \(level.rawValue), type \(scalarType.rawValue), D = \(dimension)")
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // MARK: - Workspace
+
+    func testWorkspaceReuseMatchesFreshCallsAndStopsAllocating() {
+        guard let workspace = fastcluster_workspace_create(points.count, points[0].count) else {
+            return XCTFail("workspace creation failed")
+        }
+        defer { fastcluster_workspace_destroy(workspace) }
+
+        let flat = points.flatMap { $0 }
+        let methods = [FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METHOD_MEDIAN, FASTCLUSTER_METHOD_AVERAGE]
+        var allocationsAfterWarmUp = 0
+        for round in 0..<3 {
+            for method in methods {
+                var options = fastcluster_linkage_options()
+                fastcluster_linkage_options_init(&options)
+                options.workspace = workspace
+                var dendrogram = [Double](repeating: 0, count: (points.count - 1) * 4)
+                let status = flat.withUnsafeBufferPointer { data in
+                    dendrogram.withUnsafeMutableBufferPointer { output in
+                        fastcluster_compute_linkage(
+                            method, FASTCLUSTER_METRIC_EUCLIDEAN, data.baseAddress, points.count,
+                            points[0].count, &options, output.baseAddress, output.count)
+                    }
+                }
+                XCTAssertEqual(status, FASTCLUSTER_WRAPPER_SUCCESS)
+                XCTAssertEqual(dendrogram, linkage(method).dendrogram.flatMap { $0 })
+            }
+            var stats = fastcluster_workspace_stats()
+            fastcluster_workspace_get_stats(workspace, &stats)
+            XCTAssertEqual(stats.callCount, (round + 1) * methods.count)
+            if round == 0 {
+                allocationsAfterWarmUp = stats.allocationCount
+            } else {
+                XCTAssertEqual(stats.allocationCount, allocationsAfterWarmUp)
+            }
+        }
+    }
+
+    func testRecycledCentroidRowsMatchRetainedRowsAndStayBounded() {
+        // Twenty tight pairs, each with its own gap, merge first and leave N / 2
+        // merged centroids alive at once: the most the recycled rows must hold.
+        let rows = (0..<40).map { index -> [Double] in
+            let pair = Double(index / 2)
+            let offset = Double(index % 2) * 0.01 * (1 + pair * 0.05)
+            return [pair * 1.7, sin(pair) * 3, cos(pair * 0.3) + offset]
+        }
+
+        // The incremental engine keeps one centroid row per merge.
+        guard let engine = fastcluster_incremental_create(FASTCLUSTER_METRIC_EUCLIDEAN, rows[0].count) else {
+            return XCTFail("engine creation failed")
+        }
+        defer { fastcluster_incremental_destroy(engine) }
+        XCTAssertEqual(append(rows[...], to: engine), FASTCLUSTER_WRAPPER_SUCCESS)
+        let retained = incrementalLinkage(engine)
+        XCTAssertEqual(retained.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        XCTAssertEqual(linkage(FASTCLUSTER_METHOD_CENTROID, rows: rows).dendrogram, retained.dendrogram)
+
+        // Centroid rows are the only workspace buffer that scales with the
+        // dimension, so doubling it exposes how many rows were reserved.
+        func reservedBytes(repeatingColumns times: Int) -> Int {
+            guard let workspace = fastcluster_workspace_create(0, 0) else {
+                XCTFail("workspace creation failed")
+                return 0
+            }
+            defer { fastcluster_workspace_destroy(workspace) }
+            let widened = rows.map { row in (0..<times).flatMap { _ in row } }
+            XCTAssertEqual(
+                linkage(FASTCLUSTER_METHOD_CENTROID, rows: widened, workspace: workspace).status,
+                FASTCLUSTER_WRAPPER_SUCCESS)
+            var stats = fastcluster_workspace_stats()
+            fastcluster_workspace_get_stats(workspace, &stats)
+            return stats.reservedBytes
+        }
+        let rowBytes = rows[0].count * MemoryLayout<Double>.size
+        let centroidRows = (reservedBytes(repeatingColumns: 2) - reservedBytes(repeatingColumns: 1)) / rowBytes
+        XCTAssertEqual(centroidRows, rows.count / 2 + 1)
+        XCTAssertLessThan(centroidRows, rows.count - 1)
+    }
+
+    // MARK: - Batch
+
+    func testBatchMatchesIndividualCalls() {
+        let methods = [FASTCLUSTER_METHOD_SINGLE, FASTCLUSTER_METHOD_WARD, FASTCLUSTER_METHOD_CENTROID]
+        let flat = points.flatMap { $0 }
+        let length = (points.count - 1) * 4
+        var outputs = [Double](repeating: 0, count: methods.count * length)
+
+        let overall = flat.withUnsafeBufferPointer { data in
+            outputs.withUnsafeMutableBufferPointer { output -> fastcluster_wrapper_status in
+                var jobs = methods.enumerated().map { position, method in
+                    fastcluster_linkage_job(
+                        method: method,
+                        metric: FASTCLUSTER_METRIC_EUCLIDEAN,
+                        matrix: fastcluster_matrix(
+                            data: UnsafeRawPointer(data.baseAddress),
+                            scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                            pointCount: points.count,
+                            dimension: points[0].count,
+                            rowStride: 0
+                        ),
+                        dendrogramOut: output.baseAddress! + position * length,
+                        dendrogramLength: length,
+                        status: FASTCLUSTER_WRAPPER_UNKNOWN_ERROR
+                    )
+                }
+                var options = fastcluster_linkage_options()
+                fastcluster_linkage_options_init(&options)
+                options.threadCount = 2
+                let status = fastcluster_compute_linkage_batch(&jobs, jobs.count, &options)
+                XCTAssertTrue(jobs.allSatisfy { $0.status == FASTCLUSTER_WRAPPER_SUCCESS })
+                return status
+            }
+        }
+
+        XCTAssertEqual(overall, FASTCLUSTER_WRAPPER_SUCCESS)
+        for (position, method) in methods.enumerated() {
+            let slice = Array(outputs[(position * length)..<((position + 1) * length)])
+            XCTAssertEqual(slice, linkage(method).dendrogram.flatMap { $0 })
+        }
+    }
+
+    func testBatchFailureBeforeRunningMarksEveryJob() {
+        let flat = points.flatMap { $0 }
+        let length = (points.count - 1) * 4
+        var outputs = [Double](repeating: 0, count: 2 * length)
+        let weights = [Double](repeating: 1, count: points.count)
+
+        let overall = flat.withUnsafeBufferPointer { data in
+            outputs.withUnsafeMutableBufferPointer { output -> fastcluster_wrapper_status in
+                // Seeded with SUCCESS: the batch must overwrite it.
+                var jobs = (0..<2).map { position in
+                    fastcluster_linkage_job(
+                        method: FASTCLUSTER_METHOD_CENTROID,
+                        metric: FASTCLUSTER_METRIC_EUCLIDEAN,
+                        matrix: fastcluster_matrix(
+                            data: UnsafeRawPointer(data.baseAddress),
+                            scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                            pointCount: points.count,
+                            dimension: points[0].count,
+                            rowStride: 0
+                        ),
+                        dendrogramOut: output.baseAddress! + position * length,
+                        dendrogramLength: length,
+                        status: FASTCLUSTER_WRAPPER_SUCCESS
+                    )
+                }
+                return weights.withUnsafeBufferPointer { weightPointer in
+                    var options = fastcluster_linkage_options()
+                    fastcluster_linkage_options_init(&options)
+                    options.pointWeights = weightPointer.baseAddress
+                    let status = fastcluster_compute_linkage_batch(&jobs, jobs.count, &options)
+                    XCTAssertTrue(jobs.allSatisfy { $0.status == FASTCLUSTER_WRAPPER_INVALID_ARGUMENT })
+                    return status
+                }
+            }
+        }
+
+        XCTAssertEqual(overall, FASTCLUSTER_WRAPPER_INVALID_ARGUMENT)
+        XCTAssertTrue(outputs.allSatisfy { $0 == 0 })
+    }
+
+    // MARK: - Flat Clusters
+
+    func testDistanceCutMatchesSciPyFcluster() {
+        let tree = linkage(FASTCLUSTER_METHOD_CENTROID).dendrogram
+        XCTAssertEqual(cut(tree, distance: 1.0).labels, [0, 1, 2, 0, 3, 3, 4, 3])
+        XCTAssertEqual(cut(tree, distance: 1.2).labels, [0, 1, 0, 0, 2, 2, 3, 2])
+        XCTAssertEqual(cut(tree, distance: 0).labels, [0, 1, 2, 3, 4, 5, 6, 7])
+        XCTAssertEqual(cut(tree, distance: .infinity).labels, [0, 0, 0, 0, 0, 0, 0, 0])
+    }
+
+    func testDistanceCutUsesSubtreeMaximumOnInversions() {
+        // The median root merges at 2.047 below its 2.135 child; SciPy keeps
+        // the two top clusters apart at 2.1.
+        let tree = linkage(FASTCLUSTER_METHOD_MEDIAN).dendrogram
+        XCTAssertEqual(cut(tree, distance: 2.1).labels, [0, 1, 0, 0, 2, 2, 1, 2])
+    }
+
+    func testMaxclustCutMatchesSciPyFcluster() {
+        let tree = linkage(FASTCLUSTER_METHOD_CENTROID).dendrogram
+        XCTAssertEqual(cut(tree, maxClusters: 3).labels, [0, 1, 0, 0, 2, 2, 1, 2])
+        XCTAssertEqual(cut(tree, maxClusters: 2).labels, [0, 1, 0, 0, 0, 0, 1, 0])
+        XCTAssertEqual(cut(tree, maxClusters: 1).labels, [0, 0, 0, 0, 0, 0, 0, 0])
+        XCTAssertEqual(cut(tree, maxClusters: 20).labels, [0, 1, 2, 3, 4, 5, 6, 7])
+        XCTAssertEqual(cut(tree, maxClusters: 0).status, FASTCLUSTER_WRAPPER_INVALID_ARGUMENT)
+    }
+
+    func testCutRejectsMalformedDendrogram() {
+        var tree = linkage(FASTCLUSTER_METHOD_CENTROID).dendrogram
+        tree[3][1] = tree[2][0]
+        XCTAssertEqual(cut(tree, distance: 1.0).status, FASTCLUSTER_WRAPPER_INVALID_ARGUMENT)
+    }
+
+    // MARK: - Approximate Clustering
+
+    func testApproximateWithZeroBudgetMatchesExactCut() {
+        let exact = cut(linkage(FASTCLUSTER_METHOD_CENTROID).dendrogram, distance: 1.0).labels
+        let result = approximate(threshold: 1.0, errorBudget: 0, maxMicroClusters: points.count)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        XCTAssertEqual(result.report.microClusterCount, points.count)
+        XCTAssertEqual(result.report.quantizationError, 0)
+        XCTAssertEqual(result.labels, exact)
+    }
+
+    func testApproximateFallsBackToExactWhenBudgetNeedsTooManyMicroClusters() {
+        // Eight scattered points cannot meet the budget with two micro-clusters.
+        let result = approximate(threshold: 1.0, errorBudget: 0.5)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        XCTAssertEqual(result.report.microClusterCount, points.count)
+        XCTAssertEqual(result.labels, [0, 1, 2, 0, 3, 3, 4, 3])
+    }
+
+    func testApproximateHonorsMicroClusterBound() {
+        let result = approximate(threshold: 1.0, errorBudget: 0, maxMicroClusters: 3)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        XCTAssertEqual(result.report.microClusterCount, 3)
+        XCTAssertGreaterThan(result.report.quantizationError, 0)
+        XCTAssertEqual(result.labels, [0, 1, 0, 0, 2, 2, 1, 2])
+    }
+
+    // MARK: - Incremental Clustering
+
+    func testIncrementalLinkageMatchesFullRun() {
+        for metric in [FASTCLUSTER_METRIC_EUCLIDEAN, FASTCLUSTER_METRIC_COSINE] {
+            guard let engine = fastcluster_incremental_create(metric, points[0].count) else {
+                return XCTFail("engine creation failed")
+            }
+            defer { fastcluster_incremental_destroy(engine) }
+
+            XCTAssertEqual(append(points[0..<5], to: engine), FASTCLUSTER_WRAPPER_SUCCESS)
+            XCTAssertEqual(incrementalLinkage(engine).status, FASTCLUSTER_WRAPPER_SUCCESS)
+            XCTAssertEqual(append(points[5...], to: engine), FASTCLUSTER_WRAPPER_SUCCESS)
+
+            let result = incrementalLinkage(engine)
+            XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+            XCTAssertEqual(result.report.replayedMerges + result.report.recomputedMerges, points.count - 1)
+            XCTAssertGreaterThan(result.report.replayedMerges, 0)
+            XCTAssertEqual(result.dendrogram, linkage(FASTCLUSTER_METHOD_CENTROID, metric: metric).dendrogram)
+        }
+    }
+
+    func testIncrementalAppendRejectsNaN() {
+        guard let engine = fastcluster_incremental_create(FASTCLUSTER_METRIC_EUCLIDEAN, points[0].count) else {
+            return XCTFail("engine creation failed")
+        }
+        defer { fastcluster_incremental_destroy(engine) }
+
+        XCTAssertEqual(append(points[0..<4], to: engine), FASTCLUSTER_WRAPPER_SUCCESS)
+        XCTAssertEqual(append([[0, .nan, 0]], to: engine), FASTCLUSTER_WRAPPER_RUNTIME_ERROR)
+        XCTAssertEqual(fastcluster_incremental_point_count(engine), 4)
+    }
+
+    func testIncrementalRejectsSquaredEuclidean() {
+        XCTAssertNil(fastcluster_incremental_create(FASTCLUSTER_METRIC_SQEUCLIDEAN, points[0].count))
+    }
+
+    // MARK: - Run Control
+
+    private final class ProgressLog {
+        var calls: [[Int]] = []
+    }
+
+    func testProgressCallbackReportsCompletion() {
+        let log = ProgressLog()
+        let control = fastcluster_run_control(
+            callback: { context, completed, total in
+                Unmanaged<ProgressLog>.fromOpaque(context!).takeUnretainedValue().calls.append([completed, total])
+                return 0
+            },
+            context: Unmanaged.passUnretained(log).toOpaque(),
+            timeBudgetSeconds: 60
+        )
+        let result = linkage(FASTCLUSTER_METHOD_CENTROID, control: control)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        XCTAssertEqual(result.dendrogram, linkage(FASTCLUSTER_METHOD_CENTROID).dendrogram)
+        XCTAssertEqual(log.calls.first, [0, points.count - 1])
+        XCTAssertEqual(log.calls.last, [points.count - 1, points.count - 1])
+    }
+
+    func testCallbackCancelsLinkage() {
+        let control = fastcluster_run_control(callback: { _, _, _ in 1 }, context: nil, timeBudgetSeconds: 0)
+        XCTAssertEqual(linkage(FASTCLUSTER_METHOD_CENTROID, control: control).status, FASTCLUSTER_WRAPPER_CANCELLED)
+    }
+
+    func testSpentTimeBudgetStopsLinkage() {
+        let control = fastcluster_run_control(callback: nil, context: nil, timeBudgetSeconds: 1e-12)
+        XCTAssertEqual(
+            linkage(FASTCLUSTER_METHOD_CENTROID, control: control).status, FASTCLUSTER_WRAPPER_TIME_BUDGET_EXCEEDED)
+    }
+
+    func testControlReachesApproximateReduction() {
+        let log = ProgressLog()
+        let logging = fastcluster_run_control(
+            callback: { context, completed, total in
+                Unmanaged<ProgressLog>.fromOpaque(context!).takeUnretainedValue().calls.append([completed, total])
+                return 0
+            },
+            context: Unmanaged.passUnretained(log).toOpaque(),
+            timeBudgetSeconds: 0
+        )
+        let result = approximate(threshold: 1.0, errorBudget: 0, maxMicroClusters: 3, control: logging)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        XCTAssertEqual(result.labels, approximate(threshold: 1.0, errorBudget: 0, maxMicroClusters: 3).labels)
+        // The reduction checks in first, as 0 of the point merges; the linkage
+        // of the three micro-clusters then reports its own two merges.
+        XCTAssertEqual(log.calls.first, [0, points.count - 1])
+        XCTAssertEqual(log.calls.last, [2, 2])
+
+        let cancelling = fastcluster_run_control(callback: { _, _, _ in 1 }, context: nil, timeBudgetSeconds: 0)
+        XCTAssertEqual(
+            approximate(threshold: 1.0, errorBudget: 0, maxMicroClusters: 3, control: cancelling).status,
+            FASTCLUSTER_WRAPPER_CANCELLED)
+        let spent = fastcluster_run_control(callback: nil, context: nil, timeBudgetSeconds: 1e-12)
+        XCTAssertEqual(
+            approximate(threshold: 1.0, errorBudget: 0, maxMicroClusters: 3, control: spent).status,
+            FASTCLUSTER_WRAPPER_TIME_BUDGET_EXCEEDED)
+    }
+
+    // MARK: - Active Set and Heap Variants
+
+    func testDataStructureVariantsMatchDefaults() {
+        for method in [FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METHOD_MEDIAN] {
+            let reference = linkage(method).dendrogram
+            for activeSet in [FASTCLUSTER_ACTIVE_SET_LINKED_LIST, FASTCLUSTER_ACTIVE_SET_BITMAP] {
+                for heapArity in [2, 4, 8] {
+                    let result = linkage(method, activeSet: activeSet, heapArity: heapArity)
+                    XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+                    XCTAssertEqual(result.dendrogram, reference)
+                }
+            }
+        }
+    }
+
+    func testUnsupportedHeapArityRejected() {
+        XCTAssertEqual(linkage(FASTCLUSTER_METHOD_CENTROID, heapArity: 3).status, FASTCLUSTER_WRAPPER_INVALID_ARGUMENT)
+    }
+
+    // MARK: - Threaded Merge Loop
+
+    func testThreadedMergeLoopMatchesSerial() {
+        // Large enough that four threads split the scans of the merge loop.
+        let count = 1200
+        let dimension = 128
+        let flat = (0..<(count * dimension)).map { index -> Double in
+            let point = index / dimension
+            return sin(Double(index) * 0.37) + Double((point % 9) * (index % dimension % 5))
+        }
+        for method in [FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METHOD_MEDIAN] {
+            let dendrograms = [1, 4].map { threadCount -> [Double] in
+                var dendrogram = [Double](repeating: 0, count: (count - 1) * 4)
+                var options = fastcluster_linkage_options()
+                fastcluster_linkage_options_init(&options)
+                options.threadCount = threadCount
+                let status = flat.withUnsafeBufferPointer { data in
+                    dendrogram.withUnsafeMutableBufferPointer { output in
+                        fastcluster_compute_linkage(
+                            method, FASTCLUSTER_METRIC_COSINE, data.baseAddress, count, dimension, &options,
+                            output.baseAddress, output.count)
+                    }
+                }
+                XCTAssertEqual(status, FASTCLUSTER_WRAPPER_SUCCESS)
+                return dendrogram
+            }
+            XCTAssertEqual(dendrograms[0], dendrograms[1])
+        }
+    }
+
+    // MARK: - Index Width
+
+    func testWideIndexMatchesDefault() {
+        for method in [FASTCLUSTER_METHOD_SINGLE, FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METHOD_MEDIAN] {
+            for metric in [FASTCLUSTER_METRIC_EUCLIDEAN, FASTCLUSTER_METRIC_COSINE] {
+                let wide = linkage(method, metric: metric, indexWidth: FASTCLUSTER_INDEX_64)
+                XCTAssertEqual(wide.status, FASTCLUSTER_WRAPPER_SUCCESS)
+                XCTAssertEqual(wide.dendrogram, linkage(method, metric: metric).dendrogram)
+            }
+        }
+    }
+
+    // MARK: - Half Precision
+
+    func testHalfConversionRoundsToNearest() {
+        let values: [Float] = [1.0, 65520.0, -2.0]
+        var bits = [UInt16](repeating: 0, count: values.count)
+        XCTAssertEqual(fastcluster_convert_to_half(FASTCLUSTER_SCALAR_FLOAT16, values, values.count, &bits),
+                       FASTCLUSTER_WRAPPER_SUCCESS)
+        XCTAssertEqual(bits, [0x3C00, 0x7C00, 0xC000])
+        XCTAssertEqual(fastcluster_convert_to_half(FASTCLUSTER_SCALAR_BFLOAT16, values, values.count, &bits),
+                       FASTCLUSTER_WRAPPER_SUCCESS)
+        XCTAssertEqual(bits, [0x3F80, 0x4780, 0xC000])
+        XCTAssertEqual(fastcluster_convert_to_half(FASTCLUSTER_SCALAR_FLOAT32, values, values.count, &bits),
+                       FASTCLUSTER_WRAPPER_INVALID_ARGUMENT)
+    }
+
+    func testHalfPrecisionKeepsMergeOrder() {
+        let values = points.flatMap { $0 }.map { Float($0) }
+        let formats: [(fastcluster_scalar_type, Double)] = [
+            (FASTCLUSTER_SCALAR_FLOAT16, 1e-3), (FASTCLUSTER_SCALAR_BFLOAT16, 2e-2),
+        ]
+        let methods = [
+            FASTCLUSTER_METHOD_SINGLE, FASTCLUSTER_METHOD_COMPLETE, FASTCLUSTER_METHOD_AVERAGE,
+            FASTCLUSTER_METHOD_WEIGHTED, FASTCLUSTER_METHOD_WARD, FASTCLUSTER_METHOD_CENTROID,
+            FASTCLUSTER_METHOD_MEDIAN,
+        ]
+        for (scalarType, tolerance) in formats {
+            var bits = [UInt16](repeating: 0, count: values.count)
+            XCTAssertEqual(fastcluster_convert_to_half(scalarType, values, values.count, &bits),
+                           FASTCLUSTER_WRAPPER_SUCCESS)
+            for method in methods {
+                let expected = linkage(method).dendrogram
+                var actual = [Double](repeating: 0, count: (points.count - 1) * 4)
+                let status = bits.withUnsafeBufferPointer { data in
+                    actual.withUnsafeMutableBufferPointer { output -> fastcluster_wrapper_status in
+                        var matrix = fastcluster_matrix(
+                            data: UnsafeRawPointer(data.baseAddress),
+                            scalarType: scalarType,
+                            pointCount: points.count,
+                            dimension: points[0].count,
+                            rowStride: 0
+                        )
+                        return fastcluster_compute_linkage_matrix(
+                            method, FASTCLUSTER_METRIC_EUCLIDEAN, &matrix, nil, output.baseAddress, output.count)
+                    }
+                }
+                XCTAssertEqual(status, FASTCLUSTER_WRAPPER_SUCCESS)
+                for (row, reference) in expected.enumerated() {
+                    let merge = Array(actual[(row * 4)..<(row * 4 + 4)])
+                    XCTAssertEqual(merge[0], reference[0])
+                    XCTAssertEqual(merge[1], reference[1])
+                    XCTAssertEqual(merge[2], reference[2], accuracy: tolerance)
+                    XCTAssertEqual(merge[3], reference[3])
+                }
+            }
+        }
+    }
+
+    // MARK: - Constraints
+
+    func testUnconstrainedLinkageMatchesCentroid() {
+        let result = constrainedLinkage(mustLink: [], cannotLink: [])
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        assertDendrogram(result.dendrogram, equals: linkage(FASTCLUSTER_METHOD_CENTROID).dendrogram)
+    }
+
+    func testConstraintsHoldAtEveryFiniteCut() {
+        // 4 and 7 are the closest pair, and 0 and 3 merge below 1.0 without
+        // constraints.
+        let result = constrainedLinkage(mustLink: [1, 6, 4, 5], cannotLink: [0, 3, 5, 7])
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        XCTAssertEqual(result.dendrogram[0], [1, 6, 0, 2])
+        XCTAssertEqual(result.dendrogram[1], [4, 5, 0, 2])
+        XCTAssertEqual(result.dendrogram[6][2], .infinity)
+        XCTAssertEqual(cut(result.dendrogram, distance: 1.0).labels, [0, 1, 2, 3, 4, 4, 1, 5])
+        XCTAssertEqual(cut(result.dendrogram, distance: 1e300).labels, [0, 1, 0, 1, 0, 0, 1, 1])
+    }
+
+    func testContradictoryConstraintsRejected() {
+        XCTAssertEqual(constrainedLinkage(mustLink: [0, 1], cannotLink: [1, 0]).status,
+                       FASTCLUSTER_WRAPPER_INVALID_ARGUMENT)
+        XCTAssertEqual(constrainedLinkage(mustLink: [0, 8], cannotLink: []).status,
+                       FASTCLUSTER_WRAPPER_INVALID_ARGUMENT)
+    }
+
+    // MARK: - Point Weights
+
+    func testPointWeightsMatchDuplicatedPoints() {
+        // Point 0 three times and point 5 twice, against weights 3 and 2.
+        let duplicated = [points[0], points[0], points[5]] + points
+        let weights: [Double] = [3, 1, 1, 1, 1, 2, 1, 1]
+        for method in [FASTCLUSTER_METHOD_CENTROID, FASTCLUSTER_METHOD_AVERAGE, FASTCLUSTER_METHOD_WARD] {
+            let full = linkage(method, rows: duplicated)
+            let weighted = linkage(method, pointWeights: weights)
+            XCTAssertEqual(full.status, FASTCLUSTER_WRAPPER_SUCCESS)
+            XCTAssertEqual(weighted.status, FASTCLUSTER_WRAPPER_SUCCESS)
+            let fullHeights = full.dendrogram.map { $0[2] }
+            // The copies merge first, at height 0.
+            XCTAssertEqual(Array(fullHeights.prefix(3)), [0, 0, 0])
+            for (expected, actual) in zip(fullHeights.dropFirst(3), weighted.dendrogram.map { $0[2] }) {
+                XCTAssertEqual(actual, expected, accuracy: 1e-12)
+            }
+        }
+    }
+
+    func testNonPositivePointWeightRejected() {
+        let weights: [Double] = [1, 1, 0, 1, 1, 1, 1, 1]
+        XCTAssertEqual(
+            linkage(FASTCLUSTER_METHOD_CENTROID, pointWeights: weights).status, FASTCLUSTER_WRAPPER_INVALID_ARGUMENT)
+    }
+
+    func testNonEuclideanMetricRejectedForWard() {
+        let result = linkage(FASTCLUSTER_METHOD_WARD, metric: FASTCLUSTER_METRIC_SQEUCLIDEAN)
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_INVALID_ARGUMENT)
+    }
+
+    // MARK: - VBx
+
+    private func vbx(gammaLength: Int? = nil, singlePrecision: Bool = false) -> (
+        status: fastcluster_wrapper_status, gamma: [Double], pi: [Double], elbos: [Double]
+    ) {
+        // Even rows moved to x = +20 and odd rows to x = -20; row 7 starts in
+        // the wrong cluster.
+        let rows = points.enumerated().flatMap { index, row in
+            [row[0] + (index % 2 == 0 ? 20 : -20), row[1], row[2]]
+        }
+        let labels = [0, 1, 0, 1, 0, 1, 0, 0]
+        var gamma = [Double](repeating: 0, count: gammaLength ?? points.count * 2)
+        for (index, label) in labels.enumerated() where index * 2 + label < gamma.count {
+            gamma[index * 2 + label] = 1
+        }
+        let phi: [Double] = [1, 1, 1]
+        var pi = [Double](repeating: 0, count: 2)
+        var elbos = [Double](repeating: 0, count: 20)
+        var report = fastcluster_vbx_report()
+        var options = fastcluster_vbx_options()
+        fastcluster_vbx_options_init(&options)
+        let status = rows.withUnsafeBufferPointer { rowPointer in
+            var matrix = fastcluster_matrix(
+                data: UnsafeRawPointer(rowPointer.baseAddress),
+                scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                pointCount: points.count,
+                dimension: 3,
+                rowStride: 0
+            )
+            guard singlePrecision else {
+                return fastcluster_compute_vbx(&matrix, phi, 2, &options, &gamma, gamma.count, &pi, &elbos,
+                                               elbos.count, &report)
+            }
+            var floatGamma = gamma.map { Float($0) }
+            defer { gamma = floatGamma.map { Double($0) } }
+            return fastcluster_compute_vbx_f32(&matrix, phi, 2, &options, &floatGamma, floatGamma.count, &pi, &elbos,
+                                               elbos.count, &report)
+        }
+        return (status, gamma, pi, Array(elbos.prefix(report.iterations)))
+    }
+
+    func testVBxCorrectsMislabelledFrame() {
+        let result = vbx()
+        XCTAssertEqual(result.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        let labels = (0..<points.count).map { result.gamma[$0 * 2] > result.gamma[$0 * 2 + 1] ? 0 : 1 }
+        XCTAssertEqual(labels, [0, 1, 0, 1, 0, 1, 0, 1])
+        XCTAssertEqual(result.pi[0], 0.5, accuracy: 1e-6)
+        XCTAssertEqual(result.pi[1], 0.5, accuracy: 1e-6)
+        XCTAssertFalse(result.elbos.isEmpty)
+        XCTAssertLessThanOrEqual(result.elbos.count, 20)
+    }
+
+    func testSinglePrecisionVBxMatchesDouble() {
+        let double = vbx()
+        let single = vbx(singlePrecision: true)
+        XCTAssertEqual(single.status, FASTCLUSTER_WRAPPER_SUCCESS)
+        for (expected, actual) in zip(double.gamma, single.gamma) {
+            XCTAssertEqual(actual, expected, accuracy: 1e-5)
+        }
+        for (expected, actual) in zip(double.pi, single.pi) {
+            XCTAssertEqual(actual, expected, accuracy: 1e-6)
+        }
+        for (expected, actual) in zip(double.elbos, single.elbos) {
+            XCTAssertEqual(actual, expected, accuracy: 1e-6 * abs(expected))
+        }
+    }
+
+    func testVBxThreadCountDoesNotChangeResult() {
+        // 10,000 frames in turns of 50 over 4 speakers: several E-step shards.
+        let frameCount = 10_000
+        let dimension = 16
+        let speakerCount = 4
+        let rows = (0..<frameCount).flatMap { frame -> [Double] in
+            let speaker = (frame / 50) % speakerCount
+            return (0..<dimension).map { d in
+                (d % speakerCount == speaker ? 3.0 : 0.0) + sin(Double(frame * dimension + d) * 0.7)
+            }
+        }
+        let phi = [Double](repeating: 2, count: dimension)
+        func run(threads: Int) -> (gamma: [Double], elbos: [Double]) {
+            var gamma = [Double](repeating: 0, count: frameCount * speakerCount)
+            for frame in 0..<frameCount {
+                gamma[frame * speakerCount + (frame / 70) % speakerCount] = 1
+            }
+            var pi = [Double](repeating: 0, count: speakerCount)
+            var elbos = [Double](repeating: 0, count: 20)
+            var report = fastcluster_vbx_report()
+            var options = fastcluster_vbx_options()
+            fastcluster_vbx_options_init(&options)
+            options.threadCount = threads
+            let status = rows.withUnsafeBufferPointer { rowPointer in
+                var matrix = fastcluster_matrix(
+                    data: UnsafeRawPointer(rowPointer.baseAddress),
+                    scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                    pointCount: frameCount,
+                    dimension: dimension,
+                    rowStride: 0
+                )
+                return fastcluster_compute_vbx(&matrix, phi, speakerCount, &options, &gamma, gamma.count, &pi,
+                                               &elbos, elbos.count, &report)
+            }
+            XCTAssertEqual(status, FASTCLUSTER_WRAPPER_SUCCESS)
+            return (gamma, Array(elbos.prefix(report.iterations)))
+        }
+
+        let serial = run(threads: 1)
+        let threaded = run(threads: 4)
+        XCTAssertEqual(serial.gamma, threaded.gamma)
+        XCTAssertEqual(serial.elbos, threaded.elbos)
+    }
+
+    func testVBxPrunesCollapsedSpeaker() {
+        // Row 7 starts alone in a third cluster, which loses it in the first
+        // iteration and is pruned.
+        let rows = points.enumerated().flatMap { index, row in
+            [row[0] + (index % 2 == 0 ? 20 : -20), row[1], row[2]]
+        }
+        let labels = [0, 1, 0, 1, 0, 1, 0, 2]
+        let phi: [Double] = [1, 1, 1]
+        func run(pruneThreshold: Double, gammaTolerance: Double) -> (
+            gamma: [Double], pi: [Double], history: [fastcluster_vbx_iteration], report: fastcluster_vbx_report
+        ) {
+            var gamma = [Double](repeating: 0, count: points.count * 3)
+            for (index, label) in labels.enumerated() {
+                gamma[index * 3 + label] = 1
+            }
+            var pi = [Double](repeating: 0, count: 3)
+            var history = [fastcluster_vbx_iteration](repeating: fastcluster_vbx_iteration(), count: 20)
+            var report = fastcluster_vbx_report()
+            var options = fastcluster_vbx_options()
+            fastcluster_vbx_options_init(&options)
+            options.pruneThreshold = pruneThreshold
+            options.gammaTolerance = gammaTolerance
+            let status = rows.withUnsafeBufferPointer { rowPointer in
+                history.withUnsafeMutableBufferPointer { historyPointer in
+                    options.history = historyPointer.baseAddress
+                    options.historyLength = historyPointer.count
+                    var matrix = fastcluster_matrix(
+                        data: UnsafeRawPointer(rowPointer.baseAddress),
+                        scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                        pointCount: points.count,
+                        dimension: 3,
+                        rowStride: 0
+                    )
+                    return fastcluster_compute_vbx(&matrix, phi, 3, &options, &gamma, gamma.count, &pi, nil, 0,
+                                                   &report)
+                }
+            }
+            XCTAssertEqual(status, FASTCLUSTER_WRAPPER_SUCCESS)
+            return (gamma, pi, Array(history.prefix(report.iterations)), report)
+        }
+
+        let pruned = run(pruneThreshold: 0.2, gammaTolerance: 0)
+        XCTAssertEqual(pruned.report.speakerCount, 2)
+        XCTAssertEqual(pruned.history.first?.speakerCount, 3)
+        XCTAssertEqual(pruned.history.first?.prunedSpeakers, 1)
+        XCTAssertEqual(pruned.history.last?.speakerCount, 2)
+        XCTAssertEqual(pruned.pi[2], 0)
+        XCTAssertEqual(pruned.pi[0] + pruned.pi[1], 1, accuracy: 1e-12)
+        for frame in 0..<points.count {
+            XCTAssertEqual(pruned.gamma[frame * 3 + 2], 0)
+            XCTAssertEqual(pruned.gamma[frame * 3] + pruned.gamma[frame * 3 + 1], 1, accuracy: 1e-12)
+            XCTAssertGreaterThan(pruned.gamma[frame * 3 + frame % 2], 0.5)
+        }
+
+        let early = run(pruneThreshold: 0, gammaTolerance: 0.5)
+        XCTAssertEqual(early.report.stopReason, FASTCLUSTER_VBX_STOP_GAMMA)
+        XCTAssertEqual(early.report.speakerCount, 3)
+        XCTAssertEqual(early.history.count, 2)
+        XCTAssertLessThan(early.history[1].gammaChange, 0.5)
+    }
+
+    /// ELBO, pi and gamma trajectory of the Accelerate implementation that the
+    /// native engine replaced, on 12 frames of 4 dimensions with 3 speakers.
+    /// Frames 10 and 11 start with speaker 0 and move to speakers 1 and 2.
+    func testVBxMatchesRecordedAccelerateTrajectory() {
+        let frameCount = 12
+        let dimension = 4
+        let speakerCount = 3
+        let rows = (0..<frameCount).flatMap { t in
+            (0..<dimension).map { d in
+                Double((t * 7 + d * 3) % 11 - 5) / 4.0 + (t % 3 == d % 3 ? 3.0 : 0.0)
+            }
+        }
+        let labels = [0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 0, 0]
+        var gamma = [Double](repeating: 0, count: frameCount * speakerCount)
+        for (index, label) in labels.enumerated() {
+            gamma[index * speakerCount + label] = 1
+        }
+        let phi: [Double] = [2, 1, 0.5, 0.25]
+        var pi = [Double](repeating: 0, count: speakerCount)
+        var elbos = [Double](repeating: 0, count: 10)
+        var report = fastcluster_vbx_report()
+        var options = fastcluster_vbx_options()
+        fastcluster_vbx_options_init(&options)
+        options.maxIterations = 10
+        options.convergenceTolerance = 1e-12
+        options.Fa = 0.4
+        options.Fb = 2
+        options.initSmoothing = 7
+        let status = rows.withUnsafeBufferPointer { rowPointer in
+            var matrix = fastcluster_matrix(
+                data: UnsafeRawPointer(rowPointer.baseAddress),
+                scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                pointCount: frameCount,
+                dimension: dimension,
+                rowStride: 0
+            )
+            return fastcluster_compute_vbx(&matrix, phi, speakerCount, &options, &gamma, gamma.count, &pi, &elbos,
+                                           elbos.count, &report)
+        }
+        XCTAssertEqual(status, FASTCLUSTER_WRAPPER_SUCCESS)
+        XCTAssertEqual(report.iterations, 10)
+
+        let expectedElbos = [
+            -66.75889392442838, -66.0819315887401, -66.0084582473, -65.98859724829016, -65.98018640148129,
+            -65.97409337901192, -65.96815104220933, -65.96159035689743, -65.95378122535902, -65.94383616859582,
+        ]
+        let expectedPi = [0.3463245026817274, 0.39864147716285686, 0.2550340201554157]
+        let expectedGamma = [
+            0.7954299973408538, 0.1056718344940123, 0.09889816816513378,
+            0.04518627290611837, 0.8834045820694638, 0.0714091450244177,
+            0.0680149191565426, 0.33023002124610146, 0.6017550595973559,
+            0.9715742013190932, 0.01658791548163264, 0.01183788319927412,
+            0.04183864904363552, 0.8799737208249154, 0.0781876301314491,
+            0.05993151629099421, 0.31304484408035327, 0.6270236396286526,
+            0.9682642232176242, 0.01778478617912262, 0.013950990603253,
+            0.03870401526559981, 0.8757638120849977, 0.08553217264940247,
+            0.09233908284885754, 0.27292994766785794, 0.6347309694832844,
+            0.9645075423149994, 0.01905896508083493, 0.01643349260416575,
+            0.02885869466609649, 0.8109018793778224, 0.16023942595608107,
+            0.08124491781031307, 0.2583454173671677, 0.6604096648225191,
+        ]
+        for (value, expected) in zip(elbos, expectedElbos) {
+            XCTAssertEqual(value, expected, accuracy: 1e-10)
+        }
+        for (value, expected) in zip(pi, expectedPi) {
+            XCTAssertEqual(value, expected, accuracy: 1e-12)
+        }
+        for (value, expected) in zip(gamma, expectedGamma) {
+            XCTAssertEqual(value, expected, accuracy: 1e-12)
+        }
+    }
+
+    func testVBxRejectsShortGamma() {
+        XCTAssertEqual(vbx(gammaLength: points.count * 2 - 1).status, FASTCLUSTER_WRAPPER_OUTPUT_TOO_SMALL)
+    }
+
+    // MARK: - PLDA
+
+    private let pldaInputMean: [Double] = [0.5, -0.25, 1]
+    private let pldaLDA: [Double] = [1, 0.5, -0.5, 2, 0.25, 1]  // 3 x 2
+    private let pldaLDAMean: [Double] = [0.1, -0.2]
+    private let pldaMean: [Double] = [0.3, 0.05]
+    private let pldaTransform: [Double] = [2, 1, -1, 0.5]  // 2 x 2
+
+    private func makePLDAEngine(outputDimension: Int = 2) -> OpaquePointer? {
+        pldaInputMean.withUnsafeBufferPointer { inputMean in
+            pldaLDA.withUnsafeBufferPointer { lda in
+                pldaLDAMean.withUnsafeBufferPointer { ldaMean in
+                    pldaMean.withUnsafeBufferPointer { mean in
+                        pldaTransform.withUnsafeBufferPointer { transform in
+                            var parameters = fastcluster_plda_parameters(
+                                inputDimension: 3, ldaDimension: 2, outputDimension: outputDimension,
+                                inputMean: inputMean.baseAddress, lda: lda.baseAddress,
+                                ldaMean: ldaMean.baseAddress, pldaMean: mean.baseAddress,
+                                pldaTransform: transform.baseAddress)
+                            return fastcluster_plda_create(&parameters)
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    /// The pyannote formula, one embedding at a time.
+    private func referencePLDA(_ row: [Double]) -> [Double] {
+        func normalized(_ vector: [Double]) -> [Double] {
+            let norm = sqrt(vector.reduce(0) { $0 + $1 * $1 })
+            return vector.map { $0 * sqrt(Double(vector.count)) / norm }
+        }
+        let u = normalized(zip(row, pldaInputMean).map { $0 - $1 })
+        let projected = (0..<2).map { j in (0..<3).reduce(0.0) { $0 + u[$1] * pldaLDA[$1 * 2 + j] } }
+        let y = zip(normalized(zip(projected, pldaLDAMean).map { $0 - $1 }), pldaMean).map { $0 - $1 }
+        return (0..<2).map { k in y[0] * pldaTransform[k * 2] + y[1] * pldaTransform[k * 2 + 1] }
+    }
+
+    func testPLDATransformMatchesReference() throws {
+        let engine = try XCTUnwrap(makePLDAEngine())
+        defer { fastcluster_plda_destroy(engine) }
+        // Float rows padded to a stride of 4.
+        let rows = points.flatMap { $0.map { Float($0) } + [.nan] }
+        var rho = [Double](repeating: 0, count: points.count * 2)
+        let status = rows.withUnsafeBufferPointer { rowPointer in
+            var matrix = fastcluster_matrix(
+                data: UnsafeRawPointer(rowPointer.baseAddress),
+                scalarType: FASTCLUSTER_SCALAR_FLOAT32,
+                pointCount: points.count,
+                dimension: 3,
+                rowStride: 4
+            )
+            return fastcluster_plda_transform(engine, &matrix, &rho, rho.count)
+        }
+        XCTAssertEqual(status, FASTCLUSTER_WRAPPER_SUCCESS)
+        for (index, row) in points.enumerated() {
+            let expected = referencePLDA(row.map { Double(Float($0)) })
+            XCTAssertEqual(rho[index * 2], expected[0], accuracy: 1e-12)
+            XCTAssertEqual(rho[index * 2 + 1], expected[1], accuracy: 1e-12)
+        }
+    }
+
+    func testPLDARejectsInvalidParametersAndShortOutput() throws {
+        XCTAssertNil(makePLDAEngine(outputDimension: 3))
+        let engine = try XCTUnwrap(makePLDAEngine())
+        defer { fastcluster_plda_destroy(engine) }
+        let rows = points.flatMap { $0 }
+        var rho = [Double](repeating: 0, count: points.count * 2 - 1)
+        let status = rows.withUnsafeBufferPointer { rowPointer in
+            var matrix = fastcluster_matrix(
+                data: UnsafeRawPointer(rowPointer.baseAddress),
+                scalarType: FASTCLUSTER_SCALAR_FLOAT64,
+                pointCount: points.count,
+                dimension: 3,
+                rowStride: 0
+            )
+            return fastcluster_plda_transform(engine, &matrix, &rho, rho.count)
+        }
+        XCTAssertEqual(status, FASTCLUSTER_WRAPPER_OUTPUT_TOO_SMALL)
+    }
+}
@@ -247,6 +247,32 @@ final class OfflineTypesTests: XCTestCase {
     }
 }
 
+final class AHCClusteringTests: XCTestCase {
+
+    private let session: [[Double]] = [
+        [1, 0, 0],
+        [0.99, 0.1, 0],
+        [0, 1, 0],
+        [0.05, 0.98, 0],
+    ]
+
+    func testBatchMatchesSingleSessionClustering() async {
+        let ahc = AHCClustering()
+        let results = ahc.cluster(batch: [session, session], threshold: 0.6)
+        let expected = await ahc.cluster(embeddingFeatures: session, threshold: 0.6)
+        XCTAssertEqual(results, [expected, expected])
+        XCTAssertEqual(expected, [0, 0, 1, 1])
+    }
+
+    func testBatchFallsBackToSingletonsForFailedSession() {
+        var broken = session
+        broken[2][1] = .nan
+        let results = AHCClustering().cluster(batch: [session, broken], threshold: 0.6)
+        XCTAssertEqual(results[0], [0, 0, 1, 1])
+        XCTAssertEqual(results[1], [0, 1, 2, 3])
+    }
+}
+
 @available(macOS 13.0, iOS 16.0, *)
 final class ModelWarmupTests: XCTestCase {
 